@@ -163,6 +163,9 @@ static int restore_tty;
 
 #if HAVE_PTHREADS
 static void free_input_threads(void);
+static void free_encoder_threads(void);
+static void free_filtergraph_threads(void);
+static void free_decoder_threads(void);
 #endif
 
 /* sub2video hack:
@@ -482,6 +485,11 @@ static void ffmpeg_cleanup(int ret)
         av_log(NULL, AV_LOG_INFO, "bench: maxrss=%ikB\n", maxrss);
     }
 
+#if HAVE_PTHREADS
+    free_decoder_threads();
+    free_filtergraph_threads();
+#endif
+
     for (i = 0; i < nb_filtergraphs; i++) {
         FilterGraph *fg = filtergraphs[i];
         avfilter_graph_free(&fg->graph);
@@ -523,6 +531,10 @@ static void ffmpeg_cleanup(int ret)
 
     av_freep(&subtitle_out);
 
+#if HAVE_PTHREADS
+    free_encoder_threads();
+#endif
+
     /* close files */
     for (i = 0; i < nb_output_files; i++) {
         OutputFile *of = output_files[i];
@@ -886,6 +898,399 @@ finish:
     }
 }
 
+#if HAVE_PTHREADS
+static void free_frame_msg(void *msg)
+{
+    av_frame_free((AVFrame **)msg);
+}
+
+static void *encoder_thread(void *arg)
+{
+    OutputStream *ost = arg;
+    AVCodecContext *enc = ost->enc_ctx;
+    const char *type = av_get_media_type_string(enc->codec_type);
+    AVFrame *frame;
+    AVPacket pkt;
+    int ret;
+
+    while ((ret = av_thread_message_queue_recv(ost->enc_thread_queue, &frame, 0)) >= 0) {
+        int64_t frame_pts = frame->pts;
+
+        if (debug_ts) {
+            av_log(NULL, AV_LOG_INFO, "encoder <- type:%s "
+                   "frame_pts:%s frame_pts_time:%s time_base:%d/%d\n", type,
+                   av_ts2str(frame->pts), av_ts2timestr(frame->pts, &enc->time_base),
+                   enc->time_base.num, enc->time_base.den);
+        }
+
+        /* set here rather than by reap_filters(), as the encoder reads it */
+        if (enc->codec_type == AVMEDIA_TYPE_VIDEO && !ost->frame_aspect_ratio.num)
+            enc->sample_aspect_ratio = frame->sample_aspect_ratio;
+
+        ret = avcodec_send_frame(enc, frame);
+        av_frame_free(&frame);
+
+        while (ret >= 0) {
+            av_init_packet(&pkt);
+            pkt.data = NULL;
+            pkt.size = 0;
+
+            ret = avcodec_receive_packet(enc, &pkt);
+            if (ret == AVERROR(EAGAIN)) {
+                ret = 0;
+                break;
+            }
+            if (ret < 0)
+                break;
+
+            if (debug_ts) {
+                av_log(NULL, AV_LOG_INFO, "encoder -> type:%s "
+                       "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s\n", type,
+                       av_ts2str(pkt.pts), av_ts2timestr(pkt.pts, &enc->time_base),
+                       av_ts2str(pkt.dts), av_ts2timestr(pkt.dts, &enc->time_base));
+            }
+
+            if (enc->codec_type == AVMEDIA_TYPE_VIDEO && pkt.pts == AV_NOPTS_VALUE &&
+                !(enc->codec->capabilities & AV_CODEC_CAP_DELAY))
+                pkt.pts = frame_pts;
+
+            pthread_mutex_lock(&ost->enc_pkt_lock);
+            if (av_fifo_space(ost->enc_pkt_queue) < sizeof(pkt))
+                ret = av_fifo_grow(ost->enc_pkt_queue, av_fifo_size(ost->enc_pkt_queue));
+            if (ret >= 0)
+                av_fifo_generic_write(ost->enc_pkt_queue, &pkt, sizeof(pkt), NULL);
+            else
+                av_packet_unref(&pkt);
+            pthread_mutex_unlock(&ost->enc_pkt_lock);
+        }
+        if (ret < 0)
+            break;
+    }
+
+    if (ret < 0 && ret != AVERROR_EOF) {
+        pthread_mutex_lock(&ost->enc_pkt_lock);
+        ost->enc_thread_ret = ret;
+        pthread_mutex_unlock(&ost->enc_pkt_lock);
+        av_thread_message_queue_set_err_send(ost->enc_thread_queue, ret);
+    }
+
+    return NULL;
+}
+
+/*
+ * Encoder threads only pay off when several streams are encoded concurrently.
+ */
+static int nb_threaded_encoders(void)
+{
+    int i, nb = 0;
+
+    for (i = 0; i < nb_output_streams; i++) {
+        OutputStream *ost = output_streams[i];
+        if (ost->encoding_needed &&
+            (ost->enc->type == AVMEDIA_TYPE_VIDEO ||
+             ost->enc->type == AVMEDIA_TYPE_AUDIO))
+            nb++;
+    }
+    return nb;
+}
+
+static int init_encoder_thread(OutputStream *ost)
+{
+    int ret;
+
+    ost->enc_pkt_queue = av_fifo_alloc(8 * sizeof(AVPacket));
+    if (!ost->enc_pkt_queue)
+        return AVERROR(ENOMEM);
+
+    ret = av_thread_message_queue_alloc(&ost->enc_thread_queue,
+                                        enc_thread_queue_size, sizeof(AVFrame *));
+    if (ret < 0) {
+        av_fifo_freep(&ost->enc_pkt_queue);
+        return ret;
+    }
+    av_thread_message_queue_set_free_func(ost->enc_thread_queue, free_frame_msg);
+
+    pthread_mutex_init(&ost->enc_pkt_lock, NULL);
+    if ((ret = pthread_create(&ost->enc_thread, NULL, encoder_thread, ost))) {
+        av_log(NULL, AV_LOG_ERROR, "pthread_create failed: %s. Try to increase `ulimit -v` or decrease `ulimit -s`.\n", strerror(ret));
+        pthread_mutex_destroy(&ost->enc_pkt_lock);
+        av_thread_message_queue_free(&ost->enc_thread_queue);
+        av_fifo_freep(&ost->enc_pkt_queue);
+        return AVERROR(ret);
+    }
+    return 0;
+}
+
+/*
+ * Mux the packets returned so far by the encoder thread of ost.
+ */
+static void output_encoded_packets(OutputFile *of, OutputStream *ost)
+{
+    AVPacket pkt;
+    int ret;
+
+    while (1) {
+        pthread_mutex_lock(&ost->enc_pkt_lock);
+        ret = ost->enc_thread_ret;
+        if (!av_fifo_size(ost->enc_pkt_queue)) {
+            pthread_mutex_unlock(&ost->enc_pkt_lock);
+            break;
+        }
+        av_fifo_generic_read(ost->enc_pkt_queue, &pkt, sizeof(pkt), NULL);
+        pthread_mutex_unlock(&ost->enc_pkt_lock);
+
+        /* mux_timebase may change until the header is written */
+        av_packet_rescale_ts(&pkt, ost->enc_ctx->time_base, ost->mux_timebase);
+        output_packet(of, &pkt, ost, 0);
+    }
+
+    if (ret < 0) {
+        av_log(NULL, AV_LOG_FATAL, "%s encoding failed: %s\n",
+               av_get_media_type_string(ost->enc_ctx->codec_type), av_err2str(ret));
+        exit_program(1);
+    }
+}
+
+/*
+ * Queue a reference to frame for encoding by the encoder thread of ost,
+ * waiting while the queue is full.
+ */
+static void send_frame_to_encoder_thread(OutputFile *of, OutputStream *ost,
+                                         AVFrame *frame)
+{
+    AVFrame *msg = av_frame_clone(frame);
+    int ret;
+
+    if (!msg) {
+        av_log(NULL, AV_LOG_FATAL, "Failed to allocate a frame for encoding\n");
+        exit_program(1);
+    }
+
+    ret = av_thread_message_queue_send(ost->enc_thread_queue, &msg, 0);
+    if (ret < 0)
+        av_frame_free(&msg);
+
+    output_encoded_packets(of, ost);
+}
+
+/*
+ * Let the encoder thread of ost encode all the queued frames, join it and
+ * mux the remaining packets. If abort is set, the queued frames and packets
+ * are discarded instead.
+ */
+static void stop_encoder_thread(OutputStream *ost, int abort)
+{
+    AVPacket pkt;
+
+    if (!ost->enc_thread_queue)
+        return;
+
+    if (abort)
+        av_thread_message_flush(ost->enc_thread_queue);
+    av_thread_message_queue_set_err_recv(ost->enc_thread_queue, AVERROR_EOF);
+    pthread_join(ost->enc_thread, NULL);
+    av_thread_message_queue_free(&ost->enc_thread_queue);
+
+    if (!abort)
+        output_encoded_packets(output_files[ost->file_index], ost);
+
+    while (av_fifo_size(ost->enc_pkt_queue)) {
+        av_fifo_generic_read(ost->enc_pkt_queue, &pkt, sizeof(pkt), NULL);
+        av_packet_unref(&pkt);
+    }
+    av_fifo_freep(&ost->enc_pkt_queue);
+    pthread_mutex_destroy(&ost->enc_pkt_lock);
+}
+
+static void free_encoder_threads(void)
+{
+    int i;
+
+    for (i = 0; i < nb_output_streams; i++)
+        if (output_streams[i])
+            stop_encoder_thread(output_streams[i], 1);
+}
+
+typedef struct FilterThreadMessage {
+    AVFrame *frame;             /* frame to filter, NULL to close the input */
+    int64_t eof_pts;
+} FilterThreadMessage;
+
+static void free_filter_msg(void *msg)
+{
+    av_frame_free(&((FilterThreadMessage *)msg)->frame);
+}
+
+static void *filtergraph_thread(void *arg)
+{
+    FilterGraph *fg = arg;
+    FilterThreadMessage msg;
+    int ret;
+
+    while (av_thread_message_queue_recv(fg->thread_queue, &msg, 0) >= 0) {
+        AVFilterContext *buffersrc = fg->inputs[0]->filter;
+
+        if (msg.frame) {
+            ret = av_buffersrc_add_frame_flags(buffersrc, msg.frame,
+                                               AV_BUFFERSRC_FLAG_PUSH);
+            av_frame_free(&msg.frame);
+        } else {
+            ret = av_buffersrc_close(buffersrc, msg.eof_pts,
+                                     AV_BUFFERSRC_FLAG_PUSH);
+        }
+
+        pthread_mutex_lock(&fg->thread_lock);
+        if (ret < 0 && ret != AVERROR_EOF && !fg->thread_ret)
+            fg->thread_ret = ret;
+        fg->thread_pending--;
+        pthread_cond_signal(&fg->thread_cond);
+        pthread_mutex_unlock(&fg->thread_lock);
+    }
+
+    return NULL;
+}
+
+/*
+ * Filtergraph threads are used for graphs with a single input fed by a
+ * decoder. The graph is only accessed by the main thread once the thread has
+ * filtered all the queued frames, so the frames reaped from the buffer sinks
+ * are the same as without the thread.
+ */
+static int can_use_filtergraph_thread(FilterGraph *fg)
+{
+    InputStream *ist;
+
+    if (fg->nb_inputs != 1)
+        return 0;
+
+    ist = fg->inputs[0]->ist;
+    return ist->decoding_needed && !ist->sub2video.frame &&
+           (ist->dec_ctx->codec_type == AVMEDIA_TYPE_VIDEO ||
+            ist->dec_ctx->codec_type == AVMEDIA_TYPE_AUDIO);
+}
+
+static int init_filtergraph_threads(void)
+{
+    int i, ret, nb = 0;
+
+    if (filter_thread_queue_size <= 0)
+        return 0;
+
+    /* as for the encoders, only run concurrent graphs in threads */
+    for (i = 0; i < nb_filtergraphs; i++)
+        nb += can_use_filtergraph_thread(filtergraphs[i]);
+    if (nb < 2)
+        return 0;
+
+    for (i = 0; i < nb_filtergraphs; i++) {
+        FilterGraph *fg = filtergraphs[i];
+
+        if (!can_use_filtergraph_thread(fg))
+            continue;
+
+        ret = av_thread_message_queue_alloc(&fg->thread_queue,
+                                            filter_thread_queue_size,
+                                            sizeof(FilterThreadMessage));
+        if (ret < 0)
+            return ret;
+        av_thread_message_queue_set_free_func(fg->thread_queue, free_filter_msg);
+
+        pthread_mutex_init(&fg->thread_lock, NULL);
+        pthread_cond_init(&fg->thread_cond, NULL);
+        if ((ret = pthread_create(&fg->thread, NULL, filtergraph_thread, fg))) {
+            av_log(NULL, AV_LOG_ERROR, "pthread_create failed: %s. Try to increase `ulimit -v` or decrease `ulimit -s`.\n", strerror(ret));
+            pthread_cond_destroy(&fg->thread_cond);
+            pthread_mutex_destroy(&fg->thread_lock);
+            av_thread_message_queue_free(&fg->thread_queue);
+            return AVERROR(ret);
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Queue frame, or the end of the input if frame is NULL, for the filtergraph
+ * thread of fg, waiting while the queue is full. The frame is moved into the
+ * message.
+ */
+static int send_to_filtergraph_thread(FilterGraph *fg, AVFrame *frame,
+                                      int64_t eof_pts)
+{
+    FilterThreadMessage msg = { NULL, eof_pts };
+    int ret;
+
+    if (frame) {
+        if (!(msg.frame = av_frame_alloc()))
+            return AVERROR(ENOMEM);
+        av_frame_move_ref(msg.frame, frame);
+    }
+
+    pthread_mutex_lock(&fg->thread_lock);
+    fg->thread_pending++;
+    pthread_mutex_unlock(&fg->thread_lock);
+
+    ret = av_thread_message_queue_send(fg->thread_queue, &msg, 0);
+    if (ret < 0) {
+        pthread_mutex_lock(&fg->thread_lock);
+        fg->thread_pending--;
+        pthread_mutex_unlock(&fg->thread_lock);
+        av_frame_free(&msg.frame);
+    }
+    return ret;
+}
+
+/*
+ * Wait until the filtergraph thread of fg has filtered all the queued frames,
+ * after which the main thread may access the graph.
+ */
+static void wait_filtergraph_thread(FilterGraph *fg)
+{
+    int ret;
+
+    if (!fg->thread_queue)
+        return;
+
+    pthread_mutex_lock(&fg->thread_lock);
+    while (fg->thread_pending)
+        pthread_cond_wait(&fg->thread_cond, &fg->thread_lock);
+    ret = fg->thread_ret;
+    pthread_mutex_unlock(&fg->thread_lock);
+
+    if (ret < 0) {
+        av_log(NULL, AV_LOG_FATAL, "Error while filtering: %s\n", av_err2str(ret));
+        exit_program(1);
+    }
+}
+
+static void wait_filtergraph_threads(void)
+{
+    int i;
+
+    for (i = 0; i < nb_filtergraphs; i++)
+        wait_filtergraph_thread(filtergraphs[i]);
+}
+
+static void free_filtergraph_threads(void)
+{
+    int i;
+
+    for (i = 0; i < nb_filtergraphs; i++) {
+        FilterGraph *fg = filtergraphs[i];
+
+        if (!fg || !fg->thread_queue)
+            continue;
+
+        av_thread_message_flush(fg->thread_queue);
+        av_thread_message_queue_set_err_recv(fg->thread_queue, AVERROR_EOF);
+        pthread_join(fg->thread, NULL);
+        av_thread_message_queue_free(&fg->thread_queue);
+        pthread_cond_destroy(&fg->thread_cond);
+        pthread_mutex_destroy(&fg->thread_lock);
+    }
+}
+#endif
+
 static int check_recording_time(OutputStream *ost)
 {
     OutputFile *of = output_files[ost->file_index];
@@ -920,6 +1325,12 @@ static void do_audio_out(OutputFile *of, OutputStream *ost,
     ost->frames_encoded++;
 
     av_assert0(pkt.size || !pkt.data);
+#if HAVE_PTHREADS
+    if (ost->enc_thread_queue) {
+        send_frame_to_encoder_thread(of, ost, frame);
+        return;
+    }
+#endif
     update_benchmark(NULL);
     if (debug_ts) {
         av_log(NULL, AV_LOG_INFO, "encoder <- type:audio "
@@ -1277,43 +1688,50 @@ static void do_video_out(OutputFile *of,
 
         ost->frames_encoded++;
 
-        ret = avcodec_send_frame(enc, in_picture);
-        if (ret < 0)
-            goto error;
-
-        while (1) {
-            ret = avcodec_receive_packet(enc, &pkt);
-            update_benchmark("encode_video %d.%d", ost->file_index, ost->index);
-            if (ret == AVERROR(EAGAIN))
-                break;
+#if HAVE_PTHREADS
+        if (ost->enc_thread_queue) {
+            send_frame_to_encoder_thread(of, ost, in_picture);
+        } else
+#endif
+        {
+            ret = avcodec_send_frame(enc, in_picture);
             if (ret < 0)
                 goto error;
 
-            if (debug_ts) {
-                av_log(NULL, AV_LOG_INFO, "encoder -> type:video "
-                       "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s\n",
-                       av_ts2str(pkt.pts), av_ts2timestr(pkt.pts, &enc->time_base),
-                       av_ts2str(pkt.dts), av_ts2timestr(pkt.dts, &enc->time_base));
-            }
+            while (1) {
+                ret = avcodec_receive_packet(enc, &pkt);
+                update_benchmark("encode_video %d.%d", ost->file_index, ost->index);
+                if (ret == AVERROR(EAGAIN))
+                    break;
+                if (ret < 0)
+                    goto error;
 
-            if (pkt.pts == AV_NOPTS_VALUE && !(enc->codec->capabilities & AV_CODEC_CAP_DELAY))
-                pkt.pts = ost->sync_opts;
+                if (debug_ts) {
+                    av_log(NULL, AV_LOG_INFO, "encoder -> type:video "
+                           "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s\n",
+                           av_ts2str(pkt.pts), av_ts2timestr(pkt.pts, &enc->time_base),
+                           av_ts2str(pkt.dts), av_ts2timestr(pkt.dts, &enc->time_base));
+                }
 
-            av_packet_rescale_ts(&pkt, enc->time_base, ost->mux_timebase);
+                if (pkt.pts == AV_NOPTS_VALUE && !(enc->codec->capabilities & AV_CODEC_CAP_DELAY))
+                    pkt.pts = ost->sync_opts;
 
-            if (debug_ts) {
-                av_log(NULL, AV_LOG_INFO, "encoder -> type:video "
-                    "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s\n",
-                    av_ts2str(pkt.pts), av_ts2timestr(pkt.pts, &ost->mux_timebase),
-                    av_ts2str(pkt.dts), av_ts2timestr(pkt.dts, &ost->mux_timebase));
-            }
+                av_packet_rescale_ts(&pkt, enc->time_base, ost->mux_timebase);
 
-            frame_size = pkt.size;
-            output_packet(of, &pkt, ost, 0);
+                if (debug_ts) {
+                    av_log(NULL, AV_LOG_INFO, "encoder -> type:video "
+                        "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s\n",
+                        av_ts2str(pkt.pts), av_ts2timestr(pkt.pts, &ost->mux_timebase),
+                        av_ts2str(pkt.dts), av_ts2timestr(pkt.dts, &ost->mux_timebase));
+                }
+
+                frame_size = pkt.size;
+                output_packet(of, &pkt, ost, 0);
 
-            /* if two pass, output log */
-            if (ost->logfile && enc->stats_out) {
-                fprintf(ost->logfile, "%s", enc->stats_out);
+                /* if two pass, output log */
+                if (ost->logfile && enc->stats_out) {
+                    fprintf(ost->logfile, "%s", enc->stats_out);
+                }
             }
         }
     }
@@ -1429,6 +1847,10 @@ static int reap_filters(int flush)
             continue;
         filter = ost->filter->filter;
 
+#if HAVE_PTHREADS
+        wait_filtergraph_thread(ost->filter->graph);
+#endif
+
         if (!ost->initialized) {
             char error[1024] = "";
             ret = init_output_stream(ost, error, sizeof(error));
@@ -1485,7 +1907,12 @@ static int reap_filters(int flush)
 
             switch (av_buffersink_get_type(filter)) {
             case AVMEDIA_TYPE_VIDEO:
-                if (!ost->frame_aspect_ratio.num)
+                /* encoder threads set it themselves, as encoders read it */
+                if (!ost->frame_aspect_ratio.num
+#if HAVE_PTHREADS
+                    && !ost->enc_thread_queue
+#endif
+                    )
                     enc->sample_aspect_ratio = filtered_frame->sample_aspect_ratio;
 
                 if (debug_ts) {
@@ -1513,6 +1940,11 @@ static int reap_filters(int flush)
 
             av_frame_unref(filtered_frame);
         }
+
+#if HAVE_PTHREADS
+        if (ost->enc_thread_queue)
+            output_encoded_packets(of, ost);
+#endif
     }
 
     return 0;
@@ -1831,6 +2263,12 @@ static void flush_encoders(void)
 {
     int i, ret;
 
+#if HAVE_PTHREADS
+    /* encode the queued frames, the encoders are then flushed from here */
+    for (i = 0; i < nb_output_streams; i++)
+        stop_encoder_thread(output_streams[i], 0);
+#endif
+
     for (i = 0; i < nb_output_streams; i++) {
         OutputStream   *ost = output_streams[i];
         AVCodecContext *enc = ost->enc_ctx;
@@ -2173,6 +2611,9 @@ static int ifilter_send_frame(InputFilter *ifilter, AVFrame *frame)
             }
         }
 
+#if HAVE_PTHREADS
+        wait_filtergraph_thread(fg);
+#endif
         ret = reap_filters(1);
         if (ret < 0 && ret != AVERROR_EOF) {
             char errbuf[128];
@@ -2189,6 +2630,11 @@ static int ifilter_send_frame(InputFilter *ifilter, AVFrame *frame)
         }
     }
 
+#if HAVE_PTHREADS
+    if (fg->thread_queue)
+        return send_to_filtergraph_thread(fg, frame, 0);
+#endif
+
     ret = av_buffersrc_add_frame_flags(ifilter->filter, frame, AV_BUFFERSRC_FLAG_PUSH);
     if (ret < 0) {
         if (ret != AVERROR_EOF)
@@ -2206,6 +2652,10 @@ static int ifilter_send_eof(InputFilter *ifilter, int64_t pts)
     ifilter->eof = 1;
 
     if (ifilter->filter) {
+#if HAVE_PTHREADS
+        if (ifilter->graph->thread_queue)
+            return send_to_filtergraph_thread(ifilter->graph, NULL, pts);
+#endif
         ret = av_buffersrc_close(ifilter->filter, pts, AV_BUFFERSRC_FLAG_PUSH);
         if (ret < 0)
             return ret;
@@ -2254,6 +2704,20 @@ static int decode(AVCodecContext *avctx, AVFrame *frame, int *got_frame, AVPacke
     return 0;
 }
 
+static int ist_decode(InputStream *ist, AVFrame *frame, int *got_frame, AVPacket *pkt)
+{
+#if HAVE_PTHREADS
+    /* the first decode() call for the packet was made by the decoder thread */
+    if (ist->dec_thread_result) {
+        ist->dec_thread_result = 0;
+        *got_frame = ist->dec_thread_got_frame;
+        av_frame_move_ref(frame, ist->dec_thread_frame);
+        return ist->dec_thread_ret;
+    }
+#endif
+    return decode(ist->dec_ctx, frame, got_frame, pkt);
+}
+
 static int send_frame_to_filters(InputStream *ist, AVFrame *decoded_frame)
 {
     int i, ret;
@@ -2295,7 +2759,7 @@ static int decode_audio(InputStream *ist, AVPacket *pkt, int *got_output,
     decoded_frame = ist->decoded_frame;
 
     update_benchmark(NULL);
-    ret = decode(avctx, decoded_frame, got_output, pkt);
+    ret = ist_decode(ist, decoded_frame, got_output, pkt);
     update_benchmark("decode_audio %d.%d", ist->file_index, ist->st->index);
     if (ret < 0)
         *decode_failed = 1;
@@ -2382,7 +2846,7 @@ static int decode_video(InputStream *ist, AVPacket *pkt, int *got_output, int64_
     }
 
     update_benchmark(NULL);
-    ret = decode(ist->dec_ctx, decoded_frame, got_output, pkt ? &avpkt : NULL);
+    ret = ist_decode(ist, decoded_frame, got_output, pkt ? &avpkt : NULL);
     update_benchmark("decode_video %d.%d", ist->file_index, ist->st->index);
     if (ret < 0)
         *decode_failed = 1;
@@ -2569,29 +3033,15 @@ static int send_filter_eof(InputStream *ist)
     return 0;
 }
 
-/* pkt = NULL means EOF (needed to flush decoder buffers) */
-static int process_input_packet(InputStream *ist, const AVPacket *pkt, int no_eof)
+/* Decode pkt, or flush the decoder if pkt is NULL, and send the decoded frames
+ * to the filters. Return 1 if the decoder has been fully flushed. */
+static int decode_packet(InputStream *ist, const AVPacket *pkt, int no_eof)
 {
-    int ret = 0, i;
+    int ret = 0;
     int repeating = 0;
     int eof_reached = 0;
 
     AVPacket avpkt;
-    if (!ist->saw_first_ts) {
-        ist->dts = ist->st->avg_frame_rate.num ? - ist->dec_ctx->has_b_frames * AV_TIME_BASE / av_q2d(ist->st->avg_frame_rate) : 0;
-        ist->pts = 0;
-        if (pkt && pkt->pts != AV_NOPTS_VALUE && !ist->decoding_needed) {
-            ist->dts += av_rescale_q(pkt->pts, ist->st->time_base, AV_TIME_BASE_Q);
-            ist->pts = ist->dts; //unused but better to set it to a value thats not totally wrong
-        }
-        ist->saw_first_ts = 1;
-    }
-
-    if (ist->next_dts == AV_NOPTS_VALUE)
-        ist->next_dts = ist->dts;
-    if (ist->next_pts == AV_NOPTS_VALUE)
-        ist->next_pts = ist->pts;
-
     if (!pkt) {
         /* EOF handling */
         av_init_packet(&avpkt);
@@ -2601,12 +3051,6 @@ static int process_input_packet(InputStream *ist, const AVPacket *pkt, int no_eo
         avpkt = *pkt;
     }
 
-    if (pkt && pkt->dts != AV_NOPTS_VALUE) {
-        ist->next_dts = ist->dts = av_rescale_q(pkt->dts, ist->st->time_base, AV_TIME_BASE_Q);
-        if (ist->dec_ctx->codec_type != AVMEDIA_TYPE_VIDEO || !ist->decoding_needed)
-            ist->next_pts = ist->pts = ist->dts;
-    }
-
     // while we have more to decode or while the decoder did output something on EOF
     while (ist->decoding_needed) {
         int64_t duration_dts = 0;
@@ -2708,6 +3152,249 @@ static int process_input_packet(InputStream *ist, const AVPacket *pkt, int no_eo
         }
     }
 
+    return eof_reached;
+}
+
+#if HAVE_PTHREADS
+static void *decoder_thread(void *arg)
+{
+    InputStream *ist = arg;
+    AVPacket *pkt;
+    int ret, got_frame;
+
+    pthread_mutex_lock(&ist->dec_thread_lock);
+    while (1) {
+        while (!ist->dec_thread_exit &&
+               (!ist->dec_thread_pkt || ist->dec_thread_done))
+            pthread_cond_wait(&ist->dec_thread_cond, &ist->dec_thread_lock);
+        if (ist->dec_thread_exit)
+            break;
+        pkt = ist->dec_thread_pkt;
+        pthread_mutex_unlock(&ist->dec_thread_lock);
+
+        ret = decode(ist->dec_ctx, ist->dec_thread_frame, &got_frame, pkt);
+
+        pthread_mutex_lock(&ist->dec_thread_lock);
+        ist->dec_thread_ret       = ret;
+        ist->dec_thread_got_frame = got_frame;
+        ist->dec_thread_done      = 1;
+        pthread_cond_broadcast(&ist->dec_thread_cond);
+    }
+    pthread_mutex_unlock(&ist->dec_thread_lock);
+
+    return NULL;
+}
+
+/*
+ * Decoder threads are only used for streams feeding filtergraphs with a
+ * single input. The frames of a packet reach the filters when the next packet
+ * of the stream is read, which must not change how the inputs of a graph are
+ * combined.
+ */
+static int can_use_decoder_thread(InputStream *ist)
+{
+    int ist_index = input_files[ist->file_index]->ist_index + ist->st->index;
+    int i;
+
+    if (!ist->decoding_needed || !ist->nb_filters ||
+        (ist->dec_ctx->codec_type != AVMEDIA_TYPE_VIDEO &&
+         ist->dec_ctx->codec_type != AVMEDIA_TYPE_AUDIO))
+        return 0;
+
+    /* hwaccels keep per-stream state in the get_format() callback */
+    if (ist->hwaccel_id != HWACCEL_NONE || ist->dec_ctx->hw_device_ctx)
+        return 0;
+
+    for (i = 0; i < ist->nb_filters; i++)
+        if (ist->filters[i]->graph->nb_inputs != 1)
+            return 0;
+
+    /* stream copy needs the timestamps of each packet as it is read */
+    for (i = 0; i < nb_output_streams; i++)
+        if (output_streams[i]->source_index == ist_index &&
+            !output_streams[i]->encoding_needed)
+            return 0;
+
+    return 1;
+}
+
+static int init_decoder_threads(void)
+{
+    int i, ret, nb = 0;
+
+    if (!dec_thread)
+        return 0;
+
+    for (i = 0; i < nb_input_streams; i++)
+        nb += can_use_decoder_thread(input_streams[i]);
+
+    for (i = 0; i < nb_input_streams; i++) {
+        InputStream *ist = input_streams[i];
+
+        /* decode in a thread when there are concurrent decoders, or
+         * filtergraphs to run while the next packet is decoded */
+        if (!can_use_decoder_thread(ist) || (nb < 2 && ist->nb_filters < 2))
+            continue;
+
+        if (!(ist->dec_thread_frame = av_frame_alloc()))
+            return AVERROR(ENOMEM);
+
+        pthread_mutex_init(&ist->dec_thread_lock, NULL);
+        pthread_cond_init(&ist->dec_thread_cond, NULL);
+        if ((ret = pthread_create(&ist->dec_thread, NULL, decoder_thread, ist))) {
+            av_log(NULL, AV_LOG_ERROR, "pthread_create failed: %s. Try to increase `ulimit -v` or decrease `ulimit -s`.\n", strerror(ret));
+            pthread_cond_destroy(&ist->dec_thread_cond);
+            pthread_mutex_destroy(&ist->dec_thread_lock);
+            av_frame_free(&ist->dec_thread_frame);
+            return AVERROR(ret);
+        }
+        ist->dec_thread_active = 1;
+    }
+
+    return 0;
+}
+
+/*
+ * Hand pkt to the decoder thread of ist. The main thread continues reading
+ * and filtering while the packet is decoded, and finish_decoding() processes
+ * the decoded frames before the next packet of ist.
+ * Return 1 if the packet was handed to the thread.
+ */
+static int start_decoding(InputStream *ist, const AVPacket *pkt)
+{
+    AVPacket *dpkt;
+
+    if (!ist->dec_thread_active)
+        return 0;
+
+    /* empty packets are not decoded, see decode_video() */
+    if (ist->dec_ctx->codec_type == AVMEDIA_TYPE_VIDEO && !pkt->size)
+        return 0;
+
+    if (!(dpkt = av_packet_clone(pkt)))
+        return 0;
+
+    /* decode_video() replaces the dts as for its first decode() call */
+    if (ist->dec_ctx->codec_type == AVMEDIA_TYPE_VIDEO)
+        dpkt->dts = ist->next_dts == AV_NOPTS_VALUE ? AV_NOPTS_VALUE :
+                    av_rescale_q(ist->next_dts, AV_TIME_BASE_Q, ist->st->time_base);
+
+    pthread_mutex_lock(&ist->dec_thread_lock);
+    ist->dec_thread_pkt  = dpkt;
+    ist->dec_thread_done = 0;
+    pthread_cond_broadcast(&ist->dec_thread_cond);
+    pthread_mutex_unlock(&ist->dec_thread_lock);
+
+    return 1;
+}
+
+/*
+ * Wait until the decoder thread of ist is idle, after which the main thread
+ * may access the decoder. The result of the last decode() call is kept.
+ */
+static void wait_decoder_thread(InputStream *ist)
+{
+    if (!ist->dec_thread_active)
+        return;
+
+    pthread_mutex_lock(&ist->dec_thread_lock);
+    while (ist->dec_thread_pkt && !ist->dec_thread_done)
+        pthread_cond_wait(&ist->dec_thread_cond, &ist->dec_thread_lock);
+    pthread_mutex_unlock(&ist->dec_thread_lock);
+}
+
+/*
+ * Process the packet handed to the decoder thread of ist, if any, as
+ * process_input_packet() would have: its first decode() call returns the
+ * result of the thread, the remaining frames are decoded here.
+ */
+static void finish_decoding(InputStream *ist)
+{
+    AVPacket *pkt;
+
+    if (!ist->dec_thread_active)
+        return;
+
+    wait_decoder_thread(ist);
+
+    pthread_mutex_lock(&ist->dec_thread_lock);
+    pkt = ist->dec_thread_pkt;
+    ist->dec_thread_pkt = NULL;
+    pthread_mutex_unlock(&ist->dec_thread_lock);
+
+    if (!pkt)
+        return;
+
+    ist->dec_thread_result = 1;
+    decode_packet(ist, pkt, 0);
+    av_assert0(!ist->dec_thread_result);
+
+    av_packet_free(&pkt);
+}
+
+static void free_decoder_threads(void)
+{
+    int i;
+
+    for (i = 0; i < nb_input_streams; i++) {
+        InputStream *ist = input_streams[i];
+
+        if (!ist || !ist->dec_thread_active)
+            continue;
+
+        pthread_mutex_lock(&ist->dec_thread_lock);
+        ist->dec_thread_exit = 1;
+        pthread_cond_broadcast(&ist->dec_thread_cond);
+        pthread_mutex_unlock(&ist->dec_thread_lock);
+        pthread_join(ist->dec_thread, NULL);
+
+        pthread_cond_destroy(&ist->dec_thread_cond);
+        pthread_mutex_destroy(&ist->dec_thread_lock);
+        av_packet_free(&ist->dec_thread_pkt);
+        av_frame_free(&ist->dec_thread_frame);
+        ist->dec_thread_active = 0;
+    }
+}
+#endif
+
+/* pkt = NULL means EOF (needed to flush decoder buffers) */
+static int process_input_packet(InputStream *ist, const AVPacket *pkt, int no_eof)
+{
+    int i;
+    int eof_reached = 0;
+
+#if HAVE_PTHREADS
+    finish_decoding(ist);
+#endif
+
+    if (!ist->saw_first_ts) {
+        ist->dts = ist->st->avg_frame_rate.num ? - ist->dec_ctx->has_b_frames * AV_TIME_BASE / av_q2d(ist->st->avg_frame_rate) : 0;
+        ist->pts = 0;
+        if (pkt && pkt->pts != AV_NOPTS_VALUE && !ist->decoding_needed) {
+            ist->dts += av_rescale_q(pkt->pts, ist->st->time_base, AV_TIME_BASE_Q);
+            ist->pts = ist->dts; //unused but better to set it to a value thats not totally wrong
+        }
+        ist->saw_first_ts = 1;
+    }
+
+    if (ist->next_dts == AV_NOPTS_VALUE)
+        ist->next_dts = ist->dts;
+    if (ist->next_pts == AV_NOPTS_VALUE)
+        ist->next_pts = ist->pts;
+
+    if (pkt && pkt->dts != AV_NOPTS_VALUE) {
+        ist->next_dts = ist->dts = av_rescale_q(pkt->dts, ist->st->time_base, AV_TIME_BASE_Q);
+        if (ist->dec_ctx->codec_type != AVMEDIA_TYPE_VIDEO || !ist->decoding_needed)
+            ist->next_pts = ist->pts = ist->dts;
+    }
+
+#if HAVE_PTHREADS
+    if (pkt && start_decoding(ist, pkt))
+        return 1;
+#endif
+
+    eof_reached = decode_packet(ist, pkt, no_eof);
+
     /* handle stream copy */
     if (!ist->decoding_needed && pkt) {
         ist->dts = ist->next_dts;
@@ -2847,6 +3534,88 @@ static enum AVPixelFormat get_format(AVCodecContext *s, const enum AVPixelFormat
     return *p;
 }
 
+/* Decode into a buffer of the filtergraph fed by the stream, so that filters
+ * processing frames in place do not have to copy them. This is only useful
+ * for frames the decoder does not keep, which reach the filters writable. */
+static int can_use_filter_buffer(AVCodecContext *s, AVFrame *frame, int flags)
+{
+    InputStream *ist = s->opaque;
+    InputFilter *ifilter;
+
+    if (!ist->filter_buffers || s->codec_type != AVMEDIA_TYPE_VIDEO ||
+        !(s->codec->capabilities & AV_CODEC_CAP_DR1) ||
+        (flags & AV_GET_BUFFER_FLAG_REF) || ist->nb_filters != 1)
+        return 0;
+
+    /* decoders of other codecs may hold on to frames they do not use as
+     * references, or assume the linesizes stay the same across frames */
+    if (!s->codec_descriptor ||
+        !(s->codec_descriptor->props & AV_CODEC_PROP_INTRA_ONLY))
+        return 0;
+
+    /* the filtergraph is not thread-safe */
+    if (s->active_thread_type & FF_THREAD_FRAME)
+        return 0;
+#if HAVE_PTHREADS
+    if (ist->dec_thread_active || ist->filters[0]->graph->thread_queue)
+        return 0;
+#endif
+
+    /* the frame must not trigger a reconfiguration of the graph */
+    ifilter = ist->filters[0];
+    return ifilter->graph->graph && ifilter->filter &&
+           !ifilter->hw_frames_ctx && !frame->hw_frames_ctx &&
+           ifilter->format == frame->format &&
+           ifilter->width  == s->width && ifilter->height == s->height;
+}
+
+static int get_filter_buffer(AVCodecContext *s, AVFrame *frame)
+{
+    InputStream *ist = s->opaque;
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(frame->format);
+    int linesize_align[AV_NUM_DATA_POINTERS];
+    int w = frame->width;
+    int h = frame->height;
+    AVFrame *buf;
+    int i;
+
+    if (!desc || desc->flags & (AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_PSEUDOPAL))
+        return AVERROR(EINVAL);
+
+    avcodec_align_dimensions2(s, &w, &h, linesize_align);
+
+    buf = av_buffersrc_get_video_buffer(ist->filters[0]->filter, w, h);
+    if (!buf)
+        return AVERROR(ENOMEM);
+
+    /* check the buffers against what the decoder pools would provide,
+     * including the padding after the last line */
+    for (i = 0; i < 4 && buf->data[i]; i++) {
+        int plane_h = i == 1 || i == 2 ? AV_CEIL_RSHIFT(h, desc->log2_chroma_h) : h;
+        AVBufferRef *ref = av_frame_get_plane_buffer(buf, i);
+
+        if (!ref || buf->linesize[i] <= 0 ||
+            buf->linesize[i] % linesize_align[i] ||
+            (uintptr_t)buf->data[i] % linesize_align[i] ||
+            buf->data[i] - ref->data + (int64_t)buf->linesize[i] * plane_h +
+            16 + linesize_align[i] - 1 > ref->size) {
+            av_frame_free(&buf);
+            return AVERROR(EINVAL);
+        }
+    }
+
+    for (i = 0; i < AV_NUM_DATA_POINTERS; i++) {
+        frame->buf[i]      = buf->buf[i];
+        frame->data[i]     = buf->data[i];
+        frame->linesize[i] = buf->linesize[i];
+        buf->buf[i]        = NULL;
+    }
+    frame->extended_data = frame->data;
+
+    av_frame_free(&buf);
+    return 0;
+}
+
 static int get_buffer(AVCodecContext *s, AVFrame *frame, int flags)
 {
     InputStream *ist = s->opaque;
@@ -2854,6 +3623,10 @@ static int get_buffer(AVCodecContext *s, AVFrame *frame, int flags)
     if (ist->hwaccel_get_buffer && frame->format == ist->hwaccel_pix_fmt)
         return ist->hwaccel_get_buffer(s, frame, flags);
 
+    if (can_use_filter_buffer(s, frame, flags) &&
+        get_filter_buffer(s, frame) >= 0)
+        return 0;
+
     return avcodec_default_get_buffer2(s, frame, flags);
 }
 
@@ -3276,6 +4049,9 @@ static int init_output_stream_encode(OutputStream *ost)
     if (ist) {
         ost->st->disposition          = ist->st->disposition;
 
+#if HAVE_PTHREADS
+        wait_decoder_thread(ist);
+#endif
         dec_ctx = ist->dec_ctx;
 
         enc_ctx->chroma_sample_location = dec_ctx->chroma_sample_location;
@@ -3531,6 +4307,20 @@ static int init_output_stream(OutputStream *ost, char *error, int error_len)
             ost->st->duration = av_rescale_q(ist->st->duration, ist->st->time_base, ost->st->time_base);
 
         ost->st->codec->codec= ost->enc_ctx->codec;
+
+#if HAVE_PTHREADS
+        if (enc_thread_queue_size > 0 && !ost->logfile && !vstats_filename &&
+            (ost->enc_ctx->codec_type == AVMEDIA_TYPE_VIDEO ||
+             ost->enc_ctx->codec_type == AVMEDIA_TYPE_AUDIO) &&
+            nb_threaded_encoders() > 1) {
+            ret = init_encoder_thread(ost);
+            if (ret < 0) {
+                snprintf(error, error_len, "Could not start the encoder thread "
+                         "for output stream #%d:%d", ost->file_index, ost->index);
+                return ret;
+            }
+        }
+#endif
     } else if (ost->stream_copy) {
         ret = init_output_stream_streamcopy(ost);
         if (ret < 0)
@@ -3894,6 +4684,9 @@ static int check_keyboard_interaction(int64_t cur_time)
             for (i = 0; i < nb_filtergraphs; i++) {
                 FilterGraph *fg = filtergraphs[i];
                 if (fg->graph) {
+#if HAVE_PTHREADS
+                    wait_filtergraph_thread(fg);
+#endif
                     if (time < 0) {
                         ret = avfilter_graph_send_command(fg->graph, target, command, arg, buf, sizeof(buf),
                                                           key == 'c' ? AVFILTER_CMD_FLAG_ONE : 0);
@@ -4274,6 +5067,11 @@ static int process_input(int file_index)
         exit_program(1);
     }
 
+#if HAVE_PTHREADS
+    /* the timestamp checks below need the state left by the previous packet */
+    finish_decoding(ist);
+#endif
+
     if (debug_ts) {
         av_log(NULL, AV_LOG_INFO, "demuxer -> ist_index:%d type:%s "
                "next_dts:%s next_dts_time:%s next_pts:%s next_pts_time:%s pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s off:%s off_time:%s\n",
@@ -4452,6 +5250,9 @@ static int transcode_from_filter(FilterGraph *graph, InputStream **best_ist)
     InputStream *ist;
 
     *best_ist = NULL;
+#if HAVE_PTHREADS
+    wait_filtergraph_thread(graph);
+#endif
     ret = avfilter_graph_request_oldest(graph->graph);
     if (ret >= 0)
         return reap_filters(0);
@@ -4518,6 +5319,9 @@ static int transcode_step(void)
     }
 
     if (ost->filter && ost->filter->graph->graph) {
+#if HAVE_PTHREADS
+        wait_filtergraph_thread(ost->filter->graph);
+#endif
         if (!ost->initialized) {
             char error[1024] = {0};
             ret = init_output_stream(ost, error, sizeof(error));
@@ -4587,6 +5391,9 @@ static int transcode(void)
 #if HAVE_PTHREADS
     if ((ret = init_input_threads()) < 0)
         goto fail;
+    if ((ret = init_decoder_threads()) < 0 ||
+        (ret = init_filtergraph_threads()) < 0)
+        goto fail;
 #endif
 
     while (!received_sigterm) {
@@ -4626,6 +5433,9 @@ static int transcode(void)
             process_input_packet(ist, NULL, 0);
         }
     }
+#if HAVE_PTHREADS
+    wait_filtergraph_threads();
+#endif
     flush_encoders();
 
     term_exit();
@@ -4665,6 +5475,9 @@ static int transcode(void)
     }
 
     /* close each decoder */
+#if HAVE_PTHREADS
+    free_decoder_threads();
+#endif
     for (i = 0; i < nb_input_streams; i++) {
         ist = input_streams[i];
         if (ist->decoding_needed) {
@@ -141,6 +141,8 @@ typedef struct OptionsContext {
     int        nb_hwaccel_output_formats;
     SpecifierOpt *autorotate;
     int        nb_autorotate;
+    SpecifierOpt *filter_buffers;
+    int        nb_filter_buffers;
 
     /* output options */
     StreamMap *stream_maps;
@@ -298,6 +300,15 @@ typedef struct FilterGraph {
     int          nb_inputs;
     OutputFilter **outputs;
     int         nb_outputs;
+
+#if HAVE_PTHREADS
+    AVThreadMessageQueue *thread_queue; /* frames sent to the filtergraph thread */
+    pthread_t thread;           /* thread running the filters of this graph */
+    pthread_mutex_t thread_lock;
+    pthread_cond_t thread_cond;
+    int thread_pending;         /* number of queued frames not filtered yet */
+    int thread_ret;             /* error returned by the filters */
+#endif
 } FilterGraph;
 
 typedef struct InputStream {
@@ -343,6 +354,7 @@ typedef struct InputStream {
     int guess_layout_max;
 
     int autorotate;
+    int filter_buffers;
 
     int fix_sub_duration;
     struct { /* previous decoded subtitle and related variables */
@@ -396,6 +408,20 @@ typedef struct InputStream {
     int nb_dts_buffer;
 
     int got_output;
+
+#if HAVE_PTHREADS
+    pthread_t dec_thread;       /* thread decoding the packets of this stream */
+    pthread_mutex_t dec_thread_lock;
+    pthread_cond_t dec_thread_cond;
+    int dec_thread_active;      /* the decoder thread is running */
+    int dec_thread_exit;        /* the decoder thread must return */
+    AVPacket *dec_thread_pkt;   /* packet handed to the decoder thread */
+    int dec_thread_done;        /* dec_thread_pkt has been decoded */
+    AVFrame *dec_thread_frame;  /* frame returned for dec_thread_pkt */
+    int dec_thread_got_frame;
+    int dec_thread_ret;
+    int dec_thread_result;      /* the result has not been used yet */
+#endif
 } InputStream;
 
 typedef struct InputFile {
@@ -559,6 +585,14 @@ typedef struct OutputStream {
 
     /* frame encode sum of squared error values */
     int64_t error[4];
+
+#if HAVE_PTHREADS
+    AVThreadMessageQueue *enc_thread_queue; /* frames sent to the encoder thread */
+    pthread_t enc_thread;       /* thread encoding this stream */
+    pthread_mutex_t enc_pkt_lock;
+    AVFifoBuffer *enc_pkt_queue; /* packets returned by the encoder thread */
+    int enc_thread_ret;         /* error that terminated the encoder thread */
+#endif
 } OutputStream;
 
 typedef struct OutputFile {
@@ -619,6 +653,9 @@ extern char *videotoolbox_pixfmt;
 
 extern int filter_nbthreads;
 extern int filter_complex_nbthreads;
+extern int enc_thread_queue_size;
+extern int filter_thread_queue_size;
+extern int dec_thread;
 extern int vstats_version;
 
 extern const AVIOInterruptCB int_cb;
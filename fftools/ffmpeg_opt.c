@@ -132,6 +132,9 @@ int frame_bits_per_raw_sample = 0;
 float max_error_rate  = 2.0/3;
 int filter_nbthreads = 0;
 int filter_complex_nbthreads = 0;
+int enc_thread_queue_size = 8;
+int filter_thread_queue_size = 8;
+int dec_thread = 1;
 int vstats_version = 2;
 
 
@@ -750,6 +753,9 @@ static void add_input_streams(OptionsContext *o, AVFormatContext *ic)
         ist->autorotate = 1;
         MATCH_PER_STREAM_OPT(autorotate, i, ist->autorotate, ic, st);
 
+        ist->filter_buffers = 1;
+        MATCH_PER_STREAM_OPT(filter_buffers, i, ist->filter_buffers, ic, st);
+
         MATCH_PER_STREAM_OPT(codec_tags, str, codec_tag, ic, st);
         if (codec_tag) {
             uint32_t tag = strtol(codec_tag, &next, 0);
@@ -3534,6 +3540,12 @@ const OptionDef options[] = {
         "create a complex filtergraph", "graph_description" },
     { "filter_complex_threads", HAS_ARG | OPT_INT,                   { &filter_complex_nbthreads },
         "number of threads for -filter_complex" },
+    { "enc_thread_queue_size", HAS_ARG | OPT_INT | OPT_EXPERT,       { &enc_thread_queue_size },
+        "set the maximum number of frames queued for each encoder thread, 0 disables encoder threads" },
+    { "filter_thread_queue_size", HAS_ARG | OPT_INT | OPT_EXPERT,    { &filter_thread_queue_size },
+        "set the maximum number of frames queued for each filtergraph thread, 0 disables filtergraph threads" },
+    { "dec_thread",     OPT_BOOL | OPT_EXPERT,                       { &dec_thread },
+        "decode input streams in their own threads" },
     { "lavfi",          HAS_ARG | OPT_EXPERT,                        { .func_arg = opt_filter_complex },
         "create a complex filtergraph", "graph_description" },
     { "filter_complex_script", HAS_ARG | OPT_EXPERT,                 { .func_arg = opt_filter_complex_script },
@@ -3661,6 +3673,9 @@ const OptionDef options[] = {
     { "autorotate",       HAS_ARG | OPT_BOOL | OPT_SPEC |
                           OPT_EXPERT | OPT_INPUT,                                { .off = OFFSET(autorotate) },
         "automatically insert correct rotate filters" },
+    { "filter_buffers",   OPT_VIDEO | HAS_ARG | OPT_BOOL | OPT_SPEC |
+                          OPT_EXPERT | OPT_INPUT,                                { .off = OFFSET(filter_buffers) },
+        "decode into buffers allocated by the filtergraph" },
 
     /* audio options */
     { "aframes",        OPT_AUDIO | HAS_ARG  | OPT_PERFILE | OPT_OUTPUT,           { .func_arg = opt_audio_frames },
@@ -403,6 +403,13 @@ typedef struct AACEncContext {
     int lambda_count;                            ///< count(lambda), for Qvg reporting
     enum RawDataBlockType cur_type;              ///< channel group type cur_channel belongs to
 
+    FFPsyWindowInfo windows[16];                 ///< window decisions for the current frame
+    int bitres_alloc[16];                        ///< psy bit allocation of each channel element
+    float search_lambda;                         ///< lambda of the last quantizer search
+    int nb_thread_ctx;                           ///< number of slice thread contexts
+    struct AACEncContext **thread_ctx;           ///< per-thread copies, thread_ctx[0] is the main context
+
+    /* fields below are not shared with the slice thread contexts */
     AudioFrameQueue afq;
     DECLARE_ALIGNED(16, int,   qcoefs)[96];      ///< quantized coefficients
     DECLARE_ALIGNED(32, float, scoefs)[1024];    ///< scaled coefficients
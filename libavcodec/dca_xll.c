@@ -635,7 +635,7 @@ static void chs_filter_band_data(DCAXllDecoder *s, DCAXllChSet *c, int band)
         int32_t *buf = b->msb_sample_buffer[i];
         int order = b->adapt_pred_order[i];
         if (order > 0) {
-            int coeff[DCA_XLL_ADAPT_PRED_ORDER_MAX];
+            int32_t coeff[DCA_XLL_ADAPT_PRED_ORDER_MAX];
             // Conversion from reflection coefficients to direct form coefficients
             for (j = 0; j < order; j++) {
                 int rc = b->adapt_refl_coeff[i][j];
@@ -648,12 +648,7 @@ static void chs_filter_band_data(DCAXllDecoder *s, DCAXllChSet *c, int band)
                 coeff[j] = rc;
             }
             // Inverse adaptive prediction
-            for (j = 0; j < nsamples - order; j++) {
-                int64_t err = 0;
-                for (k = 0; k < order; k++)
-                    err += (int64_t)buf[j + k] * coeff[order - k - 1];
-                buf[j + k] -= (SUINT)clip23(norm16(err));
-            }
+            s->dcadsp->adapt_pred(buf, coeff, order, nsamples);
         } else {
             // Inverse fixed coefficient prediction
             for (j = 0; j < b->fixed_pred_order[i]; j++)
@@ -1319,6 +1314,38 @@ static int combine_residual_frame(DCAXllDecoder *s, DCAXllChSet *c)
     return 0;
 }
 
+// Filter frequency bands of a channel set, executed in parallel for the
+// active channel sets as each one writes its own output channels
+static int chs_filter_frame(AVCodecContext *avctx, void *arg, int chs, int threadnr)
+{
+    DCAXllDecoder *s = arg;
+    DCAXllChSet *c = &s->chset[chs];
+    int ret;
+
+    chs_filter_band_data(s, c, 0);
+
+    if (c->residual_encode != (1 << c->nchannels) - 1
+        && (ret = combine_residual_frame(s, c)) < 0)
+        return ret;
+
+    if (s->scalable_lsbs)
+        chs_assemble_msbs_lsbs(s, c, 0);
+
+    if (c->nfreqbands > 1) {
+        chs_filter_band_data(s, c, 1);
+        chs_assemble_msbs_lsbs(s, c, 1);
+    }
+
+    return 0;
+}
+
+static int chs_assemble_frame(AVCodecContext *avctx, void *arg, int chs, int threadnr)
+{
+    DCAXllDecoder *s = arg;
+
+    return chs_assemble_freq_bands(s, &s->chset[chs]);
+}
+
 int ff_dca_xll_filter_frame(DCAXllDecoder *s, AVFrame *frame)
 {
     AVCodecContext *avctx = s->avctx;
@@ -1328,6 +1355,7 @@ int ff_dca_xll_filter_frame(DCAXllDecoder *s, AVFrame *frame)
     enum AVMatrixEncoding matrix_encoding = AV_MATRIX_ENCODING_NONE;
     int i, j, k, ret, shift, nsamples, request_mask;
     int ch_remap[DCA_SPEAKER_COUNT];
+    int chs_ret[DCA_XLL_CHSETS_MAX], threaded;
 
     // Force lossy downmixed output during recovery
     if (dca->packet & DCA_PACKET_RECOVERY) {
@@ -1344,22 +1372,25 @@ int ff_dca_xll_filter_frame(DCAXllDecoder *s, AVFrame *frame)
     }
 
     // Filter frequency bands for active channel sets
+    // Channel sets sharing a speaker are filtered in order, the last one
+    // providing the output channel
     s->output_mask = 0;
     for (i = 0, c = s->chset; i < s->nactivechsets; i++, c++) {
-        chs_filter_band_data(s, c, 0);
-
-        if (c->residual_encode != (1 << c->nchannels) - 1
-            && (ret = combine_residual_frame(s, c)) < 0)
-            return ret;
-
-        if (s->scalable_lsbs)
-            chs_assemble_msbs_lsbs(s, c, 0);
-
-        if (c->nfreqbands > 1) {
-            chs_filter_band_data(s, c, 1);
-            chs_assemble_msbs_lsbs(s, c, 1);
-        }
-
+        if (s->output_mask & c->ch_mask)
+            break;
+        s->output_mask |= c->ch_mask;
+    }
+    threaded = i == s->nactivechsets;
+    if (threaded) {
+        avctx->execute2(avctx, chs_filter_frame, s, chs_ret, s->nactivechsets);
+    } else {
+        for (i = 0; i < s->nactivechsets; i++)
+            chs_ret[i] = chs_filter_frame(avctx, s, i, 0);
+    }
+    s->output_mask = 0;
+    for (i = 0, c = s->chset; i < s->nactivechsets; i++, c++) {
+        if (chs_ret[i] < 0)
+            return chs_ret[i];
         s->output_mask |= c->ch_mask;
     }
 
@@ -1382,9 +1413,15 @@ int ff_dca_xll_filter_frame(DCAXllDecoder *s, AVFrame *frame)
 
     // Assemble frequency bands for active channel sets
     if (s->nfreqbands > 1) {
+        if (threaded) {
+            avctx->execute2(avctx, chs_assemble_frame, s, chs_ret, s->nactivechsets);
+        } else {
+            for (i = 0; i < s->nactivechsets; i++)
+                chs_ret[i] = chs_assemble_frame(avctx, s, i, 0);
+        }
         for (i = 0; i < s->nactivechsets; i++)
-            if ((ret = chs_assemble_freq_bands(s, &s->chset[i])) < 0)
-                return ret;
+            if (chs_ret[i] < 0)
+                return chs_ret[i];
     }
 
     // Normalize to regular 5.1 layout if downmixing
@@ -381,6 +381,9 @@ static const AVClass dcadec_class = {
     .category   = AV_CLASS_CATEGORY_DECODER,
 };
 
+/* The XLL channel sets can be filtered through execute2(), but
+ * AV_CODEC_CAP_SLICE_THREADS is only to be set once this is checked against
+ * the DTS-HD MA samples. */
 AVCodec ff_dca_decoder = {
     .name           = "dca",
     .long_name      = NULL_IF_CONFIG_SMALL("DCA (DTS Coherent Acoustics)"),
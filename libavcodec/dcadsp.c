@@ -303,6 +303,19 @@ static void decor_c(int32_t *dst, const int32_t *src, int coeff, ptrdiff_t len)
         dst[i] += (SUINT)((int)(src[i] * (SUINT)coeff + (1 << 2)) >> 3);
 }
 
+static void adapt_pred_c(int32_t *buf, const int32_t *coeff,
+                         ptrdiff_t order, ptrdiff_t len)
+{
+    int i, j;
+
+    for (i = 0; i < len - order; i++) {
+        int64_t err = 0;
+        for (j = 0; j < order; j++)
+            err += (int64_t)buf[i + j] * coeff[order - j - 1];
+        buf[i + j] -= (SUINT)clip23(norm16(err));
+    }
+}
+
 static void dmix_sub_xch_c(int32_t *dst1, int32_t *dst2,
                            const int32_t *src, ptrdiff_t len)
 {
@@ -473,6 +486,7 @@ av_cold void ff_dcadsp_init(DCADSPContext *s)
     s->sub_qmf_fixed[1] = sub_qmf64_fixed_c;
 
     s->decor   = decor_c;
+    s->adapt_pred = adapt_pred_c;
 
     s->dmix_sub_xch   = dmix_sub_xch_c;
     s->dmix_sub       = dmix_sub_c;
@@ -71,6 +71,9 @@ typedef struct DCADSPContext {
 
     void (*decor)(int32_t *dst, const int32_t *src, int coeff, ptrdiff_t len);
 
+    void (*adapt_pred)(int32_t *buf, const int32_t *coeff,
+                       ptrdiff_t order, ptrdiff_t len);
+
     void (*dmix_sub_xch)(int32_t *dst1, int32_t *dst2,
                          const int32_t *src, ptrdiff_t len);
 
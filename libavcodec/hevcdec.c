@@ -2437,6 +2437,37 @@ static int hls_slice_data(HEVCContext *s)
     s->avctx->execute(s->avctx, hls_decode_entry, arg, ret , 1, sizeof(int));
     return ret[0];
 }
+static void wpp_report_progress(HEVCContext *s1, int ctb_row, int thread, int n)
+{
+#if HAVE_THREADS
+    if (s1->wpp_thread) {
+        pthread_mutex_lock(&s1->wpp_progress_mutex[thread]);
+        s1->wpp_entries[ctb_row] += n;
+        pthread_cond_broadcast(&s1->wpp_progress_cond[thread]);
+        pthread_mutex_unlock(&s1->wpp_progress_mutex[thread]);
+        return;
+    }
+#endif
+    ff_thread_report_progress2(s1->avctx, ctb_row, thread, n);
+}
+
+static void wpp_await_progress(HEVCContext *s1, int ctb_row, int thread, int shift)
+{
+#if HAVE_THREADS
+    if (s1->wpp_thread) {
+        if (!ctb_row)
+            return;
+        thread = thread ? thread - 1 : s1->threads_number - 1;
+        pthread_mutex_lock(&s1->wpp_progress_mutex[thread]);
+        while (s1->wpp_entries[ctb_row - 1] - s1->wpp_entries[ctb_row] < shift)
+            pthread_cond_wait(&s1->wpp_progress_cond[thread], &s1->wpp_progress_mutex[thread]);
+        pthread_mutex_unlock(&s1->wpp_progress_mutex[thread]);
+        return;
+    }
+#endif
+    ff_thread_await_progress2(s1->avctx, ctb_row, thread, shift);
+}
+
 static int hls_decode_entry_wpp(AVCodecContext *avctxt, void *input_ctb_row, int job, int self_id)
 {
     HEVCContext *s1  = avctxt->priv_data, *s;
@@ -2466,10 +2497,10 @@ static int hls_decode_entry_wpp(AVCodecContext *avctxt, void *input_ctb_row, int
 
         hls_decode_neighbour(s, x_ctb, y_ctb, ctb_addr_ts);
 
-        ff_thread_await_progress2(s->avctx, ctb_row, thread, SHIFT_CTB_WPP);
+        wpp_await_progress(s1, ctb_row, thread, SHIFT_CTB_WPP);
 
         if (atomic_load(&s1->wpp_err)) {
-            ff_thread_report_progress2(s->avctx, ctb_row , thread, SHIFT_CTB_WPP);
+            wpp_report_progress(s1, ctb_row, thread, SHIFT_CTB_WPP);
             return 0;
         }
 
@@ -2487,18 +2518,18 @@ static int hls_decode_entry_wpp(AVCodecContext *avctxt, void *input_ctb_row, int
         ctb_addr_ts++;
 
         ff_hevc_save_states(s, ctb_addr_ts);
-        ff_thread_report_progress2(s->avctx, ctb_row, thread, 1);
+        wpp_report_progress(s1, ctb_row, thread, 1);
         ff_hevc_hls_filters(s, x_ctb, y_ctb, ctb_size);
 
         if (!more_data && (x_ctb+ctb_size) < s->ps.sps->width && ctb_row != s->sh.num_entry_point_offsets) {
             atomic_store(&s1->wpp_err, 1);
-            ff_thread_report_progress2(s->avctx, ctb_row ,thread, SHIFT_CTB_WPP);
+            wpp_report_progress(s1, ctb_row, thread, SHIFT_CTB_WPP);
             return 0;
         }
 
         if ((x_ctb+ctb_size) >= s->ps.sps->width && (y_ctb+ctb_size) >= s->ps.sps->height ) {
             ff_hevc_hls_filter(s, x_ctb, y_ctb, ctb_size);
-            ff_thread_report_progress2(s->avctx, ctb_row , thread, SHIFT_CTB_WPP);
+            wpp_report_progress(s1, ctb_row, thread, SHIFT_CTB_WPP);
             return ctb_addr_ts;
         }
         ctb_addr_rs       = s->ps.pps->ctb_addr_ts_to_rs[ctb_addr_ts];
@@ -2508,16 +2539,24 @@ static int hls_decode_entry_wpp(AVCodecContext *avctxt, void *input_ctb_row, int
             break;
         }
     }
-    ff_thread_report_progress2(s->avctx, ctb_row ,thread, SHIFT_CTB_WPP);
+    wpp_report_progress(s1, ctb_row, thread, SHIFT_CTB_WPP);
 
     return 0;
 error:
     s->tab_slice_address[ctb_addr_rs] = -1;
     atomic_store(&s1->wpp_err, 1);
-    ff_thread_report_progress2(s->avctx, ctb_row ,thread, SHIFT_CTB_WPP);
+    wpp_report_progress(s1, ctb_row, thread, SHIFT_CTB_WPP);
     return ret;
 }
 
+static void hls_decode_entry_wpp_thread(void *priv, int jobnr, int threadnr,
+                                        int nb_jobs, int nb_threads)
+{
+    HEVCContext *s = priv;
+
+    s->wpp_ret[jobnr] = hls_decode_entry_wpp(s->avctx, s->wpp_arg, jobnr, threadnr);
+}
+
 static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
 {
     const uint8_t *data = nal->data;
@@ -2544,7 +2583,15 @@ static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
         goto error;
     }
 
-    ff_alloc_entries(s->avctx, s->sh.num_entry_point_offsets + 1);
+    if (s->wpp_thread) {
+        av_fast_malloc(&s->wpp_entries, &s->wpp_entries_size,
+                       (s->sh.num_entry_point_offsets + 1) * sizeof(*s->wpp_entries));
+        if (!s->wpp_entries) {
+            res = AVERROR(ENOMEM);
+            goto error;
+        }
+    } else
+        ff_alloc_entries(s->avctx, s->sh.num_entry_point_offsets + 1);
 
     if (!s->sList[1]) {
         for (i = 1; i < s->threads_number; i++) {
@@ -2598,15 +2645,24 @@ static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
     }
 
     atomic_store(&s->wpp_err, 0);
-    ff_reset_entries(s->avctx);
+    if (s->wpp_thread)
+        memset(s->wpp_entries, 0, (s->sh.num_entry_point_offsets + 1) * sizeof(*s->wpp_entries));
+    else
+        ff_reset_entries(s->avctx);
 
     for (i = 0; i <= s->sh.num_entry_point_offsets; i++) {
         arg[i] = i;
         ret[i] = 0;
     }
 
-    if (s->ps.pps->entropy_coding_sync_enabled_flag)
-        s->avctx->execute2(s->avctx, hls_decode_entry_wpp, arg, ret, s->sh.num_entry_point_offsets + 1);
+    if (s->ps.pps->entropy_coding_sync_enabled_flag) {
+        if (s->wpp_thread) {
+            s->wpp_arg = arg;
+            s->wpp_ret = ret;
+            avpriv_slicethread_execute(s->wpp_thread, s->sh.num_entry_point_offsets + 1, 0);
+        } else
+            s->avctx->execute2(s->avctx, hls_decode_entry_wpp, arg, ret, s->sh.num_entry_point_offsets + 1);
+    }
 
     for (i = 0; i <= s->sh.num_entry_point_offsets; i++)
         res += ret[i];
@@ -3276,6 +3332,17 @@ static av_cold int hevc_decode_free(AVCodecContext *avctx)
             av_freep(&s->sList[i]);
         }
     }
+
+#if HAVE_THREADS
+    if (s->wpp_thread) {
+        avpriv_slicethread_free(&s->wpp_thread);
+        for (i = 0; i < MAX_NB_THREADS; i++) {
+            pthread_mutex_destroy(&s->wpp_progress_mutex[i]);
+            pthread_cond_destroy(&s->wpp_progress_cond[i]);
+        }
+    }
+#endif
+    av_freep(&s->wpp_entries);
     if (s->HEVClc == s->HEVClcList[0])
         s->HEVClc = NULL;
     av_freep(&s->HEVClcList[0]);
@@ -3285,6 +3352,36 @@ static av_cold int hevc_decode_free(AVCodecContext *avctx)
     return 0;
 }
 
+static int hevc_init_wpp_thread(HEVCContext *s)
+{
+#if HAVE_THREADS
+    int i, ret;
+
+    ret = avpriv_slicethread_create(&s->wpp_thread, s, hls_decode_entry_wpp_thread,
+                                    NULL, s->threads_number);
+    if (ret < 0)
+        return ret;
+    for (i = 0; i < MAX_NB_THREADS; i++) {
+        pthread_mutex_init(&s->wpp_progress_mutex[i], NULL);
+        pthread_cond_init(&s->wpp_progress_cond[i], NULL);
+    }
+    return 0;
+#else
+    return AVERROR(ENOSYS);
+#endif
+}
+
+/* Row threads are an optimization on top of frame threads, so a failure to
+ * create them only disables them for this context. */
+static void hevc_init_row_threads(HEVCContext *s)
+{
+    if (hevc_init_wpp_thread(s) < 0) {
+        av_log(s->avctx, AV_LOG_WARNING, "Could not create the row threads, "
+               "using frame threading only\n");
+        s->threads_number = 1;
+    }
+}
+
 static av_cold int hevc_init_context(AVCodecContext *avctx)
 {
     HEVCContext *s = avctx->priv_data;
@@ -3401,6 +3498,9 @@ static int hevc_update_thread_context(AVCodecContext *dst,
     s->threads_number      = s0->threads_number;
     s->threads_type        = s0->threads_type;
 
+    if (s->threads_type == FF_THREAD_FRAME && s->threads_number > 1 && !s->wpp_thread)
+        hevc_init_row_threads(s);
+
     if (s0->eos) {
         s->seq_decode = (s->seq_decode + 1) & 0xff;
         s->max_ra = INT_MAX;
@@ -3434,6 +3534,8 @@ static av_cold int hevc_decode_init(AVCodecContext *avctx)
 
     if(avctx->active_thread_type & FF_THREAD_SLICE)
         s->threads_number = avctx->thread_count;
+    else if (avctx->active_thread_type & FF_THREAD_FRAME && s->wpp_threads > 1)
+        s->threads_number = s->wpp_threads;
     else
         s->threads_number = 1;
 
@@ -3450,6 +3552,9 @@ static av_cold int hevc_decode_init(AVCodecContext *avctx)
         else
             s->threads_type = FF_THREAD_SLICE;
 
+    if (s->threads_type == FF_THREAD_FRAME && s->threads_number > 1)
+        hevc_init_row_threads(s);
+
     return 0;
 }
 
@@ -3483,6 +3588,8 @@ static const AVOption options[] = {
         AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, PAR },
     { "strict-displaywin", "stricly apply default display window size", OFFSET(apply_defdispwin),
         AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, PAR },
+    { "wpp_threads", "number of threads decoding the rows of each frame with frame threading", OFFSET(wpp_threads),
+        AV_OPT_TYPE_INT, {.i64 = 0}, 0, MAX_NB_THREADS, PAR },
     { NULL },
 };
 
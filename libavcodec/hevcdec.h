@@ -27,6 +27,8 @@
 
 #include "libavutil/buffer.h"
 #include "libavutil/md5.h"
+#include "libavutil/slicethread.h"
+#include "libavutil/thread.h"
 
 #include "avcodec.h"
 #include "bswapdsp.h"
@@ -470,6 +472,22 @@ typedef struct HEVCContext {
     int enable_parallel_tiles;
     atomic_int wpp_err;
 
+    /**
+     * Threads decoding the rows of WPP slices of a frame thread, when frame
+     * and row threading are combined. The slice threading row progress is
+     * not available in frame threads, the progress of these rows is kept in
+     * wpp_entries.
+     */
+    AVSliceThread *wpp_thread;
+    int *wpp_entries;           ///< number of CTBs decoded in each row
+    unsigned int wpp_entries_size;
+    int *wpp_arg;               ///< rows of the current slice
+    int *wpp_ret;               ///< return values of the rows
+#if HAVE_THREADS
+    pthread_mutex_t wpp_progress_mutex[MAX_NB_THREADS];
+    pthread_cond_t  wpp_progress_cond[MAX_NB_THREADS];
+#endif
+
     const uint8_t *data;
 
     H2645Packet pkt;
@@ -480,6 +498,7 @@ typedef struct HEVCContext {
     int is_nalff;           ///< this flag is != 0 if bitstream is encapsulated
                             ///< as a format defined in 14496-15
     int apply_defdispwin;
+    int wpp_threads;        ///< number of row threads per frame thread
 
     int nal_length_size;    ///< Number of bytes used for nal length (1, 2 or 4)
     int nuh_layer_id;
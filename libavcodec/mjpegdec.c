@@ -43,6 +43,7 @@
 #include "mjpegdec.h"
 #include "jpeglsdec.h"
 #include "put_bits.h"
+#include "thread.h"
 #include "tiff.h"
 #include "exif.h"
 #include "bytestream.h"
@@ -71,34 +72,54 @@ static int build_vlc(VLC *vlc, const uint8_t *bits_table,
                               huff_code, 2, 2, huff_sym, 2, 2, use_static);
 }
 
-static int build_basic_mjpeg_vlc(MJpegDecodeContext *s)
+/* build the VLCs of a huffman table from raw_huffman_lengths/values */
+static int build_huffman_vlc(MJpegDecodeContext *s, int class, int index)
 {
-    int ret;
-
-    if ((ret = build_vlc(&s->vlcs[0][0], avpriv_mjpeg_bits_dc_luminance,
-                         avpriv_mjpeg_val_dc, 12, 0, 0)) < 0)
-        return ret;
-
-    if ((ret = build_vlc(&s->vlcs[0][1], avpriv_mjpeg_bits_dc_chrominance,
-                         avpriv_mjpeg_val_dc, 12, 0, 0)) < 0)
-        return ret;
-
-    if ((ret = build_vlc(&s->vlcs[1][0], avpriv_mjpeg_bits_ac_luminance,
-                         avpriv_mjpeg_val_ac_luminance, 251, 0, 1)) < 0)
-        return ret;
-
-    if ((ret = build_vlc(&s->vlcs[1][1], avpriv_mjpeg_bits_ac_chrominance,
-                         avpriv_mjpeg_val_ac_chrominance, 251, 0, 1)) < 0)
-        return ret;
-
-    if ((ret = build_vlc(&s->vlcs[2][0], avpriv_mjpeg_bits_ac_luminance,
-                         avpriv_mjpeg_val_ac_luminance, 251, 0, 0)) < 0)
+    const uint8_t *bits_table = s->raw_huffman_lengths[class][index];
+    const uint8_t *val_table  = s->raw_huffman_values[class][index];
+    int i, n = 0, code_max = 0, ret;
+
+    for (i = 1; i <= 16; i++)
+        n += bits_table[i];
+    for (i = 0; i < n; i++)
+        code_max = FFMAX(code_max, val_table[i]);
+
+    ff_free_vlc(&s->vlcs[class][index]);
+    if ((ret = build_vlc(&s->vlcs[class][index], bits_table, val_table,
+                         code_max + 1, 0, class > 0)) < 0)
         return ret;
 
-    if ((ret = build_vlc(&s->vlcs[2][1], avpriv_mjpeg_bits_ac_chrominance,
-                         avpriv_mjpeg_val_ac_chrominance, 251, 0, 0)) < 0)
-        return ret;
+    if (class > 0) {
+        ff_free_vlc(&s->vlcs[2][index]);
+        if ((ret = build_vlc(&s->vlcs[2][index], bits_table, val_table,
+                             code_max + 1, 0, 0)) < 0)
+            return ret;
+    }
+    return 0;
+}
 
+static int build_basic_mjpeg_vlc(MJpegDecodeContext *s)
+{
+    static const struct {
+        int class, index, nb_values;
+        const uint8_t *bits, *values;
+    } ht[] = {
+        { 0, 0,  12, avpriv_mjpeg_bits_dc_luminance,   avpriv_mjpeg_val_dc },
+        { 0, 1,  12, avpriv_mjpeg_bits_dc_chrominance, avpriv_mjpeg_val_dc },
+        { 1, 0, 162, avpriv_mjpeg_bits_ac_luminance,   avpriv_mjpeg_val_ac_luminance },
+        { 1, 1, 162, avpriv_mjpeg_bits_ac_chrominance, avpriv_mjpeg_val_ac_chrominance },
+    };
+    int i, ret;
+
+    for (i = 0; i < FF_ARRAY_ELEMS(ht); i++) {
+        uint8_t *values = s->raw_huffman_values[ht[i].class][ht[i].index];
+
+        memcpy(s->raw_huffman_lengths[ht[i].class][ht[i].index], ht[i].bits, 17);
+        memcpy(values, ht[i].values, ht[i].nb_values);
+        memset(values + ht[i].nb_values, 0, 256 - ht[i].nb_values);
+        if ((ret = build_huffman_vlc(s, ht[i].class, ht[i].index)) < 0)
+            return ret;
+    }
 
     return 0;
 }
@@ -226,7 +247,7 @@ int ff_mjpeg_decode_dqt(MJpegDecodeContext *s)
 /* decode huffman tables and build VLC decoders */
 int ff_mjpeg_decode_dht(MJpegDecodeContext *s)
 {
-    int len, index, i, class, n, v, code_max;
+    int len, index, i, class, n;
     uint8_t bits_table[17];
     uint8_t val_table[256];
     int ret = 0;
@@ -248,6 +269,7 @@ int ff_mjpeg_decode_dht(MJpegDecodeContext *s)
         if (index >= 4)
             return AVERROR_INVALIDDATA;
         n = 0;
+        bits_table[0] = 0;
         for (i = 1; i <= 16; i++) {
             bits_table[i] = get_bits(&s->gb, 8);
             n += bits_table[i];
@@ -256,29 +278,18 @@ int ff_mjpeg_decode_dht(MJpegDecodeContext *s)
         if (len < n || n > 256)
             return AVERROR_INVALIDDATA;
 
-        code_max = 0;
-        for (i = 0; i < n; i++) {
-            v = get_bits(&s->gb, 8);
-            if (v > code_max)
-                code_max = v;
-            val_table[i] = v;
-        }
+        for (i = 0; i < n; i++)
+            val_table[i] = get_bits(&s->gb, 8);
+        memset(val_table + n, 0, sizeof(val_table) - n);
         len -= n;
 
         /* build VLC and flush previous vlc if present */
-        ff_free_vlc(&s->vlcs[class][index]);
+        memcpy(s->raw_huffman_lengths[class][index], bits_table, sizeof(bits_table));
+        memcpy(s->raw_huffman_values[class][index],  val_table,  sizeof(val_table));
         av_log(s->avctx, AV_LOG_DEBUG, "class=%d index=%d nb_codes=%d\n",
-               class, index, code_max + 1);
-        if ((ret = build_vlc(&s->vlcs[class][index], bits_table, val_table,
-                             code_max + 1, 0, class > 0)) < 0)
+               class, index, n);
+        if ((ret = build_huffman_vlc(s, class, index)) < 0)
             return ret;
-
-        if (class > 0) {
-            ff_free_vlc(&s->vlcs[2][index]);
-            if ((ret = build_vlc(&s->vlcs[2][index], bits_table, val_table,
-                                 code_max + 1, 0, 0)) < 0)
-                return ret;
-        }
     }
     return 0;
 }
@@ -643,9 +654,13 @@ unk_pixfmt:
         return 0;
     }
 
-    av_frame_unref(s->picture_ptr);
-    if (ff_get_buffer(s->avctx, s->picture_ptr, AV_GET_BUFFER_FLAG_REF) < 0)
-        return -1;
+    {
+        ThreadFrame tf = { .f = s->picture_ptr };
+
+        ff_thread_release_buffer(s->avctx, &tf);
+        if (ff_thread_get_buffer(s->avctx, &tf, AV_GET_BUFFER_FLAG_REF) < 0)
+            return -1;
+    }
     s->picture_ptr->pict_type = AV_PICTURE_TYPE_I;
     s->picture_ptr->key_frame = 1;
     s->got_picture            = 1;
@@ -1279,28 +1294,17 @@ static void shift_output(MJpegDecodeContext *s, uint8_t *ptr, int linesize)
     }
 }
 
-static int mjpeg_decode_scan(MJpegDecodeContext *s, int nb_components, int Ah,
-                             int Al, const uint8_t *mb_bitmask,
-                             int mb_bitmask_size,
-                             const AVFrame *reference)
+/* decode the MCUs mb_start to mb_end - 1 of a sequential DCT scan */
+static int decode_scan_mcus(MJpegDecodeContext *s, int nb_components, int Ah,
+                            int Al, GetBitContext *mb_bitmask_gb,
+                            const AVFrame *reference, int mb_start, int mb_end)
 {
-    int i, mb_x, mb_y, chroma_h_shift, chroma_v_shift, chroma_width, chroma_height;
+    int i, mb, chroma_h_shift, chroma_v_shift, chroma_width, chroma_height;
     uint8_t *data[MAX_COMPONENTS];
     const uint8_t *reference_data[MAX_COMPONENTS];
     int linesize[MAX_COMPONENTS];
-    GetBitContext mb_bitmask_gb = {0}; // initialize to silence gcc warning
     int bytes_per_pixel = 1 + (s->bits > 8);
 
-    if (mb_bitmask) {
-        if (mb_bitmask_size != (s->mb_width * s->mb_height + 7)>>3) {
-            av_log(s->avctx, AV_LOG_ERROR, "mb_bitmask_size mismatches\n");
-            return AVERROR_INVALIDDATA;
-        }
-        init_get_bits(&mb_bitmask_gb, mb_bitmask, s->mb_width * s->mb_height);
-    }
-
-    s->restart_count = 0;
-
     av_pix_fmt_get_chroma_sub_sample(s->avctx->pix_fmt, &chroma_h_shift,
                                      &chroma_v_shift);
     chroma_width  = AV_CEIL_RSHIFT(s->width,  chroma_h_shift);
@@ -1311,95 +1315,221 @@ static int mjpeg_decode_scan(MJpegDecodeContext *s, int nb_components, int Ah,
         data[c] = s->picture_ptr->data[c];
         reference_data[c] = reference ? reference->data[c] : NULL;
         linesize[c] = s->linesize[c];
-        s->coefs_finished[c] |= 1;
     }
 
-    for (mb_y = 0; mb_y < s->mb_height; mb_y++) {
-        for (mb_x = 0; mb_x < s->mb_width; mb_x++) {
-            const int copy_mb = mb_bitmask && !get_bits1(&mb_bitmask_gb);
+    for (mb = mb_start; mb < mb_end; mb++) {
+        const int mb_x = mb % s->mb_width;
+        const int mb_y = mb / s->mb_width;
+        const int copy_mb = mb_bitmask_gb && !get_bits1(mb_bitmask_gb);
 
-            if (s->restart_interval && !s->restart_count)
-                s->restart_count = s->restart_interval;
+        if (s->restart_interval && !s->restart_count)
+            s->restart_count = s->restart_interval;
 
-            if (get_bits_left(&s->gb) < 0) {
-                av_log(s->avctx, AV_LOG_ERROR, "overread %d\n",
-                       -get_bits_left(&s->gb));
-                return AVERROR_INVALIDDATA;
-            }
-            for (i = 0; i < nb_components; i++) {
-                uint8_t *ptr;
-                int n, h, v, x, y, c, j;
-                int block_offset;
-                n = s->nb_blocks[i];
-                c = s->comp_index[i];
-                h = s->h_scount[i];
-                v = s->v_scount[i];
-                x = 0;
-                y = 0;
-                for (j = 0; j < n; j++) {
-                    block_offset = (((linesize[c] * (v * mb_y + y) * 8) +
-                                     (h * mb_x + x) * 8 * bytes_per_pixel) >> s->avctx->lowres);
-
-                    if (s->interlaced && s->bottom_field)
-                        block_offset += linesize[c] >> 1;
-                    if (   8*(h * mb_x + x) < ((c == 1) || (c == 2) ? chroma_width  : s->width)
-                        && 8*(v * mb_y + y) < ((c == 1) || (c == 2) ? chroma_height : s->height)) {
-                        ptr = data[c] + block_offset;
-                    } else
-                        ptr = NULL;
-                    if (!s->progressive) {
-                        if (copy_mb) {
-                            if (ptr)
-                                mjpeg_copy_block(s, ptr, reference_data[c] + block_offset,
-                                                linesize[c], s->avctx->lowres);
+        if (get_bits_left(&s->gb) < 0) {
+            av_log(s->avctx, AV_LOG_ERROR, "overread %d\n",
+                   -get_bits_left(&s->gb));
+            return AVERROR_INVALIDDATA;
+        }
+        for (i = 0; i < nb_components; i++) {
+            uint8_t *ptr;
+            int n, h, v, x, y, c, j;
+            int block_offset;
+            n = s->nb_blocks[i];
+            c = s->comp_index[i];
+            h = s->h_scount[i];
+            v = s->v_scount[i];
+            x = 0;
+            y = 0;
+            for (j = 0; j < n; j++) {
+                block_offset = (((linesize[c] * (v * mb_y + y) * 8) +
+                                 (h * mb_x + x) * 8 * bytes_per_pixel) >> s->avctx->lowres);
+
+                if (s->interlaced && s->bottom_field)
+                    block_offset += linesize[c] >> 1;
+                if (   8*(h * mb_x + x) < ((c == 1) || (c == 2) ? chroma_width  : s->width)
+                    && 8*(v * mb_y + y) < ((c == 1) || (c == 2) ? chroma_height : s->height)) {
+                    ptr = data[c] + block_offset;
+                } else
+                    ptr = NULL;
+                if (!s->progressive) {
+                    if (copy_mb) {
+                        if (ptr)
+                            mjpeg_copy_block(s, ptr, reference_data[c] + block_offset,
+                                            linesize[c], s->avctx->lowres);
 
-                        } else {
-                            s->bdsp.clear_block(s->block);
-                            if (decode_block(s, s->block, i,
-                                             s->dc_index[i], s->ac_index[i],
-                                             s->quant_matrixes[s->quant_sindex[i]]) < 0) {
-                                av_log(s->avctx, AV_LOG_ERROR,
-                                       "error y=%d x=%d\n", mb_y, mb_x);
-                                return AVERROR_INVALIDDATA;
-                            }
-                            if (ptr) {
-                                s->idsp.idct_put(ptr, linesize[c], s->block);
-                                if (s->bits & 7)
-                                    shift_output(s, ptr, linesize[c]);
-                            }
-                        }
                     } else {
-                        int block_idx  = s->block_stride[c] * (v * mb_y + y) +
-                                         (h * mb_x + x);
-                        int16_t *block = s->blocks[c][block_idx];
-                        if (Ah)
-                            block[0] += get_bits1(&s->gb) *
-                                        s->quant_matrixes[s->quant_sindex[i]][0] << Al;
-                        else if (decode_dc_progressive(s, block, i, s->dc_index[i],
-                                                       s->quant_matrixes[s->quant_sindex[i]],
-                                                       Al) < 0) {
+                        s->bdsp.clear_block(s->block);
+                        if (decode_block(s, s->block, i,
+                                         s->dc_index[i], s->ac_index[i],
+                                         s->quant_matrixes[s->quant_sindex[i]]) < 0) {
                             av_log(s->avctx, AV_LOG_ERROR,
                                    "error y=%d x=%d\n", mb_y, mb_x);
                             return AVERROR_INVALIDDATA;
                         }
+                        if (ptr) {
+                            s->idsp.idct_put(ptr, linesize[c], s->block);
+                            if (s->bits & 7)
+                                shift_output(s, ptr, linesize[c]);
+                        }
                     }
-                    ff_dlog(s->avctx, "mb: %d %d processed\n", mb_y, mb_x);
-                    ff_dlog(s->avctx, "%d %d %d %d %d %d %d %d \n",
-                            mb_x, mb_y, x, y, c, s->bottom_field,
-                            (v * mb_y + y) * 8, (h * mb_x + x) * 8);
-                    if (++x == h) {
-                        x = 0;
-                        y++;
+                } else {
+                    int block_idx  = s->block_stride[c] * (v * mb_y + y) +
+                                     (h * mb_x + x);
+                    int16_t *block = s->blocks[c][block_idx];
+                    if (Ah)
+                        block[0] += get_bits1(&s->gb) *
+                                    s->quant_matrixes[s->quant_sindex[i]][0] << Al;
+                    else if (decode_dc_progressive(s, block, i, s->dc_index[i],
+                                                   s->quant_matrixes[s->quant_sindex[i]],
+                                                   Al) < 0) {
+                        av_log(s->avctx, AV_LOG_ERROR,
+                               "error y=%d x=%d\n", mb_y, mb_x);
+                        return AVERROR_INVALIDDATA;
                     }
                 }
+                ff_dlog(s->avctx, "mb: %d %d processed\n", mb_y, mb_x);
+                ff_dlog(s->avctx, "%d %d %d %d %d %d %d %d \n",
+                        mb_x, mb_y, x, y, c, s->bottom_field,
+                        (v * mb_y + y) * 8, (h * mb_x + x) * 8);
+                if (++x == h) {
+                    x = 0;
+                    y++;
+                }
             }
-
-            handle_rstn(s, nb_components);
         }
+
+        handle_rstn(s, nb_components);
+    }
+    return 0;
+}
+
+typedef struct ScanSliceArgs {
+    int nb_components, Ah, Al;
+    int first_rst;   ///< index in rst_offsets of the marker ending the first interval
+    int start, end;  ///< offsets in buffer of the scan data
+    int nb_slices;
+    int end_bits;    ///< position in buffer after the last interval, in bits
+} ScanSliceArgs;
+
+static int decode_scan_slice(AVCodecContext *avctx, void *arg,
+                             int jobnr, int threadnr)
+{
+    MJpegDecodeContext *s  = avctx->priv_data;
+    MJpegDecodeContext *sc = &s->slice_ctx[threadnr];
+    ScanSliceArgs *a = arg;
+    int start = jobnr ? s->rst_offsets[a->first_rst + jobnr - 1] : a->start;
+    int end   = jobnr < a->nb_slices - 1 ? s->rst_offsets[a->first_rst + jobnr] : a->end;
+    int mb_start = jobnr * s->restart_interval;
+    int i, ret;
+
+    ret = init_get_bits8(&sc->gb, s->buffer + start, end - start);
+    if (ret < 0)
+        return ret;
+    /* each interval starts as after a restart marker */
+    for (i = 0; i < a->nb_components; i++)
+        sc->last_dc[i] = (4 << s->bits);
+    sc->restart_count = 0;
+
+    ret = decode_scan_mcus(sc, a->nb_components, a->Ah, a->Al, NULL, NULL, mb_start,
+                           FFMIN(mb_start + s->restart_interval, s->mb_width * s->mb_height));
+
+    if (jobnr == a->nb_slices - 1)
+        a->end_bits = start * 8 + get_bits_count(&sc->gb);
+    return ret;
+}
+
+/**
+ * Decode the restart intervals of a sequential DCT scan in parallel, they
+ * are independent once the RSTn markers which separate them are located.
+ *
+ * @return AVERROR(EAGAIN) if the scan must be decoded sequentially
+ */
+static int decode_scan_slices(MJpegDecodeContext *s, int nb_components,
+                              int Ah, int Al)
+{
+    AVCodecContext *avctx = s->avctx;
+    ScanSliceArgs a = {
+        .nb_components = nb_components,
+        .Ah            = Ah,
+        .Al            = Al,
+        .start         = get_bits_count(&s->gb) >> 3,
+        .end           = s->gb.size_in_bits >> 3,
+    };
+    int *ret;
+    int i, err = 0;
+
+    a.nb_slices = (s->mb_width * s->mb_height + s->restart_interval - 1) /
+                  s->restart_interval;
+    if (a.nb_slices < 2 || s->gb.buffer != s->buffer || get_bits_count(&s->gb) & 7)
+        return AVERROR(EAGAIN);
+
+    /* the scan may follow another one in the buffer (AVRn fields) */
+    for (a.first_rst = 0; a.first_rst < s->nb_rst; a.first_rst++)
+        if (s->rst_offsets[a.first_rst] > a.start)
+            break;
+    if (s->nb_rst - a.first_rst < a.nb_slices - 1)
+        return AVERROR(EAGAIN);
+
+    if (!s->slice_ctx) {
+        s->slice_ctx = av_malloc_array(avctx->thread_count, sizeof(*s->slice_ctx));
+        if (!s->slice_ctx)
+            return AVERROR(ENOMEM);
     }
+    ret = av_malloc_array(a.nb_slices, sizeof(*ret));
+    if (!ret)
+        return AVERROR(ENOMEM);
+    for (i = 0; i < avctx->thread_count; i++)
+        s->slice_ctx[i] = *s;
+
+    avctx->execute2(avctx, decode_scan_slice, &a, ret, a.nb_slices);
+
+    for (i = 0; i < a.nb_slices; i++)
+        if (ret[i] < 0 && !err)
+            err = ret[i];
+    av_free(ret);
+    if (err < 0)
+        return err;
+
+    /* leave the reader after the scan, as the sequential decoding would */
+    skip_bits_long(&s->gb, a.end_bits - get_bits_count(&s->gb));
+    s->restart_count = 0;
     return 0;
 }
 
+static int mjpeg_decode_scan(MJpegDecodeContext *s, int nb_components, int Ah,
+                             int Al, const uint8_t *mb_bitmask,
+                             int mb_bitmask_size,
+                             const AVFrame *reference)
+{
+    int i;
+    GetBitContext mb_bitmask_gb = {0}; // initialize to silence gcc warning
+
+    if (mb_bitmask) {
+        if (mb_bitmask_size != (s->mb_width * s->mb_height + 7)>>3) {
+            av_log(s->avctx, AV_LOG_ERROR, "mb_bitmask_size mismatches\n");
+            return AVERROR_INVALIDDATA;
+        }
+        init_get_bits(&mb_bitmask_gb, mb_bitmask, s->mb_width * s->mb_height);
+    }
+
+    s->restart_count = 0;
+
+    for (i = 0; i < nb_components; i++)
+        s->coefs_finished[s->comp_index[i]] |= 1;
+
+    if (s->avctx->active_thread_type & FF_THREAD_SLICE &&
+        s->restart_interval && !s->progressive && !mb_bitmask &&
+        s->avctx->codec_id != AV_CODEC_ID_THP) {
+        int ret = decode_scan_slices(s, nb_components, Ah, Al);
+        if (ret != AVERROR(EAGAIN))
+            return ret;
+    }
+
+    return decode_scan_mcus(s, nb_components, Ah, Al,
+                            mb_bitmask ? &mb_bitmask_gb : NULL, reference,
+                            0, s->mb_width * s->mb_height);
+}
+
 static int mjpeg_decode_scan_progressive_ac(MJpegDecodeContext *s, int ss,
                                             int se, int Ah, int Al)
 {
@@ -2070,6 +2200,8 @@ int ff_mjpeg_find_marker(MJpegDecodeContext *s,
             }                                         \
         } while (0)
 
+        s->nb_rst = 0;
+
         if (s->avctx->codec_id == AV_CODEC_ID_THP) {
             ptr = buf_end;
             copy_data_segment(0);
@@ -2098,6 +2230,16 @@ int ff_mjpeg_find_marker(MJpegDecodeContext *s,
                         copy_data_segment(1);
                         if (x)
                             break;
+                    } else if (s->nb_rst >= 0) {
+                        /* RSTn, kept in the unescaped data */
+                        int *offsets = av_fast_realloc(s->rst_offsets, &s->rst_offsets_size,
+                                                       (s->nb_rst + 1) * sizeof(*offsets));
+                        if (offsets) {
+                            s->rst_offsets = offsets;
+                            s->rst_offsets[s->nb_rst++] = (dst - s->buffer) + (ptr - src);
+                        } else {
+                            s->nb_rst = -1;
+                        }
                     }
                 }
             }
@@ -2177,6 +2319,40 @@ static void reset_icc_profile(MJpegDecodeContext *s)
     s->iccnum  = 0;
 }
 
+/**
+ * Check whether the next frame thread can start once the first scan of the
+ * packet starts: a baseline or extended sequential picture, with nothing
+ * but scans and restart markers after its first scan.
+ */
+static int can_setup_early(const uint8_t *buf, const uint8_t *buf_end)
+{
+    int start_code, sof = 0, sos = 0;
+
+    while ((start_code = find_marker(&buf, buf_end)) >= 0) {
+        if (start_code == EOI)
+            return sos;
+        if (start_code == SOI || (start_code >= RST0 && start_code <= RST7))
+            continue;
+        if (sos && start_code != SOS)
+            return 0;
+        if (start_code == SOF0 || start_code == SOF1) {
+            sof = 1;
+        } else if (start_code == SOF2 || start_code == SOF3 ||
+                   start_code == SOF48 || start_code == LSE) {
+            return 0;
+        } else if (start_code == SOS) {
+            if (!sof)
+                return 0;
+            sos = 1;
+        }
+        /* skip the segment, the tables may contain marker lookalikes */
+        if (buf_end - buf < 2)
+            return 0;
+        buf += AV_RB16(buf);
+    }
+    return sos;
+}
+
 int ff_mjpeg_decode_frame(AVCodecContext *avctx, void *data, int *got_frame,
                           AVPacket *avpkt)
 {
@@ -2197,6 +2373,10 @@ int ff_mjpeg_decode_frame(AVCodecContext *avctx, void *data, int *got_frame,
     av_freep(&s->stereo3d);
     s->adobe_transform = -1;
 
+    s->early_setup = 0;
+    if (avctx->active_thread_type & FF_THREAD_FRAME)
+        s->early_setup = can_setup_early(buf, buf + buf_size) ? -1 : 0;
+
     if (s->iccnum != 0)
         reset_icc_profile(s);
 
@@ -2370,6 +2550,13 @@ eoi_parser:
                 break;
             }
 
+            /* the picture is allocated and nothing the next frame depends
+             * on changes anymore, let the next frame thread start */
+            if (s->early_setup < 0 && s->got_picture && !s->interlaced) {
+                s->early_setup = 1;
+                ff_thread_finish_setup(avctx);
+            }
+
             if ((ret = ff_mjpeg_decode_sos(s, NULL, 0, NULL)) < 0 &&
                 (avctx->err_recognition & AV_EF_EXPLODE))
                 goto fail;
@@ -2650,6 +2837,8 @@ av_cold int ff_mjpeg_decode_end(AVCodecContext *avctx)
         av_frame_unref(s->picture_ptr);
 
     av_freep(&s->buffer);
+    av_freep(&s->rst_offsets);
+    av_freep(&s->slice_ctx);
     av_freep(&s->stereo3d);
     av_freep(&s->ljpeg_buffer);
     s->ljpeg_buffer_size = 0;
@@ -2669,6 +2858,103 @@ av_cold int ff_mjpeg_decode_end(AVCodecContext *avctx)
     return 0;
 }
 
+#if HAVE_THREADS
+/* rebuild the VLCs, of the tables which differ from s1 ones if not NULL */
+static int rebuild_huffman_vlcs(MJpegDecodeContext *s, const MJpegDecodeContext *s1)
+{
+    static const uint8_t no_codes[17] = { 0 };
+    int class, index, ret;
+
+    for (class = 0; class < 2; class++) {
+        for (index = 0; index < 4; index++) {
+            if (s1 &&
+                !memcmp(s->raw_huffman_lengths[class][index],
+                        s1->raw_huffman_lengths[class][index],
+                        sizeof(s->raw_huffman_lengths[class][index])) &&
+                !memcmp(s->raw_huffman_values[class][index],
+                        s1->raw_huffman_values[class][index],
+                        sizeof(s->raw_huffman_values[class][index])))
+                continue;
+            if (s1) {
+                memcpy(s->raw_huffman_lengths[class][index],
+                       s1->raw_huffman_lengths[class][index],
+                       sizeof(s->raw_huffman_lengths[class][index]));
+                memcpy(s->raw_huffman_values[class][index],
+                       s1->raw_huffman_values[class][index],
+                       sizeof(s->raw_huffman_values[class][index]));
+            }
+            /* never defined */
+            if (!memcmp(s->raw_huffman_lengths[class][index], no_codes,
+                        sizeof(no_codes)))
+                continue;
+            if ((ret = build_huffman_vlc(s, class, index)) < 0)
+                return ret;
+        }
+    }
+    return 0;
+}
+
+static int mjpeg_decode_init_thread_copy(AVCodecContext *avctx)
+{
+    MJpegDecodeContext *s = avctx->priv_data;
+
+    s->avctx       = avctx;
+    s->picture     = av_frame_alloc();
+    s->picture_ptr = s->picture;
+    s->buffer      = NULL;
+    s->buffer_size = 0;
+    s->rst_offsets = NULL;
+    s->rst_offsets_size = 0;
+    s->slice_ctx   = NULL;
+    memset(s->vlcs, 0, sizeof(s->vlcs));
+    memset(s->blocks, 0, sizeof(s->blocks));
+    memset(s->last_nnz, 0, sizeof(s->last_nnz));
+    s->ljpeg_buffer      = NULL;
+    s->ljpeg_buffer_size = 0;
+    s->exif_metadata = NULL;
+    s->stereo3d      = NULL;
+    s->iccdata       = NULL;
+    s->iccdatalens   = NULL;
+    s->iccnum        = 0;
+    if (!s->picture)
+        return AVERROR(ENOMEM);
+
+    return rebuild_huffman_vlcs(s, NULL);
+}
+
+static int mjpeg_decode_update_thread_context(AVCodecContext *dst,
+                                              const AVCodecContext *src)
+{
+    MJpegDecodeContext *s = dst->priv_data, *s1 = src->priv_data;
+    int ret;
+
+    if (dst == src)
+        return 0;
+
+    if ((ret = rebuild_huffman_vlcs(s, s1)) < 0)
+        return ret;
+
+    memcpy(&s->quant_matrixes, &s1->quant_matrixes,
+           (char *)&s1->pix_desc + sizeof(s1->pix_desc) - (char *)&s1->quant_matrixes);
+
+    /* after an early setup, the source thread is still decoding its
+     * picture; otherwise it may have left the first field of a picture */
+    if (s1->early_setup == 1) {
+        s->got_picture = 0;
+        s->cur_scan    = 0;
+    } else {
+        s->got_picture = s1->got_picture;
+        s->cur_scan    = s1->cur_scan;
+        av_frame_unref(s->picture_ptr);
+        if (s->got_picture &&
+            (ret = av_frame_ref(s->picture_ptr, s1->picture_ptr)) < 0)
+            return ret;
+    }
+
+    return 0;
+}
+#endif
+
 static void decode_flush(AVCodecContext *avctx)
 {
     MJpegDecodeContext *s = avctx->priv_data;
@@ -2701,7 +2987,10 @@ AVCodec ff_mjpeg_decoder = {
     .close          = ff_mjpeg_decode_end,
     .decode         = ff_mjpeg_decode_frame,
     .flush          = decode_flush,
-    .capabilities   = AV_CODEC_CAP_DR1,
+    .init_thread_copy      = ONLY_IF_THREADS_ENABLED(mjpeg_decode_init_thread_copy),
+    .update_thread_context = ONLY_IF_THREADS_ENABLED(mjpeg_decode_update_thread_context),
+    .capabilities   = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_FRAME_THREADS |
+                      AV_CODEC_CAP_SLICE_THREADS,
     .max_lowres     = 3,
     .priv_class     = &mjpegdec_class,
     .caps_internal  = FF_CODEC_CAP_INIT_THREADSAFE |
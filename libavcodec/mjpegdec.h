@@ -50,8 +50,15 @@ typedef struct MJpegDecodeContext {
     int buffer_size;
     uint8_t *buffer;
 
-    uint16_t quant_matrixes[4][64];
     VLC vlcs[3][4];
+
+    /* huffman tables the VLCs are built from, [class][index] */
+    uint8_t raw_huffman_lengths[2][4][17];
+    uint8_t raw_huffman_values[2][4][256];
+
+    /* The state of the stream from quant_matrixes up to pix_desc carries over
+     * from one packet to the next, frame threads copy it as a whole. */
+    uint16_t quant_matrixes[4][64];
     int qscale[4];      ///< quantizer scale calculated from quant_matrixes
 
     int org_height;  /* size given at codec init */
@@ -92,29 +99,45 @@ typedef struct MJpegDecodeContext {
     int quant_sindex[MAX_COMPONENTS];
     int h_max, v_max; /* maximum h and v counts */
     int quant_index[4];   /* quant table index for each component */
+    int linesize[MAX_COMPONENTS];                   ///< linesize << interlaced
+    int palette_index;
+    ScanTable scantable;
+    IDCTDSPContext idsp;
+
+    int restart_interval;
+
+    int buggy_avid;
+    int cs_itu601;
+    int interlace_polarity;
+    int multiscope;
+
+    const AVPixFmtDescriptor *pix_desc;
+    /* end of the state copied by frame threads */
+
     int last_dc[MAX_COMPONENTS]; /* last DEQUANTIZED dc (XXX: am I right to do that ?) */
     AVFrame *picture; /* picture structure */
     AVFrame *picture_ptr; /* pointer to picture structure */
     int got_picture;                                ///< we found a SOF and picture is valid, too.
-    int linesize[MAX_COMPONENTS];                   ///< linesize << interlaced
     int8_t *qscale_table;
     DECLARE_ALIGNED(32, int16_t, block)[64];
     int16_t (*blocks[MAX_COMPONENTS])[64]; ///< intermediate sums (progressive mode)
     uint8_t *last_nnz[MAX_COMPONENTS];
     uint64_t coefs_finished[MAX_COMPONENTS]; ///< bitmask of which coefs have been completely decoded (progressive mode)
-    int palette_index;
-    ScanTable scantable;
     BlockDSPContext bdsp;
     HpelDSPContext hdsp;
-    IDCTDSPContext idsp;
 
-    int restart_interval;
     int restart_count;
 
-    int buggy_avid;
-    int cs_itu601;
-    int interlace_polarity;
-    int multiscope;
+    /* offsets in buffer of the data following the RSTn markers of the
+     * current scan, used to decode the restart intervals in parallel */
+    int *rst_offsets;
+    unsigned int rst_offsets_size;
+    int nb_rst;
+    struct MJpegDecodeContext *slice_ctx; ///< one copy per slice thread
+
+    /* frame threading: -1 if ff_thread_finish_setup() may be called at the
+     * first SOS of the packet, 1 once it was, 0 otherwise */
+    int early_setup;
 
     int mjpb_skiptosod;
 
@@ -129,8 +152,6 @@ typedef struct MJpegDecodeContext {
 
     AVStereo3D *stereo3d; ///!< stereoscopic information (cached, since it is read before frame allocation)
 
-    const AVPixFmtDescriptor *pix_desc;
-
     uint8_t **iccdata;
     int *iccdatalens;
     int iccnum;
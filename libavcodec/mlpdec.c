@@ -124,6 +124,10 @@ typedef struct SubStream {
     /// Running XOR of all output samples.
     int32_t     lossless_check_data;
 
+    int         matrix_changed;
+    int         filter_changed[MAX_CHANNELS][NUM_FILTERS];
+
+    int8_t      bypassed_lsbs[MAX_BLOCKSIZE][MAX_CHANNELS];
 } SubStream;
 
 typedef struct MLPDecodeContext {
@@ -154,11 +158,19 @@ typedef struct MLPDecodeContext {
 
     SubStream   substream[MAX_SUBSTREAMS];
 
-    int         matrix_changed;
-    int         filter_changed[MAX_CHANNELS][NUM_FILTERS];
+    /// Data of each substream in the current access unit.
+    const uint8_t *substream_buf[MAX_SUBSTREAMS];
+    uint16_t    substream_data_len[MAX_SUBSTREAMS];
+    uint8_t     substream_parity_present[MAX_SUBSTREAMS];
+
+    /// Set if the substreams of the current access unit are decoded in parallel.
+    int         substreams_threaded;
+
+    /// State of the substreams before they are decoded in parallel, to decode
+    /// the access unit again sequentially when a substream needs it.
+    SubStream   substream_saved[MAX_SUBSTREAMS];
 
     int8_t      noise_buffer[MAX_BLOCKSIZE_POW2];
-    int8_t      bypassed_lsbs[MAX_BLOCKSIZE][MAX_CHANNELS];
     DECLARE_ALIGNED(32, int32_t, sample_buffer)[MAX_BLOCKSIZE][MAX_CHANNELS];
 
     MLPDSPContext dsp;
@@ -249,7 +261,7 @@ static inline int read_huff_channels(MLPDecodeContext *m, GetBitContext *gbp,
 
     for (mat = 0; mat < s->num_primitive_matrices; mat++)
         if (s->lsb_bypass[mat])
-            m->bypassed_lsbs[pos + s->blockpos][mat] = get_bits1(gbp);
+            s->bypassed_lsbs[pos + s->blockpos][mat] = get_bits1(gbp);
 
     for (channel = s->min_channel; channel <= s->max_channel; channel++) {
         ChannelParams *cp = &s->channel_params[channel];
@@ -653,7 +665,7 @@ static int read_filter_params(MLPDecodeContext *m, GetBitContext *gbp,
     // Filter is 0 for FIR, 1 for IIR.
     av_assert0(filter < 2);
 
-    if (m->filter_changed[channel][filter]++ > 1) {
+    if (s->filter_changed[channel][filter]++ > 1) {
         av_log(m->avctx, AV_LOG_ERROR, "Filters may change only once per access unit.\n");
         return AVERROR_INVALIDDATA;
     }
@@ -723,7 +735,7 @@ static int read_matrix_params(MLPDecodeContext *m, unsigned int substr, GetBitCo
                                      ? MAX_MATRICES_MLP
                                      : MAX_MATRICES_TRUEHD;
 
-    if (m->matrix_changed++ > 1) {
+    if (s->matrix_changed++ > 1) {
         av_log(m->avctx, AV_LOG_ERROR, "Matrices may change only once per access unit.\n");
         return AVERROR_INVALIDDATA;
     }
@@ -969,8 +981,8 @@ static int read_block_data(MLPDecodeContext *m, GetBitContext *gbp,
         return AVERROR_INVALIDDATA;
     }
 
-    memset(&m->bypassed_lsbs[s->blockpos][0], 0,
-           s->blocksize * sizeof(m->bypassed_lsbs[0]));
+    memset(&s->bypassed_lsbs[s->blockpos][0], 0,
+           s->blocksize * sizeof(s->bypassed_lsbs[0]));
 
     for (i = 0; i < s->blocksize; i++)
         if ((ret = read_huff_channels(m, gbp, substr, i)) < 0)
@@ -1092,7 +1104,7 @@ static int output_data(MLPDecodeContext *m, unsigned int substr,
         unsigned int dest_ch = s->matrix_out_ch[mat];
         m->dsp.mlp_rematrix_channel(&m->sample_buffer[0][0],
                                     s->matrix_coeff[mat],
-                                    &m->bypassed_lsbs[0][mat],
+                                    &s->bypassed_lsbs[0][mat],
                                     m->noise_buffer,
                                     s->num_primitive_matrices - mat,
                                     dest_ch,
@@ -1125,6 +1137,142 @@ static int output_data(MLPDecodeContext *m, unsigned int substr,
     return 0;
 }
 
+/** Read the data of a substream of the current access unit: the decoding
+ *  parameters and the blocks of PCM samples, which are filtered.
+ *  @return negative on error, 1 if the substreams are decoded in parallel and
+ *  this one has a restart header, so that the access unit must be decoded
+ *  sequentially, 0 otherwise. */
+
+static int read_substream(MLPDecodeContext *m, unsigned int substr)
+{
+    SubStream *s = &m->substream[substr];
+    const uint8_t *buf = m->substream_buf[substr];
+    unsigned int data_len = m->substream_data_len[substr];
+    GetBitContext gb;
+    int ret;
+
+    init_get_bits(&gb, buf, data_len * 8);
+
+    s->matrix_changed = 0;
+    memset(s->filter_changed, 0, sizeof(s->filter_changed));
+
+    s->blockpos = 0;
+    do {
+        if (get_bits1(&gb)) {
+            if (get_bits1(&gb)) {
+                /* A restart header should be present. It changes the
+                 * parameters shared between substreams, so it cannot be read
+                 * while other substreams are decoded. */
+                if (m->substreams_threaded)
+                    return 1;
+                if (read_restart_header(m, &gb, buf, substr) < 0)
+                    goto next_substr;
+                s->restart_seen = 1;
+            }
+
+            if (!s->restart_seen)
+                goto next_substr;
+            if (read_decoding_params(m, &gb, substr) < 0)
+                goto next_substr;
+        }
+
+        if (!s->restart_seen)
+            goto next_substr;
+
+        if ((ret = read_block_data(m, &gb, substr)) < 0)
+            return ret;
+
+        if (get_bits_count(&gb) >= data_len * 8)
+            goto substream_length_mismatch;
+
+    } while (!get_bits1(&gb));
+
+    skip_bits(&gb, (-get_bits_count(&gb)) & 15);
+
+    if (data_len * 8 - get_bits_count(&gb) >= 32) {
+        int shorten_by;
+
+        if (get_bits(&gb, 16) != 0xD234)
+            return AVERROR_INVALIDDATA;
+
+        shorten_by = get_bits(&gb, 16);
+        if      (m->avctx->codec_id == AV_CODEC_ID_TRUEHD && shorten_by  & 0x2000)
+            s->blockpos -= FFMIN(shorten_by & 0x1FFF, s->blockpos);
+        else if (m->avctx->codec_id == AV_CODEC_ID_MLP    && shorten_by != 0xD234)
+            return AVERROR_INVALIDDATA;
+
+        if (substr == m->max_decoded_substream)
+            av_log(m->avctx, AV_LOG_INFO, "End of stream indicated.\n");
+    }
+
+    if (m->substream_parity_present[substr]) {
+        uint8_t parity, checksum;
+
+        if (data_len * 8 - get_bits_count(&gb) != 16)
+            goto substream_length_mismatch;
+
+        parity   = ff_mlp_calculate_parity(buf, data_len - 2);
+        checksum = ff_mlp_checksum8       (buf, data_len - 2);
+
+        if ((get_bits(&gb, 8) ^ parity) != 0xa9    )
+            av_log(m->avctx, AV_LOG_ERROR, "Substream %d parity check failed.\n", substr);
+        if ( get_bits(&gb, 8)           != checksum)
+            av_log(m->avctx, AV_LOG_ERROR, "Substream %d checksum failed.\n"    , substr);
+    }
+
+    if (data_len * 8 != get_bits_count(&gb))
+        goto substream_length_mismatch;
+
+next_substr:
+    if (!s->restart_seen)
+        av_log(m->avctx, AV_LOG_ERROR,
+               "No restart header present in substream %d.\n", substr);
+
+    return 0;
+
+substream_length_mismatch:
+    av_log(m->avctx, AV_LOG_ERROR, "substream %d length mismatch\n", substr);
+    return AVERROR_INVALIDDATA;
+}
+
+static int read_substream_thread(AVCodecContext *avctx, void *arg,
+                                 int substr, int threadnr)
+{
+    return read_substream(avctx->priv_data, substr);
+}
+
+/** Check whether the substreams of the current access unit can be decoded in
+ *  parallel: each substream filters its own range of channels, and only a
+ *  restart header changes the parameters shared between substreams. A restart
+ *  header at the start of a substream is checked here, one in a later block
+ *  is only found while decoding. */
+
+static int substreams_independent(MLPDecodeContext *m)
+{
+    unsigned int substr, ch, channel_mask = 0;
+
+    if (!(m->avctx->active_thread_type & FF_THREAD_SLICE) ||
+        m->is_major_sync_unit || !m->max_decoded_substream)
+        return 0;
+
+    for (substr = 0; substr <= m->max_decoded_substream; substr++) {
+        SubStream *s = &m->substream[substr];
+
+        if (m->substream_data_len[substr] &&
+            (m->substream_buf[substr][0] & 0xc0) == 0xc0)
+            return 0;
+        if (!s->restart_seen)
+            continue;
+        for (ch = s->min_channel; ch <= s->max_channel; ch++) {
+            if (channel_mask & (1U << ch))
+                return 0;
+            channel_mask |= 1U << ch;
+        }
+    }
+
+    return 1;
+}
+
 /** Read an access unit from the stream.
  *  @return negative on error, 0 if not enough data is present in the input stream,
  *  otherwise the number of bytes consumed. */
@@ -1140,8 +1288,6 @@ static int read_access_unit(AVCodecContext *avctx, void* data,
     unsigned int substream_start;
     unsigned int header_size = 4;
     unsigned int substr_header_size = 0;
-    uint8_t substream_parity_present[MAX_SUBSTREAMS];
-    uint16_t substream_data_len[MAX_SUBSTREAMS];
     uint8_t parity_bits;
     int ret;
 
@@ -1221,8 +1367,8 @@ static int read_access_unit(AVCodecContext *avctx, void* data,
         if (substr > m->max_decoded_substream)
             continue;
 
-        substream_parity_present[substr] = checkdata_present;
-        substream_data_len[substr] = end - substream_start;
+        m->substream_parity_present[substr] = checkdata_present;
+        m->substream_data_len[substr] = end - substream_start;
         substream_start = end;
     }
 
@@ -1237,81 +1383,38 @@ static int read_access_unit(AVCodecContext *avctx, void* data,
     buf += header_size + substr_header_size;
 
     for (substr = 0; substr <= m->max_decoded_substream; substr++) {
-        SubStream *s = &m->substream[substr];
-        init_get_bits(&gb, buf, substream_data_len[substr] * 8);
-
-        m->matrix_changed = 0;
-        memset(m->filter_changed, 0, sizeof(m->filter_changed));
-
-        s->blockpos = 0;
-        do {
-            if (get_bits1(&gb)) {
-                if (get_bits1(&gb)) {
-                    /* A restart header should be present. */
-                    if (read_restart_header(m, &gb, buf, substr) < 0)
-                        goto next_substr;
-                    s->restart_seen = 1;
-                }
-
-                if (!s->restart_seen)
-                    goto next_substr;
-                if (read_decoding_params(m, &gb, substr) < 0)
-                    goto next_substr;
-            }
-
-            if (!s->restart_seen)
-                goto next_substr;
-
-            if ((ret = read_block_data(m, &gb, substr)) < 0)
-                return ret;
-
-            if (get_bits_count(&gb) >= substream_data_len[substr] * 8)
-                goto substream_length_mismatch;
-
-        } while (!get_bits1(&gb));
-
-        skip_bits(&gb, (-get_bits_count(&gb)) & 15);
-
-        if (substream_data_len[substr] * 8 - get_bits_count(&gb) >= 32) {
-            int shorten_by;
-
-            if (get_bits(&gb, 16) != 0xD234)
-                return AVERROR_INVALIDDATA;
-
-            shorten_by = get_bits(&gb, 16);
-            if      (m->avctx->codec_id == AV_CODEC_ID_TRUEHD && shorten_by  & 0x2000)
-                s->blockpos -= FFMIN(shorten_by & 0x1FFF, s->blockpos);
-            else if (m->avctx->codec_id == AV_CODEC_ID_MLP    && shorten_by != 0xD234)
-                return AVERROR_INVALIDDATA;
+        m->substream_buf[substr] = buf;
+        buf += m->substream_data_len[substr];
+    }
 
-            if (substr == m->max_decoded_substream)
-                av_log(m->avctx, AV_LOG_INFO, "End of stream indicated.\n");
+    m->substreams_threaded = substreams_independent(m);
+    if (m->substreams_threaded) {
+        int substr_ret[MAX_SUBSTREAMS], restart = 0;
+
+        /* the bypassed LSBs are rewritten by every access unit */
+        for (substr = 0; substr <= m->max_decoded_substream; substr++)
+            memcpy(&m->substream_saved[substr], &m->substream[substr],
+                   offsetof(SubStream, bypassed_lsbs));
+
+        avctx->execute2(avctx, read_substream_thread, NULL, substr_ret,
+                        m->max_decoded_substream + 1);
+        for (substr = 0; substr <= m->max_decoded_substream; substr++) {
+            if (substr_ret[substr] < 0)
+                return substr_ret[substr];
+            restart |= substr_ret[substr];
         }
 
-        if (substream_parity_present[substr]) {
-            uint8_t parity, checksum;
-
-            if (substream_data_len[substr] * 8 - get_bits_count(&gb) != 16)
-                goto substream_length_mismatch;
-
-            parity   = ff_mlp_calculate_parity(buf, substream_data_len[substr] - 2);
-            checksum = ff_mlp_checksum8       (buf, substream_data_len[substr] - 2);
-
-            if ((get_bits(&gb, 8) ^ parity) != 0xa9    )
-                av_log(m->avctx, AV_LOG_ERROR, "Substream %d parity check failed.\n", substr);
-            if ( get_bits(&gb, 8)           != checksum)
-                av_log(m->avctx, AV_LOG_ERROR, "Substream %d checksum failed.\n"    , substr);
+        if (restart) {
+            for (substr = 0; substr <= m->max_decoded_substream; substr++)
+                memcpy(&m->substream[substr], &m->substream_saved[substr],
+                       offsetof(SubStream, bypassed_lsbs));
+            m->substreams_threaded = 0;
         }
-
-        if (substream_data_len[substr] * 8 != get_bits_count(&gb))
-            goto substream_length_mismatch;
-
-next_substr:
-        if (!s->restart_seen)
-            av_log(m->avctx, AV_LOG_ERROR,
-                   "No restart header present in substream %d.\n", substr);
-
-        buf += substream_data_len[substr];
+    }
+    if (!m->substreams_threaded) {
+        for (substr = 0; substr <= m->max_decoded_substream; substr++)
+            if ((ret = read_substream(m, substr)) < 0)
+                return ret;
     }
 
     if ((ret = output_data(m, m->max_decoded_substream, data, got_frame_ptr)) < 0)
@@ -1319,15 +1422,14 @@ next_substr:
 
     return length;
 
-substream_length_mismatch:
-    av_log(m->avctx, AV_LOG_ERROR, "substream %d length mismatch\n", substr);
-    return AVERROR_INVALIDDATA;
-
 error:
     m->params_valid = 0;
     return AVERROR_INVALIDDATA;
 }
 
+/* The substreams can be read through execute2(), but AV_CODEC_CAP_SLICE_THREADS
+ * is only to be set once this is checked against multi-substream samples. */
+
 #if CONFIG_MLP_DECODER
 AVCodec ff_mlp_decoder = {
     .name           = "mlp",
@@ -347,8 +347,10 @@ typedef struct VC1Context{
     int fieldtx_is_raw;
     uint8_t zzi_8x8[64];
     uint8_t *blk_mv_type_base, *blk_mv_type;    ///< 0: frame MV, 1: field MV (interlaced frame)
-    uint8_t *mv_f_base, *mv_f[2];               ///< 0: MV obtained from same field, 1: opposite field
-    uint8_t *mv_f_next_base, *mv_f_next[2];
+    AVBufferRef *mv_f_buf;                      ///< mv_f of the current picture, shared with the next frame thread
+    AVBufferRef *mv_f_next_buf;                 ///< mv_f of the next anchor picture, read by B-field pictures
+    uint8_t *mv_f[2];                           ///< 0: MV obtained from same field, 1: opposite field
+    uint8_t *mv_f_next[2];
     int field_mode;         ///< 1 for interlaced field pictures
     int fptype;
     int second_field;
@@ -394,6 +396,9 @@ typedef struct VC1Context{
 
     int parse_only;              ///< Context is used within parser
     int resync_marker;           ///< could this stream contain resync markers
+
+    struct VC1Context *slice_ctx; ///< per-thread copies decoding slices in parallel
+    int nb_slice_ctx;
 } VC1Context;
 
 /**
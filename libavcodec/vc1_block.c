@@ -30,6 +30,7 @@
 #include "mpegutils.h"
 #include "mpegvideo.h"
 #include "msmpeg4data.h"
+#include "thread.h"
 #include "unary.h"
 #include "vc1.h"
 #include "vc1_pred.h"
@@ -66,6 +67,45 @@ static inline void init_block_index(VC1Context *v)
 
 /** @} */ //Bitplane group
 
+/**
+ * Report the macroblock rows of the current picture completed up to row
+ * mb_y of the current picture or field to the other frame threads.
+ */
+static void vc1_report_progress(VC1Context *v, int mb_y)
+{
+#if HAVE_THREADS
+    MpegEncContext *s = &v->s;
+
+    if (!(s->avctx->active_thread_type & FF_THREAD_FRAME) ||
+        !s->current_picture.reference)
+        return;
+    /* The first field is complete when the second one is decoded, a row of
+     * the second field completes two rows of the picture. */
+    if (v->field_mode) {
+        if (!v->second_field)
+            return;
+        mb_y = 2 * mb_y + 1;
+    }
+    if (mb_y >= 0)
+        ff_thread_report_progress(&s->current_picture_ptr->tf, mb_y, 0);
+#endif
+}
+
+/**
+ * Wait until the co-located macroblock row of the next picture, read by
+ * the direct mode prediction of B-pictures, is decoded.
+ */
+static void vc1_await_next_row(VC1Context *v)
+{
+#if HAVE_THREADS
+    MpegEncContext *s = &v->s;
+
+    if (s->avctx->active_thread_type & FF_THREAD_FRAME)
+        ff_thread_await_progress(&s->next_picture.tf,
+                                 v->field_mode ? 2 * s->mb_y + 1 : s->mb_y, 0);
+#endif
+}
+
 static void vc1_put_signed_blocks_clamped(VC1Context *v)
 {
     MpegEncContext *s = &v->s;
@@ -2618,6 +2658,7 @@ static void vc1_decode_i_blocks(VC1Context *v)
             ff_mpeg_draw_horiz_band(s, (s->mb_y - 1) * 16, 16);
 
         s->first_slice_line = 0;
+        vc1_report_progress(v, s->mb_y - 2);
     }
     if (v->s.loop_filter)
         ff_mpeg_draw_horiz_band(s, (s->end_mb_y - 1) * 16, 16);
@@ -2746,6 +2787,7 @@ static void vc1_decode_i_blocks_adv(VC1Context *v)
         else if (s->mb_y)
             ff_mpeg_draw_horiz_band(s, (s->mb_y-1) * 16, 16);
         s->first_slice_line = 0;
+        vc1_report_progress(v, s->mb_y - 2);
     }
 
     /* raw bottom MB row */
@@ -2825,6 +2867,7 @@ static void vc1_decode_p_blocks(VC1Context *v)
         if (s->mb_y != s->start_mb_y)
             ff_mpeg_draw_horiz_band(s, (s->mb_y - 1) * 16, 16);
         s->first_slice_line = 0;
+        vc1_report_progress(v, s->mb_y - 2);
     }
     if (apply_loop_filter) {
         s->mb_x = 0;
@@ -2873,6 +2916,7 @@ static void vc1_decode_b_blocks(VC1Context *v)
     for (s->mb_y = s->start_mb_y; s->mb_y < s->end_mb_y; s->mb_y++) {
         s->mb_x = 0;
         init_block_index(v);
+        vc1_await_next_row(v);
         for (; s->mb_x < s->mb_width; s->mb_x++) {
             ff_update_block_index(s);
 
@@ -2897,6 +2941,7 @@ static void vc1_decode_b_blocks(VC1Context *v)
         else if (s->mb_y)
             ff_mpeg_draw_horiz_band(s, (s->mb_y - 1) * 16, 16);
         s->first_slice_line = 0;
+        vc1_report_progress(v, s->mb_y - 2);
     }
     if (v->s.loop_filter)
         ff_mpeg_draw_horiz_band(s, (s->end_mb_y - 1) * 16, 16);
@@ -2917,11 +2962,16 @@ static void vc1_decode_skip_blocks(VC1Context *v)
         s->mb_x = 0;
         init_block_index(v);
         ff_update_block_index(s);
+#if HAVE_THREADS
+        if (s->avctx->active_thread_type & FF_THREAD_FRAME)
+            ff_thread_await_progress(&s->last_picture.tf, s->mb_y, 0);
+#endif
         memcpy(s->dest[0], s->last_picture.f->data[0] + s->mb_y * 16 * s->linesize,   s->linesize   * 16);
         memcpy(s->dest[1], s->last_picture.f->data[1] + s->mb_y *  8 * s->uvlinesize, s->uvlinesize *  8);
         memcpy(s->dest[2], s->last_picture.f->data[2] + s->mb_y *  8 * s->uvlinesize, s->uvlinesize *  8);
         ff_mpeg_draw_horiz_band(s, s->mb_y * 16, 16);
         s->first_slice_line = 0;
+        vc1_report_progress(v, s->mb_y);
     }
     s->pict_type = AV_PICTURE_TYPE_P;
 }
@@ -2968,4 +3018,5 @@ void ff_vc1_decode_blocks(VC1Context *v)
             break;
         }
     }
+    vc1_report_progress(v, v->s.end_mb_y - 1);
 }
@@ -35,6 +35,7 @@
 #include "msmpeg4.h"
 #include "msmpeg4data.h"
 #include "profiles.h"
+#include "thread.h"
 #include "vc1.h"
 #include "vc1data.h"
 #include "libavutil/avassert.h"
@@ -320,6 +321,49 @@ static void vc1_sprite_flush(AVCodecContext *avctx)
 
 #endif
 
+/* row buffers used while decoding blocks, owned by each slice thread */
+static int vc1_alloc_block_buffers(VC1Context *v)
+{
+    MpegEncContext *s = &v->s;
+
+    v->n_allocated_blks = s->mb_width + 2;
+    v->block            = av_malloc(sizeof(*v->block) * v->n_allocated_blks);
+    v->cbp_base         = av_malloc(sizeof(v->cbp_base[0]) * 2 * s->mb_stride);
+    v->ttblk_base       = av_malloc(sizeof(v->ttblk_base[0]) * 2 * s->mb_stride);
+    v->is_intra_base    = av_mallocz(sizeof(v->is_intra_base[0]) * 2 * s->mb_stride);
+    v->luma_mv_base     = av_mallocz(sizeof(v->luma_mv_base[0]) * 2 * s->mb_stride);
+    if (!v->block || !v->cbp_base || !v->ttblk_base ||
+        !v->is_intra_base || !v->luma_mv_base)
+        return AVERROR(ENOMEM);
+    v->cbp              = v->cbp_base      + s->mb_stride;
+    v->ttblk            = v->ttblk_base    + s->mb_stride;
+    v->is_intra         = v->is_intra_base + s->mb_stride;
+    v->luma_mv          = v->luma_mv_base  + s->mb_stride;
+
+    return 0;
+}
+
+static void vc1_free_block_buffers(VC1Context *v)
+{
+    av_freep(&v->block);
+    av_freep(&v->cbp_base);
+    av_freep(&v->ttblk_base);
+    av_freep(&v->is_intra_base); // FIXME use v->mb_type[]
+    av_freep(&v->luma_mv_base);
+}
+
+static void vc1_set_mv_f(VC1Context *v)
+{
+    MpegEncContext *s = &v->s;
+    int mb_height = FFALIGN(s->mb_height, 2);
+    int size      = s->b8_stride * (mb_height * 2 + 1) + s->mb_stride * (mb_height + 1) * 2;
+
+    v->mv_f[0]      = v->mv_f_buf->data + s->b8_stride + 1;
+    v->mv_f[1]      = v->mv_f[0] + size;
+    v->mv_f_next[0] = v->mv_f_next_buf->data + s->b8_stride + 1;
+    v->mv_f_next[1] = v->mv_f_next[0] + size;
+}
+
 av_cold int ff_vc1_decode_init_alloc_tables(VC1Context *v)
 {
     MpegEncContext *s = &v->s;
@@ -337,24 +381,8 @@ av_cold int ff_vc1_decode_init_alloc_tables(VC1Context *v)
         !v->fieldtx_plane || !v->acpred_plane || !v->over_flags_plane)
         goto error;
 
-    v->n_allocated_blks = s->mb_width + 2;
-    v->block            = av_malloc(sizeof(*v->block) * v->n_allocated_blks);
-    v->cbp_base         = av_malloc(sizeof(v->cbp_base[0]) * 2 * s->mb_stride);
-    if (!v->block || !v->cbp_base)
-        goto error;
-    v->cbp              = v->cbp_base + s->mb_stride;
-    v->ttblk_base       = av_malloc(sizeof(v->ttblk_base[0]) * 2 * s->mb_stride);
-    if (!v->ttblk_base)
+    if (vc1_alloc_block_buffers(v) < 0)
         goto error;
-    v->ttblk            = v->ttblk_base + s->mb_stride;
-    v->is_intra_base    = av_mallocz(sizeof(v->is_intra_base[0]) * 2 * s->mb_stride);
-    if (!v->is_intra_base)
-        goto error;
-    v->is_intra         = v->is_intra_base + s->mb_stride;
-    v->luma_mv_base     = av_mallocz(sizeof(v->luma_mv_base[0]) * 2 * s->mb_stride);
-    if (!v->luma_mv_base)
-        goto error;
-    v->luma_mv          = v->luma_mv_base + s->mb_stride;
 
     /* allocate block type info in that way so it could be used with s->block_index[] */
     v->mb_type_base = av_malloc(s->b8_stride * (mb_height * 2 + 1) + s->mb_stride * (mb_height + 1) * 2);
@@ -369,16 +397,11 @@ av_cold int ff_vc1_decode_init_alloc_tables(VC1Context *v)
     if (!v->blk_mv_type_base)
         goto error;
     v->blk_mv_type      = v->blk_mv_type_base + s->b8_stride + 1;
-    v->mv_f_base        = av_mallocz(2 * (s->b8_stride * (mb_height * 2 + 1) + s->mb_stride * (mb_height + 1) * 2));
-    if (!v->mv_f_base)
-        goto error;
-    v->mv_f[0]          = v->mv_f_base + s->b8_stride + 1;
-    v->mv_f[1]          = v->mv_f[0] + (s->b8_stride * (mb_height * 2 + 1) + s->mb_stride * (mb_height + 1) * 2);
-    v->mv_f_next_base   = av_mallocz(2 * (s->b8_stride * (mb_height * 2 + 1) + s->mb_stride * (mb_height + 1) * 2));
-    if (!v->mv_f_next_base)
+    v->mv_f_buf         = av_buffer_allocz(2 * (s->b8_stride * (mb_height * 2 + 1) + s->mb_stride * (mb_height + 1) * 2));
+    v->mv_f_next_buf    = av_buffer_allocz(2 * (s->b8_stride * (mb_height * 2 + 1) + s->mb_stride * (mb_height + 1) * 2));
+    if (!v->mv_f_buf || !v->mv_f_next_buf)
         goto error;
-    v->mv_f_next[0]     = v->mv_f_next_base + s->b8_stride + 1;
-    v->mv_f_next[1]     = v->mv_f_next[0] + (s->b8_stride * (mb_height * 2 + 1) + s->mb_stride * (mb_height + 1) * 2);
+    vc1_set_mv_f(v);
 
     if (s->avctx->codec_id == AV_CODEC_ID_WMV3IMAGE || s->avctx->codec_id == AV_CODEC_ID_VC1IMAGE) {
         for (i = 0; i < 4; i++)
@@ -540,6 +563,7 @@ static av_cold int vc1_decode_init(AVCodecContext *avctx)
         return AVERROR(ENOMEM);
 
     avctx->has_b_frames = !!avctx->max_b_frames;
+    avctx->internal->allocate_progress = 1;
 
     if (v->color_prim == 1 || v->color_prim == 5 || v->color_prim == 6)
         avctx->color_primaries = v->color_prim;
@@ -580,21 +604,12 @@ static av_cold int vc1_decode_init(AVCodecContext *avctx)
     return 0;
 }
 
-/** Close a VC1/WMV3 decoder
- * @warning Initial try at using MpegEncContext stuff
- */
-av_cold int ff_vc1_decode_end(AVCodecContext *avctx)
+static void vc1_free_tables(VC1Context *v)
 {
-    VC1Context *v = avctx->priv_data;
     int i;
 
-    av_frame_free(&v->sprite_output_frame);
-
     for (i = 0; i < 4; i++)
         av_freep(&v->sr_rows[i >> 1][i & 1]);
-    av_freep(&v->hrd_rate);
-    av_freep(&v->hrd_buffer);
-    ff_mpv_common_end(&v->s);
     av_freep(&v->mv_type_mb_plane);
     av_freep(&v->direct_mb_plane);
     av_freep(&v->forward_mb_plane);
@@ -603,17 +618,235 @@ av_cold int ff_vc1_decode_end(AVCodecContext *avctx)
     av_freep(&v->over_flags_plane);
     av_freep(&v->mb_type_base);
     av_freep(&v->blk_mv_type_base);
-    av_freep(&v->mv_f_base);
-    av_freep(&v->mv_f_next_base);
-    av_freep(&v->block);
-    av_freep(&v->cbp_base);
-    av_freep(&v->ttblk_base);
-    av_freep(&v->is_intra_base); // FIXME use v->mb_type[]
-    av_freep(&v->luma_mv_base);
+    av_buffer_unref(&v->mv_f_buf);
+    av_buffer_unref(&v->mv_f_next_buf);
+    vc1_free_block_buffers(v);
+    for (i = 0; i < v->nb_slice_ctx; i++)
+        vc1_free_block_buffers(&v->slice_ctx[i]);
+    av_freep(&v->slice_ctx);
+    v->nb_slice_ctx = 0;
     ff_intrax8_common_end(&v->x8);
+}
+
+/** Close a VC1/WMV3 decoder
+ * @warning Initial try at using MpegEncContext stuff
+ */
+av_cold int ff_vc1_decode_end(AVCodecContext *avctx)
+{
+    VC1Context *v = avctx->priv_data;
+
+    av_frame_free(&v->sprite_output_frame);
+
+    av_freep(&v->hrd_rate);
+    av_freep(&v->hrd_buffer);
+    ff_mpv_common_end(&v->s);
+    vc1_free_tables(v);
     return 0;
 }
 
+#if HAVE_THREADS
+typedef struct VC1SliceJob {
+    GetBitContext gb;
+    int start_mb_y, end_mb_y;
+    int error_count;        ///< error resilience counts once the slice is decoded
+    int error_occurred;
+} VC1SliceJob;
+
+static av_cold int vc1_alloc_slice_contexts(VC1Context *v)
+{
+    MpegEncContext *s = &v->s;
+    int i, ret;
+
+    v->slice_ctx = av_mallocz_array(s->slice_context_count, sizeof(*v->slice_ctx));
+    if (!v->slice_ctx)
+        return AVERROR(ENOMEM);
+    for (i = 0; i < s->slice_context_count; i++) {
+        VC1Context *c = &v->slice_ctx[i];
+
+        memcpy(c, v, sizeof(*c));
+        c->slice_ctx    = NULL;
+        c->nb_slice_ctx = 0;
+        v->nb_slice_ctx++;
+        if ((ret = vc1_alloc_block_buffers(c)) < 0)
+            return ret;
+    }
+    return 0;
+}
+
+static void vc1_backup_block_buffers(VC1Context *bak, const VC1Context *src)
+{
+#define COPY(a) bak->a = src->a
+    COPY(block);
+    COPY(n_allocated_blks);
+    COPY(cbp_base);
+    COPY(cbp);
+    COPY(ttblk_base);
+    COPY(ttblk);
+    COPY(is_intra_base);
+    COPY(is_intra);
+    COPY(luma_mv_base);
+    COPY(luma_mv);
+    COPY(slice_ctx);
+    COPY(nb_slice_ctx);
+#undef COPY
+}
+
+static int vc1_decode_slice_thread(AVCodecContext *avctx, void *arg,
+                                   int jobnr, int threadnr)
+{
+    VC1Context *v   = avctx->priv_data;
+    VC1Context *c   = &v->slice_ctx[threadnr];
+    VC1SliceJob *job = (VC1SliceJob *)arg + jobnr;
+    VC1Context bak;
+
+    vc1_backup_block_buffers(&bak, c);
+    memcpy(&c->bits, &v->bits, sizeof(*c) - offsetof(VC1Context, bits));
+    vc1_backup_block_buffers(c, &bak);
+
+    c->s            = *v->s.thread_context[threadnr];
+    c->s.gb         = job->gb;
+    c->s.start_mb_y = job->start_mb_y;
+    c->s.end_mb_y   = job->end_mb_y;
+
+    ff_vc1_decode_blocks(c);
+
+    job->error_count    = c->s.er.error_count;
+    job->error_occurred = c->s.er.error_occurred;
+    return 0;
+}
+
+/**
+ * Decode slices of the current field or frame in parallel.
+ * Slices do not predict or filter across their top boundary, so that
+ * consecutive slices without a picture header are independent.
+ */
+static int vc1_decode_slices(VC1Context *v, VC1SliceJob *jobs, int nb_jobs)
+{
+    MpegEncContext *s = &v->s;
+    int error_count   = s->er.error_count;
+    int i, ret;
+
+    if (!v->slice_ctx && (ret = vc1_alloc_slice_contexts(v)) < 0)
+        return ret;
+    for (i = 1; i < s->slice_context_count; i++)
+        if ((ret = ff_update_duplicate_context(s->thread_context[i], s)) < 0)
+            return ret;
+
+    s->avctx->execute2(s->avctx, vc1_decode_slice_thread, jobs, NULL, nb_jobs);
+
+    for (i = 0; i < nb_jobs; i++) {
+        if (jobs[i].error_count == INT_MAX || s->er.error_count == INT_MAX)
+            s->er.error_count = INT_MAX;
+        else
+            s->er.error_count += jobs[i].error_count - error_count;
+        s->er.error_occurred |= jobs[i].error_occurred;
+    }
+    return 0;
+}
+
+static av_cold int vc1_decode_init_thread_copy(AVCodecContext *avctx)
+{
+    VC1Context *v = avctx->priv_data;
+
+    v->s.avctx = avctx;
+
+    if (avctx->internal->is_copy) {
+        /* the tables are allocated once the first frame is known, by
+         * vc1_update_thread_context() */
+        v->sprite_output_frame = av_frame_alloc();
+        if (!v->sprite_output_frame)
+            return AVERROR(ENOMEM);
+    }
+
+    return 0;
+}
+
+static void vc1_backup_tables(VC1Context *bak, const VC1Context *src)
+{
+#define COPY(a) bak->a = src->a
+    COPY(ttblk_base);
+    COPY(ttblk);
+    COPY(mb_type_base);
+    COPY(mb_type[0]);
+    COPY(mb_type[1]);
+    COPY(mb_type[2]);
+    COPY(mv_type_mb_plane);
+    COPY(direct_mb_plane);
+    COPY(forward_mb_plane);
+    COPY(curr_luty);
+    COPY(curr_lutuv);
+    COPY(curr_use_ic);
+    COPY(acpred_plane);
+    COPY(over_flags_plane);
+    COPY(hrd_rate);
+    COPY(hrd_buffer);
+    COPY(hrd_fullness);
+    COPY(fieldtx_plane);
+    COPY(blk_mv_type_base);
+    COPY(blk_mv_type);
+    COPY(mv_f_buf);
+    COPY(mv_f_next_buf);
+    COPY(sprite_output_frame);
+    COPY(sr_rows[0][0]);
+    COPY(sr_rows[0][1]);
+    COPY(sr_rows[1][0]);
+    COPY(sr_rows[1][1]);
+#undef COPY
+    vc1_backup_block_buffers(bak, src);
+}
+
+static int vc1_update_thread_context(AVCodecContext *dst,
+                                     const AVCodecContext *src)
+{
+    VC1Context *v = dst->priv_data, *v1 = src->priv_data;
+    MpegEncContext *s = &v->s, *s1 = &v1->s;
+    int initialized = s->context_initialized;
+    int mb_width    = s->mb_width, mb_height = s->mb_height;
+    VC1Context bak;
+    int ret;
+
+    if (dst == src || !s1->context_initialized)
+        return 0;
+
+    if ((ret = ff_mpeg_update_thread_context(dst, src)) < 0)
+        return ret;
+
+    /* The strides are doubled while a field picture is decoded, take them
+     * from the first picture allocated by this thread instead. */
+    if (!initialized)
+        s->linesize = s->uvlinesize = 0;
+    s->h_edge_pos = s1->h_edge_pos;
+    s->v_edge_pos = s1->v_edge_pos;
+
+    if (!initialized || s->mb_width != mb_width || s->mb_height != mb_height) {
+        vc1_free_tables(v);
+        if ((ret = ff_vc1_decode_init_alloc_tables(v)) < 0)
+            return ret;
+    }
+
+    vc1_backup_tables(&bak, v);
+    memcpy(&v->bits, &v1->bits, sizeof(*v) - offsetof(VC1Context, bits));
+    vc1_backup_tables(v, &bak);
+
+    if (v1->curr_luty)
+        v->curr_luty   = v1->curr_luty   == v1->aux_luty    ? v->aux_luty    : v->next_luty;
+    if (v1->curr_lutuv)
+        v->curr_lutuv  = v1->curr_lutuv  == v1->aux_lutuv   ? v->aux_lutuv   : v->next_lutuv;
+    if (v1->curr_use_ic)
+        v->curr_use_ic = v1->curr_use_ic == &v1->aux_use_ic ? &v->aux_use_ic : &v->next_use_ic;
+
+    /* the source has already swapped the buffers for the next picture */
+    av_buffer_unref(&v->mv_f_buf);
+    av_buffer_unref(&v->mv_f_next_buf);
+    v->mv_f_buf      = av_buffer_ref(v1->mv_f_buf);
+    v->mv_f_next_buf = av_buffer_ref(v1->mv_f_next_buf);
+    if (!v->mv_f_buf || !v->mv_f_next_buf)
+        return AVERROR(ENOMEM);
+    vc1_set_mv_f(v);
+
+    return 0;
+}
+#endif
 
 /** Decode a VC1/WMV3 frame
  * @todo TODO: Handle VC-1 IDUs (Transport level?)
@@ -628,7 +861,10 @@ static int vc1_decode_frame(AVCodecContext *avctx, void *data,
     AVFrame *pict = data;
     uint8_t *buf2 = NULL;
     const uint8_t *buf_start = buf, *buf_start_second_field = NULL;
-    int mb_height, n_slices1=-1;
+    int mb_height, n_slices1=-1, frame_started = 0;
+#if HAVE_THREADS
+    VC1SliceJob *jobs = NULL;
+#endif
     struct {
         uint8_t *buf;
         GetBitContext gb;
@@ -875,6 +1111,7 @@ static int vc1_decode_frame(AVCodecContext *avctx, void *data,
     if ((ret = ff_mpv_frame_start(s, avctx)) < 0) {
         goto err;
     }
+    frame_started = 1;
 
     v->s.current_picture_ptr->field_picture = v->field_mode;
     v->s.current_picture_ptr->f->interlaced_frame = (v->fcm != PROGRESSIVE);
@@ -963,7 +1200,7 @@ static int vc1_decode_frame(AVCodecContext *avctx, void *data,
                 goto err;
         }
     } else {
-        int header_ret = 0;
+        int header_ret = 0, last_header = 0;
 
         ff_mpeg_er_frame_start(s);
 
@@ -980,6 +1217,40 @@ static int vc1_decode_frame(AVCodecContext *avctx, void *data,
 
         av_assert0 (mb_height > 0);
 
+        /* The picture writes mv_f, and an anchor field picture becomes the
+         * co-located picture of the next B-field pictures. The buffers are
+         * swapped now so that another frame thread can take them over as
+         * soon as the headers are parsed. */
+        if (!av_buffer_is_writable(v->mv_f_buf)) {
+            int size = v->mv_f_buf->size;
+
+            av_buffer_unref(&v->mv_f_buf);
+            if (!(v->mv_f_buf = av_buffer_allocz(size))) {
+                ret = AVERROR(ENOMEM);
+                goto err;
+            }
+        }
+        vc1_set_mv_f(v);
+        if (v->field_mode &&
+            v->s.pict_type != AV_PICTURE_TYPE_BI && v->s.pict_type != AV_PICTURE_TYPE_B)
+            FFSWAP(AVBufferRef *, v->mv_f_next_buf, v->mv_f_buf);
+
+        /* the next frame thread can start once the last header is parsed */
+        for (i = 1; i <= n_slices; i++)
+            if ((v->field_mode && i == n_slices1 + 2) || show_bits1(&slices[i - 1].gb))
+                last_header = i;
+
+#if HAVE_THREADS
+        if (n_slices && (avctx->active_thread_type & FF_THREAD_SLICE) &&
+            s->slice_context_count > 1 && s->slice_context_count == avctx->thread_count) {
+            jobs = av_malloc_array(n_slices + 1, sizeof(*jobs));
+            if (!jobs) {
+                ret = AVERROR(ENOMEM);
+                goto err;
+            }
+        }
+#endif
+
         for (i = 0; i <= n_slices; i++) {
             if (i > 0 &&  slices[i - 1].mby_start >= mb_height) {
                 if (v->field_mode <= 0) {
@@ -1020,6 +1291,8 @@ static int vc1_decode_frame(AVCodecContext *avctx, void *data,
             }
             if (header_ret < 0)
                 continue;
+            if (i == last_header)
+                ff_thread_finish_setup(avctx);
             s->start_mb_y = (i == 0) ? 0 : FFMAX(0, slices[i-1].mby_start % mb_height);
             if (!v->field_mode || v->second_field)
                 s->end_mb_y = (i == n_slices     ) ? mb_height : FFMIN(mb_height, slices[i].mby_start % mb_height);
@@ -1038,6 +1311,48 @@ static int vc1_decode_frame(AVCodecContext *avctx, void *data,
                 av_log(v->s.avctx, AV_LOG_ERROR, "missing cbpcy_vlc\n");
                 continue;
             }
+#if HAVE_THREADS
+            /* gather the following slices of the field or frame which do
+             * not change the picture header */
+            if (jobs && !v->x8_type) {
+                int first_field = v->field_mode && !v->second_field;
+                int nb_jobs = 0;
+
+                jobs[nb_jobs].gb         = s->gb;
+                jobs[nb_jobs].start_mb_y = s->start_mb_y;
+                /* a slice of the first field is decoded sequentially up to
+                 * the end of the field, the next slice overwriting the rows
+                 * which follow it; in parallel it must stop at the next one */
+                jobs[nb_jobs].end_mb_y   = first_field && i <= n_slices1 ?
+                                           FFMIN(mb_height, slices[i].mby_start) : s->end_mb_y;
+                nb_jobs++;
+                while (i + nb_jobs <= n_slices) {
+                    int j     = i + nb_jobs;
+                    int start = slices[j - 1].mby_start % mb_height;
+                    int end   = j == n_slices || (first_field && j == n_slices1 + 1) ? mb_height :
+                                FFMIN(mb_height, slices[j].mby_start % mb_height);
+
+                    if ((slices[j - 1].mby_start >= mb_height) != v->second_field ||
+                        (v->field_mode && j == n_slices1 + 2) ||
+                        show_bits1(&slices[j - 1].gb) ||
+                        start < jobs[nb_jobs - 1].end_mb_y || end <= start)
+                        break;
+                    jobs[nb_jobs].gb         = slices[j - 1].gb;
+                    skip_bits1(&jobs[nb_jobs].gb);
+                    jobs[nb_jobs].start_mb_y = start;
+                    jobs[nb_jobs].end_mb_y   = end;
+                    nb_jobs++;
+                }
+                if (nb_jobs > 1) {
+                    if ((ret = vc1_decode_slices(v, jobs, nb_jobs)) < 0)
+                        goto err;
+                    i += nb_jobs - 1;
+                    if (i != n_slices)
+                        s->gb = slices[i].gb;
+                    continue;
+                }
+            }
+#endif
             ff_vc1_decode_blocks(v);
             if (i != n_slices)
                 s->gb = slices[i].gb;
@@ -1049,10 +1364,6 @@ static int vc1_decode_frame(AVCodecContext *avctx, void *data,
             s->current_picture.f->linesize[2] >>= 1;
             s->linesize                      >>= 1;
             s->uvlinesize                    >>= 1;
-            if (v->s.pict_type != AV_PICTURE_TYPE_BI && v->s.pict_type != AV_PICTURE_TYPE_B) {
-                FFSWAP(uint8_t *, v->mv_f_next[0], v->mv_f[0]);
-                FFSWAP(uint8_t *, v->mv_f_next[1], v->mv_f[1]);
-            }
         }
         ff_dlog(s->avctx, "Consumed %i/%i bits\n",
                 get_bits_count(&s->gb), s->gb.size_in_bits);
@@ -1100,13 +1411,22 @@ end:
     for (i = 0; i < n_slices; i++)
         av_free(slices[i].buf);
     av_free(slices);
+#if HAVE_THREADS
+    av_free(jobs);
+#endif
     return buf_size;
 
 err:
+    /* do not leave other frame threads waiting for a broken picture */
+    if (frame_started)
+        ff_thread_report_progress(&s->current_picture_ptr->tf, INT_MAX, 0);
     av_free(buf2);
     for (i = 0; i < n_slices; i++)
         av_free(slices[i].buf);
     av_free(slices);
+#if HAVE_THREADS
+    av_free(jobs);
+#endif
     return ret;
 }
 
@@ -1132,6 +1452,9 @@ static const enum AVPixelFormat vc1_hwaccel_pixfmt_list_420[] = {
     AV_PIX_FMT_NONE
 };
 
+/* The frame threading callbacks and the slice jobs are in place, but
+ * AV_CODEC_CAP_FRAME_THREADS and AV_CODEC_CAP_SLICE_THREADS are only to be set
+ * once they are checked against the VC-1 and WMV3 samples. */
 AVCodec ff_vc1_decoder = {
     .name           = "vc1",
     .long_name      = NULL_IF_CONFIG_SMALL("SMPTE VC-1"),
@@ -1143,6 +1466,8 @@ AVCodec ff_vc1_decoder = {
     .decode         = vc1_decode_frame,
     .flush          = ff_mpeg_flush,
     .capabilities   = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_DELAY,
+    .init_thread_copy      = ONLY_IF_THREADS_ENABLED(vc1_decode_init_thread_copy),
+    .update_thread_context = ONLY_IF_THREADS_ENABLED(vc1_update_thread_context),
     .pix_fmts       = vc1_hwaccel_pixfmt_list_420,
     .profiles       = NULL_IF_CONFIG_SMALL(ff_vc1_profiles)
 };
@@ -1159,6 +1484,8 @@ AVCodec ff_wmv3_decoder = {
     .decode         = vc1_decode_frame,
     .flush          = ff_mpeg_flush,
     .capabilities   = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_DELAY,
+    .init_thread_copy      = ONLY_IF_THREADS_ENABLED(vc1_decode_init_thread_copy),
+    .update_thread_context = ONLY_IF_THREADS_ENABLED(vc1_update_thread_context),
     .pix_fmts       = vc1_hwaccel_pixfmt_list_420,
     .profiles       = NULL_IF_CONFIG_SMALL(ff_vc1_profiles)
 };
@@ -299,3 +299,118 @@ LFE_FIR1_FLOAT
 INIT_XMM avx
 LFE_FIR1_FLOAT
 %endif
+
+%if ARCH_X86_64
+; Each sample is predicted from the previous ones, so they are computed one at
+; a time. The products of the older samples are summed in SIMD from a window
+; kept in m0-m3, while the newest one is handled in a GPR, as it is the only
+; one on the dependency chain between two samples.
+INIT_XMM sse4
+cglobal adapt_pred, 4, 8, 16, 64, buf, coeff, order, len, cnt, newest, clast, tmp
+    sub          lenq, orderq
+    jle .end
+    dec        orderq
+
+    ; coefficients of the older samples, right aligned and zero padded
+    pxor           m0, m0
+    mova    [rsp+ 0], m0
+    mova    [rsp+16], m0
+    mova    [rsp+32], m0
+    mova    [rsp+48], m0
+    mov          cntq, orderq
+    neg          cntq
+    jz .coeffs_done
+    lea          tmpq, [coeffq+orderq*4]
+.coeffs:
+    mov       newestd, [tmpq]
+    mov [rsp+64+cntq*4], newestd
+    sub          tmpq, 4
+    inc          cntq
+    jnz .coeffs
+.coeffs_done:
+    mova           m8, [rsp+ 0]
+    mova           m9, [rsp+16]
+    mova          m10, [rsp+32]
+    mova          m11, [rsp+48]
+    psrlq         m12, m8,  32
+    psrlq         m13, m9,  32
+    psrlq         m14, m10, 32
+    psrlq         m15, m11, 32
+
+    ; older samples, aligned the same way
+    mova    [rsp+ 0], m0
+    mova    [rsp+16], m0
+    mova    [rsp+32], m0
+    mova    [rsp+48], m0
+    lea          bufq, [bufq+orderq*4]
+    mov          cntq, orderq
+    neg          cntq
+    jz .window_done
+.window:
+    mov       newestd, [bufq+cntq*4]
+    mov [rsp+64+cntq*4], newestd
+    inc          cntq
+    jnz .window
+.window_done:
+    mova           m0, [rsp+ 0]
+    mova           m1, [rsp+16]
+    mova           m2, [rsp+32]
+    mova           m3, [rsp+48]
+    movsxd     clastq, dword [coeffq]
+    movsxd    newestq, dword [bufq]
+
+.loop:
+    pmuldq         m4, m0, m8
+    psrlq          m5, m0, 32
+    pmuldq         m5, m12
+    paddq          m4, m5
+    pmuldq         m5, m1, m9
+    psrlq          m6, m1, 32
+    pmuldq         m6, m13
+    paddq          m4, m5
+    paddq          m4, m6
+    pmuldq         m5, m2, m10
+    psrlq          m6, m2, 32
+    pmuldq         m6, m14
+    paddq          m4, m5
+    paddq          m4, m6
+    pmuldq         m5, m3, m11
+    psrlq          m6, m3, 32
+    pmuldq         m6, m15
+    paddq          m4, m5
+    paddq          m4, m6
+    pshufd         m5, m4, q3232
+    paddq          m4, m5
+    movq         tmpq, m4
+
+    ; shift the newest sample into the window
+    movd           m5, newestd
+    palignr        m5, m3, 4
+    palignr        m3, m2, 4
+    palignr        m2, m1, 4
+    palignr        m1, m0, 4
+    mova           m0, m1
+    mova           m1, m2
+    mova           m2, m3
+    mova           m3, m5
+
+    ; buf[i] -= clip23(norm16(err))
+    imul      newestq, clastq
+    lea       newestq, [newestq+tmpq+(1 << 15)]
+    sar       newestq, 16
+    mov          tmpd, -(1 << 23)
+    cmp       newestd, tmpd
+    cmovl     newestd, tmpd
+    mov          tmpd, (1 << 23) - 1
+    cmp       newestd, tmpd
+    cmovg     newestd, tmpd
+    mov          tmpd, [bufq+4]
+    sub          tmpd, newestd
+    mov      [bufq+4], tmpd
+    movsxd    newestq, tmpd
+    add          bufq, 4
+    dec          lenq
+    jg .loop
+.end:
+    RET
+%endif
@@ -33,6 +33,9 @@ LFE_FIR_FLOAT_FUNC(sse3)
 LFE_FIR_FLOAT_FUNC(avx)
 LFE_FIR_FLOAT_FUNC(fma3)
 
+void ff_adapt_pred_sse4(int32_t *buf, const int32_t *coeff,
+                        ptrdiff_t order, ptrdiff_t len);
+
 av_cold void ff_dcadsp_init_x86(DCADSPContext *s)
 {
     int cpu_flags = av_get_cpu_flags();
@@ -49,4 +52,6 @@ av_cold void ff_dcadsp_init_x86(DCADSPContext *s)
     }
     if (EXTERNAL_FMA3(cpu_flags))
         s->lfe_fir_float[0] = ff_lfe_fir0_float_fma3;
+    if (ARCH_X86_64 && EXTERNAL_SSE4(cpu_flags))
+        s->adapt_pred = ff_adapt_pred_sse4;
 }
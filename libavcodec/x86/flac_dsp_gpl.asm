@@ -22,6 +22,12 @@
 
 %include "libavutil/x86/x86util.asm"
 
+SECTION_RODATA 32
+
+pq_int32_max: times 4 dq  0x7fffffff
+pq_int32_min: times 4 dq -0x80000000
+pq_64:        times 2 dq  64
+
 SECTION .text
 
 INIT_XMM sse4
@@ -99,3 +105,92 @@ neg  orderq
     sub length, (3*mmsize)/4
 jg .looplen
 RET
+
+; 64-bit arithmetic right shift of the sums in %1 by xm3, then clip them to the
+; int32 range. xm6 holds 64 - shift, %2 to %4 are clobbered.
+%macro SHIFT_CLIP_SUMS 4
+    pxor    %2, %2
+    pcmpgtq %2, %1                 ; sign mask
+    psrlq   %1, xm3
+    psllq   %2, xm6
+    por     %1, %2                 ; p >>= shift
+    pcmpgtq %2, %1, [pq_int32_max] ; p > INT32_MAX
+    mova    %3, [pq_int32_min]
+    pcmpgtq %3, %1                 ; p < INT32_MIN
+    por     %4, %2, %3
+    pandn   %4, %1
+    pand    %2, [pq_int32_max]
+    pand    %3, [pq_int32_min]
+    por     %2, %3
+    por     %4, %2
+    pshufd  %1, %4, q0020          ; low dword of each sum
+%endmacro
+
+%if HAVE_AVX2_EXTERNAL
+INIT_YMM avx2
+%if ARCH_X86_64
+    cglobal flac_enc_lpc_32, 5, 7, 8, 0, res, smp, len, order, coefs
+    DECLARE_REG_TMP 5, 6
+    %define length r2d
+
+    movsxd orderq, orderd
+%else
+    cglobal flac_enc_lpc_32, 5, 6, 8, 0, res, smp, len, order, coefs
+    DECLARE_REG_TMP 2, 5
+    %define length r2mp
+%endif
+
+; As above, copy the warm-up samples without checking the order.
+%assign iter 0
+%rep 32/(mmsize/4)
+    movu  m0,         [smpq+iter]
+    movu [resq+iter],  m0
+    %assign iter iter+mmsize
+%endrep
+
+lea  resq,   [resq+orderq*4]
+lea  smpq,   [smpq+orderq*4]
+lea  coefsq, [coefsq+orderq*4]
+sub  length,  orderd
+movd xm3,     r5m
+mova xm6,    [pq_64]
+psubq xm6,    xm3
+neg  orderq
+
+%define posj t0q
+%define negj t1q
+
+.looplen:
+    pxor m0,   m0
+    pxor m4,   m4
+    mov  posj, orderq
+    xor  negj, negj
+
+    .looporder:
+        vpbroadcastd m2, [coefsq+posj*4] ; c = coefs[j]
+        ; s = smp[i-j-1], sign extended to 64 bits
+        pmovsxdq m1, [smpq+negj*4-4]
+        pmovsxdq m5, [smpq+negj*4+12]
+        pmuldq   m1,  m2
+        pmuldq   m5,  m2
+        paddq    m0,  m1             ; p += c * s
+        paddq    m4,  m5
+
+        dec    negj
+        inc    posj
+    jnz .looporder
+
+    SHIFT_CLIP_SUMS m0, m1, m2, m5
+    SHIFT_CLIP_SUMS m4, m1, m2, m5
+    punpcklqdq m0,     m4
+    vpermq     m0,     m0, q3120     ; undo the in-lane interleaving
+    movu       m1,    [smpq]
+    psubd      m1,     m0            ; smp[i] - clip(p >> shift)
+    movu      [resq],  m1
+
+    add resq,    mmsize
+    add smpq,    mmsize
+    sub length,  mmsize/4
+jg .looplen
+RET
+%endif
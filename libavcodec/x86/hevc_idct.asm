@@ -234,6 +234,56 @@ times 4 dw 78, -82
 times 4 dw 85, -88
 times 4 dw 90, -90
 
+; 16x16 transform coeffs for the avx2 version, as pairs of the rows k and k + 2
+; of the even then odd rows, for the first 8 columns
+trans_pairs16: dw  64,  89,  64,  75,  64,  50,  64,  18,  64, -18,  64, -50,  64, -75,  64, -89
+dw  83,  75,  36, -18, -36, -89, -83, -50, -83,  50, -36,  89,  36,  18,  83, -75
+dw  64,  50, -64, -89, -64,  18,  64,  75,  64, -75, -64, -18, -64,  89,  64, -50
+dw  36,  18, -83, -50,  83,  75, -36, -89, -36,  89,  83, -75, -83,  50,  36, -18
+dw  90,  87,  87,  57,  80,   9,  70, -43,  57, -80,  43, -90,  25, -70,   9, -25
+dw  80,  70,   9, -43, -70, -87, -87,   9, -25,  90,  57,  25,  90, -80,  43, -57
+dw  57,  43, -80, -90, -25,  57,  90,  25,  -9, -87, -87,  70,  43,   9,  70, -80
+dw  25,   9, -70, -25,  90,  43, -80, -57,  43,  70,   9, -80, -57,  87,  87, -90
+
+; 32x32 transform coeffs for the avx2 version, as pairs of the rows k and k + 2
+; of the even then odd rows, for the first 16 columns
+trans_pairs32: dw  64,  90,  64,  87,  64,  80,  64,  70,  64,  57,  64,  43,  64,  25,  64,   9
+dw  64,  -9,  64, -25,  64, -43,  64, -57,  64, -70,  64, -80,  64, -87,  64, -90
+dw  89,  87,  75,  57,  50,   9,  18, -43, -18, -80, -50, -90, -75, -70, -89, -25
+dw -89,  25, -75,  70, -50,  90, -18,  80,  18,  43,  50,  -9,  75, -57,  89, -87
+dw  83,  80,  36,   9, -36, -70, -83, -87, -83, -25, -36,  57,  36,  90,  83,  43
+dw  83, -43,  36, -90, -36, -57, -83,  25, -83,  87, -36,  70,  36,  -9,  83, -80
+dw  75,  70, -18, -43, -89, -87, -50,   9,  50,  90,  89,  25,  18, -80, -75, -57
+dw -75,  57,  18,  80,  89, -25,  50, -90, -50,  -9, -89,  87, -18,  43,  75, -70
+dw  64,  57, -64, -80, -64, -25,  64,  90,  64,  -9, -64, -87, -64,  43,  64,  70
+dw  64, -70, -64, -43, -64,  87,  64,   9,  64, -90, -64,  25, -64,  80,  64, -57
+dw  50,  43, -89, -90,  18,  57,  75,  25, -75, -87, -18,  70,  89,   9, -50, -80
+dw -50,  80,  89,  -9, -18, -70, -75,  87,  75, -25,  18, -57, -89,  90,  50, -43
+dw  36,  25, -83, -70,  83,  90, -36, -80, -36,  43,  83,   9, -83, -57,  36,  87
+dw  36, -87, -83,  57,  83,  -9, -36, -43, -36,  80,  83, -90, -83,  70,  36, -25
+dw  18,   9, -50, -25,  75,  43, -89, -57,  89,  70, -75, -80,  50,  87, -18, -90
+dw -18,  90,  50, -87, -75,  80,  89, -70, -89,  57,  75, -43, -50,  25,  18,  -9
+dw  90,  90,  90,  82,  88,  67,  85,  46,  82,  22,  78,  -4,  73, -31,  67, -54
+dw  61, -73,  54, -85,  46, -90,  38, -88,  31, -78,  22, -61,  13, -38,   4, -13
+dw  88,  85,  67,  46,  31, -13, -13, -67, -54, -90, -82, -73, -90, -22, -78,  38
+dw -46,  82,  -4,  88,  38,  54,  73,  -4,  90, -61,  85, -90,  61, -78,  22, -31
+dw  82,  78,  22,  -4, -54, -82, -90, -73, -61,  13,  13,  85,  78,  67,  85, -22
+dw  31, -88, -46, -61, -90,  31, -67,  90,   4,  54,  73, -38,  88, -90,  38, -46
+dw  73,  67, -31, -54, -90, -78, -22,  38,  78,  85,  67, -22, -38, -90, -90,   4
+dw -13,  90,  82,  13,  61, -88, -46, -31, -88,  82,  -4,  46,  85, -73,  54, -61
+dw  61,  54, -73, -85, -46,  -4,  82,  88,  31, -46, -88, -61, -13,  82,  90,  13
+dw  -4, -90, -90,  38,  22,  67,  85, -78, -38, -22, -78,  90,  54, -31,  67, -73
+dw  46,  38, -90, -88,  38,  73,  54,  -4, -90, -67,  31,  90,  61, -46, -88, -31
+dw  22,  85,  67, -78, -85,  13,  13,  61,  73, -90, -82,  54,   4,  22,  78, -82
+dw  31,  22, -78, -61,  90,  85, -61, -90,   4,  73,  54, -38, -88,  -4,  82,  46
+dw -38, -78, -22,  90,  73, -82, -90,  54,  67, -13, -13, -31, -46,  67,  85, -88
+dw  13,   4, -38, -13,  61,  22, -78, -31,  88,  38, -90, -46,  85,  54, -73, -61
+dw  54,  67, -31, -73,   4,  78,  22, -82, -46,  85,  67, -88, -82,  90,  90, -90
+; word order of the rows after the first pass of the avx2 version, pairing
+; the columns k and k + 2
+idct_pairs_shuf: times 2 db 0, 1, 4, 5, 8, 9, 12, 13, 2, 3, 6, 7, 10, 11, 14, 15
+idct_rev_perm: dd 7, 6, 5, 4, 3, 2, 1, 0
+
 SECTION .text
 
 ; void ff_hevc_idct_HxW_dc_{8,10}_<opt>(int16_t *coeffs)
@@ -851,3 +901,165 @@ INIT_IDCT 10, sse2
 INIT_IDCT 10, avx
 ;INIT_IDCT 12, sse2
 ;INIT_IDCT 12, avx
+
+; 2-D transform as a product with the transform matrix, split in its even and
+; odd rows only once: the rows k and k + 2 of the coefficients are interleaved
+; so that pmaddwd sums both products, and the outputs i and N - 1 - i are the
+; sum and the difference of the even and odd parts.
+;
+; The first pass works on 16 columns at once, with the coefficients of an
+; output row broadcast. It stores its output with the columns k and k + 2 next
+; to each other, so that the second pass broadcasts them from each row onto 8
+; outputs at once.
+;
+; void ff_hevc_idct_NxN_{8,10}_avx2(int16_t *coeffs, int col_limit)
+; %1 = transform size
+; %2 = bitdepth
+%macro IDCT_AVX2 2
+cglobal hevc_idct_%1x%1_%2, 1, 6, 9, %1*32, coeffs, tab, dst, dst2, cnt, grp
+    lea               tabq, [trans_pairs%1]
+    vpbroadcastd        m7, [pd_64]
+    movu                m8, [idct_pairs_shuf]
+    mov               grpd, %1/16
+.cols:
+%assign %%p 0
+%rep %1/4
+    mova                m0, [coeffsq + (4 * %%p    ) * %1 * 2]
+    mova                m1, [coeffsq + (4 * %%p + 2) * %1 * 2]
+    punpcklwd           m2, m0, m1
+    punpckhwd           m0, m1
+    mova  [rsp + %%p * 64     ], m2
+    mova  [rsp + %%p * 64 + 32], m0
+    mova                m0, [coeffsq + (4 * %%p + 1) * %1 * 2]
+    mova                m1, [coeffsq + (4 * %%p + 3) * %1 * 2]
+    punpcklwd           m2, m0, m1
+    punpckhwd           m0, m1
+    mova  [rsp + (%1/4 + %%p) * 64     ], m2
+    mova  [rsp + (%1/4 + %%p) * 64 + 32], m0
+%assign %%p %%p+1
+%endrep
+
+    mov               dstq, coeffsq
+    lea              dst2q, [coeffsq + (%1 - 1) * %1 * 2]
+    mov               cntd, %1/2
+.cols_loop:
+    vpbroadcastd        m4, [tabq]
+    vpbroadcastd        m5, [tabq + %1/4 * %1 * 2]
+    pmaddwd             m0, m4, [rsp]
+    pmaddwd             m1, m4, [rsp + 32]
+    pmaddwd             m2, m5, [rsp + %1/4 * 64]
+    pmaddwd             m3, m5, [rsp + %1/4 * 64 + 32]
+%assign %%p 1
+%rep %1/4-1
+    vpbroadcastd        m4, [tabq + %%p * %1 * 2]
+    vpbroadcastd        m5, [tabq + (%1/4 + %%p) * %1 * 2]
+    pmaddwd             m6, m4, [rsp + %%p * 64]
+    paddd               m0, m6
+    pmaddwd             m6, m4, [rsp + %%p * 64 + 32]
+    paddd               m1, m6
+    pmaddwd             m6, m5, [rsp + (%1/4 + %%p) * 64]
+    paddd               m2, m6
+    pmaddwd             m6, m5, [rsp + (%1/4 + %%p) * 64 + 32]
+    paddd               m3, m6
+%assign %%p %%p+1
+%endrep
+    paddd               m0, m7
+    paddd               m1, m7
+    paddd               m4, m0, m2
+    paddd               m5, m1, m3
+    psubd               m0, m2
+    psubd               m1, m3
+    psrad               m4, 7
+    psrad               m5, 7
+    psrad               m0, 7
+    psrad               m1, 7
+    packssdw            m4, m5
+    packssdw            m0, m1
+    pshufb              m4, m8
+    pshufb              m0, m8
+    vpermq              m4, m4, q3120
+    vpermq              m0, m0, q3120
+    mova            [dstq], m4
+    mova           [dst2q], m0
+    add               tabq, 4
+    add               dstq, %1 * 2
+    sub              dst2q, %1 * 2
+    dec               cntd
+    jg .cols_loop
+
+    sub               tabq, %1 * 2
+    add            coeffsq, 32
+    dec               grpd
+    jg .cols
+
+    sub            coeffsq, %1 * 2
+%if %2 == 8
+    vpbroadcastd        m7, [pd_2048]
+%else
+    vpbroadcastd        m7, [pd_512]
+%endif
+    movu                m8, [idct_rev_perm]
+    mov               cntd, %1
+.rows:
+    vpbroadcastd        m4, [coeffsq]
+    vpbroadcastd        m5, [coeffsq + 16]
+    pmaddwd             m0, m4, [tabq]
+    pmaddwd             m1, m5, [tabq + %1/4 * %1 * 2]
+%if %1 == 32
+    pmaddwd             m2, m4, [tabq + 32]
+    pmaddwd             m3, m5, [tabq + %1/4 * %1 * 2 + 32]
+%endif
+%assign %%p 1
+%rep %1/4-1
+%assign %%pos (%%p & 3) + 8 * (%%p >> 2)
+    vpbroadcastd        m4, [coeffsq + %%pos * 4]
+    vpbroadcastd        m5, [coeffsq + %%pos * 4 + 16]
+    pmaddwd             m6, m4, [tabq + %%p * %1 * 2]
+    paddd               m0, m6
+    pmaddwd             m6, m5, [tabq + (%1/4 + %%p) * %1 * 2]
+    paddd               m1, m6
+%if %1 == 32
+    pmaddwd             m6, m4, [tabq + %%p * %1 * 2 + 32]
+    paddd               m2, m6
+    pmaddwd             m6, m5, [tabq + (%1/4 + %%p) * %1 * 2 + 32]
+    paddd               m3, m6
+%endif
+%assign %%p %%p+1
+%endrep
+    paddd               m0, m7
+    paddd               m4, m0, m1
+    psubd               m0, m1
+    psrad               m4, 20 - %2
+    psrad               m0, 20 - %2
+    vpermd              m0, m8, m0
+%if %1 == 16
+    packssdw            m4, m0
+    vpermq              m4, m4, q3120
+    mova         [coeffsq], m4
+%else
+    paddd               m2, m7
+    paddd               m5, m2, m3
+    psubd               m2, m3
+    psrad               m5, 20 - %2
+    psrad               m2, 20 - %2
+    vpermd              m2, m8, m2
+    packssdw            m4, m5
+    packssdw            m2, m0
+    vpermq              m4, m4, q3120
+    vpermq              m2, m2, q3120
+    mova         [coeffsq], m4
+    mova    [coeffsq + 32], m2
+%endif
+    add            coeffsq, %1 * 2
+    dec               cntd
+    jg .rows
+    RET
+%endmacro
+
+%if ARCH_X86_64 && HAVE_AVX2_EXTERNAL
+INIT_YMM avx2
+IDCT_AVX2 16, 8
+IDCT_AVX2 32, 8
+IDCT_AVX2 16, 10
+IDCT_AVX2 32, 10
+%endif
@@ -0,0 +1,325 @@
+;******************************************************************************
+;* SIMD-optimized intra prediction functions for HEVC decoding
+;*
+;* This file is part of FFmpeg.
+;*
+;* FFmpeg is free software; you can redistribute it and/or
+;* modify it under the terms of the GNU Lesser General Public
+;* License as published by the Free Software Foundation; either
+;* version 2.1 of the License, or (at your option) any later version.
+;*
+;* FFmpeg is distributed in the hope that it will be useful,
+;* but WITHOUT ANY WARRANTY; without even the implied warranty of
+;* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+;* Lesser General Public License for more details.
+;*
+;* You should have received a copy of the GNU Lesser General Public
+;* License along with FFmpeg; if not, write to the Free Software
+;* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+;******************************************************************************
+
+%include "libavutil/x86/x86util.asm"
+
+SECTION_RODATA
+
+pw_planar_x: dw  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15, 16
+             dw 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32
+
+SECTION .text
+
+; All the pixels are processed as words, mmsize / 2 at a time; 8-bit pixels
+; are zero-extended when loaded and packed back when stored.
+
+; LOAD_PIXELS dst, src, bitdepth
+%macro LOAD_PIXELS 3
+%if %3 == 8
+    pmovzxbw        %1, %2
+%else
+    movu            %1, %2
+%endif
+%endmacro
+
+; STORE_PIXELS dst, src register number, bitdepth
+%macro STORE_PIXELS 3
+%if %3 == 8
+    packuswb       m%2, m%2
+%if mmsize == 32
+    vpermq         m%2, m%2, q2020
+    movu            %1, xm%2
+%else
+    movq            %1, xm%2
+%endif
+%else
+    movu            %1, m%2
+%endif
+%endmacro
+
+;------------------------------------------------------------------------------
+; planar prediction
+;
+; The value of a row is computed incrementally: with
+;   acc[x]  = (x + 1) * top[size] + size + (size - 1 - y) * top[x] + (y + 1) * left[size]
+;   pred[x] = (acc[x] + (size - 1 - x) * left[y]) >> (log2(size) + 1)
+; acc only needs left[size] - top[x] to be added from one row to the next.
+; Everything fits in unsigned words for up to 10-bit pixels.
+;------------------------------------------------------------------------------
+
+; PLANAR_INIT acc, diff, weight, x offset, bitdepth
+; m0 = top[size], m1 = left[size], m2 = size, m3 = scratch
+%macro PLANAR_INIT 5
+    movu           m%3, [pw_planar_x + 2 * %4]  ; x + 1
+    pmullw         m%1, m%3, m0
+    psubw          m%3, m2, m%3                 ; size - 1 - x
+    paddw          m%1, m2
+%if %5 == 8
+    LOAD_PIXELS    m%2, [topq + %4], %5
+%else
+    LOAD_PIXELS    m%2, [topq + 2 * %4], %5
+%endif
+    pmullw          m3, m%2, m2
+    psubw           m3, m%2                     ; (size - 1) * top[x]
+    paddw          m%1, m3
+    paddw          m%1, m1
+    psubw          m%2, m1, m%2                 ; left[size] - top[x]
+%endmacro
+
+; PLANAR_ROW acc, diff, weight, x offset, shift, bitdepth
+; m0 = left[y], m1 = scratch
+%macro PLANAR_ROW 6
+    pmullw          m1, m0, m%3
+    paddw           m1, m%1
+    psrlw           m1, %5
+    paddw          m%1, m%2
+%if %6 == 8
+    STORE_PIXELS   [srcq + %4], 1, %6
+%else
+    STORE_PIXELS   [srcq + 2 * %4], 1, %6
+%endif
+%endmacro
+
+; void ff_hevc_pred_planar_<size>_<bitdepth>_avx2(uint8_t *src, const uint8_t *top,
+;                                                 const uint8_t *left, ptrdiff_t stride)
+; %1 = size, %2 = log2 of the size, %3 = bitdepth
+%macro PRED_PLANAR 3
+cglobal hevc_pred_planar_%1_%3, 4, 6, 10, src, top, left, stride, cnt, tmp
+%if %3 == 8
+    movzx         tmpd, byte [topq + %1]
+    movd           xm0, tmpd
+    movzx         tmpd, byte [leftq + %1]
+    movd           xm1, tmpd
+%else
+    add        strideq, strideq
+    movzx         tmpd, word [topq + 2 * %1]
+    movd           xm0, tmpd
+    movzx         tmpd, word [leftq + 2 * %1]
+    movd           xm1, tmpd
+%endif
+    mov           tmpd, %1
+    movd           xm2, tmpd
+    vpbroadcastw    m0, xm0
+    vpbroadcastw    m1, xm1
+    vpbroadcastw    m2, xm2
+    PLANAR_INIT      4, 5, 6, 0, %3
+%if %1 == 32
+    PLANAR_INIT      7, 8, 9, 16, %3
+%endif
+
+    mov           cntd, %1
+.loop:
+%if %3 == 8
+    movzx         tmpd, byte [leftq]
+    movd           xm0, tmpd
+    vpbroadcastw    m0, xm0
+%else
+    vpbroadcastw    m0, [leftq]
+%endif
+    PLANAR_ROW       4, 5, 6, 0, %2 + 1, %3
+%if %1 == 32
+    PLANAR_ROW       7, 8, 9, 16, %2 + 1, %3
+%endif
+    add           srcq, strideq
+    add          leftq, (%3 + 7) / 8
+    dec           cntd
+    jg .loop
+    RET
+%endmacro
+
+;------------------------------------------------------------------------------
+; angular prediction
+;
+; The kernels only interpolate between the samples of the reference array
+; ref, which the caller builds from top or left (ref[0] is the corner sample),
+; and take the stride in bytes. A block is predicted row by row for the
+; vertical modes, and in 8x8 tiles of columns which are then transposed for
+; the horizontal ones.
+;
+;   ((32 - fact) * a + fact * b + 16) >> 5 == a + (((b - a) * fact + 16) >> 5)
+;
+; and the right hand side is a pmulhrsw by fact << 10.
+;------------------------------------------------------------------------------
+
+; ANGULAR_POS position, weight register
+; idxq = (position >> 5), m%2 = (position & 31) << 10
+%macro ANGULAR_POS 2
+    mov           idxd, %1
+    mov          factd, %1
+    sar           idxd, 5
+    and          factd, 31
+    shl          factd, 10
+    movsxd        idxq, idxd
+    movd          xm%2, factd
+    vpbroadcastw   m%2, xm%2
+%endmacro
+
+; ANGULAR_INTERP dst, tmp, weight, src, bitdepth
+; interpolate the pixels at src + 1 and src + 2
+%macro ANGULAR_INTERP 5
+%if %5 == 8
+    pmovzxbw       m%1, [%4 + 1]
+    pmovzxbw       m%2, [%4 + 2]
+%else
+    movu           m%1, [%4 + 2]
+    movu           m%2, [%4 + 4]
+%endif
+    psubw          m%2, m%1
+    pmulhrsw       m%2, m%3
+    paddw          m%1, m%2
+%endmacro
+
+; void ff_hevc_pred_angular_v_<size>_<bitdepth>_avx2(uint8_t *dst, ptrdiff_t stride,
+;                                                    const uint8_t *ref, int angle)
+; %1 = size, %2 = bitdepth
+%macro PRED_ANGULAR_V 2
+cglobal hevc_pred_angular_v_%1_%2, 4, 8, 3, dst, stride, ref, angle, pos, idx, fact, cnt
+    mov           posd, angled
+    mov           cntd, %1
+.loop:
+    ANGULAR_POS    posd, 0
+%if %2 == 8
+    add           idxq, refq
+    ANGULAR_INTERP   1, 2, 0, idxq, %2
+    STORE_PIXELS [dstq], 1, %2
+%if %1 == 32
+    ANGULAR_INTERP   1, 2, 0, idxq + 16, %2
+    STORE_PIXELS [dstq + 16], 1, %2
+%endif
+%else
+    lea           idxq, [refq + idxq * 2]
+    ANGULAR_INTERP   1, 2, 0, idxq, %2
+    STORE_PIXELS [dstq], 1, %2
+%if %1 == 32
+    ANGULAR_INTERP   1, 2, 0, idxq + 32, %2
+    STORE_PIXELS [dstq + 32], 1, %2
+%endif
+%endif
+    add           dstq, strideq
+    add           posd, angled
+    dec           cntd
+    jg .loop
+    RET
+%endmacro
+
+; ANGULAR_H_COL dst, bitdepth
+; the column at position cpos, for the rows y to y + mmsize / 2 - 1
+%macro ANGULAR_H_COL 2
+    ANGULAR_POS   cposd, 8
+    add           idxq, yq
+%if %2 == 8
+    add           idxq, refq
+%else
+    lea           idxq, [refq + idxq * 2]
+%endif
+    ANGULAR_INTERP  %1, 9, 8, idxq, %2
+    add          cposd, angled
+%endmacro
+
+; ANGULAR_H_STORE src, bitdepth
+; store a transposed row, its second half goes 8 rows below with ymm
+%macro ANGULAR_H_STORE 2
+%if %2 == 8
+    packuswb       m%1, m%1
+    movq        [rowq], xm%1
+%if mmsize == 32
+    vextracti128  xm%1, m%1, 1
+    movq       [row2q], xm%1
+%endif
+%else
+    movu        [rowq], xm%1
+%if mmsize == 32
+    vextracti128 [row2q], m%1, 1
+%endif
+%endif
+    add           rowq, strideq
+%if mmsize == 32
+    add          row2q, strideq
+%endif
+%endmacro
+
+; void ff_hevc_pred_angular_h_<size>_<bitdepth>_avx2(uint8_t *dst, ptrdiff_t stride,
+;                                                    const uint8_t *ref, int angle)
+; %1 = size, %2 = bitdepth
+%macro PRED_ANGULAR_H 2
+cglobal hevc_pred_angular_h_%1_%2, 4, 12, 10, dst, stride, ref, angle, pos, cpos, idx, fact, y, row, row2, cnt
+    mov           posd, angled
+    mov           cntd, %1 / 8
+.loop_x:
+    xor             yd, yd
+.loop_y:
+    mov          cposd, posd
+    ANGULAR_H_COL    0, %2
+    ANGULAR_H_COL    1, %2
+    ANGULAR_H_COL    2, %2
+    ANGULAR_H_COL    3, %2
+    ANGULAR_H_COL    4, %2
+    ANGULAR_H_COL    5, %2
+    ANGULAR_H_COL    6, %2
+    ANGULAR_H_COL    7, %2
+    TRANSPOSE8x8W    0, 1, 2, 3, 4, 5, 6, 7, 8
+
+    mov           rowq, yq
+    imul          rowq, strideq
+    add           rowq, dstq
+%if mmsize == 32
+    lea          row2q, [rowq + strideq * 8]
+%endif
+    ANGULAR_H_STORE  0, %2
+    ANGULAR_H_STORE  1, %2
+    ANGULAR_H_STORE  2, %2
+    ANGULAR_H_STORE  3, %2
+    ANGULAR_H_STORE  4, %2
+    ANGULAR_H_STORE  5, %2
+    ANGULAR_H_STORE  6, %2
+    ANGULAR_H_STORE  7, %2
+
+    add             yd, mmsize / 2
+    cmp             yd, %1
+    jl .loop_y
+    add           dstq, 8 * ((%2 + 7) / 8)
+    lea           posd, [posq + angleq * 8]
+    dec           cntd
+    jg .loop_x
+    RET
+%endmacro
+
+%macro PRED_ANGULAR 2
+PRED_ANGULAR_V %1, %2
+PRED_ANGULAR_H %1, %2
+%endmacro
+
+%if ARCH_X86_64 && HAVE_AVX2_EXTERNAL
+INIT_XMM avx2
+PRED_PLANAR   8, 3, 8
+PRED_PLANAR   8, 3, 10
+PRED_ANGULAR  8, 8
+PRED_ANGULAR  8, 10
+
+INIT_YMM avx2
+PRED_PLANAR  16, 4, 8
+PRED_PLANAR  16, 4, 10
+PRED_PLANAR  32, 5, 8
+PRED_PLANAR  32, 5, 10
+PRED_ANGULAR 16, 8
+PRED_ANGULAR 16, 10
+PRED_ANGULAR 32, 8
+PRED_ANGULAR 32, 10
+%endif
@@ -0,0 +1,80 @@
+/*
+ * HEVC intra prediction x86 optimizations
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <string.h>
+
+#include "config.h"
+
+#include "libavutil/attributes.h"
+#include "libavutil/cpu.h"
+#include "libavutil/x86/cpu.h"
+
+#include "libavcodec/hevcdec.h"
+#include "libavcodec/hevcpred.h"
+
+#if ARCH_X86_64 && HAVE_AVX2_EXTERNAL
+
+typedef void (*angular_kernel)(uint8_t *dst, ptrdiff_t stride,
+                               const uint8_t *ref, int angle);
+
+static const int intra_pred_angle[] = {
+     32,  26,  21,  17, 13,  9,  5, 2, 0, -2, -5, -9, -13, -17, -21, -26, -32,
+    -26, -21, -17, -13, -9, -5, -2, 0, 2,  5,  9, 13,  17,  21,  26,  32
+};
+static const int inv_angle[] = {
+    -4096, -1638, -910, -630, -482, -390, -315, -256, -315, -390, -482,
+    -630, -910, -1638, -4096
+};
+
+#define BIT_DEPTH 8
+#include "hevcpred_init_template.c"
+#undef BIT_DEPTH
+
+#define BIT_DEPTH 10
+#include "hevcpred_init_template.c"
+#undef BIT_DEPTH
+
+#endif /* ARCH_X86_64 && HAVE_AVX2_EXTERNAL */
+
+av_cold void ff_hevc_pred_init_x86(HEVCPredContext *hpc, int bit_depth)
+{
+#if ARCH_X86_64 && HAVE_AVX2_EXTERNAL
+    int cpu_flags = av_get_cpu_flags();
+
+    /* 4x4 blocks are left to the C functions */
+    if (EXTERNAL_AVX2_FAST(cpu_flags)) {
+        if (bit_depth == 8) {
+            hpc->pred_planar[1]  = ff_hevc_pred_planar_8_8_avx2;
+            hpc->pred_planar[2]  = ff_hevc_pred_planar_16_8_avx2;
+            hpc->pred_planar[3]  = ff_hevc_pred_planar_32_8_avx2;
+            hpc->pred_angular[1] = pred_angular_1_avx2_8;
+            hpc->pred_angular[2] = pred_angular_2_avx2_8;
+            hpc->pred_angular[3] = pred_angular_3_avx2_8;
+        } else if (bit_depth == 10) {
+            hpc->pred_planar[1]  = ff_hevc_pred_planar_8_10_avx2;
+            hpc->pred_planar[2]  = ff_hevc_pred_planar_16_10_avx2;
+            hpc->pred_planar[3]  = ff_hevc_pred_planar_32_10_avx2;
+            hpc->pred_angular[1] = pred_angular_1_avx2_10;
+            hpc->pred_angular[2] = pred_angular_2_avx2_10;
+            hpc->pred_angular[3] = pred_angular_3_avx2_10;
+        }
+    }
+#endif /* ARCH_X86_64 && HAVE_AVX2_EXTERNAL */
+}
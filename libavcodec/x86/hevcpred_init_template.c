@@ -0,0 +1,100 @@
+/*
+ * HEVC intra prediction x86 glue, bit depth dependent part
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavcodec/bit_depth_template.c"
+
+#define ANGULAR_KERNEL(dir, size) FUNC2(ff_hevc_pred_angular_ ## dir ## _ ## size, BIT_DEPTH, _avx2)
+
+#define DECL_ANGULAR_KERNELS(size)                                                   \
+void ANGULAR_KERNEL(v, size)(uint8_t *dst, ptrdiff_t stride, const uint8_t *ref, int angle); \
+void ANGULAR_KERNEL(h, size)(uint8_t *dst, ptrdiff_t stride, const uint8_t *ref, int angle);
+
+DECL_ANGULAR_KERNELS(8)
+DECL_ANGULAR_KERNELS(16)
+DECL_ANGULAR_KERNELS(32)
+
+void FUNC2(ff_hevc_pred_planar_8, BIT_DEPTH, _avx2)(uint8_t *src, const uint8_t *top,
+                                                   const uint8_t *left, ptrdiff_t stride);
+void FUNC2(ff_hevc_pred_planar_16, BIT_DEPTH, _avx2)(uint8_t *src, const uint8_t *top,
+                                                    const uint8_t *left, ptrdiff_t stride);
+void FUNC2(ff_hevc_pred_planar_32, BIT_DEPTH, _avx2)(uint8_t *src, const uint8_t *top,
+                                                    const uint8_t *left, ptrdiff_t stride);
+
+/**
+ * Build the reference array the way the C version does, let the asm
+ * kernel interpolate the block and apply the boundary filters.
+ */
+static av_always_inline void FUNC(pred_angular_avx2)(uint8_t *_src, const uint8_t *_top,
+                                                    const uint8_t *_left, ptrdiff_t stride,
+                                                    int c_idx, int mode, int size,
+                                                    angular_kernel pred_v,
+                                                    angular_kernel pred_h)
+{
+    pixel *src         = (pixel *)_src;
+    const pixel *top   = (const pixel *)_top;
+    const pixel *left  = (const pixel *)_left;
+    const pixel *side  = mode >= 18 ? top  : left;
+    const pixel *other = mode >= 18 ? left : top;
+    int angle = intra_pred_angle[mode - 2];
+    int last  = (size * angle) >> 5;
+    pixel ref_array[3 * MAX_TB_SIZE + 4];
+    pixel *ref = ref_array + size;
+    int i;
+
+    /* the kernels may read the sample following the last one they use */
+    memcpy(ref, side - 1, (2 * size + 1) * sizeof(pixel));
+    ref[2 * size + 1] = ref[2 * size];
+    if (angle < 0 && last < -1) {
+        for (i = last; i <= -1; i++)
+            ref[i] = other[-1 + ((i * inv_angle[mode - 11] + 128) >> 8)];
+    }
+
+    if (mode >= 18) {
+        pred_v(_src, stride * sizeof(pixel), (const uint8_t *)ref, angle);
+        if (mode == 26 && c_idx == 0 && size < 32) {
+            for (i = 0; i < size; i++)
+                src[i * stride] = av_clip_pixel(top[0] + ((left[i] - left[-1]) >> 1));
+        }
+    } else {
+        pred_h(_src, stride * sizeof(pixel), (const uint8_t *)ref, angle);
+        if (mode == 10 && c_idx == 0 && size < 32) {
+            for (i = 0; i < size; i++)
+                src[i] = av_clip_pixel(left[0] + ((top[i] - top[-1]) >> 1));
+        }
+    }
+}
+
+#define PRED_ANGULAR(idx, size)                                                 \
+static void FUNC(pred_angular_ ## idx ## _avx2)(uint8_t *src, const uint8_t *top, \
+                                               const uint8_t *left,             \
+                                               ptrdiff_t stride, int c_idx,     \
+                                               int mode)                        \
+{                                                                               \
+    FUNC(pred_angular_avx2)(src, top, left, stride, c_idx, mode, size,          \
+                            ANGULAR_KERNEL(v, size), ANGULAR_KERNEL(h, size));  \
+}
+
+PRED_ANGULAR(1,  8)
+PRED_ANGULAR(2, 16)
+PRED_ANGULAR(3, 32)
+
+#undef ANGULAR_KERNEL
+#undef DECL_ANGULAR_KERNELS
+#undef PRED_ANGULAR
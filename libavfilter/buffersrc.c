@@ -295,6 +295,17 @@ unsigned av_buffersrc_get_nb_failed_requests(AVFilterContext *buffer_src)
     return ((BufferSourceContext *)buffer_src->priv)->nb_failed_requests;
 }
 
+AVFrame *av_buffersrc_get_video_buffer(AVFilterContext *ctx, int w, int h)
+{
+    AVFilterLink *outlink;
+
+    if (ctx->nb_outputs < 1 || !(outlink = ctx->outputs[0]) ||
+        outlink->type != AVMEDIA_TYPE_VIDEO || !outlink->dst)
+        return NULL;
+
+    return ff_get_video_buffer(outlink, w, h);
+}
+
 #define OFFSET(x) offsetof(BufferSourceContext, x)
 #define A AV_OPT_FLAG_FILTERING_PARAM|AV_OPT_FLAG_AUDIO_PARAM
 #define V AV_OPT_FLAG_FILTERING_PARAM|AV_OPT_FLAG_VIDEO_PARAM
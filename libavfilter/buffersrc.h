@@ -202,6 +202,28 @@ int av_buffersrc_add_frame_flags(AVFilterContext *buffer_src,
  */
 int av_buffersrc_close(AVFilterContext *ctx, int64_t pts, unsigned flags);
 
+/**
+ * Allocate a video frame to be filled by the caller and then added to the
+ * buffer source.
+ *
+ * The buffer comes from the filters fed by the buffer source, so that a
+ * picture written into it can be processed in place if the frame is still
+ * writable when it reaches them, e.g. by a pad filter reserving its borders
+ * around the picture. The frame has the pixel format of the buffer source
+ * and linesizes aligned to at least 32 bytes. w and h may be larger than the
+ * size configured for the buffer source, e.g. to add the padding a decoder
+ * requires; the frame then has to be cropped to the configured size before
+ * being added.
+ *
+ * This function may only be called on a configured filter graph.
+ *
+ * @param ctx an instance of the buffersrc filter
+ * @param w   the width of the frame to allocate
+ * @param h   the height of the frame to allocate
+ * @return the newly allocated frame or NULL on failure
+ */
+AVFrame *av_buffersrc_get_video_buffer(AVFilterContext *ctx, int w, int h);
+
 /**
  * @}
  */
@@ -0,0 +1,57 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFILTER_OVERLAY_H
+#define AVFILTER_OVERLAY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct OverlayDSPContext {
+    /**
+     * Blend w pixels of an overlay plane with straight alpha on top of an
+     * opaque main plane. The alpha plane a has the same size as the blended
+     * plane for blend_row_444, twice its width for blend_row_422 and twice
+     * its width and height for blend_row_420, alinesize being the stride
+     * between two alpha lines.
+     *
+     * @return the number of pixels blended, at most w; the caller handles
+     *         the remaining ones
+     */
+    int (*blend_row_444)(uint8_t *d, const uint8_t *s, const uint8_t *a,
+                         ptrdiff_t alinesize, int w);
+    int (*blend_row_422)(uint8_t *d, const uint8_t *s, const uint8_t *a,
+                         ptrdiff_t alinesize, int w);
+    int (*blend_row_420)(uint8_t *d, const uint8_t *s, const uint8_t *a,
+                         ptrdiff_t alinesize, int w);
+
+    /**
+     * Blend w packed 32-bit pixels on top of main pixels which have an
+     * alpha channel, both using the same component order with alpha at
+     * byte alpha_pos.
+     *
+     * @return the number of pixels blended, at most w; the caller handles
+     *         the remaining ones
+     */
+    int (*blend_row_rgba)(uint8_t *d, const uint8_t *s, int w, int alpha_pos);
+} OverlayDSPContext;
+
+void ff_overlay_dsp_init(OverlayDSPContext *dsp);
+void ff_overlay_dsp_init_x86(OverlayDSPContext *dsp);
+
+#endif /* AVFILTER_OVERLAY_H */
@@ -0,0 +1,98 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFILTER_TONEMAP_H
+#define AVFILTER_TONEMAP_H
+
+#include "libavutil/mem.h"
+
+enum TonemapAlgorithm {
+    TONEMAP_NONE,
+    TONEMAP_LINEAR,
+    TONEMAP_GAMMA,
+    TONEMAP_CLIP,
+    TONEMAP_REINHARD,
+    TONEMAP_HABLE,
+    TONEMAP_MOBIUS,
+    TONEMAP_MAX,
+};
+
+/*
+ * Parameters of the tone mapping, in the form used by the SIMD functions:
+ * each value is replicated over 8 lanes. With x the brightest component of
+ * a pixel, the tone curve is x if x <= THRESHOLD, otherwise
+ * min(((NUM0 * x + NUM1) * x + NUM2) / ((DEN0 * x + DEN1) * x + DEN2), MAX).
+ * The weights LUMA0-2 are those of the planes 0 to 2 in the luma used for
+ * desaturation.
+ */
+enum TonemapParam {
+    TONEMAP_PARAM_LUMA0,
+    TONEMAP_PARAM_LUMA1,
+    TONEMAP_PARAM_LUMA2,
+    TONEMAP_PARAM_DESAT,
+    TONEMAP_PARAM_NUM0,
+    TONEMAP_PARAM_NUM1,
+    TONEMAP_PARAM_NUM2,
+    TONEMAP_PARAM_DEN0,
+    TONEMAP_PARAM_DEN1,
+    TONEMAP_PARAM_DEN2,
+    TONEMAP_PARAM_THRESHOLD,
+    TONEMAP_PARAM_MAX,
+    TONEMAP_PARAM_NB,
+};
+
+typedef struct TonemapParams {
+    /* must be first, the SIMD functions address it from the struct start */
+    DECLARE_ALIGNED(32, float, simd)[TONEMAP_PARAM_NB][8];
+
+    /* parameters of the C version, identical to the filter options */
+    enum TonemapAlgorithm algorithm;
+    double param;
+    double desat;
+    double peak;
+    double luma[3];
+} TonemapParams;
+
+typedef struct TonemapDSPContext {
+    /**
+     * Tone map w pixels of planar float RGB, in the plane order of the
+     * GBRPF32 format, from src to dst.
+     *
+     * The C version is the float reference. The SIMD versions evaluate the
+     * curves in single precision in the rational form described above and
+     * stay within 1e-5 of it relatively to max(1, |reference|), with
+     * desaturation enabled or not.
+     *
+     * @return the number of pixels processed, at most w; the caller handles
+     *         the remaining ones
+     */
+    int (*tonemap_row)(float *const dst[3], const float *const src[3], int w,
+                       const TonemapParams *p);
+} TonemapDSPContext;
+
+/**
+ * Set the parameters of the tone mapping. luma may be NULL if desat is 0.
+ */
+void ff_tonemap_params_init(TonemapParams *p, enum TonemapAlgorithm algorithm,
+                            double param, double desat, double peak,
+                            const double luma[3]);
+
+void ff_tonemap_dsp_init(TonemapDSPContext *dsp, enum TonemapAlgorithm algorithm);
+void ff_tonemap_dsp_init_x86(TonemapDSPContext *dsp, enum TonemapAlgorithm algorithm);
+
+#endif /* AVFILTER_TONEMAP_H */
@@ -0,0 +1,436 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * scale one input to several output sizes at once
+ *
+ * Packed and semi-planar inputs are unpacked once per frame into a cached
+ * planar picture, which all the output scalers then read. The outputs are
+ * scaled concurrently, one job per output.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/avstring.h"
+#include "libavutil/internal.h"
+#include "libavutil/opt.h"
+#include "libavutil/parseutils.h"
+#include "libavutil/pixdesc.h"
+#include "libswscale/swscale.h"
+
+#include "avfilter.h"
+#include "filters.h"
+#include "formats.h"
+#include "internal.h"
+#include "video.h"
+
+typedef struct MultiScaleContext {
+    const AVClass *class;
+
+    char *sizes_str;
+    char *flags_str;
+    int format;                         ///< enum AVPixelFormat of the outputs
+
+    int nb_outputs;
+    int *w, *h;
+    int flags;                          ///< sws flags
+
+    struct SwsContext **sws;            ///< one scaler per output
+    struct SwsContext *unpack_sws;      ///< input to unpacked conversion
+    AVFrame *unpacked;                  ///< planar copy of the current input
+} MultiScaleContext;
+
+typedef struct ThreadData {
+    AVFrame *in, **out;
+} ThreadData;
+
+/**
+ * Check whether every component of the format lies in its own plane, in
+ * native endianness, so that libswscale reads it without unpacking.
+ */
+static int is_planar(const AVPixFmtDescriptor *desc)
+{
+    int i, j;
+
+    if (!(desc->flags & AV_PIX_FMT_FLAG_PLANAR) ||
+        desc->flags & (AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_PSEUDOPAL |
+                       AV_PIX_FMT_FLAG_BITSTREAM | AV_PIX_FMT_FLAG_HWACCEL |
+                       AV_PIX_FMT_FLAG_BAYER) ||
+        (desc->comp[0].depth > 8 &&
+         !!(desc->flags & AV_PIX_FMT_FLAG_BE) != HAVE_BIGENDIAN))
+        return 0;
+
+    for (i = 0; i < desc->nb_components; i++)
+        for (j = 0; j < i; j++)
+            if (desc->comp[i].plane == desc->comp[j].plane)
+                return 0;
+    return 1;
+}
+
+/**
+ * Find the planar format into which the input is unpacked once per frame:
+ * the smallest one with the same components and chroma subsampling which
+ * holds the input without loss. Planar inputs are read directly.
+ */
+static enum AVPixelFormat unpacked_format(enum AVPixelFormat fmt)
+{
+    const AVPixFmtDescriptor *src = av_pix_fmt_desc_get(fmt), *desc = NULL;
+    enum AVPixelFormat best = AV_PIX_FMT_NONE;
+    int has_alpha = src->flags & AV_PIX_FMT_FLAG_ALPHA;
+
+    if (is_planar(src))
+        return AV_PIX_FMT_NONE;
+
+    while ((desc = av_pix_fmt_desc_next(desc))) {
+        enum AVPixelFormat pix_fmt = av_pix_fmt_desc_get_id(desc);
+
+        if (!is_planar(desc) ||
+            desc->nb_components != src->nb_components ||
+            (desc->flags & AV_PIX_FMT_FLAG_RGB) != (src->flags & AV_PIX_FMT_FLAG_RGB) ||
+            desc->log2_chroma_w != src->log2_chroma_w ||
+            desc->log2_chroma_h != src->log2_chroma_h ||
+            !sws_isSupportedInput(pix_fmt) || !sws_isSupportedOutput(pix_fmt) ||
+            av_get_pix_fmt_loss(pix_fmt, fmt, has_alpha))
+            continue;
+        if (best == AV_PIX_FMT_NONE ||
+            desc->comp[0].depth < av_pix_fmt_desc_get(best)->comp[0].depth)
+            best = pix_fmt;
+    }
+
+    return best;
+}
+
+static int config_output(AVFilterLink *outlink);
+
+static av_cold int init(AVFilterContext *ctx)
+{
+    MultiScaleContext *s = ctx->priv;
+    char *p, *arg, *saveptr = NULL;
+    int i, ret;
+
+    if (!s->sizes_str || !*s->sizes_str) {
+        av_log(ctx, AV_LOG_ERROR, "No output sizes specified.\n");
+        return AVERROR(EINVAL);
+    }
+
+    for (p = s->sizes_str; *p; p++)
+        s->nb_outputs += *p == '|';
+    s->nb_outputs++;
+
+    s->w   = av_calloc(s->nb_outputs, sizeof(*s->w));
+    s->h   = av_calloc(s->nb_outputs, sizeof(*s->h));
+    s->sws = av_calloc(s->nb_outputs, sizeof(*s->sws));
+    if (!s->w || !s->h || !s->sws)
+        return AVERROR(ENOMEM);
+
+    p = s->sizes_str;
+    for (i = 0; i < s->nb_outputs; i++) {
+        char name[32];
+        AVFilterPad pad = { 0 };
+
+        if (!(arg = av_strtok(p, "|", &saveptr)))
+            return AVERROR(EINVAL);
+        p = NULL;
+        if ((ret = av_parse_video_size(&s->w[i], &s->h[i], arg)) < 0) {
+            av_log(ctx, AV_LOG_ERROR, "Invalid size '%s'\n", arg);
+            return ret;
+        }
+
+        snprintf(name, sizeof(name), "output%d", i);
+        pad.type         = AVMEDIA_TYPE_VIDEO;
+        pad.name         = av_strdup(name);
+        pad.config_props = config_output;
+        if (!pad.name)
+            return AVERROR(ENOMEM);
+
+        if ((ret = ff_insert_outpad(ctx, i, &pad)) < 0) {
+            av_freep(&pad.name);
+            return ret;
+        }
+    }
+
+    if (s->flags_str) {
+        const AVClass *class = sws_get_class();
+        const AVOption    *o = av_opt_find(&class, "sws_flags", NULL, 0,
+                                           AV_OPT_SEARCH_FAKE_OBJ);
+        ret = av_opt_eval_flags(&class, o, s->flags_str, &s->flags);
+        if (ret < 0)
+            return ret;
+    }
+
+    return 0;
+}
+
+static av_cold void uninit(AVFilterContext *ctx)
+{
+    MultiScaleContext *s = ctx->priv;
+    int i;
+
+    for (i = 0; i < ctx->nb_outputs; i++)
+        av_freep(&ctx->output_pads[i].name);
+    for (i = 0; s->sws && i < s->nb_outputs; i++)
+        sws_freeContext(s->sws[i]);
+    sws_freeContext(s->unpack_sws);
+    av_frame_free(&s->unpacked);
+    av_freep(&s->sws);
+    av_freep(&s->w);
+    av_freep(&s->h);
+}
+
+static int query_formats(AVFilterContext *ctx)
+{
+    MultiScaleContext *s = ctx->priv;
+    const AVPixFmtDescriptor *desc = NULL;
+    AVFilterFormats *formats = NULL;
+    int i, ret;
+
+    while ((desc = av_pix_fmt_desc_next(desc))) {
+        enum AVPixelFormat pix_fmt = av_pix_fmt_desc_get_id(desc);
+        if (sws_isSupportedInput(pix_fmt) &&
+            (s->format != AV_PIX_FMT_NONE || sws_isSupportedOutput(pix_fmt)) &&
+            (ret = ff_add_format(&formats, pix_fmt)) < 0)
+            return ret;
+    }
+
+    if (s->format == AV_PIX_FMT_NONE)
+        return ff_set_common_formats(ctx, formats);
+
+    if ((ret = ff_formats_ref(formats, &ctx->inputs[0]->out_formats)) < 0)
+        return ret;
+    for (i = 0; i < ctx->nb_outputs; i++) {
+        enum AVPixelFormat out_fmts[] = { s->format, AV_PIX_FMT_NONE };
+
+        if ((ret = ff_formats_ref(ff_make_format_list(out_fmts),
+                                  &ctx->outputs[i]->in_formats)) < 0)
+            return ret;
+    }
+
+    return 0;
+}
+
+static int config_input(AVFilterLink *inlink)
+{
+    AVFilterContext *ctx = inlink->dst;
+    MultiScaleContext *s = ctx->priv;
+    enum AVPixelFormat fmt = unpacked_format(inlink->format);
+    int ret;
+
+    sws_freeContext(s->unpack_sws);
+    s->unpack_sws = NULL;
+    av_frame_free(&s->unpacked);
+
+    /* a single output gains nothing from the intermediate copy */
+    if (fmt == AV_PIX_FMT_NONE || ctx->nb_outputs < 2)
+        return 0;
+
+    s->unpacked = av_frame_alloc();
+    if (!s->unpacked)
+        return AVERROR(ENOMEM);
+    s->unpacked->format = fmt;
+    s->unpacked->width  = inlink->w;
+    s->unpacked->height = inlink->h;
+    if ((ret = av_frame_get_buffer(s->unpacked, 0)) < 0)
+        return ret;
+
+    s->unpack_sws = sws_getContext(inlink->w, inlink->h, inlink->format,
+                                   inlink->w, inlink->h, fmt,
+                                   s->flags, NULL, NULL, NULL);
+    if (!s->unpack_sws)
+        return AVERROR(EINVAL);
+
+    av_log(ctx, AV_LOG_VERBOSE, "unpacking %s input to %s once per frame\n",
+           av_get_pix_fmt_name(inlink->format), av_get_pix_fmt_name(fmt));
+
+    return 0;
+}
+
+static int config_output(AVFilterLink *outlink)
+{
+    AVFilterContext *ctx = outlink->src;
+    AVFilterLink *inlink = ctx->inputs[0];
+    MultiScaleContext *s = ctx->priv;
+    const int idx = FF_OUTLINK_IDX(outlink);
+    struct SwsContext *sws;
+    int ret;
+
+    outlink->w = s->w[idx];
+    outlink->h = s->h[idx];
+
+    if (inlink->sample_aspect_ratio.num)
+        outlink->sample_aspect_ratio = av_mul_q((AVRational){ outlink->h * inlink->w,
+                                                              outlink->w * inlink->h },
+                                                inlink->sample_aspect_ratio);
+    else
+        outlink->sample_aspect_ratio = inlink->sample_aspect_ratio;
+
+    sws_freeContext(s->sws[idx]);
+    s->sws[idx] = sws = sws_alloc_context();
+    if (!sws)
+        return AVERROR(ENOMEM);
+
+    av_opt_set_int(sws, "srcw",       inlink->w, 0);
+    av_opt_set_int(sws, "srch",       inlink->h, 0);
+    av_opt_set_int(sws, "src_format", s->unpacked ? s->unpacked->format : inlink->format, 0);
+    av_opt_set_int(sws, "dstw",       outlink->w, 0);
+    av_opt_set_int(sws, "dsth",       outlink->h, 0);
+    av_opt_set_int(sws, "dst_format", outlink->format, 0);
+    av_opt_set_int(sws, "sws_flags",  s->flags, 0);
+
+    /* Use the MPEG-2 chroma positions for YUV420P, as the scale filter does */
+    if (inlink->format == AV_PIX_FMT_YUV420P)
+        av_opt_set_int(sws, "src_v_chr_pos", 128, 0);
+    if (outlink->format == AV_PIX_FMT_YUV420P)
+        av_opt_set_int(sws, "dst_v_chr_pos", 128, 0);
+
+    if ((ret = sws_init_context(sws, NULL, NULL)) < 0)
+        return ret;
+
+    av_log(ctx, AV_LOG_VERBOSE, "output%d: w:%d h:%d fmt:%s -> w:%d h:%d fmt:%s\n",
+           idx, inlink->w, inlink->h, av_get_pix_fmt_name(inlink->format),
+           outlink->w, outlink->h, av_get_pix_fmt_name(outlink->format));
+
+    return 0;
+}
+
+static int scale_output(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    MultiScaleContext *s = ctx->priv;
+    ThreadData *td = arg;
+    AVFrame *in  = td->in;
+    AVFrame *out = td->out[jobnr];
+
+    if (!out)
+        return 0;
+
+    sws_scale(s->sws[jobnr], (const uint8_t * const *)in->data, in->linesize,
+              0, in->height, out->data, out->linesize);
+    return 0;
+}
+
+static int filter_frame(AVFilterLink *inlink, AVFrame *in)
+{
+    AVFilterContext *ctx = inlink->dst;
+    MultiScaleContext *s = ctx->priv;
+    enum AVColorSpace colorspace = in->colorspace;
+    const int *coeffs;
+    AVFrame **out;
+    ThreadData td;
+    int i, ret = AVERROR_EOF;
+
+    out = av_calloc(ctx->nb_outputs, sizeof(*out));
+    if (!out) {
+        av_frame_free(&in);
+        return AVERROR(ENOMEM);
+    }
+
+    if (colorspace < 1 || colorspace > 10 || colorspace == 8)
+        colorspace = AVCOL_SPC_BT470BG;
+    coeffs = sws_getCoefficients(colorspace);
+
+    for (i = 0; i < ctx->nb_outputs; i++) {
+        AVFilterLink *outlink = ctx->outputs[i];
+        int *inv_table, *table, in_full, out_full, brightness, contrast, saturation;
+
+        if (ff_outlink_get_status(outlink))
+            continue;
+        out[i] = ff_get_video_buffer(outlink, outlink->w, outlink->h);
+        if (!out[i]) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+        av_frame_copy_props(out[i], in);
+        out[i]->width  = outlink->w;
+        out[i]->height = outlink->h;
+        av_reduce(&out[i]->sample_aspect_ratio.num, &out[i]->sample_aspect_ratio.den,
+                  (int64_t)in->sample_aspect_ratio.num * outlink->h * inlink->w,
+                  (int64_t)in->sample_aspect_ratio.den * outlink->w * inlink->h,
+                  INT_MAX);
+
+        /* same colorspace handling as the scale filter with default options */
+        sws_getColorspaceDetails(s->sws[i], &inv_table, &in_full,
+                                 &table, &out_full,
+                                 &brightness, &contrast, &saturation);
+        if (in->color_range != AVCOL_RANGE_UNSPECIFIED)
+            in_full = in->color_range == AVCOL_RANGE_JPEG;
+        sws_setColorspaceDetails(s->sws[i], coeffs, in_full, coeffs, out_full,
+                                 brightness, contrast, saturation);
+        out[i]->color_range = out_full ? AVCOL_RANGE_JPEG : AVCOL_RANGE_MPEG;
+    }
+
+    td.in  = in;
+    td.out = out;
+    if (s->unpack_sws) {
+        sws_scale(s->unpack_sws, (const uint8_t * const *)in->data, in->linesize,
+                  0, in->height, s->unpacked->data, s->unpacked->linesize);
+        td.in = s->unpacked;
+    }
+    ctx->internal->execute(ctx, scale_output, &td, NULL, ctx->nb_outputs);
+
+    for (i = 0; i < ctx->nb_outputs; i++) {
+        if (!out[i])
+            continue;
+        ret = ff_filter_frame(ctx->outputs[i], out[i]);
+        out[i] = NULL;
+        if (ret < 0)
+            break;
+    }
+
+end:
+    for (i = 0; i < ctx->nb_outputs; i++)
+        av_frame_free(&out[i]);
+    av_free(out);
+    av_frame_free(&in);
+    return ret;
+}
+
+#define OFFSET(x) offsetof(MultiScaleContext, x)
+#define FLAGS AV_OPT_FLAG_VIDEO_PARAM|AV_OPT_FLAG_FILTERING_PARAM
+
+static const AVOption multiscale_options[] = {
+    { "sizes",  "set '|'-separated list of output sizes", OFFSET(sizes_str), AV_OPT_TYPE_STRING,    { .str = NULL },           .flags = FLAGS },
+    { "flags",  "Flags to pass to libswscale",            OFFSET(flags_str), AV_OPT_TYPE_STRING,    { .str = "bilinear" },     .flags = FLAGS },
+    { "format", "set output pixel format",                OFFSET(format),    AV_OPT_TYPE_PIXEL_FMT, { .i64 = AV_PIX_FMT_NONE }, -1, INT_MAX, FLAGS },
+    { NULL }
+};
+
+AVFILTER_DEFINE_CLASS(multiscale);
+
+static const AVFilterPad multiscale_inputs[] = {
+    {
+        .name         = "default",
+        .type         = AVMEDIA_TYPE_VIDEO,
+        .config_props = config_input,
+        .filter_frame = filter_frame,
+    },
+    { NULL }
+};
+
+AVFilter ff_vf_multiscale = {
+    .name          = "multiscale",
+    .description   = NULL_IF_CONFIG_SMALL("Scale the input video to several sizes at once."),
+    .priv_size     = sizeof(MultiScaleContext),
+    .priv_class    = &multiscale_class,
+    .init          = init,
+    .uninit        = uninit,
+    .query_formats = query_formats,
+    .inputs        = multiscale_inputs,
+    .outputs       = NULL,
+    .flags         = AVFILTER_FLAG_DYNAMIC_OUTPUTS | AVFILTER_FLAG_SLICE_THREADS,
+};
@@ -38,6 +38,7 @@
 #include "internal.h"
 #include "drawutils.h"
 #include "framesync.h"
+#include "overlay.h"
 #include "video.h"
 
 static const char *const var_names[] = {
@@ -123,9 +124,16 @@ typedef struct OverlayContext {
 
     AVExpr *x_pexpr, *y_pexpr;
 
-    void (*blend_image)(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y);
+    OverlayDSPContext dsp;
+
+    void (*blend_image)(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src,
+                        int x, int y, int jobnr, int nb_jobs);
 } OverlayContext;
 
+typedef struct ThreadData {
+    AVFrame *dst, *src;
+} ThreadData;
+
 static av_cold void uninit(AVFilterContext *ctx)
 {
     OverlayContext *s = ctx->priv;
@@ -397,13 +405,82 @@ static int config_output(AVFilterLink *outlink)
 // ((((x) + (y)) << 8) - ((x) + (y)) - (y) * (x)) is a faster version of: 255 * (x + y)
 #define UNPREMULTIPLY_ALPHA(x, y) ((((x) << 16) - ((x) << 9) + (x)) / ((((x) + (y)) << 8) - ((x) + (y)) - (y) * (x)))
 
+static int blend_row_444_c(uint8_t *d, const uint8_t *s, const uint8_t *a,
+                           ptrdiff_t alinesize, int w)
+{
+    int k;
+
+    for (k = 0; k < w; k++)
+        d[k] = FAST_DIV255(d[k] * (255 - a[k]) + s[k] * a[k]);
+    return w;
+}
+
+static int blend_row_422_c(uint8_t *d, const uint8_t *s, const uint8_t *a,
+                           ptrdiff_t alinesize, int w)
+{
+    int k;
+
+    for (k = 0; k < w; k++) {
+        int alpha = (a[2*k] + ((a[2*k] + a[2*k+1]) >> 1)) >> 1;
+        d[k] = FAST_DIV255(d[k] * (255 - alpha) + s[k] * alpha);
+    }
+    return w;
+}
+
+static int blend_row_420_c(uint8_t *d, const uint8_t *s, const uint8_t *a,
+                           ptrdiff_t alinesize, int w)
+{
+    int k;
+
+    for (k = 0; k < w; k++) {
+        int alpha = (a[2*k]             + a[2*k+1] +
+                     a[alinesize + 2*k] + a[alinesize + 2*k+1]) >> 2;
+        d[k] = FAST_DIV255(d[k] * (255 - alpha) + s[k] * alpha);
+    }
+    return w;
+}
+
+/* The alpha == 0 and alpha == 255 cases of blend_image_packed_rgb() give
+ * the same results through the general equations, so they are not special
+ * cased here. */
+static int blend_row_rgba_c(uint8_t *d, const uint8_t *s, int w, int alpha_pos)
+{
+    int j, c;
+
+    for (j = 0; j < w; j++) {
+        int alpha = s[alpha_pos];
+
+        if (alpha != 0 && alpha != 255)
+            alpha = UNPREMULTIPLY_ALPHA(alpha, d[alpha_pos]);
+        for (c = 0; c < 4; c++)
+            if (c != alpha_pos)
+                d[c] = FAST_DIV255(d[c] * (255 - alpha) + s[c] * alpha);
+        d[alpha_pos] += FAST_DIV255((255 - d[alpha_pos]) * s[alpha_pos]);
+        d += 4;
+        s += 4;
+    }
+    return w;
+}
+
+av_cold void ff_overlay_dsp_init(OverlayDSPContext *dsp)
+{
+    dsp->blend_row_444  = blend_row_444_c;
+    dsp->blend_row_422  = blend_row_422_c;
+    dsp->blend_row_420  = blend_row_420_c;
+    dsp->blend_row_rgba = blend_row_rgba_c;
+
+    if (ARCH_X86)
+        ff_overlay_dsp_init_x86(dsp);
+}
+
 /**
  * Blend image in src to destination buffer dst at position (x, y).
  */
 
 static void blend_image_packed_rgb(AVFilterContext *ctx,
                                    AVFrame *dst, const AVFrame *src,
-                                   int main_has_alpha, int x, int y)
+                                   int main_has_alpha, int x, int y,
+                                   int jobnr, int nb_jobs)
 {
     OverlayContext *s = ctx->priv;
     int i, imax, j, jmax;
@@ -422,18 +499,30 @@ static void blend_image_packed_rgb(AVFilterContext *ctx,
     const int sb = s->overlay_rgba_map[B];
     const int sa = s->overlay_rgba_map[A];
     const int sstep = s->overlay_pix_step[0];
+    const int use_row = main_has_alpha && dstep == 4 && sstep == 4 &&
+                        !memcmp(s->main_rgba_map, s->overlay_rgba_map, 4);
+    const int slice_start = (src_h *  jobnr   ) / nb_jobs;
+    const int slice_end   = (src_h * (jobnr+1)) / nb_jobs;
     uint8_t *S, *sp, *d, *dp;
 
-    i = FFMAX(-y, 0);
+    i = FFMAX(-y, slice_start);
     sp = src->data[0] + i     * src->linesize[0];
     dp = dst->data[0] + (y+i) * dst->linesize[0];
 
-    for (imax = FFMIN(-y + dst_h, src_h); i < imax; i++) {
+    for (imax = FFMIN3(-y + dst_h, src_h, slice_end); i < imax; i++) {
         j = FFMAX(-x, 0);
         S = sp + j     * sstep;
         d = dp + (x+j) * dstep;
+        jmax = FFMIN(-x + dst_w, src_w);
 
-        for (jmax = FFMIN(-x + dst_w, src_w); j < jmax; j++) {
+        if (use_row && j < jmax) {
+            int n = s->dsp.blend_row_rgba(d, S, jmax - j, da);
+            j += n;
+            S += n * sstep;
+            d += n * dstep;
+        }
+
+        for (; j < jmax; j++) {
             alpha = S[sa];
 
             // if the main channel has an alpha channel, alpha has to be calculated
@@ -487,8 +576,14 @@ static av_always_inline void blend_plane(AVFilterContext *ctx,
                                          int main_has_alpha,
                                          int dst_plane,
                                          int dst_offset,
-                                         int dst_step)
+                                         int dst_step,
+                                         int slice_start, int slice_end)
 {
+    OverlayContext *octx = ctx->priv;
+    int (*blend_row)(uint8_t *d, const uint8_t *s, const uint8_t *a,
+                     ptrdiff_t alinesize, int w) =
+        hsub ? vsub ? octx->dsp.blend_row_420 : octx->dsp.blend_row_422
+             : vsub ? NULL                    : octx->dsp.blend_row_444;
     int src_wp = AV_CEIL_RSHIFT(src_w, hsub);
     int src_hp = AV_CEIL_RSHIFT(src_h, vsub);
     int dst_wp = AV_CEIL_RSHIFT(dst_w, hsub);
@@ -498,7 +593,7 @@ static av_always_inline void blend_plane(AVFilterContext *ctx,
     uint8_t *s, *sp, *d, *dp, *dap, *a, *da, *ap;
     int jmax, j, k, kmax;
 
-    j = FFMAX(-yp, 0);
+    j = FFMAX(-yp, slice_start);
     sp = src->data[i] + j         * src->linesize[i];
     dp = dst->data[dst_plane]
                       + (yp+j)    * dst->linesize[dst_plane]
@@ -506,14 +601,28 @@ static av_always_inline void blend_plane(AVFilterContext *ctx,
     ap = src->data[3] + (j<<vsub) * src->linesize[3];
     dap = dst->data[3] + ((yp+j) << vsub) * dst->linesize[3];
 
-    for (jmax = FFMIN(-yp + dst_hp, src_hp); j < jmax; j++) {
+    for (jmax = FFMIN3(-yp + dst_hp, src_hp, slice_end); j < jmax; j++) {
         k = FFMAX(-xp, 0);
         d = dp + (xp+k) * dst_step;
         s = sp + k;
         a = ap + (k<<hsub);
         da = dap + ((xp+k) << hsub);
+        kmax = FFMIN(-xp + dst_wp, src_wp);
+
+        // the row functions only handle pixels with a complete alpha block
+        if (blend_row && !main_has_alpha && dst_step == 1 && (!vsub || j+1 < src_hp)) {
+            int w = FFMIN(kmax, src_wp - hsub) - k;
+            if (w > 0) {
+                int n = blend_row(d, s, a, src->linesize[3], w);
+                k  += n;
+                d  += n;
+                s  += n;
+                a  += n << hsub;
+                da += n << hsub;
+            }
+        }
 
-        for (kmax = FFMIN(-xp + dst_wp, src_wp); k < kmax; k++) {
+        for (; k < kmax; k++) {
             int alpha_v, alpha_h, alpha;
 
             // average alpha for color components, improve quality
@@ -562,17 +671,18 @@ static av_always_inline void blend_plane(AVFilterContext *ctx,
 static inline void alpha_composite(const AVFrame *src, const AVFrame *dst,
                                    int src_w, int src_h,
                                    int dst_w, int dst_h,
-                                   int x, int y)
+                                   int x, int y,
+                                   int slice_start, int slice_end)
 {
     uint8_t alpha;          ///< the amount of overlay to blend on to main
     uint8_t *s, *sa, *d, *da;
     int i, imax, j, jmax;
 
-    i = FFMAX(-y, 0);
+    i = FFMAX(-y, slice_start);
     sa = src->data[3] + i     * src->linesize[3];
     da = dst->data[3] + (y+i) * dst->linesize[3];
 
-    for (imax = FFMIN(-y + dst_h, src_h); i < imax; i++) {
+    for (imax = FFMIN3(-y + dst_h, src_h, slice_end); i < imax; i++) {
         j = FFMAX(-x, 0);
         s = sa + j;
         d = da + x+j;
@@ -601,100 +711,139 @@ static inline void alpha_composite(const AVFrame *src, const AVFrame *dst,
     }
 }
 
+/**
+ * Blend the part of the overlay assigned to slice jobnr. The slices are
+ * made of whole chroma lines, so that each one owns the alpha lines its
+ * chroma lines read when the main picture has an alpha plane.
+ */
 static av_always_inline void blend_image_yuv(AVFilterContext *ctx,
                                              AVFrame *dst, const AVFrame *src,
                                              int hsub, int vsub,
                                              int main_has_alpha,
-                                             int x, int y)
+                                             int x, int y,
+                                             int jobnr, int nb_jobs)
 {
     OverlayContext *s = ctx->priv;
     const int src_w = src->width;
     const int src_h = src->height;
     const int dst_w = dst->width;
     const int dst_h = dst->height;
+    const int src_hp = AV_CEIL_RSHIFT(src_h, vsub);
+    const int slice_start = (src_hp *  jobnr   ) / nb_jobs;
+    const int slice_end   = (src_hp * (jobnr+1)) / nb_jobs;
+    const int luma_start  = slice_start << vsub;
+    const int luma_end    = FFMIN(slice_end << vsub, src_h);
 
     blend_plane(ctx, dst, src, src_w, src_h, dst_w, dst_h, 0, 0,       0, x, y, main_has_alpha,
-                s->main_desc->comp[0].plane, s->main_desc->comp[0].offset, s->main_desc->comp[0].step);
+                s->main_desc->comp[0].plane, s->main_desc->comp[0].offset, s->main_desc->comp[0].step,
+                luma_start, luma_end);
     blend_plane(ctx, dst, src, src_w, src_h, dst_w, dst_h, 1, hsub, vsub, x, y, main_has_alpha,
-                s->main_desc->comp[1].plane, s->main_desc->comp[1].offset, s->main_desc->comp[1].step);
+                s->main_desc->comp[1].plane, s->main_desc->comp[1].offset, s->main_desc->comp[1].step,
+                slice_start, slice_end);
     blend_plane(ctx, dst, src, src_w, src_h, dst_w, dst_h, 2, hsub, vsub, x, y, main_has_alpha,
-                s->main_desc->comp[2].plane, s->main_desc->comp[2].offset, s->main_desc->comp[2].step);
+                s->main_desc->comp[2].plane, s->main_desc->comp[2].offset, s->main_desc->comp[2].step,
+                slice_start, slice_end);
 
     if (main_has_alpha)
-        alpha_composite(src, dst, src_w, src_h, dst_w, dst_h, x, y);
+        alpha_composite(src, dst, src_w, src_h, dst_w, dst_h, x, y, luma_start, luma_end);
 }
 
 static av_always_inline void blend_image_planar_rgb(AVFilterContext *ctx,
                                                     AVFrame *dst, const AVFrame *src,
                                                     int hsub, int vsub,
                                                     int main_has_alpha,
-                                                    int x, int y)
+                                                    int x, int y,
+                                                    int jobnr, int nb_jobs)
 {
     OverlayContext *s = ctx->priv;
     const int src_w = src->width;
     const int src_h = src->height;
     const int dst_w = dst->width;
     const int dst_h = dst->height;
+    const int slice_start = (src_h *  jobnr   ) / nb_jobs;
+    const int slice_end   = (src_h * (jobnr+1)) / nb_jobs;
 
     blend_plane(ctx, dst, src, src_w, src_h, dst_w, dst_h, 0, 0,       0, x, y, main_has_alpha,
-                s->main_desc->comp[1].plane, s->main_desc->comp[1].offset, s->main_desc->comp[1].step);
+                s->main_desc->comp[1].plane, s->main_desc->comp[1].offset, s->main_desc->comp[1].step,
+                slice_start, slice_end);
     blend_plane(ctx, dst, src, src_w, src_h, dst_w, dst_h, 1, hsub, vsub, x, y, main_has_alpha,
-                s->main_desc->comp[2].plane, s->main_desc->comp[2].offset, s->main_desc->comp[2].step);
+                s->main_desc->comp[2].plane, s->main_desc->comp[2].offset, s->main_desc->comp[2].step,
+                slice_start, slice_end);
     blend_plane(ctx, dst, src, src_w, src_h, dst_w, dst_h, 2, hsub, vsub, x, y, main_has_alpha,
-                s->main_desc->comp[0].plane, s->main_desc->comp[0].offset, s->main_desc->comp[0].step);
+                s->main_desc->comp[0].plane, s->main_desc->comp[0].offset, s->main_desc->comp[0].step,
+                slice_start, slice_end);
 
     if (main_has_alpha)
-        alpha_composite(src, dst, src_w, src_h, dst_w, dst_h, x, y);
+        alpha_composite(src, dst, src_w, src_h, dst_w, dst_h, x, y, slice_start, slice_end);
 }
 
-static void blend_image_yuv420(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y)
+static void blend_image_yuv420(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src,
+                               int x, int y, int jobnr, int nb_jobs)
 {
-    blend_image_yuv(ctx, dst, src, 1, 1, 0, x, y);
+    blend_image_yuv(ctx, dst, src, 1, 1, 0, x, y, jobnr, nb_jobs);
 }
 
-static void blend_image_yuva420(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y)
+static void blend_image_yuva420(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src,
+                                int x, int y, int jobnr, int nb_jobs)
 {
-    blend_image_yuv(ctx, dst, src, 1, 1, 1, x, y);
+    blend_image_yuv(ctx, dst, src, 1, 1, 1, x, y, jobnr, nb_jobs);
 }
 
-static void blend_image_yuv422(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y)
+static void blend_image_yuv422(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src,
+                               int x, int y, int jobnr, int nb_jobs)
 {
-    blend_image_yuv(ctx, dst, src, 1, 0, 0, x, y);
+    blend_image_yuv(ctx, dst, src, 1, 0, 0, x, y, jobnr, nb_jobs);
 }
 
-static void blend_image_yuva422(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y)
+static void blend_image_yuva422(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src,
+                                int x, int y, int jobnr, int nb_jobs)
 {
-    blend_image_yuv(ctx, dst, src, 1, 0, 1, x, y);
+    blend_image_yuv(ctx, dst, src, 1, 0, 1, x, y, jobnr, nb_jobs);
 }
 
-static void blend_image_yuv444(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y)
+static void blend_image_yuv444(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src,
+                               int x, int y, int jobnr, int nb_jobs)
 {
-    blend_image_yuv(ctx, dst, src, 0, 0, 0, x, y);
+    blend_image_yuv(ctx, dst, src, 0, 0, 0, x, y, jobnr, nb_jobs);
 }
 
-static void blend_image_yuva444(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y)
+static void blend_image_yuva444(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src,
+                                int x, int y, int jobnr, int nb_jobs)
 {
-    blend_image_yuv(ctx, dst, src, 0, 0, 1, x, y);
+    blend_image_yuv(ctx, dst, src, 0, 0, 1, x, y, jobnr, nb_jobs);
 }
 
-static void blend_image_gbrp(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y)
+static void blend_image_gbrp(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src,
+                             int x, int y, int jobnr, int nb_jobs)
 {
-    blend_image_planar_rgb(ctx, dst, src, 0, 0, 0, x, y);
+    blend_image_planar_rgb(ctx, dst, src, 0, 0, 0, x, y, jobnr, nb_jobs);
 }
 
-static void blend_image_gbrap(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y)
+static void blend_image_gbrap(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src,
+                              int x, int y, int jobnr, int nb_jobs)
 {
-    blend_image_planar_rgb(ctx, dst, src, 0, 0, 1, x, y);
+    blend_image_planar_rgb(ctx, dst, src, 0, 0, 1, x, y, jobnr, nb_jobs);
 }
 
-static void blend_image_rgb(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y)
+static void blend_image_rgb(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src,
+                            int x, int y, int jobnr, int nb_jobs)
 {
-    blend_image_packed_rgb(ctx, dst, src, 0, x, y);
+    blend_image_packed_rgb(ctx, dst, src, 0, x, y, jobnr, nb_jobs);
 }
 
-static void blend_image_rgba(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y)
+static void blend_image_rgba(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src,
+                             int x, int y, int jobnr, int nb_jobs)
 {
-    blend_image_packed_rgb(ctx, dst, src, 1, x, y);
+    blend_image_packed_rgb(ctx, dst, src, 1, x, y, jobnr, nb_jobs);
+}
+
+static int blend_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    OverlayContext *s = ctx->priv;
+    ThreadData *td = arg;
+
+    s->blend_image(ctx, td->dst, td->src, s->x, s->y, jobnr, nb_jobs);
+    return 0;
 }
 
 static int config_input_main(AVFilterLink *inlink)
@@ -792,8 +941,14 @@ static int do_blend(FFFrameSync *fs)
     }
 
     if (s->x < mainpic->width  && s->x + second->width  >= 0 ||
-        s->y < mainpic->height && s->y + second->height >= 0)
-        s->blend_image(ctx, mainpic, second, s->x, s->y);
+        s->y < mainpic->height && s->y + second->height >= 0) {
+        ThreadData td;
+
+        td.dst = mainpic;
+        td.src = second;
+        ctx->internal->execute(ctx, blend_slice, &td, NULL, FFMIN(second->height,
+                               ff_filter_get_nb_threads(ctx)));
+    }
     return ff_filter_frame(ctx->outputs[0], mainpic);
 }
 
@@ -802,6 +957,7 @@ static av_cold int init(AVFilterContext *ctx)
     OverlayContext *s = ctx->priv;
 
     s->fs.on_event = do_blend;
+    ff_overlay_dsp_init(&s->dsp);
     return 0;
 }
 
@@ -876,5 +1032,6 @@ AVFilter ff_vf_overlay = {
     .process_command = process_command,
     .inputs        = avfilter_vf_overlay_inputs,
     .outputs       = avfilter_vf_overlay_outputs,
-    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_INTERNAL,
+    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_INTERNAL |
+                     AVFILTER_FLAG_SLICE_THREADS,
 };
@@ -35,6 +35,7 @@
  */
 
 #include "libavutil/avstring.h"
+#include "libavutil/intreadwrite.h"
 #include "libavutil/opt.h"
 #include "libavutil/pixdesc.h"
 #include "avfilter.h"
@@ -59,22 +60,38 @@ typedef struct SSIMContext {
     uint8_t rgba_map[4];
     int planewidth[4];
     int planeheight[4];
-    int *temp;
+    void **temp;                ///< 4x4 block sums, one buffer per slice
+    float *line_ssim[4];        ///< per line SSIM, summed in order after the slices
+    int nb_threads;
     int is_rgb;
-    float (*ssim_plane)(SSIMDSPContext *dsp,
-                        uint8_t *main, int main_stride,
-                        uint8_t *ref, int ref_stride,
-                        int width, int height, void *temp,
-                        int max);
+    void (*ssim_plane)(SSIMDSPContext *dsp,
+                       uint8_t *main, int main_stride,
+                       uint8_t *ref, int ref_stride,
+                       int width, int height, void *temp,
+                       int max, int slice_start, int slice_end,
+                       float *line_ssim, uint64_t *sse);
     SSIMDSPContext dsp;
+
+    int psnr;                   ///< also compute the PSNR from the block sums
+    uint64_t (*sse)[4];         ///< per slice sums of squared errors
+    double planeweight[4];
+    double mse, min_mse, max_mse, mse_comp[4];
 } SSIMContext;
 
+typedef struct ThreadData {
+    uint8_t *main_data[4];
+    uint8_t *ref_data[4];
+    int main_linesize[4];
+    int ref_linesize[4];
+} ThreadData;
+
 #define OFFSET(x) offsetof(SSIMContext, x)
 #define FLAGS AV_OPT_FLAG_FILTERING_PARAM|AV_OPT_FLAG_VIDEO_PARAM
 
 static const AVOption ssim_options[] = {
     {"stats_file", "Set file where to store per-frame difference information", OFFSET(stats_file_str), AV_OPT_TYPE_STRING, {.str=NULL}, 0, 0, FLAGS },
     {"f",          "Set file where to store per-frame difference information", OFFSET(stats_file_str), AV_OPT_TYPE_STRING, {.str=NULL}, 0, 0, FLAGS },
+    {"psnr",       "Also calculate the PSNR in the same pass",                 OFFSET(psnr),           AV_OPT_TYPE_BOOL,   {.i64=0},    0, 1, FLAGS },
     { NULL }
 };
 
@@ -221,60 +238,130 @@ static float ssim_endn_8bit(const int (*sum0)[4], const int (*sum1)[4], int widt
 
 #define SUM_LEN(w) (((w) >> 2) + 3)
 
-static float ssim_plane_16bit(SSIMDSPContext *dsp,
-                              uint8_t *main, int main_stride,
-                              uint8_t *ref, int ref_stride,
-                              int width, int height, void *temp,
-                              int max)
+/**
+ * Compute the SSIM of the lines slice_start to slice_end - 1 of 4x4 blocks
+ * into line_ssim. The block lines of the slice are those from slice_start - 1
+ * to slice_end - 1, and their squared errors are added to sse if not NULL.
+ * A block line shared with the next slice is left to that slice, so that
+ * it is only counted once.
+ */
+static void ssim_plane_16bit(SSIMDSPContext *dsp,
+                             uint8_t *main, int main_stride,
+                             uint8_t *ref, int ref_stride,
+                             int width, int height, void *temp,
+                             int max, int slice_start, int slice_end,
+                             float *line_ssim, uint64_t *sse)
 {
-    int z = 0, y;
-    float ssim = 0.0;
+    int z = slice_start - 1, y, i;
     int64_t (*sum0)[4] = temp;
     int64_t (*sum1)[4] = sum0 + SUM_LEN(width);
+    const int sse_end = slice_end == height >> 2 ? slice_end : slice_end - 1;
 
     width >>= 2;
     height >>= 2;
 
-    for (y = 1; y < height; y++) {
+    for (y = slice_start; y < slice_end; y++) {
         for (; z <= y; z++) {
             FFSWAP(void*, sum0, sum1);
             ssim_4x4xn_16bit(&main[4 * z * main_stride], main_stride,
                              &ref[4 * z * ref_stride], ref_stride,
                              sum0, width);
+            if (sse && z < sse_end)
+                for (i = 0; i < width; i++)
+                    *sse += sum0[i][2] - 2 * sum0[i][3];
         }
 
-        ssim += ssim_endn_16bit((const int64_t (*)[4])sum0, (const int64_t (*)[4])sum1, width - 1, max);
+        line_ssim[y] = ssim_endn_16bit((const int64_t (*)[4])sum0, (const int64_t (*)[4])sum1, width - 1, max);
     }
-
-    return ssim / ((height - 1) * (width - 1));
 }
 
-static float ssim_plane(SSIMDSPContext *dsp,
-                        uint8_t *main, int main_stride,
-                        uint8_t *ref, int ref_stride,
-                        int width, int height, void *temp,
-                        int max)
+static void ssim_plane(SSIMDSPContext *dsp,
+                       uint8_t *main, int main_stride,
+                       uint8_t *ref, int ref_stride,
+                       int width, int height, void *temp,
+                       int max, int slice_start, int slice_end,
+                       float *line_ssim, uint64_t *sse)
 {
-    int z = 0, y;
-    float ssim = 0.0;
+    int z = slice_start - 1, y, i;
     int (*sum0)[4] = temp;
     int (*sum1)[4] = sum0 + SUM_LEN(width);
+    const int sse_end = slice_end == height >> 2 ? slice_end : slice_end - 1;
 
     width >>= 2;
     height >>= 2;
 
-    for (y = 1; y < height; y++) {
+    for (y = slice_start; y < slice_end; y++) {
         for (; z <= y; z++) {
             FFSWAP(void*, sum0, sum1);
             dsp->ssim_4x4_line(&main[4 * z * main_stride], main_stride,
                                &ref[4 * z * ref_stride], ref_stride,
                                sum0, width);
+            if (sse && z < sse_end)
+                for (i = 0; i < width; i++)
+                    *sse += sum0[i][2] - 2 * sum0[i][3];
         }
 
-        ssim += dsp->ssim_end_line((const int (*)[4])sum0, (const int (*)[4])sum1, width - 1);
+        line_ssim[y] = dsp->ssim_end_line((const int (*)[4])sum0, (const int (*)[4])sum1, width - 1);
+    }
+}
+
+/* squared errors of the pixels not covered by the 4x4 blocks */
+static uint64_t sse_rect(const uint8_t *main, int main_stride,
+                         const uint8_t *ref, int ref_stride,
+                         int x0, int x1, int y0, int y1, int max)
+{
+    uint64_t sse = 0;
+    int x, y;
+
+    for (y = y0; y < y1; y++) {
+        const uint8_t *m = main + y * main_stride;
+        const uint8_t *r = ref  + y * ref_stride;
+
+        for (x = x0; x < x1; x++) {
+            int64_t d = max > 255 ? AV_RN16(m + 2 * x) - AV_RN16(r + 2 * x) : m[x] - r[x];
+            sse += d * d;
+        }
     }
+    return sse;
+}
 
-    return ssim / ((height - 1) * (width - 1));
+static int ssim_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    SSIMContext *s = ctx->priv;
+    ThreadData *td = arg;
+    int c;
+
+    for (c = 0; c < s->nb_components; c++) {
+        const int w = s->planewidth[c];
+        const int h = s->planeheight[c];
+        const int rows = h >> 2;
+        const int slice_start = 1 + ((rows - 1) *  jobnr   ) / nb_jobs;
+        const int slice_end   = 1 + ((rows - 1) * (jobnr+1)) / nb_jobs;
+        uint64_t *sse = s->psnr ? &s->sse[jobnr][c] : NULL;
+
+        if (sse)
+            *sse = 0;
+        if (rows > 1)
+            s->ssim_plane(&s->dsp, td->main_data[c], td->main_linesize[c],
+                          td->ref_data[c], td->ref_linesize[c],
+                          w, h, s->temp[jobnr], s->max,
+                          slice_start, slice_end, s->line_ssim[c], sse);
+        if (!sse)
+            continue;
+
+        if (rows > 1) {
+            const int sse_end = slice_end == rows ? slice_end : slice_end - 1;
+
+            *sse += sse_rect(td->main_data[c], td->main_linesize[c],
+                             td->ref_data[c], td->ref_linesize[c],
+                             w & ~3, w, 4 * (slice_start - 1), 4 * sse_end, s->max);
+        }
+        if (jobnr == nb_jobs - 1)
+            *sse += sse_rect(td->main_data[c], td->main_linesize[c],
+                             td->ref_data[c], td->ref_linesize[c],
+                             0, w, rows > 1 ? h & ~3 : 0, h, s->max);
+    }
+    return 0;
 }
 
 static double ssim_db(double ssim, double weight)
@@ -282,14 +369,22 @@ static double ssim_db(double ssim, double weight)
     return 10 * log10(weight / (weight - ssim));
 }
 
+static inline double get_psnr(double mse, uint64_t nb_frames, int max)
+{
+    return 10.0 * log10((double)max * max / (mse / nb_frames));
+}
+
 static int do_ssim(FFFrameSync *fs)
 {
     AVFilterContext *ctx = fs->parent;
     SSIMContext *s = ctx->priv;
     AVFrame *master, *ref;
     AVDictionary **metadata;
+    ThreadData td;
     float c[4], ssimv = 0.0;
-    int ret, i;
+    double comp_mse[4], mse = 0;
+    int nb_jobs = av_clip(s->planeheight[0] >> 2, 1, s->nb_threads);
+    int ret, i, j, y;
 
     ret = ff_framesync_dualinput_get(fs, &master, &ref);
     if (ret < 0)
@@ -301,10 +396,24 @@ static int do_ssim(FFFrameSync *fs)
     s->nb_frames++;
 
     for (i = 0; i < s->nb_components; i++) {
-        c[i] = s->ssim_plane(&s->dsp, master->data[i], master->linesize[i],
-                             ref->data[i], ref->linesize[i],
-                             s->planewidth[i], s->planeheight[i], s->temp,
-                             s->max);
+        td.main_data[i]     = master->data[i];
+        td.main_linesize[i] = master->linesize[i];
+        td.ref_data[i]      = ref->data[i];
+        td.ref_linesize[i]  = ref->linesize[i];
+    }
+
+    ctx->internal->execute(ctx, ssim_slice, &td, NULL, nb_jobs);
+
+    /* The lines are summed in the same order whatever the number of slices,
+     * so that the result does not depend on the number of threads. */
+    for (i = 0; i < s->nb_components; i++) {
+        const int width  = s->planewidth[i]  >> 2;
+        const int height = s->planeheight[i] >> 2;
+        float ssim = 0.0;
+
+        for (y = 1; y < height; y++)
+            ssim += s->line_ssim[i][y];
+        c[i] = ssim / ((height - 1) * (width - 1));
         ssimv += s->coefs[i] * c[i];
         s->ssim[i] += c[i];
     }
@@ -317,6 +426,30 @@ static int do_ssim(FFFrameSync *fs)
     set_meta(metadata, "lavfi.ssim.All", 0, ssimv);
     set_meta(metadata, "lavfi.ssim.dB", 0, ssim_db(ssimv, 1.0));
 
+    if (s->psnr) {
+        for (i = 0; i < s->nb_components; i++) {
+            uint64_t sse = 0;
+
+            for (j = 0; j < nb_jobs; j++)
+                sse += s->sse[j][i];
+            comp_mse[i] = sse / (double)(s->planewidth[i] * s->planeheight[i]);
+            mse += comp_mse[i] * s->planeweight[i];
+            s->mse_comp[i] += comp_mse[i];
+        }
+        s->min_mse = FFMIN(s->min_mse, mse);
+        s->max_mse = FFMAX(s->max_mse, mse);
+        s->mse += mse;
+
+        for (i = 0; i < s->nb_components; i++) {
+            int cidx = s->is_rgb ? s->rgba_map[i] : i;
+            char comp = av_tolower(s->comps[i]);
+            set_meta(metadata, "lavfi.psnr.mse.", comp, comp_mse[cidx]);
+            set_meta(metadata, "lavfi.psnr.psnr.", comp, get_psnr(comp_mse[cidx], 1, s->max));
+        }
+        set_meta(metadata, "lavfi.psnr.mse_avg", 0, mse);
+        set_meta(metadata, "lavfi.psnr.psnr_avg", 0, get_psnr(mse, 1, s->max));
+    }
+
     if (s->stats_file) {
         fprintf(s->stats_file, "n:%"PRId64" ", s->nb_frames);
 
@@ -325,7 +458,18 @@ static int do_ssim(FFFrameSync *fs)
             fprintf(s->stats_file, "%c:%f ", s->comps[i], c[cidx]);
         }
 
-        fprintf(s->stats_file, "All:%f (%f)\n", ssimv, ssim_db(ssimv, 1.0));
+        fprintf(s->stats_file, "All:%f (%f)", ssimv, ssim_db(ssimv, 1.0));
+
+        if (s->psnr) {
+            fprintf(s->stats_file, " mse_avg:%0.2f", mse);
+            for (i = 0; i < s->nb_components; i++) {
+                int cidx = s->is_rgb ? s->rgba_map[i] : i;
+                fprintf(s->stats_file, " psnr_%c:%0.2f", av_tolower(s->comps[i]),
+                        get_psnr(comp_mse[cidx], 1, s->max));
+            }
+            fprintf(s->stats_file, " psnr_avg:%0.2f", get_psnr(mse, 1, s->max));
+        }
+        fprintf(s->stats_file, "\n");
     }
 
     return ff_filter_frame(ctx->outputs[0], master);
@@ -335,6 +479,9 @@ static av_cold int init(AVFilterContext *ctx)
 {
     SSIMContext *s = ctx->priv;
 
+    s->min_mse = +INFINITY;
+    s->max_mse = -INFINITY;
+
     if (s->stats_file_str) {
         if (!strcmp(s->stats_file_str, "-")) {
             s->stats_file = stdout;
@@ -407,12 +554,30 @@ static int config_input_ref(AVFilterLink *inlink)
     s->planewidth[0]  = s->planewidth[3]  = inlink->w;
     for (i = 0; i < s->nb_components; i++)
         sum += s->planeheight[i] * s->planewidth[i];
-    for (i = 0; i < s->nb_components; i++)
+    for (i = 0; i < s->nb_components; i++) {
         s->coefs[i] = (double) s->planeheight[i] * s->planewidth[i] / sum;
+        s->planeweight[i] = (double) s->planeheight[i] * s->planewidth[i] / sum;
+    }
 
-    s->temp = av_mallocz_array(2 * SUM_LEN(inlink->w), (desc->comp[0].depth > 8) ? sizeof(int64_t[4]) : sizeof(int[4]));
+    s->nb_threads = ff_filter_get_nb_threads(ctx);
+    s->temp = av_mallocz_array(s->nb_threads, sizeof(*s->temp));
     if (!s->temp)
         return AVERROR(ENOMEM);
+    for (i = 0; i < s->nb_threads; i++) {
+        s->temp[i] = av_mallocz_array(2 * SUM_LEN(inlink->w), (desc->comp[0].depth > 8) ? sizeof(int64_t[4]) : sizeof(int[4]));
+        if (!s->temp[i])
+            return AVERROR(ENOMEM);
+    }
+    for (i = 0; i < s->nb_components; i++) {
+        s->line_ssim[i] = av_mallocz_array((s->planeheight[i] >> 2) + 1, sizeof(*s->line_ssim[i]));
+        if (!s->line_ssim[i])
+            return AVERROR(ENOMEM);
+    }
+    if (s->psnr) {
+        s->sse = av_mallocz_array(s->nb_threads, sizeof(*s->sse));
+        if (!s->sse)
+            return AVERROR(ENOMEM);
+    }
     s->max = (1 << desc->comp[0].depth) - 1;
 
     s->ssim_plane = desc->comp[0].depth > 8 ? ssim_plane_16bit : ssim_plane;
@@ -455,10 +620,10 @@ static int activate(AVFilterContext *ctx)
 static av_cold void uninit(AVFilterContext *ctx)
 {
     SSIMContext *s = ctx->priv;
+    int i;
 
     if (s->nb_frames > 0) {
         char buf[256];
-        int i;
         buf[0] = 0;
         for (i = 0; i < s->nb_components; i++) {
             int c = s->is_rgb ? s->rgba_map[i] : i;
@@ -467,6 +632,20 @@ static av_cold void uninit(AVFilterContext *ctx)
         }
         av_log(ctx, AV_LOG_INFO, "SSIM%s All:%f (%f)\n", buf,
                s->ssim_total / s->nb_frames, ssim_db(s->ssim_total, s->nb_frames));
+
+        if (s->psnr) {
+            buf[0] = 0;
+            for (i = 0; i < s->nb_components; i++) {
+                int c = s->is_rgb ? s->rgba_map[i] : i;
+                av_strlcatf(buf, sizeof(buf), " %c:%f", av_tolower(s->comps[i]),
+                            get_psnr(s->mse_comp[c], s->nb_frames, s->max));
+            }
+            av_log(ctx, AV_LOG_INFO, "PSNR%s average:%f min:%f max:%f\n",
+                   buf,
+                   get_psnr(s->mse, s->nb_frames, s->max),
+                   get_psnr(s->max_mse, 1, s->max),
+                   get_psnr(s->min_mse, 1, s->max));
+        }
     }
 
     ff_framesync_uninit(&s->fs);
@@ -474,7 +653,13 @@ static av_cold void uninit(AVFilterContext *ctx)
     if (s->stats_file && s->stats_file != stdout)
         fclose(s->stats_file);
 
+    if (s->temp)
+        for (i = 0; i < s->nb_threads; i++)
+            av_freep(&s->temp[i]);
     av_freep(&s->temp);
+    for (i = 0; i < 4; i++)
+        av_freep(&s->line_ssim[i]);
+    av_freep(&s->sse);
 }
 
 static const AVFilterPad ssim_inputs[] = {
@@ -510,4 +695,5 @@ AVFilter ff_vf_ssim = {
     .priv_class    = &ssim_class,
     .inputs        = ssim_inputs,
     .outputs       = ssim_outputs,
+    .flags         = AVFILTER_FLAG_SLICE_THREADS,
 };
@@ -37,21 +37,11 @@
 #include "avfilter.h"
 #include "formats.h"
 #include "internal.h"
+#include "tonemap.h"
 #include "video.h"
 
 #define REFERENCE_WHITE 100.0f
 
-enum TonemapAlgorithm {
-    TONEMAP_NONE,
-    TONEMAP_LINEAR,
-    TONEMAP_GAMMA,
-    TONEMAP_CLIP,
-    TONEMAP_REINHARD,
-    TONEMAP_HABLE,
-    TONEMAP_MOBIUS,
-    TONEMAP_MAX,
-};
-
 typedef struct LumaCoefficients {
     double cr, cg, cb;
 } LumaCoefficients;
@@ -76,6 +66,9 @@ typedef struct TonemapContext {
     double peak;
 
     const LumaCoefficients *coeffs;
+
+    TonemapParams params;
+    TonemapDSPContext dsp;
 } TonemapContext;
 
 static const enum AVPixelFormat pix_fmts[] = {
@@ -111,6 +104,8 @@ static av_cold int init(AVFilterContext *ctx)
     if (isnan(s->param))
         s->param = 1.0f;
 
+    ff_tonemap_dsp_init(&s->dsp, s->tonemap);
+
     return 0;
 }
 
@@ -159,15 +154,10 @@ static float mobius(float in, float j, double peak)
 }
 
 #define MIX(x,y,a) (x) * (1 - (a)) + (y) * (a)
-static void tonemap(TonemapContext *s, AVFrame *out, const AVFrame *in,
-                    const AVPixFmtDescriptor *desc, int x, int y, double peak)
+static void tonemap(const TonemapParams *p, float *r_out, float *b_out, float *g_out,
+                    const float *r_in, const float *b_in, const float *g_in)
 {
-    const float *r_in = (const float *)(in->data[0] + x * desc->comp[0].step + y * in->linesize[0]);
-    const float *b_in = (const float *)(in->data[1] + x * desc->comp[1].step + y * in->linesize[1]);
-    const float *g_in = (const float *)(in->data[2] + x * desc->comp[2].step + y * in->linesize[2]);
-    float *r_out = (float *)(out->data[0] + x * desc->comp[0].step + y * out->linesize[0]);
-    float *b_out = (float *)(out->data[1] + x * desc->comp[1].step + y * out->linesize[1]);
-    float *g_out = (float *)(out->data[2] + x * desc->comp[2].step + y * out->linesize[2]);
+    double peak = p->peak;
     float sig, sig_orig;
 
     /* load values */
@@ -176,9 +166,9 @@ static void tonemap(TonemapContext *s, AVFrame *out, const AVFrame *in,
     *g_out = *g_in;
 
     /* desaturate to prevent unnatural colors */
-    if (s->desat > 0) {
-        float luma = s->coeffs->cr * *r_in + s->coeffs->cg * *g_in + s->coeffs->cb * *b_in;
-        float overbright = FFMAX(luma - s->desat, 1e-6) / FFMAX(luma, 1e-6);
+    if (p->desat > 0) {
+        float luma = p->luma[0] * *r_in + p->luma[2] * *g_in + p->luma[1] * *b_in;
+        float overbright = FFMAX(luma - p->desat, 1e-6) / FFMAX(luma, 1e-6);
         *r_out = MIX(*r_in, luma, overbright);
         *g_out = MIX(*g_in, luma, overbright);
         *b_out = MIX(*b_in, luma, overbright);
@@ -190,29 +180,29 @@ static void tonemap(TonemapContext *s, AVFrame *out, const AVFrame *in,
     sig = FFMAX(FFMAX3(*r_out, *g_out, *b_out), 1e-6);
     sig_orig = sig;
 
-    switch(s->tonemap) {
+    switch(p->algorithm) {
     default:
     case TONEMAP_NONE:
         // do nothing
         break;
     case TONEMAP_LINEAR:
-        sig = sig * s->param / peak;
+        sig = sig * p->param / peak;
         break;
     case TONEMAP_GAMMA:
-        sig = sig > 0.05f ? pow(sig / peak, 1.0f / s->param)
-                          : sig * pow(0.05f / peak, 1.0f / s->param) / 0.05f;
+        sig = sig > 0.05f ? pow(sig / peak, 1.0f / p->param)
+                          : sig * pow(0.05f / peak, 1.0f / p->param) / 0.05f;
         break;
     case TONEMAP_CLIP:
-        sig = av_clipf(sig * s->param, 0, 1.0f);
+        sig = av_clipf(sig * p->param, 0, 1.0f);
         break;
     case TONEMAP_HABLE:
         sig = hable(sig) / hable(peak);
         break;
     case TONEMAP_REINHARD:
-        sig = sig / (sig + s->param) * (peak + s->param) / peak;
+        sig = sig / (sig + p->param) * (peak + p->param) / peak;
         break;
     case TONEMAP_MOBIUS:
-        sig = mobius(sig, s->param, peak);
+        sig = mobius(sig, p->param, peak);
         break;
     }
 
@@ -223,14 +213,158 @@ static void tonemap(TonemapContext *s, AVFrame *out, const AVFrame *in,
     *b_out *= sig / sig_orig;
 }
 
+static int tonemap_row_c(float *const dst[3], const float *const src[3], int w,
+                         const TonemapParams *p)
+{
+    int x;
+
+    for (x = 0; x < w; x++)
+        tonemap(p, dst[0] + x, dst[1] + x, dst[2] + x,
+                src[0] + x, src[1] + x, src[2] + x);
+
+    return w;
+}
+
+void ff_tonemap_params_init(TonemapParams *p, enum TonemapAlgorithm algorithm,
+                            double param, double desat, double peak,
+                            const double luma[3])
+{
+    float num[3] = { 0, 1, 0 }, den[3] = { 0, 0, 1 };
+    float threshold = -FLT_MAX, max = FLT_MAX;
+    float a, b, j, k;
+    int i, n;
+
+    p->algorithm = algorithm;
+    p->param     = param;
+    p->desat     = desat;
+    p->peak      = peak;
+    for (i = 0; i < 3; i++)
+        p->luma[i] = luma ? luma[i] : 0;
+
+    switch (algorithm) {
+    case TONEMAP_NONE:
+    case TONEMAP_GAMMA:
+        threshold = FLT_MAX;
+        break;
+    case TONEMAP_LINEAR:
+        num[1] = param / peak;
+        break;
+    case TONEMAP_CLIP:
+        num[1] = param;
+        max    = 1.0f;
+        break;
+    case TONEMAP_REINHARD:
+        num[1] = (peak + param) / peak;
+        den[1] = 1;
+        den[2] = param;
+        break;
+    case TONEMAP_HABLE:
+        /* hable() with its constant term folded into the fraction, which
+         * avoids the cancellation near 0 */
+        num[0] = 0.15f * (0.30f - 0.02f)         / hable(peak);
+        num[1] = 0.50f * (0.30f * 0.10f - 0.02f) / hable(peak);
+        num[2] = 0;
+        den[0] = 0.30f * 0.15f;
+        den[1] = 0.30f * 0.50f;
+        den[2] = 0.30f * 0.20f * 0.30f;
+        break;
+    case TONEMAP_MOBIUS:
+        j = param;
+        a = -j * j * (peak - 1.0f) / (j * j - 2.0f * j + peak);
+        b = (j * j - 2.0f * j * peak + peak) / FFMAX(peak - 1.0f, 1e-6);
+        k = (b * b + 2.0f * b * j + j * j) / (b - a);
+        num[1]    = k;
+        num[2]    = k * a;
+        den[1]    = 1;
+        den[2]    = b;
+        threshold = j;
+        break;
+    }
+
+    for (n = 0; n < 8; n++) {
+        p->simd[TONEMAP_PARAM_LUMA0][n]     = p->luma[0];
+        p->simd[TONEMAP_PARAM_LUMA1][n]     = p->luma[1];
+        p->simd[TONEMAP_PARAM_LUMA2][n]     = p->luma[2];
+        p->simd[TONEMAP_PARAM_DESAT][n]     = desat;
+        for (i = 0; i < 3; i++) {
+            p->simd[TONEMAP_PARAM_NUM0 + i][n] = num[i];
+            p->simd[TONEMAP_PARAM_DEN0 + i][n] = den[i];
+        }
+        p->simd[TONEMAP_PARAM_THRESHOLD][n] = threshold;
+        p->simd[TONEMAP_PARAM_MAX][n]       = max;
+    }
+}
+
+av_cold void ff_tonemap_dsp_init(TonemapDSPContext *dsp, enum TonemapAlgorithm algorithm)
+{
+    dsp->tonemap_row = tonemap_row_c;
+
+    if (ARCH_X86)
+        ff_tonemap_dsp_init_x86(dsp, algorithm);
+}
+
+typedef struct ThreadData {
+    AVFrame *in, *out;
+    const AVPixFmtDescriptor *desc, *odesc;
+} ThreadData;
+
+static int tonemap_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    TonemapContext *s = ctx->priv;
+    ThreadData *td = arg;
+    AVFrame *in = td->in, *out = td->out;
+    const AVPixFmtDescriptor *desc = td->desc, *odesc = td->odesc;
+    const int slice_start = (out->height *  jobnr)      / nb_jobs;
+    const int slice_end   = (out->height * (jobnr + 1)) / nb_jobs;
+    int x, y, i;
+
+    for (y = slice_start; y < slice_end; y++) {
+        float *dst[3];
+        const float *src[3];
+
+        for (i = 0; i < 3; i++) {
+            dst[i] = (float *)(out->data[i] + y * out->linesize[i]);
+            src[i] = (const float *)(in->data[i] + y * in->linesize[i]);
+        }
+
+        x = s->dsp.tonemap_row(dst, src, out->width, &s->params);
+        if (x < out->width) {
+            for (i = 0; i < 3; i++) {
+                dst[i] += x;
+                src[i] += x;
+            }
+            tonemap_row_c(dst, src, out->width - x, &s->params);
+        }
+    }
+
+    /* copy/generate alpha if needed */
+    if (desc->flags & AV_PIX_FMT_FLAG_ALPHA && odesc->flags & AV_PIX_FMT_FLAG_ALPHA) {
+        av_image_copy_plane(out->data[3] + slice_start * out->linesize[3], out->linesize[3],
+                            in->data[3] + slice_start * in->linesize[3], in->linesize[3],
+                            out->linesize[3], slice_end - slice_start);
+    } else if (odesc->flags & AV_PIX_FMT_FLAG_ALPHA) {
+        for (y = slice_start; y < slice_end; y++) {
+            for (x = 0; x < out->width; x++) {
+                AV_WN32(out->data[3] + x * odesc->comp[3].step + y * out->linesize[3],
+                        av_float2int(1.0f));
+            }
+        }
+    }
+
+    return 0;
+}
+
 static int filter_frame(AVFilterLink *link, AVFrame *in)
 {
-    TonemapContext *s = link->dst->priv;
-    AVFilterLink *outlink = link->dst->outputs[0];
+    AVFilterContext *ctx = link->dst;
+    TonemapContext *s = ctx->priv;
+    AVFilterLink *outlink = ctx->outputs[0];
     AVFrame *out;
     const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(link->format);
     const AVPixFmtDescriptor *odesc = av_pix_fmt_desc_get(outlink->format);
-    int ret, x, y;
+    ThreadData td;
+    double luma[3];
+    int ret;
     double peak = s->peak;
 
     if (!desc || !odesc) {
@@ -276,24 +410,21 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
         s->desat = 0;
     }
 
-    /* do the tone map */
-    for (y = 0; y < out->height; y++)
-        for (x = 0; x < out->width; x++)
-            tonemap(s, out, in, desc, x, y, peak);
+    /* luma[i] weights plane i. The planes are in G, B, R order, but the
+     * filter has always weighted them with the R, B and G coefficients,
+     * which is kept here. */
+    luma[0] = s->coeffs->cr;
+    luma[1] = s->coeffs->cb;
+    luma[2] = s->coeffs->cg;
+    ff_tonemap_params_init(&s->params, s->tonemap, s->param, s->desat, peak, luma);
 
-    /* copy/generate alpha if needed */
-    if (desc->flags & AV_PIX_FMT_FLAG_ALPHA && odesc->flags & AV_PIX_FMT_FLAG_ALPHA) {
-        av_image_copy_plane(out->data[3], out->linesize[3],
-                            in->data[3], in->linesize[3],
-                            out->linesize[3], outlink->h);
-    } else if (odesc->flags & AV_PIX_FMT_FLAG_ALPHA) {
-        for (y = 0; y < out->height; y++) {
-            for (x = 0; x < out->width; x++) {
-                AV_WN32(out->data[3] + x * odesc->comp[3].step + y * out->linesize[3],
-                        av_float2int(1.0f));
-            }
-        }
-    }
+    /* do the tone map */
+    td.in    = in;
+    td.out   = out;
+    td.desc  = desc;
+    td.odesc = odesc;
+    ctx->internal->execute(ctx, tonemap_slice, &td, NULL,
+                           FFMIN(out->height, ff_filter_get_nb_threads(ctx)));
 
     av_frame_free(&in);
 
@@ -351,4 +482,5 @@ AVFilter ff_vf_tonemap = {
     .priv_class      = &tonemap_class,
     .inputs          = tonemap_inputs,
     .outputs         = tonemap_outputs,
+    .flags           = AVFILTER_FLAG_SLICE_THREADS,
 };
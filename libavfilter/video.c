@@ -35,6 +35,10 @@
 
 #define BUFFER_ALIGN 32
 
+/* the largest padding of the dimensions by avcodec_align_dimensions2():
+ * an alignment to 64 and 2 extra lines */
+#define POOL_PADDING (64 + 2)
+
 
 AVFrame *ff_null_get_video_buffer(AVFilterLink *link, int w, int h)
 {
@@ -47,12 +51,13 @@ AVFrame *ff_default_get_video_buffer(AVFilterLink *link, int w, int h)
     int pool_height = 0;
     int pool_align = 0;
     enum AVPixelFormat pool_format = AV_PIX_FMT_NONE;
+    AVFrame *frame;
 
     if (link->hw_frames_ctx &&
         ((AVHWFramesContext*)link->hw_frames_ctx->data)->format == link->format) {
         int ret;
-        AVFrame *frame = av_frame_alloc();
 
+        frame = av_frame_alloc();
         if (!frame)
             return NULL;
 
@@ -75,7 +80,14 @@ AVFrame *ff_default_get_video_buffer(AVFilterLink *link, int w, int h)
             return NULL;
         }
 
-        if (pool_width != w || pool_height != h ||
+        /* a pool of larger frames also serves smaller requests, so that
+         * callers asking for padded and unpadded frames on the same link,
+         * e.g. a decoder writing into filter buffers, share one pool; it is
+         * only kept while its frames exceed the link size by no more than
+         * that padding, so that it shrinks with the frame size */
+        if (pool_width < w || pool_height < h ||
+            pool_width  > FFMAX(w, link->w) + POOL_PADDING ||
+            pool_height > FFMAX(h, link->h) + POOL_PADDING ||
             pool_format != link->format || pool_align != BUFFER_ALIGN) {
 
             ff_frame_pool_uninit((FFFramePool **)&link->frame_pool);
@@ -86,7 +98,14 @@ AVFrame *ff_default_get_video_buffer(AVFilterLink *link, int w, int h)
         }
     }
 
-    return ff_frame_pool_get(link->frame_pool);
+    frame = ff_frame_pool_get(link->frame_pool);
+    if (!frame)
+        return NULL;
+
+    frame->width  = w;
+    frame->height = h;
+
+    return frame;
 }
 
 AVFrame *ff_get_video_buffer(AVFilterLink *link, int w, int h)
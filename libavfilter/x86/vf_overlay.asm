@@ -0,0 +1,161 @@
+;*****************************************************************************
+;* x86-optimized functions for overlay filter
+;*
+;* This file is part of FFmpeg.
+;*
+;* FFmpeg is free software; you can redistribute it and/or
+;* modify it under the terms of the GNU Lesser General Public
+;* License as published by the Free Software Foundation; either
+;* version 2.1 of the License, or (at your option) any later version.
+;*
+;* FFmpeg is distributed in the hope that it will be useful,
+;* but WITHOUT ANY WARRANTY; without even the implied warranty of
+;* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+;* Lesser General Public License for more details.
+;*
+;* You should have received a copy of the GNU Lesser General Public
+;* License along with FFmpeg; if not, write to the Free Software
+;* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+;******************************************************************************
+
+%include "libavutil/x86/x86util.asm"
+
+SECTION_RODATA
+
+ps_1:     times 4 dd 1.0
+ps_65025: times 4 dd 65025.0
+pd_bcast: times 4 dd 0x01010101
+pw_128:   times 8 dw 128
+pw_255:   times 8 dw 255
+pw_257:   times 8 dw 257
+pb_1:     times 16 db 1
+
+SECTION .text
+
+; d = (d * (255 - a) + s * a) / 255, rounded to nearest like FAST_DIV255()
+%macro BLEND 6 ; d, s, a (clobbered), pw_255, pw_128, pw_257
+    pmullw          %2, %3               ; s * a
+    pxor            %3, %4               ; 255 - a
+    pmullw          %1, %3               ; d * (255 - a)
+    paddw           %1, %2
+    paddw           %1, %5
+    pmulhuw         %1, %6               ; ((x + 128) * 257) >> 16
+%endmacro
+
+; int ff_overlay_row_4xx(uint8_t *d, const uint8_t *s, const uint8_t *a,
+;                        ptrdiff_t alinesize, int w)
+%macro OVERLAY_ROW 2
+cglobal overlay_row_%1, 5, 6, %2, d, s, a, alinesize, w, x
+    movsxdifnidn    wq, wd
+    and             wq, ~(mmsize/2 - 1)
+    jz .end
+%ifidn %1, 420
+    add     alinesizeq, aq
+%endif
+    mova            m3, [pw_255]
+    mova            m4, [pw_128]
+    mova            m5, [pw_257]
+%ifnidn %1, 444
+    mova            m6, [pb_1]
+%endif
+    xor             xq, xq
+
+.loop:
+%ifidn %1, 444
+    pmovzxbw        m2, [aq + xq]
+%elifidn %1, 422
+    movu            m2, [aq + 2*xq]
+    pand            m7, m3, m2           ; a[2*k]
+    pmaddubsw       m2, m6               ; a[2*k] + a[2*k+1]
+    psrlw           m2, 1
+    paddw           m2, m7
+    psrlw           m2, 1
+%else
+    movu            m2, [aq + 2*xq]
+    movu            m7, [alinesizeq + 2*xq]
+    pmaddubsw       m2, m6
+    pmaddubsw       m7, m6
+    paddw           m2, m7
+    psrlw           m2, 2                ; average of the 2x2 alpha block
+%endif
+    pmovzxbw        m0, [dq + xq]
+    pmovzxbw        m1, [sq + xq]
+    BLEND           m0, m1, m2, m3, m4, m5
+    packuswb        m0, m0
+    movh   [dq + xq], m0
+    add             xq, mmsize/2
+    cmp             xq, wq
+    jl .loop
+
+.end:
+    mov            eax, wd
+    RET
+%endmacro
+
+INIT_XMM sse4
+OVERLAY_ROW 444, 6
+OVERLAY_ROW 422, 8
+OVERLAY_ROW 420, 8
+
+; int ff_overlay_row_rgba(uint8_t *d, const uint8_t *s, int w, int alpha_pos)
+cglobal overlay_row_rgba, 4, 5, 8, d, s, w, apos, x
+    movsxdifnidn    wq, wd
+    and             wq, ~3
+    jz .end
+    shl          aposd, 3
+    movd            m7, aposd            ; alpha shift
+    pcmpeqb         m6, m6
+    psrld           m6, 24
+    pslld           m6, m7               ; alpha byte mask
+    xor             xq, xq
+
+.loop:
+    movu            m0, [dq + 4*xq]
+    movu            m1, [sq + 4*xq]
+
+    ; unpremultiplied alpha: 255 * 255 * x / (255 * (x + y) - x * y), with
+    ; x the overlay alpha and y the main alpha; single precision division
+    ; truncates exactly for these operands
+    pand            m2, m1, m6
+    psrld           m2, m7               ; x
+    pand            m3, m0, m6
+    psrld           m3, m7               ; y
+    paddd           m4, m2, m3
+    pmulld          m3, m2               ; x * y
+    mova            m5, m4
+    pslld           m4, 8
+    psubd           m4, m5
+    psubd           m4, m3               ; 255 * (x + y) - x * y
+    cvtdq2ps        m4, m4
+    maxps           m4, [ps_1]           ; x = y = 0 gives 0 / 1
+    cvtdq2ps        m3, m2
+    mulps           m3, [ps_65025]
+    divps           m3, m4
+    cvttps2dq       m3, m3
+
+    ; colour bytes are weighted by the unpremultiplied alpha, the alpha byte
+    ; is composited as y + x * (255 - y) / 255 by blending 255 with weight x
+    pmulld          m3, [pd_bcast]
+    pand            m2, m1, m6
+    pandn           m4, m6, m3
+    por             m4, m2               ; weights
+    por             m1, m6
+
+    pmovzxbw        m2, m0
+    pmovzxbw        m3, m1
+    pmovzxbw        m5, m4
+    BLEND           m2, m3, m5, [pw_255], [pw_128], [pw_257]
+    pxor            m5, m5
+    punpckhbw       m0, m5
+    punpckhbw       m1, m5
+    punpckhbw       m4, m5
+    BLEND           m0, m1, m4, [pw_255], [pw_128], [pw_257]
+    packuswb        m2, m0
+    movu [dq + 4*xq], m2
+    add             xq, 4
+    cmp             xq, wq
+    jl .loop
+
+.end:
+    mov            eax, wd
+    RET
@@ -0,0 +1,42 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavutil/attributes.h"
+#include "libavutil/cpu.h"
+#include "libavutil/x86/cpu.h"
+#include "libavfilter/overlay.h"
+
+int ff_overlay_row_444_sse4(uint8_t *d, const uint8_t *s, const uint8_t *a,
+                            ptrdiff_t alinesize, int w);
+int ff_overlay_row_422_sse4(uint8_t *d, const uint8_t *s, const uint8_t *a,
+                            ptrdiff_t alinesize, int w);
+int ff_overlay_row_420_sse4(uint8_t *d, const uint8_t *s, const uint8_t *a,
+                            ptrdiff_t alinesize, int w);
+int ff_overlay_row_rgba_sse4(uint8_t *d, const uint8_t *s, int w, int alpha_pos);
+
+av_cold void ff_overlay_dsp_init_x86(OverlayDSPContext *dsp)
+{
+    int cpu_flags = av_get_cpu_flags();
+
+    if (EXTERNAL_SSE4(cpu_flags)) {
+        dsp->blend_row_444  = ff_overlay_row_444_sse4;
+        dsp->blend_row_422  = ff_overlay_row_422_sse4;
+        dsp->blend_row_420  = ff_overlay_row_420_sse4;
+        dsp->blend_row_rgba = ff_overlay_row_rgba_sse4;
+    }
+}
@@ -0,0 +1,141 @@
+;*****************************************************************************
+;* x86-optimized functions for tonemap filter
+;*
+;* This file is part of FFmpeg.
+;*
+;* FFmpeg is free software; you can redistribute it and/or
+;* modify it under the terms of the GNU Lesser General Public
+;* License as published by the Free Software Foundation; either
+;* version 2.1 of the License, or (at your option) any later version.
+;*
+;* FFmpeg is distributed in the hope that it will be useful,
+;* but WITHOUT ANY WARRANTY; without even the implied warranty of
+;* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+;* Lesser General Public License for more details.
+;*
+;* You should have received a copy of the GNU Lesser General Public
+;* License along with FFmpeg; if not, write to the Free Software
+;* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+;******************************************************************************
+
+%include "libavutil/x86/x86util.asm"
+
+SECTION_RODATA 32
+
+ps_1:   times 8 dd 1.0
+ps_eps: times 8 dd 0.000001
+
+; TonemapParams.simd, each parameter replicated over 8 lanes
+%define LUMA0     0*32
+%define LUMA1     1*32
+%define LUMA2     2*32
+%define DESAT     3*32
+%define NUM0      4*32
+%define NUM1      5*32
+%define NUM2      6*32
+%define DEN0      7*32
+%define DEN1      8*32
+%define DEN2      9*32
+%define THRESHOLD 10*32
+%define MAX       11*32
+
+SECTION .text
+
+%macro TONEMAP_LOOP 1 ; desat
+.loop_%1:
+    movu            m0, [s0q + 4*xq]
+    movu            m1, [s1q + 4*xq]
+    movu            m2, [s2q + 4*xq]
+%if %1
+    ; desaturation: mix the components with the luma, weighted by
+    ; max(luma - desat, eps) / max(luma, eps)
+    mulps           m3, m0, [pq + LUMA0]
+    mulps           m4, m2, [pq + LUMA2]
+    addps           m3, m4
+    mulps           m4, m1, [pq + LUMA1]
+    addps           m3, m4               ; luma
+    subps           m4, m3, [pq + DESAT]
+    maxps           m4, [ps_eps]
+    maxps           m5, m3, [ps_eps]
+    divps           m4, m5               ; overbright
+    mova            m5, [ps_1]
+    subps           m5, m4
+    mulps           m3, m4
+    mulps           m0, m5
+    mulps           m1, m5
+    mulps           m2, m5
+    addps           m0, m3
+    addps           m1, m3
+    addps           m2, m3
+%endif
+    maxps           m3, m0, m1
+    maxps           m3, m2
+    maxps           m3, [ps_eps]         ; sig
+
+    ; tone curve
+    mulps           m4, m3, [pq + NUM0]
+    addps           m4, [pq + NUM1]
+    mulps           m4, m3
+    addps           m4, [pq + NUM2]
+    mulps           m5, m3, [pq + DEN0]
+    addps           m5, [pq + DEN1]
+    mulps           m5, m3
+    addps           m5, [pq + DEN2]
+    divps           m4, m5
+    minps           m4, [pq + MAX]
+    cmpps           m5, m3, [pq + THRESHOLD], 2
+    andps           m6, m5, m3           ; sig <= threshold is kept as is
+    andnps          m5, m4
+    orps            m5, m6
+
+    divps           m5, m3               ; scale factor
+    mulps           m0, m5
+    mulps           m1, m5
+    mulps           m2, m5
+    movu [d0q + 4*xq], m0
+    movu [d1q + 4*xq], m1
+    movu [d2q + 4*xq], m2
+    add             xq, mmsize/4
+    cmp             xq, wq
+    jl .loop_%1
+%endmacro
+
+; int ff_tonemap_row(float *const dst[3], const float *const src[3], int w,
+;                    const TonemapParams *p)
+%macro TONEMAP_ROW 0
+cglobal tonemap_row, 4, 11, 7, dst, src, w, p, d0, d1, d2, s0, s1, s2, x
+    movsxdifnidn    wq, wd
+    and             wq, ~(mmsize/4 - 1)
+    jz .end
+    mov            d0q, [dstq]
+    mov            d1q, [dstq + gprsize]
+    mov            d2q, [dstq + 2*gprsize]
+    mov            s0q, [srcq]
+    mov            s1q, [srcq + gprsize]
+    mov            s2q, [srcq + 2*gprsize]
+    xor             xq, xq
+
+    movss          xm0, [pq + DESAT]
+    xorps          xm1, xm1
+    comiss         xm0, xm1
+    jbe .loop_0
+
+    TONEMAP_LOOP 1
+    jmp .end
+
+    TONEMAP_LOOP 0
+
+.end:
+    mov            eax, wd
+    RET
+%endmacro
+
+%if ARCH_X86_64
+INIT_XMM sse2
+TONEMAP_ROW
+
+%if HAVE_AVX_EXTERNAL
+INIT_YMM avx
+TONEMAP_ROW
+%endif
+%endif
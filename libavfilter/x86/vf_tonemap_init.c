@@ -0,0 +1,43 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavutil/attributes.h"
+#include "libavutil/cpu.h"
+#include "libavutil/x86/cpu.h"
+#include "libavfilter/tonemap.h"
+
+int ff_tonemap_row_sse2(float *const dst[3], const float *const src[3], int w,
+                        const TonemapParams *p);
+int ff_tonemap_row_avx(float *const dst[3], const float *const src[3], int w,
+                       const TonemapParams *p);
+
+av_cold void ff_tonemap_dsp_init_x86(TonemapDSPContext *dsp, enum TonemapAlgorithm algorithm)
+{
+    int cpu_flags = av_get_cpu_flags();
+
+    /* the gamma curve is not a rational function */
+    if (algorithm == TONEMAP_GAMMA)
+        return;
+
+#if ARCH_X86_64
+    if (EXTERNAL_SSE2(cpu_flags))
+        dsp->tonemap_row = ff_tonemap_row_sse2;
+    if (EXTERNAL_AVX_FAST(cpu_flags))
+        dsp->tonemap_row = ff_tonemap_row_avx;
+#endif
+}
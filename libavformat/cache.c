@@ -23,16 +23,21 @@
 
 /**
  * @TODO
- *      support keeping files
  *      support filling with a background thread
  */
 
 #include "libavutil/avassert.h"
 #include "libavutil/avstring.h"
 #include "libavutil/internal.h"
+#include "libavutil/md5.h"
 #include "libavutil/opt.h"
+#include "libavutil/random_seed.h"
+#include "libavutil/thread.h"
 #include "libavutil/tree.h"
 #include "avformat.h"
+#if HAVE_DIRENT_H
+#include <dirent.h>
+#endif
 #include <fcntl.h>
 #if HAVE_IO_H
 #include <io.h>
@@ -42,19 +47,89 @@
 #endif
 #include <sys/stat.h>
 #include <stdlib.h>
+#include "internal.h"
 #include "os_support.h"
 #include "url.h"
 
+/*
+ * The input is cached in blocks of block_size bytes, in two tiers: a
+ * memory tier and a disk tier, which is either an anonymous temporary file
+ * or a directory keeping the blocks of each input across opens. Each tier
+ * can be bounded, the least recently used blocks are evicted first.
+ *
+ * The blocks of a cache directory are tracked in a CacheDir shared by all
+ * the opens using the directory, so that they share its size bound. The
+ * blocks of an input are kept in a subdirectory named after the URL, the
+ * block size and the version of the input, its size, modification time and
+ * entity tag, so that the blocks of an input which changed are not reused.
+ */
+
+enum CacheTier {
+    TIER_MEM,
+    TIER_DISK,
+    TIER_NB,
+};
+
 typedef struct CacheEntry {
-    int64_t logical_pos;
-    int64_t physical_pos;
-    int size;
+    int64_t index;          ///< number of the block in the input
+    int size;               ///< less than block_size only for the last block
+    uint8_t *data;          ///< memory tier copy, or NULL
+    int64_t physical_pos;   ///< position in the temporary file, or -1
+    struct CacheEntry *prev[TIER_NB], *next[TIER_NB]; ///< LRU lists, most recent first
 } CacheEntry;
 
+typedef struct CacheSubdir {
+    char *name;             ///< blocks of one version of an input
+    int refs;               ///< opens storing their blocks in it
+    struct CacheSubdir *next;
+} CacheSubdir;
+
+typedef struct DirBlock {
+    CacheSubdir *subdir;
+    int64_t index;
+    int size;
+    struct DirBlock *prev, *next; ///< LRU list, most recent first
+} DirBlock;
+
+typedef struct CacheDir {
+    char *path;
+    int refs;               ///< opens using the directory
+    CacheSubdir *subdirs;
+    struct AVTreeNode *root; ///< DirBlock by subdirectory and index
+    DirBlock *lru_head, *lru_tail;
+    int64_t used;
+    struct CacheDir *next;
+} CacheDir;
+
+/* cache_dirs_lock protects the CacheDir list and the CacheDir contents */
+static AVOnce cache_dirs_once = AV_ONCE_INIT;
+static AVMutex cache_dirs_lock;
+static CacheDir *cache_dirs;
+
+static void init_cache_dirs_lock(void)
+{
+    ff_mutex_init(&cache_dirs_lock, NULL);
+}
+
+static void lock_cache_dirs(void)
+{
+    ff_thread_once(&cache_dirs_once, init_cache_dirs_lock);
+    ff_mutex_lock(&cache_dirs_lock);
+}
+
 typedef struct Context {
     AVClass *class;
     int fd;
+    char *dir;
+    CacheDir *shared;
+    CacheSubdir *subdir;
     struct AVTreeNode *root;
+    CacheEntry *lru_head[TIER_NB], *lru_tail[TIER_NB];
+    int64_t used[TIER_NB];
+    int64_t *free_slots;
+    unsigned int free_slots_size;
+    int nb_free_slots;
+    int64_t file_end;
     int64_t logical_pos;
     int64_t cache_pos;
     int64_t inner_pos;
@@ -62,160 +137,911 @@ typedef struct Context {
     int is_true_eof;
     URLContext *inner;
     int64_t cache_hit, cache_miss;
+
+    /* block the reads are served from */
+    uint8_t *block;
+    const uint8_t *cur;
+    int cur_size;
+    int cur_error;
+    int cur_partial;        ///< the block is still being read from the input
+    int64_t cur_index;
+
     int read_ahead_limit;
+    int block_size;
+    int64_t mem_size;
+    int64_t disk_size;
+    char *cache_dir;
 } Context;
 
 static int cmp(const void *key, const void *node)
 {
-    return FFDIFFSIGN(*(const int64_t *)key, ((const CacheEntry *) node)->logical_pos);
+    return FFDIFFSIGN(*(const int64_t *)key, ((const CacheEntry *) node)->index);
 }
 
-static int cache_open(URLContext *h, const char *arg, int flags, AVDictionary **options)
+static int in_tier(const CacheEntry *e, enum CacheTier tier)
 {
-    char *buffername;
-    Context *c= h->priv_data;
+    return tier == TIER_MEM ? !!e->data : e->physical_pos >= 0;
+}
 
-    av_strstart(arg, "cache:", &arg);
+static void lru_remove(Context *c, CacheEntry *e, enum CacheTier tier)
+{
+    if (e->prev[tier])
+        e->prev[tier]->next[tier] = e->next[tier];
+    else
+        c->lru_head[tier] = e->next[tier];
+    if (e->next[tier])
+        e->next[tier]->prev[tier] = e->prev[tier];
+    else
+        c->lru_tail[tier] = e->prev[tier];
+    e->prev[tier] = e->next[tier] = NULL;
+}
+
+static void lru_insert(Context *c, CacheEntry *e, enum CacheTier tier)
+{
+    e->prev[tier] = NULL;
+    e->next[tier] = c->lru_head[tier];
+    if (c->lru_head[tier])
+        c->lru_head[tier]->prev[tier] = e;
+    else
+        c->lru_tail[tier] = e;
+    c->lru_head[tier] = e;
+}
 
-    c->fd = avpriv_tempfile("ffcache", &buffername, 0, h);
-    if (c->fd < 0){
-        av_log(h, AV_LOG_ERROR, "Failed to create tempfile\n");
-        return c->fd;
+static void touch_entry(Context *c, CacheEntry *e)
+{
+    int tier;
+
+    for (tier = 0; tier < TIER_NB; tier++) {
+        if (in_tier(e, tier) && c->lru_head[tier] != e) {
+            lru_remove(c, e, tier);
+            lru_insert(c, e, tier);
+        }
     }
+}
 
-    unlink(buffername);
-    av_freep(&buffername);
+static CacheEntry *add_entry(Context *c, int64_t index, int size)
+{
+    struct AVTreeNode *node = av_tree_node_alloc();
+    CacheEntry *e = av_mallocz(sizeof(*e));
 
-    return ffurl_open_whitelist(&c->inner, arg, flags, &h->interrupt_callback,
-                                options, h->protocol_whitelist, h->protocol_blacklist, h);
+    if (!e || !node) {
+        av_free(e);
+        av_free(node);
+        return NULL;
+    }
+    e->index        = index;
+    e->size         = size;
+    e->physical_pos = -1;
+    av_tree_insert(&c->root, e, cmp, &node);
+    av_assert0(!node);
+    return e;
 }
 
-static int add_entry(URLContext *h, const unsigned char *buf, int size)
+static void remove_entry(Context *c, CacheEntry *e)
+{
+    struct AVTreeNode *node = NULL;
+
+    av_assert0(!in_tier(e, TIER_MEM) && !in_tier(e, TIER_DISK));
+    av_tree_insert(&c->root, e, cmp, &node);
+    av_free(node);
+    av_free(e);
+}
+
+static void drop_from_tier(Context *c, CacheEntry *e, enum CacheTier tier)
+{
+    if (tier == TIER_MEM) {
+        if (c->cur == e->data)
+            c->cur_index = -1;
+        av_freep(&e->data);
+        c->used[TIER_MEM] -= e->size;
+    } else {
+        int64_t *slots = av_fast_realloc(c->free_slots, &c->free_slots_size,
+                                         (c->nb_free_slots + 1) * sizeof(*slots));
+        /* on allocation failure the slot is not reused, the file grows */
+        if (slots) {
+            c->free_slots = slots;
+            c->free_slots[c->nb_free_slots++] = e->physical_pos;
+        }
+        e->physical_pos = -1;
+        c->used[TIER_DISK] -= c->block_size;
+    }
+    lru_remove(c, e, tier);
+    if (!in_tier(e, TIER_MEM) && !in_tier(e, TIER_DISK))
+        remove_entry(c, e);
+}
+
+/**
+ * Make room for size bytes in a tier, evicting the least recently used
+ * blocks.
+ */
+static void evict(Context *c, enum CacheTier tier, int size)
+{
+    int64_t limit = tier == TIER_MEM ? c->mem_size : c->disk_size;
+
+    while (limit > 0 && c->used[tier] + size > limit && c->lru_tail[tier])
+        drop_from_tier(c, c->lru_tail[tier], tier);
+}
+
+/* The functions below working on a CacheDir must be called with
+ * cache_dirs_lock held. */
+
+static int cmp_dir_block(const void *key, const void *node)
+{
+    const DirBlock *a = key, *b = node;
+
+    if (a->subdir != b->subdir)
+        return FFDIFFSIGN((uintptr_t)a->subdir, (uintptr_t)b->subdir);
+    return FFDIFFSIGN(a->index, b->index);
+}
+
+static void dir_block_path(const CacheDir *d, const CacheSubdir *s,
+                           int64_t index, char *buf, int size)
+{
+    snprintf(buf, size, "%s/%s/%"PRIx64".blk", d->path, s->name, index);
+}
+
+static void dir_lru_remove(CacheDir *d, DirBlock *b)
+{
+    if (b->prev)
+        b->prev->next = b->next;
+    else
+        d->lru_head = b->next;
+    if (b->next)
+        b->next->prev = b->prev;
+    else
+        d->lru_tail = b->prev;
+    b->prev = b->next = NULL;
+}
+
+static void dir_lru_insert(CacheDir *d, DirBlock *b)
+{
+    b->prev = NULL;
+    b->next = d->lru_head;
+    if (d->lru_head)
+        d->lru_head->prev = b;
+    else
+        d->lru_tail = b;
+    d->lru_head = b;
+}
+
+static int dir_insert_block(CacheDir *d, DirBlock *b)
+{
+    struct AVTreeNode *node = av_tree_node_alloc();
+
+    if (!node)
+        return AVERROR(ENOMEM);
+    av_tree_insert(&d->root, b, cmp_dir_block, &node);
+    av_assert0(!node);
+    dir_lru_insert(d, b);
+    d->used += b->size;
+    return 0;
+}
+
+static DirBlock *dir_add_block(CacheDir *d, CacheSubdir *s, int64_t index, int size)
+{
+    DirBlock *b = av_mallocz(sizeof(*b));
+
+    if (!b)
+        return NULL;
+    b->subdir = s;
+    b->index  = index;
+    b->size   = size;
+    if (dir_insert_block(d, b) < 0) {
+        av_free(b);
+        return NULL;
+    }
+    return b;
+}
+
+/**
+ * Forget a block, and delete its file if unlink_file is set.
+ */
+static void dir_drop_block(CacheDir *d, DirBlock *b, int unlink_file)
 {
-    Context *c= h->priv_data;
-    int64_t pos = -1;
-    int ret;
-    CacheEntry *entry = NULL, *next[2] = {NULL, NULL};
-    CacheEntry *entry_ret;
     struct AVTreeNode *node = NULL;
 
-    //FIXME avoid lseek
-    pos = lseek(c->fd, 0, SEEK_END);
-    if (pos < 0) {
+    if (unlink_file) {
+        char path[1024];
+        dir_block_path(d, b->subdir, b->index, path, sizeof(path));
+        unlink(path);
+    }
+    dir_lru_remove(d, b);
+    av_tree_insert(&d->root, b, cmp_dir_block, &node);
+    av_free(node);
+    d->used -= b->size;
+    av_free(b);
+}
+
+/**
+ * Make room for size bytes in a cache directory, evicting the least
+ * recently used blocks of all the inputs.
+ */
+static void dir_evict(CacheDir *d, int64_t limit, int size)
+{
+    while (limit > 0 && d->used + size > limit && d->lru_tail)
+        dir_drop_block(d, d->lru_tail, 1);
+}
+
+/**
+ * Look for a block of the input, also on disk in case another process
+ * stored it.
+ */
+static DirBlock *dir_find_block(Context *c, int64_t index)
+{
+    DirBlock key = { .subdir = c->subdir, .index = index };
+    DirBlock *b = av_tree_find(c->shared->root, &key, cmp_dir_block, NULL);
+    char path[1024];
+    struct stat st;
+
+    if (b)
+        return b;
+    dir_block_path(c->shared, c->subdir, index, path, sizeof(path));
+    if (stat(path, &st) < 0 || st.st_size <= 0 || st.st_size > c->block_size)
+        return NULL;
+    return dir_add_block(c->shared, c->subdir, index, st.st_size);
+}
+
+static CacheSubdir *get_subdir(CacheDir *d, const char *name)
+{
+    CacheSubdir *s;
+
+    for (s = d->subdirs; s; s = s->next)
+        if (!strcmp(s->name, name))
+            return s;
+    if (!(s = av_mallocz(sizeof(*s))) || !(s->name = av_strdup(name))) {
+        av_free(s);
+        return NULL;
+    }
+    s->next    = d->subdirs;
+    d->subdirs = s;
+    return s;
+}
+
+#if HAVE_DIRENT_H
+typedef struct FoundBlock {
+    int64_t mtime;
+    DirBlock *block;
+} FoundBlock;
+
+static int cmp_mtime(const void *a, const void *b)
+{
+    return FFDIFFSIGN(((const FoundBlock *)a)->mtime, ((const FoundBlock *)b)->mtime);
+}
+
+/**
+ * Find the blocks left by the previous opens, the most recently written
+ * ones are considered the most recently used.
+ */
+static int scan_cache_dir(CacheDir *d)
+{
+    FoundBlock *found = NULL;
+    unsigned found_size = 0;
+    int nb_found = 0, i, ret = 0;
+    struct dirent *de;
+    DIR *dir;
+
+    if (!(dir = opendir(d->path)))
+        return AVERROR(errno);
+    while (ret >= 0 && (de = readdir(dir))) {
+        CacheSubdir *s = NULL;
+        char path[1024];
+        struct dirent *be;
+        DIR *subdir;
+
+        if (de->d_name[0] == '.')
+            continue;
+        snprintf(path, sizeof(path), "%s/%s", d->path, de->d_name);
+        if (!(subdir = opendir(path)))
+            continue;
+        while ((be = readdir(subdir))) {
+            FoundBlock *tmp;
+            struct stat st;
+            char *end;
+            int64_t index = strtoll(be->d_name, &end, 16);
+
+            if (end == be->d_name || strcmp(end, ".blk"))
+                continue;
+            snprintf(path, sizeof(path), "%s/%s/%s", d->path, de->d_name, be->d_name);
+            if (stat(path, &st) < 0 || st.st_size <= 0 || st.st_size > INT_MAX)
+                continue;
+            if ((!s && !(s = get_subdir(d, de->d_name))) ||
+                !(tmp = av_fast_realloc(found, &found_size,
+                                        (nb_found + 1) * sizeof(*found)))) {
+                ret = AVERROR(ENOMEM);
+                break;
+            }
+            found = tmp;
+            if (!(found[nb_found].block = av_mallocz(sizeof(DirBlock)))) {
+                ret = AVERROR(ENOMEM);
+                break;
+            }
+            found[nb_found].mtime = st.st_mtime;
+            found[nb_found].block->subdir = s;
+            found[nb_found].block->index  = index;
+            found[nb_found].block->size   = st.st_size;
+            nb_found++;
+        }
+        closedir(subdir);
+    }
+    closedir(dir);
+
+    qsort(found, nb_found, sizeof(*found), cmp_mtime);
+    for (i = 0; i < nb_found; i++) {
+        if (ret >= 0 && (ret = dir_insert_block(d, found[i].block)) >= 0)
+            continue;
+        av_free(found[i].block);
+    }
+    av_free(found);
+    return ret;
+}
+#endif
+
+static int enu_free_dir_block(void *opaque, void *elem)
+{
+    av_free(elem);
+    return 0;
+}
+
+static void cache_dir_unref(CacheDir *d)
+{
+    CacheDir **p;
+
+    if (--d->refs)
+        return;
+    for (p = &cache_dirs; *p != d; p = &(*p)->next)
+        ;
+    *p = d->next;
+    av_tree_enumerate(d->root, NULL, NULL, enu_free_dir_block);
+    av_tree_destroy(d->root);
+    while (d->subdirs) {
+        CacheSubdir *s = d->subdirs;
+        d->subdirs = s->next;
+        av_free(s->name);
+        av_free(s);
+    }
+    av_free(d->path);
+    av_free(d);
+}
+
+static CacheDir *cache_dir_ref(const char *path)
+{
+    CacheDir *d;
+
+    for (d = cache_dirs; d; d = d->next) {
+        if (!strcmp(d->path, path)) {
+            d->refs++;
+            return d;
+        }
+    }
+    if (!(d = av_mallocz(sizeof(*d))) || !(d->path = av_strdup(path))) {
+        av_free(d);
+        return NULL;
+    }
+    d->refs    = 1;
+    d->next    = cache_dirs;
+    cache_dirs = d;
+#if HAVE_DIRENT_H
+    if (scan_cache_dir(d) < 0) {
+        cache_dir_unref(d);
+        return NULL;
+    }
+#endif
+    return d;
+}
+
+/**
+ * Delete the blocks of the other versions of an input, unless they are
+ * used by another open.
+ */
+static void remove_other_versions(CacheDir *d, CacheSubdir *cur, const char *prefix)
+{
+    DirBlock *b, *next;
+    CacheSubdir *s;
+
+    for (b = d->lru_head; b; b = next) {
+        next = b->next;
+        if (b->subdir != cur && !b->subdir->refs &&
+            av_strstart(b->subdir->name, prefix, NULL))
+            dir_drop_block(d, b, 1);
+    }
+    for (s = d->subdirs; s; s = s->next) {
+        if (s != cur && !s->refs && av_strstart(s->name, prefix, NULL)) {
+            char path[1024];
+            snprintf(path, sizeof(path), "%s/%s", d->path, s->name);
+            rmdir(path);
+        }
+    }
+}
+
+static void block_path(Context *c, int64_t index, char *buf, int size)
+{
+    snprintf(buf, size, "%s/%"PRIx64".blk", c->dir, index);
+}
+
+static int write_full(int fd, const uint8_t *buf, int size)
+{
+    while (size > 0) {
+        int ret = write(fd, buf, size);
+        if (ret < 0)
+            return AVERROR(errno);
+        buf  += ret;
+        size -= ret;
+    }
+    return 0;
+}
+
+static int read_full(int fd, uint8_t *buf, int size)
+{
+    int done = 0;
+
+    while (done < size) {
+        int ret = read(fd, buf + done, size - done);
+        if (ret < 0)
+            return AVERROR(errno);
+        if (!ret)
+            break;
+        done += ret;
+    }
+    return done;
+}
+
+static int store_in_dir(URLContext *h, int64_t index, const uint8_t *data, int size)
+{
+    Context *c = h->priv_data;
+    char path[1024], tmp[1040];
+    DirBlock *b;
+    int fd, ret;
+
+    block_path(c, index, path, sizeof(path));
+    /* other opens of the input may share the directory, a block file
+     * appears only when complete */
+    snprintf(tmp, sizeof(tmp), "%s.%08x.tmp", path, av_get_random_seed());
+    fd = avpriv_open(tmp, O_WRONLY | O_CREAT | O_EXCL
+#ifdef O_BINARY
+                     | O_BINARY
+#endif
+                     , 0666);
+    if (fd < 0)
+        return AVERROR(errno);
+    ret = write_full(fd, data, size);
+    close(fd);
+    if (ret >= 0 && rename(tmp, path) < 0)
         ret = AVERROR(errno);
-        av_log(h, AV_LOG_ERROR, "seek in cache failed\n");
-        goto fail;
+    if (ret < 0) {
+        unlink(tmp);
+        return ret;
+    }
+
+    lock_cache_dirs();
+    if (!(b = dir_find_block(c, index))) {
+        ret = AVERROR(ENOMEM);
+    } else {
+        dir_lru_remove(c->shared, b);
+        dir_lru_insert(c->shared, b);
+        dir_evict(c->shared, c->disk_size, 0);
     }
+    ff_mutex_unlock(&cache_dirs_lock);
+    return ret;
+}
+
+static int store_in_file(URLContext *h, CacheEntry *e, const uint8_t *data)
+{
+    Context *c = h->priv_data;
+    int64_t pos;
+    int ret;
+
+    evict(c, TIER_DISK, c->block_size);
+    pos = c->nb_free_slots ? c->free_slots[--c->nb_free_slots] : c->file_end;
+    if (lseek(c->fd, pos, SEEK_SET) < 0)
+        return AVERROR(errno);
     c->cache_pos = pos;
+    if ((ret = write_full(c->fd, data, e->size)) < 0) {
+        c->cache_pos = -1;
+        return ret;
+    }
+    c->cache_pos += e->size;
+    c->file_end = FFMAX(c->file_end, pos + c->block_size);
+    e->physical_pos = pos;
+    c->used[TIER_DISK] += c->block_size;
+    lru_insert(c, e, TIER_DISK);
+    return 0;
+}
 
-    ret = write(c->fd, buf, size);
-    if (ret < 0) {
+static int store_in_memory(Context *c, CacheEntry *e, const uint8_t *data)
+{
+    if (e->size > c->mem_size)
+        return 0;
+    evict(c, TIER_MEM, e->size);
+    if (!(e->data = av_memdup(data, e->size)))
+        return AVERROR(ENOMEM);
+    c->used[TIER_MEM] += e->size;
+    lru_insert(c, e, TIER_MEM);
+    return 0;
+}
+
+/**
+ * Load a block from the temporary file in the block buffer.
+ */
+static int load_from_file(URLContext *h, CacheEntry *e)
+{
+    Context *c = h->priv_data;
+    int ret;
+
+    if (c->cache_pos != e->physical_pos &&
+        lseek(c->fd, e->physical_pos, SEEK_SET) < 0) {
+        c->cache_pos = -1;
+        return AVERROR(errno);
+    }
+    c->cache_pos = e->physical_pos;
+    ret = read_full(c->fd, c->block, e->size);
+    c->cache_pos = ret < 0 ? -1 : c->cache_pos + ret;
+    if (ret >= 0 && ret != e->size)
+        ret = AVERROR_INVALIDDATA;
+    return ret;
+}
+
+/**
+ * Load a block from the cache directory in the block buffer.
+ *
+ * @return the size of the block, or a negative error code
+ */
+static int load_from_dir(URLContext *h, int64_t index)
+{
+    Context *c = h->priv_data;
+    char path[1024];
+    DirBlock *b;
+    int fd, size, ret;
+
+    lock_cache_dirs();
+    if ((b = dir_find_block(c, index))) {
+        dir_lru_remove(c->shared, b);
+        dir_lru_insert(c->shared, b);
+    }
+    size = b ? b->size : 0;
+    ff_mutex_unlock(&cache_dirs_lock);
+    if (!size)
+        return AVERROR(ENOENT);
+
+    block_path(c, index, path, sizeof(path));
+    fd = avpriv_open(path, O_RDONLY
+#ifdef O_BINARY
+                     | O_BINARY
+#endif
+                     );
+    if (fd < 0) {
         ret = AVERROR(errno);
-        av_log(h, AV_LOG_ERROR, "write in cache failed\n");
-        goto fail;
+    } else {
+        ret = read_full(fd, c->block, size);
+        close(fd);
+        if (ret >= 0 && ret != size)
+            ret = AVERROR_INVALIDDATA;
     }
-    c->cache_pos += ret;
 
-    entry = av_tree_find(c->root, &c->logical_pos, cmp, (void**)next);
+    if (ret < 0) {
+        /* the block may have been evicted by another open */
+        DirBlock key = { .subdir = c->subdir, .index = index };
 
-    if (!entry)
-        entry = next[0];
+        av_log(h, AV_LOG_WARNING, "Failed to read block from the cache\n");
+        lock_cache_dirs();
+        if ((b = av_tree_find(c->shared->root, &key, cmp_dir_block, NULL)))
+            dir_drop_block(c->shared, b, 0);
+        ff_mutex_unlock(&cache_dirs_lock);
+    }
+    return ret;
+}
 
-    if (!entry ||
-        entry->logical_pos  + entry->size != c->logical_pos ||
-        entry->physical_pos + entry->size != pos
-    ) {
-        entry = av_malloc(sizeof(*entry));
-        node = av_tree_node_alloc();
-        if (!entry || !node) {
-            ret = AVERROR(ENOMEM);
-            goto fail;
+/**
+ * Add the block in the block buffer to the memory tier, and to the disk
+ * tier if it was read from the inner protocol.
+ */
+static int store_block(URLContext *h, int64_t index, int size, int fetched)
+{
+    Context *c = h->priv_data;
+    CacheEntry *e;
+    int ret = 0;
+
+    if (fetched && c->dir && store_in_dir(h, index, c->block, size) < 0)
+        av_log(h, AV_LOG_ERROR, "write in cache failed\n");
+    if (c->mem_size <= 0 && !(fetched && c->fd >= 0))
+        return 0;
+
+    if (!(e = add_entry(c, index, size)))
+        return AVERROR(ENOMEM);
+    if (c->mem_size > 0 && (ret = store_in_memory(c, e, c->block)) < 0)
+        goto end;
+    if (fetched && c->fd >= 0 && store_in_file(h, e, c->block) < 0)
+        av_log(h, AV_LOG_ERROR, "write in cache failed\n");
+    if (e->data && c->cur_index == index)
+        c->cur = e->data;
+end:
+    if (!in_tier(e, TIER_MEM) && !in_tier(e, TIER_DISK))
+        remove_entry(c, e);
+    return ret;
+}
+
+static void serve_block(Context *c, int64_t index, const uint8_t *data, int size)
+{
+    c->cache_hit++;
+    c->end = FFMAX(c->end, index * c->block_size + size);
+    if (size < c->block_size)
+        c->is_true_eof = 1;
+    c->cur       = data;
+    c->cur_size  = size;
+    c->cur_error = size < c->block_size ? AVERROR_EOF : 0;
+    c->cur_index = index;
+}
+
+/**
+ * Finish reading the current block from the inner protocol, and cache it
+ * unless it was cut by an error.
+ */
+static int end_fetch(URLContext *h, int error)
+{
+    Context *c = h->priv_data;
+
+    c->cur_partial = 0;
+    c->cur_error   = error;
+    if (error == AVERROR_EOF)
+        c->is_true_eof = 1;
+    /* a block cut by an error is not cached, and fetched again next time */
+    if (error && error != AVERROR_EOF) {
+        c->cur_index = -1;
+        return 0;
+    }
+    return c->cur_size ? store_block(h, c->cur_index, c->cur_size, 1) : 0;
+}
+
+/**
+ * Read more of the current block from the inner protocol. A single read
+ * is done, so that the data of slow inputs is returned as it arrives.
+ */
+static int fill_block(URLContext *h)
+{
+    Context *c = h->priv_data;
+    int64_t pos = c->cur_index * c->block_size + c->cur_size;
+    int ret;
+
+    if (c->inner_pos != pos) {
+        int64_t r = ffurl_seek(c->inner, pos, SEEK_SET);
+        if (r < 0) {
+            av_log(h, AV_LOG_ERROR, "Failed to perform internal seek\n");
+            return end_fetch(h, r);
         }
-        entry->logical_pos = c->logical_pos;
-        entry->physical_pos = pos;
-        entry->size = ret;
-
-        entry_ret = av_tree_insert(&c->root, entry, cmp, &node);
-        if (entry_ret && entry_ret != entry) {
-            ret = -1;
-            av_log(h, AV_LOG_ERROR, "av_tree_insert failed\n");
-            goto fail;
+        c->inner_pos = r;
+    }
+
+    ret = ffurl_read(c->inner, c->block + c->cur_size, c->block_size - c->cur_size);
+    if (!ret)
+        ret = AVERROR_EOF;
+    if (ret < 0)
+        return end_fetch(h, ret);
+    c->cur_size  += ret;
+    c->inner_pos += ret;
+    c->end = FFMAX(c->end, pos + ret);
+    return c->cur_size == c->block_size ? end_fetch(h, 0) : 0;
+}
+
+/**
+ * Make the block at index the one the reads are served from.
+ */
+static int get_block(URLContext *h, int64_t index)
+{
+    Context *c = h->priv_data;
+    CacheEntry *e = av_tree_find(c->root, &index, cmp, NULL);
+    int ret;
+
+    c->cur_partial = 0;
+    if (e && !e->data) {
+        ret = load_from_file(h, e);
+        if (ret < 0) {
+            av_log(h, AV_LOG_WARNING, "Failed to read block from the cache\n");
+            drop_from_tier(c, e, TIER_DISK);
+            e = NULL;
+        } else if ((ret = store_in_memory(c, e, c->block)) < 0) {
+            return ret;
         }
-    } else
-        entry->size += ret;
+    }
+    if (e) {
+        touch_entry(c, e);
+        serve_block(c, index, e->data ? e->data : c->block, e->size);
+        return 0;
+    }
 
+    if (c->dir && (ret = load_from_dir(h, index)) > 0) {
+        serve_block(c, index, c->block, ret);
+        return store_block(h, index, ret, 0);
+    }
+
+    c->cache_miss++;
+    c->cur         = c->block;
+    c->cur_size    = 0;
+    c->cur_error   = 0;
+    c->cur_index   = index;
+    c->cur_partial = 1;
     return 0;
-fail:
-    //we could truncate the file to pos here if pos >=0 but ftruncate isn't available in VS so
-    //for simplicty we just leave the file a bit larger
-    av_free(entry);
-    av_free(node);
+}
+
+static int is_cached(Context *c, int64_t index)
+{
+    int ret;
+
+    if (av_tree_find(c->root, &index, cmp, NULL))
+        return 1;
+    if (!c->dir)
+        return 0;
+    lock_cache_dirs();
+    ret = !!dir_find_block(c, index);
+    ff_mutex_unlock(&cache_dirs_lock);
     return ret;
 }
 
 static int cache_read(URLContext *h, unsigned char *buf, int size)
 {
-    Context *c= h->priv_data;
-    CacheEntry *entry, *next[2] = {NULL, NULL};
-    int64_t r;
+    Context *c = h->priv_data;
+    int64_t index = c->logical_pos / c->block_size;
+    int offset = c->logical_pos % c->block_size;
+    int ret;
 
-    entry = av_tree_find(c->root, &c->logical_pos, cmp, (void**)next);
+    if (c->cur_index != index) {
+        if ((ret = get_block(h, index)) < 0)
+            return ret;
+    }
+    while (offset >= c->cur_size && c->cur_partial) {
+        if ((ret = fill_block(h)) < 0)
+            return ret;
+    }
 
-    if (!entry)
-        entry = next[0];
+    if (offset >= c->cur_size) {
+        c->cur_index = -1;
+        return c->cur_error ? c->cur_error : AVERROR_EOF;
+    }
+    size = FFMIN(size, c->cur_size - offset);
+    memcpy(buf, c->cur + offset, size);
+    c->logical_pos += size;
 
-    if (entry) {
-        int64_t in_block_pos = c->logical_pos - entry->logical_pos;
-        av_assert0(entry->logical_pos <= c->logical_pos);
-        if (in_block_pos < entry->size) {
-            int64_t physical_target = entry->physical_pos + in_block_pos;
+    return size;
+}
 
-            if (c->cache_pos != physical_target) {
-                r = lseek(c->fd, physical_target, SEEK_SET);
-            } else
-                r = c->cache_pos;
+/**
+ * Describe the version of the input from what the inner protocol tells.
+ *
+ * @return 0 if nothing is known, in which case the input cannot be cached
+ *         across opens
+ */
+static int input_version(URLContext *h, char *buf, int size)
+{
+    Context *c = h->priv_data;
+    int64_t file_size = ffurl_seek(c->inner, 0, AVSEEK_SIZE);
+    int64_t mtime = 0;
+    uint8_t *etag = NULL;
+    int fd = ffurl_get_file_handle(c->inner);
+    struct stat st;
+    int known;
 
-            if (r >= 0) {
-                c->cache_pos = r;
-                r = read(c->fd, buf, FFMIN(size, entry->size - in_block_pos));
-            }
+    /* pipes have no size and their time is the one of the last write */
+    if (fd >= 0 && !fstat(fd, &st) && S_ISREG(st.st_mode))
+        mtime = st.st_mtime;
+    av_opt_get(c->inner, "etag", AV_OPT_SEARCH_CHILDREN, &etag);
+    known = file_size > 0 || mtime || (etag && *etag);
+    snprintf(buf, size, "%"PRId64" %"PRId64" %s", file_size, mtime,
+             etag ? (char *)etag : "");
+    av_free(etag);
+    return known;
+}
 
-            if (r > 0) {
-                c->cache_pos += r;
-                c->logical_pos += r;
-                c->cache_hit ++;
-                return r;
-            }
-        }
+static int open_dir(URLContext *h, const char *url)
+{
+    Context *c = h->priv_data;
+    char version[1024], prefix[64], hex[33];
+    uint8_t md5[16];
+    int ret = 0;
+
+    if (!input_version(h, version, sizeof(version))) {
+        av_log(h, AV_LOG_VERBOSE, "The version of the input is unknown, "
+               "caching it in a temporary file\n");
+        return 0;
     }
 
-    // Cache miss or some kind of fault with the cache
+    /* the blocks of each input, block size and version are kept apart */
+    av_md5_sum(md5, url, strlen(url));
+    ff_data_to_hex(hex, md5, sizeof(md5), 1);
+    hex[32] = 0;
+    snprintf(prefix, sizeof(prefix), "%s-%d-", hex, c->block_size);
+    av_md5_sum(md5, version, strlen(version));
+    ff_data_to_hex(hex, md5, 8, 1);
+    hex[16] = 0;
+    if (!(c->dir = av_asprintf("%s/%s%s", c->cache_dir, prefix, hex)))
+        return AVERROR(ENOMEM);
 
-    if (c->logical_pos != c->inner_pos) {
-        r = ffurl_seek(c->inner, c->logical_pos, SEEK_SET);
-        if (r<0) {
-            av_log(h, AV_LOG_ERROR, "Failed to perform internal seek\n");
-            return r;
-        }
-        c->inner_pos = r;
+    if ((mkdir(c->cache_dir, 0777) < 0 && errno != EEXIST) ||
+        (mkdir(c->dir, 0777) < 0 && errno != EEXIST)) {
+        ret = AVERROR(errno);
+        av_log(h, AV_LOG_ERROR, "Failed to create cache directory %s\n", c->dir);
+        return ret;
     }
 
-    r = ffurl_read(c->inner, buf, size);
-    if (r == AVERROR_EOF && size>0) {
-        c->is_true_eof = 1;
-        av_assert0(c->end >= c->logical_pos);
+    lock_cache_dirs();
+    if (!(c->shared = cache_dir_ref(c->cache_dir))) {
+        ret = AVERROR(ENOMEM);
+    } else if (!(c->subdir = get_subdir(c->shared, c->dir + strlen(c->cache_dir) + 1))) {
+        ret = AVERROR(ENOMEM);
+    } else {
+        c->subdir->refs++;
+        remove_other_versions(c->shared, c->subdir, prefix);
+        dir_evict(c->shared, c->disk_size, 0);
     }
-    if (r<=0)
-        return r;
-    c->inner_pos += r;
+    ff_mutex_unlock(&cache_dirs_lock);
+    return ret;
+}
+
+static int enu_free(void *opaque, void *elem)
+{
+    CacheEntry *e = elem;
+    av_free(e->data);
+    av_free(e);
+    return 0;
+}
+
+static void cache_cleanup(URLContext *h)
+{
+    Context *c = h->priv_data;
+
+    if (c->fd >= 0)
+        close(c->fd);
+    ffurl_closep(&c->inner);
+    av_tree_enumerate(c->root, NULL, NULL, enu_free);
+    av_tree_destroy(c->root);
+    c->root = NULL;
+    av_freep(&c->free_slots);
+    av_freep(&c->block);
+    av_freep(&c->dir);
+    if (c->shared) {
+        lock_cache_dirs();
+        if (c->subdir)
+            c->subdir->refs--;
+        cache_dir_unref(c->shared);
+        ff_mutex_unlock(&cache_dirs_lock);
+        c->shared = NULL;
+        c->subdir = NULL;
+    }
+}
+
+static int cache_open(URLContext *h, const char *arg, int flags, AVDictionary **options)
+{
+    char *buffername;
+    Context *c= h->priv_data;
+    int ret;
 
-    c->cache_miss ++;
+    av_strstart(arg, "cache:", &arg);
+
+    c->fd        = -1;
+    c->cur_index = -1;
+    if (!(c->block = av_malloc(c->block_size)))
+        return AVERROR(ENOMEM);
+
+    ret = ffurl_open_whitelist(&c->inner, arg, flags, &h->interrupt_callback,
+                               options, h->protocol_whitelist, h->protocol_blacklist, h);
+    if (ret < 0)
+        goto fail;
+
+    if (c->cache_dir && (ret = open_dir(h, arg)) < 0)
+        goto fail;
+    if (!c->dir && c->disk_size >= 0) {
+        c->fd = avpriv_tempfile("ffcache", &buffername, 0, h);
+        if (c->fd < 0){
+            av_log(h, AV_LOG_ERROR, "Failed to create tempfile\n");
+            ret = c->fd;
+            goto fail;
+        }
 
-    add_entry(h, buf, r);
-    c->logical_pos += r;
-    c->end = FFMAX(c->end, c->logical_pos);
+        unlink(buffername);
+        av_freep(&buffername);
+    }
+    return 0;
 
-    return r;
+fail:
+    cache_cleanup(h);
+    return ret;
 }
 
 static int64_t cache_seek(URLContext *h, int64_t pos, int whence)
@@ -245,7 +1071,8 @@ resolve_eof:
         pos += c->end;
     }
 
-    if (whence == SEEK_SET && pos >= 0 && pos < c->end) {
+    if (whence == SEEK_SET && pos >= 0 &&
+        (pos < c->end || is_cached(c, pos / c->block_size))) {
         //Seems within filesize, assume it will not fail.
         c->logical_pos = pos;
         return pos;
@@ -277,18 +1104,13 @@ resolve_eof:
 
     if (ret >= 0) {
         c->logical_pos = ret;
+        c->inner_pos   = ret;
         c->end = FFMAX(c->end, ret);
     }
 
     return ret;
 }
 
-static int enu_free(void *opaque, void *elem)
-{
-    av_free(elem);
-    return 0;
-}
-
 static int cache_close(URLContext *h)
 {
     Context *c= h->priv_data;
@@ -296,10 +1118,7 @@ static int cache_close(URLContext *h)
     av_log(h, AV_LOG_INFO, "Statistics, cache hits:%"PRId64" cache misses:%"PRId64"\n",
            c->cache_hit, c->cache_miss);
 
-    close(c->fd);
-    ffurl_close(c->inner);
-    av_tree_enumerate(c->root, NULL, NULL, enu_free);
-    av_tree_destroy(c->root);
+    cache_cleanup(h);
 
     return 0;
 }
@@ -309,6 +1128,10 @@ static int cache_close(URLContext *h)
 
 static const AVOption options[] = {
     { "read_ahead_limit", "Amount in bytes that may be read ahead when seeking isn't supported, -1 for unlimited", OFFSET(read_ahead_limit), AV_OPT_TYPE_INT, { .i64 = 65536 }, -1, INT_MAX, D },
+    { "cache_block_size", "size of the cached blocks", OFFSET(block_size), AV_OPT_TYPE_INT, { .i64 = 65536 }, 4096, INT_MAX, D },
+    { "cache_mem_size", "maximum size of the memory tier, 0 to disable it", OFFSET(mem_size), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, D },
+    { "cache_disk_size", "maximum size of the disk tier, 0 for unlimited, -1 to disable it", OFFSET(disk_size), AV_OPT_TYPE_INT64, { .i64 = 0 }, -1, INT64_MAX, D },
+    { "cache_dir", "directory keeping the cached blocks across opens", OFFSET(cache_dir), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, D },
     {NULL},
 };
 
@@ -36,6 +36,7 @@
 #include "avc.h"
 #include "avformat.h"
 #include "avio_internal.h"
+#include "httppool.h"
 #include "internal.h"
 #include "isom.h"
 #include "os_support.h"
@@ -72,6 +73,10 @@ typedef struct OutputStream {
     Segment **segments;
     int64_t first_pts, start_pts, max_pts;
     int64_t last_dts;
+    int64_t chunk_start_pts, max_chunk_duration;
+    int chunk_packets;
+    int written_len;
+    char filename[1024], full_path[1024], temp_path[1024];
     int bit_rate;
     char bandwidth_str[64];
 
@@ -101,6 +106,14 @@ typedef struct DASHContext {
     const char *media_seg_name;
     const char *utc_timing_url;
     const char *user_agent;
+    int http_persistent;
+    HTTPPool *http_pool;
+    int64_t http_requests;
+    int64_t http_reused;
+    int64_t http_connections;
+    int64_t http_dropped;
+    int streaming;
+    int64_t frag_duration;
 } DASHContext;
 
 static struct codec_string {
@@ -217,6 +230,35 @@ static void set_http_options(AVDictionary **options, DASHContext *c)
         av_dict_set(options, "user_agent", c->user_agent, 0);
 }
 
+static int dashenc_io_open(AVFormatContext *s, AVIOContext **pb, const char *filename,
+                           AVDictionary **options)
+{
+    DASHContext *c = s->priv_data;
+
+    return ff_http_pool_open(c->http_pool, s, pb, filename, options);
+}
+
+static void dashenc_io_close(AVFormatContext *s, AVIOContext **pb, const char *filename)
+{
+    DASHContext *c = s->priv_data;
+
+    if (*pb && ff_http_pool_close(c->http_pool, s, pb) < 0)
+        av_log(s, AV_LOG_WARNING, "Failed to upload '%s'\n", filename);
+}
+
+static void export_http_stats(DASHContext *c)
+{
+    HTTPPoolStats stats;
+
+    if (!c->http_pool)
+        return;
+    ff_http_pool_get_stats(c->http_pool, &stats);
+    c->http_requests    = stats.requests;
+    c->http_reused      = stats.reused;
+    c->http_connections = stats.connections;
+    c->http_dropped     = stats.dropped;
+}
+
 static int flush_init_segment(AVFormatContext *s, OutputStream *os)
 {
     DASHContext *c = s->priv_data;
@@ -228,7 +270,7 @@ static int flush_init_segment(AVFormatContext *s, OutputStream *os)
 
     os->pos = os->init_range_length = range_length;
     if (!c->single_file)
-        ff_format_io_close(s, &os->out);
+        dashenc_io_close(s, &os->out, os->initfile);
     return 0;
 }
 
@@ -244,6 +286,8 @@ static void dash_free(AVFormatContext *s)
         c->nb_as = 0;
     }
 
+    ff_http_pool_free(s, &c->http_pool);
+
     if (!c->streams)
         return;
     for (i = 0; i < s->nb_streams; i++) {
@@ -262,7 +306,22 @@ static void dash_free(AVFormatContext *s)
     av_freep(&c->streams);
 }
 
-static void output_segment_list(OutputStream *os, AVIOContext *out, DASHContext *c)
+static void write_availability_time_offset(AVIOContext *out, OutputStream *os,
+                                           DASHContext *c)
+{
+    // A segment is announced as available when it is complete, the first
+    // chunk can be downloaded as soon as it has been written. Until a chunk
+    // has been measured, the chunks are assumed to last frag_duration.
+    int64_t seg_duration = c->last_duration ? c->last_duration : c->min_seg_duration;
+    int64_t chunk_duration = os->max_chunk_duration ? os->max_chunk_duration : c->frag_duration;
+    int64_t offset = FFMAX(seg_duration - chunk_duration, 0);
+
+    avio_printf(out, "availabilityTimeOffset=\"%.3f\" availabilityTimeComplete=\"false\" ",
+                offset / (double)AV_TIME_BASE);
+}
+
+static void output_segment_list(OutputStream *os, AVIOContext *out, DASHContext *c,
+                                int final)
 {
     int i, start_index = 0, start_number = 1;
     if (c->window_size) {
@@ -275,6 +334,8 @@ static void output_segment_list(OutputStream *os, AVIOContext *out, DASHContext
         avio_printf(out, "\t\t\t\t<SegmentTemplate timescale=\"%d\" ", timescale);
         if (!c->use_timeline)
             avio_printf(out, "duration=\"%"PRId64"\" ", c->last_duration);
+        if (c->streaming && !final && !strcmp(os->format_name, "mp4"))
+            write_availability_time_offset(out, os, c);
         avio_printf(out, "initialization=\"%s\" media=\"%s\" startNumber=\"%d\">\n", c->init_seg_name, c->media_seg_name, c->use_timeline ? start_number : 1);
         if (c->use_timeline) {
             int64_t cur_time = 0;
@@ -314,7 +375,10 @@ static void output_segment_list(OutputStream *os, AVIOContext *out, DASHContext
         }
         avio_printf(out, "\t\t\t\t</SegmentList>\n");
     } else {
-        avio_printf(out, "\t\t\t\t<SegmentList timescale=\"%d\" duration=\"%"PRId64"\" startNumber=\"%d\">\n", AV_TIME_BASE, c->last_duration, start_number);
+        avio_printf(out, "\t\t\t\t<SegmentList timescale=\"%d\" duration=\"%"PRId64"\" ", AV_TIME_BASE, c->last_duration);
+        if (c->streaming && !final && !strcmp(os->format_name, "mp4"))
+            write_availability_time_offset(out, os, c);
+        avio_printf(out, "startNumber=\"%d\">\n", start_number);
         avio_printf(out, "\t\t\t\t\t<Initialization sourceURL=\"%s\" />\n", os->initfile);
         for (i = start_index; i < os->nb_segments; i++) {
             Segment *seg = os->segments[i];
@@ -391,7 +455,8 @@ static void format_date_now(char *buf, int size)
     }
 }
 
-static int write_adaptation_set(AVFormatContext *s, AVIOContext *out, int as_index)
+static int write_adaptation_set(AVFormatContext *s, AVIOContext *out, int as_index,
+                                int final)
 {
     DASHContext *c = s->priv_data;
     AdaptationSet *as = &c->as[as_index];
@@ -430,7 +495,7 @@ static int write_adaptation_set(AVFormatContext *s, AVIOContext *out, int as_ind
             avio_printf(out, "\t\t\t\t<AudioChannelConfiguration schemeIdUri=\"urn:mpeg:dash:23003:3:audio_channel_configuration:2011\" value=\"%d\" />\n",
                 s->streams[i]->codecpar->channels);
         }
-        output_segment_list(os, out, c);
+        output_segment_list(os, out, c, final);
         avio_printf(out, "\t\t\t</Representation>\n");
     }
     avio_printf(out, "\t\t</AdaptationSet>\n");
@@ -589,7 +654,7 @@ static int write_manifest(AVFormatContext *s, int final)
 
     snprintf(temp_filename, sizeof(temp_filename), use_rename ? "%s.tmp" : "%s", s->filename);
     set_http_options(&opts, c);
-    ret = s->io_open(s, &out, temp_filename, AVIO_FLAG_WRITE, &opts);
+    ret = dashenc_io_open(s, &out, temp_filename, &opts);
     if (ret < 0) {
         av_log(s, AV_LOG_ERROR, "Unable to open %s for writing\n", temp_filename);
         return ret;
@@ -650,7 +715,7 @@ static int write_manifest(AVFormatContext *s, int final)
     }
 
     for (i = 0; i < c->nb_as; i++) {
-        if ((ret = write_adaptation_set(s, out, i)) < 0)
+        if ((ret = write_adaptation_set(s, out, i, final)) < 0)
             return ret;
     }
     avio_printf(out, "\t</Period>\n");
@@ -660,7 +725,7 @@ static int write_manifest(AVFormatContext *s, int final)
 
     avio_printf(out, "</MPD>\n");
     avio_flush(out);
-    ff_format_io_close(s, &out);
+    dashenc_io_close(s, &out, temp_filename);
 
     if (use_rename)
         return avpriv_io_move(temp_filename, s->filename);
@@ -688,6 +753,14 @@ static int dash_init(AVFormatContext *s)
     if (c->single_file)
         c->use_template = 0;
 
+    if (c->http_persistent && !(c->http_pool = ff_http_pool_alloc()))
+        return AVERROR(ENOMEM);
+
+    if (c->streaming && c->single_file) {
+        av_log(s, AV_LOG_WARNING, "Streaming is not supported with single_file, disabling it\n");
+        c->streaming = 0;
+    }
+
     av_strlcpy(c->dirname, s->filename, sizeof(c->dirname));
     ptr = strrchr(c->dirname, '/');
     if (ptr) {
@@ -779,14 +852,19 @@ static int dash_init(AVFormatContext *s)
         }
         snprintf(filename, sizeof(filename), "%s%s", c->dirname, os->initfile);
         set_http_options(&opts, c);
-        ret = s->io_open(s, &os->out, filename, AVIO_FLAG_WRITE, &opts);
+        ret = dashenc_io_open(s, &os->out, filename, &opts);
         if (ret < 0)
             return ret;
         av_dict_free(&opts);
         os->init_start_pos = 0;
 
         if (!strcmp(os->format_name, "mp4")) {
-            av_dict_set(&opts, "movflags", "frag_custom+dash+delay_moov", 0);
+            // In streaming mode, the segments are made of CMAF chunks,
+            // without an index
+            if (c->streaming)
+                av_dict_set(&opts, "movflags", "frag_custom+delay_moov+default_base_moof+skip_trailer", 0);
+            else
+                av_dict_set(&opts, "movflags", "frag_custom+dash+delay_moov", 0);
         } else {
             av_dict_set_int(&opts, "cluster_time_limit", c->min_seg_duration / 1000, 0);
             av_dict_set_int(&opts, "cluster_size_limit", 5 * 1024 * 1024, 0); // set a large cluster size limit
@@ -948,6 +1026,48 @@ static int update_stream_extradata(AVFormatContext *s, OutputStream *os,
     return 0;
 }
 
+static int dash_open_segment(AVFormatContext *s, OutputStream *os, int stream)
+{
+    DASHContext *c = s->priv_data;
+    const char *proto = avio_find_protocol_name(s->filename);
+    int use_rename = proto && !strcmp(proto, "file");
+    AVDictionary *opts = NULL;
+    int ret;
+
+    ff_dash_fill_tmpl_params(os->filename, sizeof(os->filename), c->media_seg_name, stream, os->segment_index, os->bit_rate, os->start_pts);
+    if (snprintf(os->full_path, sizeof(os->full_path), "%s%s", c->dirname, os->filename) >= sizeof(os->full_path) ||
+        snprintf(os->temp_path, sizeof(os->temp_path), use_rename ? "%s.tmp" : "%s", os->full_path) >= sizeof(os->temp_path)) {
+        av_log(s, AV_LOG_ERROR, "Segment path too long: %s%s\n", c->dirname, os->filename);
+        return AVERROR(EINVAL);
+    }
+    set_http_options(&opts, c);
+    ret = dashenc_io_open(s, &os->out, os->temp_path, &opts);
+    av_dict_free(&opts);
+    if (ret < 0)
+        return ret;
+    if (!strcmp(os->format_name, "mp4"))
+        write_styp(os->ctx->pb);
+    return 0;
+}
+
+/* Write the fragment of the packets buffered since the last one to the
+ * segment being written, and send it right away. */
+static int dash_flush_chunk(AVFormatContext *s, OutputStream *os, int stream)
+{
+    int ret, range_length;
+
+    if (!os->init_range_length && (ret = flush_init_segment(s, os)) < 0)
+        return ret;
+    if (!os->out && (ret = dash_open_segment(s, os, stream)) < 0)
+        return ret;
+
+    if ((ret = flush_dynbuf(os, &range_length)) < 0)
+        return ret;
+    os->written_len += range_length;
+    avio_flush(os->out);
+    return 0;
+}
+
 static int dash_flush(AVFormatContext *s, int final, int stream)
 {
     DASHContext *c = s->priv_data;
@@ -963,7 +1083,6 @@ static int dash_flush(AVFormatContext *s, int final, int stream)
     for (i = 0; i < s->nb_streams; i++) {
         OutputStream *os = &c->streams[i];
         AVStream *st = s->streams[i];
-        char filename[1024] = "", full_path[1024], temp_path[1024];
         int range_length, index_length = 0;
 
         if (!os->packets_written)
@@ -986,33 +1105,37 @@ static int dash_flush(AVFormatContext *s, int final, int stream)
         }
 
         if (!c->single_file) {
-            AVDictionary *opts = NULL;
-            ff_dash_fill_tmpl_params(filename, sizeof(filename), c->media_seg_name, i, os->segment_index, os->bit_rate, os->start_pts);
-            snprintf(full_path, sizeof(full_path), "%s%s", c->dirname, filename);
-            snprintf(temp_path, sizeof(temp_path), use_rename ? "%s.tmp" : "%s", full_path);
-            set_http_options(&opts, c);
-            ret = s->io_open(s, &os->out, temp_path, AVIO_FLAG_WRITE, &opts);
-            if (ret < 0)
+            // in streaming mode, the segment has been opened for its first
+            // chunk
+            if (!os->out && (ret = dash_open_segment(s, os, i)) < 0)
                 break;
-            av_dict_free(&opts);
-            if (!strcmp(os->format_name, "mp4"))
-                write_styp(os->ctx->pb);
         } else {
-            snprintf(full_path, sizeof(full_path), "%s%s", c->dirname, os->initfile);
+            os->filename[0] = '\0';
+            if (snprintf(os->full_path, sizeof(os->full_path), "%s%s", c->dirname, os->initfile) >= sizeof(os->full_path)) {
+                av_log(s, AV_LOG_ERROR, "Output path too long: %s%s\n", c->dirname, os->initfile);
+                ret = AVERROR(EINVAL);
+                break;
+            }
         }
 
         ret = flush_dynbuf(os, &range_length);
         if (ret < 0)
             break;
+        range_length += os->written_len;
+        os->written_len = 0;
+        if (c->streaming && !strcmp(os->format_name, "mp4"))
+            os->max_chunk_duration = FFMAX(os->max_chunk_duration,
+                                           av_rescale_q(os->max_pts - os->chunk_start_pts,
+                                                        st->time_base, AV_TIME_BASE_Q));
         os->packets_written = 0;
 
         if (c->single_file) {
-            find_index_range(s, full_path, os->pos, &index_length);
+            find_index_range(s, os->full_path, os->pos, &index_length);
         } else {
-            ff_format_io_close(s, &os->out);
+            dashenc_io_close(s, &os->out, os->temp_path);
 
             if (use_rename) {
-                ret = avpriv_io_move(temp_path, full_path);
+                ret = avpriv_io_move(os->temp_path, os->full_path);
                 if (ret < 0)
                     break;
             }
@@ -1029,8 +1152,8 @@ static int dash_flush(AVFormatContext *s, int final, int stream)
                      " bandwidth=\"%d\"", os->bit_rate);
             }
         }
-        add_segment(os, filename, os->start_pts, os->max_pts - os->start_pts, os->pos, range_length, index_length);
-        av_log(s, AV_LOG_VERBOSE, "Representation %d media segment %d written to: %s\n", i, os->segment_index, full_path);
+        add_segment(os, os->filename, os->start_pts, os->max_pts - os->start_pts, os->pos, range_length, index_length);
+        av_log(s, AV_LOG_VERBOSE, "Representation %d media segment %d written to: %s\n", i, os->segment_index, os->full_path);
 
         os->pos += range_length;
     }
@@ -1057,6 +1180,7 @@ static int dash_flush(AVFormatContext *s, int final, int stream)
 
     if (ret >= 0)
         ret = write_manifest(s, final);
+    export_http_stats(c);
     return ret;
 }
 
@@ -1126,12 +1250,30 @@ static int dash_write_packet(AVFormatContext *s, AVPacket *pkt)
             os->start_pts = os->max_pts;
         else
             os->start_pts = pkt->pts;
+        os->chunk_start_pts = os->start_pts;
+        os->chunk_packets   = 0;
     }
+
+    // Send the chunk before the packet which would make it longer than
+    // frag_duration
+    if (c->streaming && !strcmp(os->format_name, "mp4") && os->chunk_packets &&
+        av_compare_ts(FFMAX(os->max_pts, pkt->pts + pkt->duration) - os->chunk_start_pts,
+                      st->time_base, c->frag_duration, AV_TIME_BASE_Q) > 0) {
+        int64_t chunk_duration = av_rescale_q(os->max_pts - os->chunk_start_pts,
+                                              st->time_base, AV_TIME_BASE_Q);
+        os->max_chunk_duration = FFMAX(os->max_chunk_duration, chunk_duration);
+        os->chunk_start_pts    = os->max_pts;
+        os->chunk_packets      = 0;
+        if ((ret = dash_flush_chunk(s, os, pkt->stream_index)) < 0)
+            return ret;
+    }
+
     if (os->max_pts == AV_NOPTS_VALUE)
         os->max_pts = pkt->pts + pkt->duration;
     else
         os->max_pts = FFMAX(os->max_pts, pkt->pts + pkt->duration);
     os->packets_written++;
+    os->chunk_packets++;
     return ff_write_chained(os->ctx, 0, pkt, s, 0);
 }
 
@@ -1206,6 +1348,14 @@ static const AVOption options[] = {
     { "media_seg_name", "DASH-templated name to used for the media segments", OFFSET(media_seg_name), AV_OPT_TYPE_STRING, {.str = "chunk-stream$RepresentationID$-$Number%05d$.m4s"}, 0, 0, E },
     { "utc_timing_url", "URL of the page that will return the UTC timestamp in ISO format", OFFSET(utc_timing_url), AV_OPT_TYPE_STRING, { 0 }, 0, 0, E },
     { "http_user_agent", "override User-Agent field in HTTP header", OFFSET(user_agent), AV_OPT_TYPE_STRING, {.str = NULL}, 0, 0, E},
+    { "http_persistent", "Use persistent HTTP connections", OFFSET(http_persistent), AV_OPT_TYPE_BOOL, {.i64 = 0 }, 0, 1, E },
+#define X AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY
+    { "http_requests", "Number of HTTP uploads and deletions sent with http_persistent", OFFSET(http_requests), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, X },
+    { "http_reused", "Number of HTTP requests sent on an open connection", OFFSET(http_reused), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, X },
+    { "http_connections", "Number of new HTTP connections", OFFSET(http_connections), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, X },
+    { "http_dropped", "Number of idle HTTP connections closed by the server", OFFSET(http_dropped), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, X },
+    { "streaming", "Send each chunk of the segments as soon as it is written", OFFSET(streaming), AV_OPT_TYPE_BOOL, {.i64 = 0 }, 0, 1, E },
+    { "frag_duration", "maximum duration of the chunks in streaming mode (in microseconds), 0 for one chunk per frame", OFFSET(frag_duration), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, E },
     { NULL },
 };
 
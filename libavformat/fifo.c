@@ -19,6 +19,8 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <stdatomic.h>
+
 #include "libavutil/avassert.h"
 #include "libavutil/opt.h"
 #include "libavutil/time.h"
@@ -31,6 +33,16 @@
 #define FIFO_DEFAULT_MAX_RECOVERY_ATTEMPTS   0
 #define FIFO_DEFAULT_RECOVERY_WAIT_TIME_USEC 5000000 // 5 seconds
 
+typedef struct FifoStats {
+    /* Packets written or dropped by the consumer thread, and total time
+     * the written packets spent between fifo_write_packet() and the
+     * underlying muxer, in microseconds */
+    int64_t written_pkts;
+    int64_t dropped_pkts;
+    int64_t latency_total;
+    int64_t latency_max;
+} FifoStats;
+
 typedef struct FifoContext {
     const AVClass *class;
     AVFormatContext *avf;
@@ -78,6 +90,25 @@ typedef struct FifoContext {
     /* Value > 0 signals queue overflow */
     volatile uint8_t overflow_flag;
 
+    /* Number of messages in the queue */
+    atomic_int nb_queued;
+
+    /* Statistics, exported as read-only options. They are refreshed by every
+     * fifo_write_packet() call and when the output is closed. */
+    int64_t written_pkts;
+    int64_t dropped_pkts;
+    int64_t latency_avg;
+    int64_t latency_max;
+    int queue_max;
+
+    /* Packets dropped by fifo_write_packet() on overflow */
+    int64_t overflow_pkts;
+
+    /* Statistics of the consumer thread, published after every message */
+    pthread_mutex_t stats_lock;
+    int stats_lock_initialized;
+    FifoStats thread_stats;
+
 } FifoContext;
 
 typedef struct FifoThreadContext {
@@ -99,6 +130,8 @@ typedef struct FifoThreadContext {
      * so finalization by calling write_trailer and ff_io_close must be done
      * before exiting / reinitialization of underlying muxer */
     uint8_t header_written;
+
+    FifoStats stats;
 } FifoThreadContext;
 
 typedef enum FifoMessageType {
@@ -110,6 +143,7 @@ typedef enum FifoMessageType {
 typedef struct FifoMessage {
     FifoMessageType type;
     AVPacket pkt;
+    int64_t queued_time; ///< when the packet was queued, in av_gettime_relative() units
 } FifoMessage;
 
 static int fifo_thread_write_header(FifoThreadContext *ctx)
@@ -160,8 +194,9 @@ static int fifo_thread_flush_output(FifoThreadContext *ctx)
     return av_write_frame(avf2, NULL);
 }
 
-static int fifo_thread_write_packet(FifoThreadContext *ctx, AVPacket *pkt)
+static int fifo_thread_write_packet(FifoThreadContext *ctx, FifoMessage *msg)
 {
+    AVPacket *pkt = &msg->pkt;
     AVFormatContext *avf = ctx->avf;
     FifoContext *fifo = avf->priv_data;
     AVFormatContext *avf2 = fifo->avf;
@@ -175,6 +210,7 @@ static int fifo_thread_write_packet(FifoThreadContext *ctx, AVPacket *pkt)
         } else {
             av_log(avf, AV_LOG_VERBOSE, "Dropping non-keyframe packet\n");
             av_packet_unref(pkt);
+            ctx->stats.dropped_pkts++;
             return 0;
         }
     }
@@ -185,8 +221,14 @@ static int fifo_thread_write_packet(FifoThreadContext *ctx, AVPacket *pkt)
     av_packet_rescale_ts(pkt, src_tb, dst_tb);
 
     ret = av_write_frame(avf2, pkt);
-    if (ret >= 0)
+    if (ret >= 0) {
+        int64_t latency = av_gettime_relative() - msg->queued_time;
+
+        ctx->stats.written_pkts++;
+        ctx->stats.latency_total += latency;
+        ctx->stats.latency_max    = FFMAX(ctx->stats.latency_max, latency);
         av_packet_unref(pkt);
+    }
     return ret;
 }
 
@@ -221,7 +263,7 @@ static int fifo_thread_dispatch_message(FifoThreadContext *ctx, FifoMessage *msg
         av_assert0(ret >= 0);
         return ret;
     case FIFO_WRITE_PACKET:
-        return fifo_thread_write_packet(ctx, &msg->pkt);
+        return fifo_thread_write_packet(ctx, msg);
     case FIFO_FLUSH_OUTPUT:
         return fifo_thread_flush_output(ctx);
     }
@@ -378,14 +420,25 @@ static int fifo_thread_recover(FifoThreadContext *ctx, FifoMessage *msg, int err
     } while (ret == AVERROR(EAGAIN) && !fifo->drop_pkts_on_overflow);
 
     if (ret == AVERROR(EAGAIN) && fifo->drop_pkts_on_overflow) {
-        if (msg->type == FIFO_WRITE_PACKET)
+        if (msg->type == FIFO_WRITE_PACKET) {
             av_packet_unref(&msg->pkt);
+            ctx->stats.dropped_pkts++;
+        }
         ret = 0;
     }
 
     return ret;
 }
 
+static void fifo_thread_publish_stats(FifoThreadContext *ctx)
+{
+    FifoContext *fifo = ctx->avf->priv_data;
+
+    pthread_mutex_lock(&fifo->stats_lock);
+    fifo->thread_stats = ctx->stats;
+    pthread_mutex_unlock(&fifo->stats_lock);
+}
+
 static void *fifo_consumer_thread(void *data)
 {
     AVFormatContext *avf = data;
@@ -419,7 +472,16 @@ static void *fifo_consumer_thread(void *data)
          * set, the queue is flushed and flag cleared. */
         pthread_mutex_lock(&fifo->overflow_flag_lock);
         if (fifo->overflow_flag) {
-            av_thread_message_flush(queue);
+            FifoMessage flushed;
+
+            /* same as av_thread_message_flush(), counting the packets */
+            while (av_thread_message_queue_recv(queue, &flushed,
+                                                AV_THREAD_MESSAGE_NONBLOCK) >= 0) {
+                atomic_fetch_sub_explicit(&fifo->nb_queued, 1, memory_order_relaxed);
+                if (flushed.type == FIFO_WRITE_PACKET)
+                    fifo_thread_ctx.stats.dropped_pkts++;
+                free_message(&flushed);
+            }
             if (fifo->restart_with_keyframe)
                 fifo_thread_ctx.drop_until_keyframe = 1;
             fifo->overflow_flag = 0;
@@ -430,18 +492,38 @@ static void *fifo_consumer_thread(void *data)
         if (just_flushed)
             av_log(avf, AV_LOG_INFO, "FIFO queue flushed\n");
 
+        fifo_thread_publish_stats(&fifo_thread_ctx);
+
         ret = av_thread_message_queue_recv(queue, &msg, 0);
         if (ret < 0) {
             av_thread_message_queue_set_err_send(queue, ret);
             break;
         }
+        atomic_fetch_sub_explicit(&fifo->nb_queued, 1, memory_order_relaxed);
     }
 
     fifo->write_trailer_ret = fifo_thread_write_trailer(&fifo_thread_ctx);
+    fifo_thread_publish_stats(&fifo_thread_ctx);
 
     return NULL;
 }
 
+/* Copy the statistics of the consumer thread to the exported options, on the
+ * thread of the caller so that they can be read between two packets. */
+static void fifo_update_stats(FifoContext *fifo)
+{
+    FifoStats stats;
+
+    pthread_mutex_lock(&fifo->stats_lock);
+    stats = fifo->thread_stats;
+    pthread_mutex_unlock(&fifo->stats_lock);
+
+    fifo->written_pkts = stats.written_pkts;
+    fifo->dropped_pkts = stats.dropped_pkts + fifo->overflow_pkts;
+    fifo->latency_max  = stats.latency_max;
+    fifo->latency_avg  = stats.written_pkts ? stats.latency_total / stats.written_pkts : 0;
+}
+
 static int fifo_mux_init(AVFormatContext *avf, AVOutputFormat *oformat,
                          const char *filename)
 {
@@ -516,12 +598,18 @@ static int fifo_init(AVFormatContext *avf)
         return ret;
 
     av_thread_message_queue_set_free_func(fifo->queue, free_message);
+    atomic_init(&fifo->nb_queued, 0);
 
     ret = pthread_mutex_init(&fifo->overflow_flag_lock, NULL);
     if (ret < 0)
         return AVERROR(ret);
     fifo->overflow_flag_lock_initialized = 1;
 
+    ret = pthread_mutex_init(&fifo->stats_lock, NULL);
+    if (ret < 0)
+        return AVERROR(ret);
+    fifo->stats_lock_initialized = 1;
+
     return 0;
 }
 
@@ -544,18 +632,25 @@ static int fifo_write_packet(AVFormatContext *avf, AVPacket *pkt)
 {
     FifoContext *fifo = avf->priv_data;
     FifoMessage msg = {.type = pkt ? FIFO_WRITE_PACKET : FIFO_FLUSH_OUTPUT};
-    int ret;
+    int ret, nb_queued;
 
     if (pkt) {
         av_init_packet(&msg.pkt);
         ret = av_packet_ref(&msg.pkt,pkt);
         if (ret < 0)
             return ret;
+        msg.queued_time = av_gettime_relative();
     }
 
+    /* counted beforehand, so that the consumer never sees it negative */
+    nb_queued = atomic_fetch_add_explicit(&fifo->nb_queued, 1, memory_order_relaxed) + 1;
     ret = av_thread_message_queue_send(fifo->queue, &msg,
                                        fifo->drop_pkts_on_overflow ?
                                        AV_THREAD_MESSAGE_NONBLOCK : 0);
+    if (ret >= 0)
+        fifo->queue_max = FFMAX(fifo->queue_max, FFMIN(nb_queued, fifo->queue_size));
+    else
+        atomic_fetch_sub_explicit(&fifo->nb_queued, 1, memory_order_relaxed);
     if (ret == AVERROR(EAGAIN)) {
         uint8_t overflow_set = 0;
 
@@ -569,16 +664,20 @@ static int fifo_write_packet(AVFormatContext *avf, AVPacket *pkt)
 
         if (overflow_set)
             av_log(avf, AV_LOG_WARNING, "FIFO queue full\n");
+        if (pkt)
+            fifo->overflow_pkts++;
         ret = 0;
         goto fail;
     } else if (ret < 0) {
         goto fail;
     }
 
+    fifo_update_stats(fifo);
     return ret;
 fail:
     if (pkt)
         av_packet_unref(&msg.pkt);
+    fifo_update_stats(fifo);
     return ret;
 }
 
@@ -596,6 +695,13 @@ static int fifo_write_trailer(AVFormatContext *avf)
         return AVERROR(ret);
     }
 
+    fifo_update_stats(fifo);
+    av_log(avf, fifo->dropped_pkts ? AV_LOG_INFO : AV_LOG_VERBOSE,
+           "%s: %"PRId64" packets written, %"PRId64" dropped, latency "
+           "avg %0.3fms max %0.3fms, queue max %d/%d\n", avf->filename,
+           fifo->written_pkts, fifo->dropped_pkts, fifo->latency_avg / 1000.0,
+           fifo->latency_max / 1000.0, fifo->queue_max, fifo->queue_size);
+
     ret = fifo->write_trailer_ret;
     return ret;
 }
@@ -609,6 +715,8 @@ static void fifo_deinit(AVFormatContext *avf)
     av_thread_message_queue_free(&fifo->queue);
     if (fifo->overflow_flag_lock_initialized)
         pthread_mutex_destroy(&fifo->overflow_flag_lock);
+    if (fifo->stats_lock_initialized)
+        pthread_mutex_destroy(&fifo->stats_lock);
 }
 
 #define OFFSET(x) offsetof(FifoContext, x)
@@ -643,6 +751,22 @@ static const AVOption options[] = {
         {"recover_any_error", "Attempt recovery regardless of type of the error", OFFSET(recover_any_error),
          AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, AV_OPT_FLAG_ENCODING_PARAM},
 
+#define X AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY
+        {"written_pkts", "Number of packets written to the underlying muxer", OFFSET(written_pkts),
+         AV_OPT_TYPE_INT64, {.i64 = 0}, 0, INT64_MAX, X},
+
+        {"dropped_pkts", "Number of packets dropped on queue overflow or while recovering", OFFSET(dropped_pkts),
+         AV_OPT_TYPE_INT64, {.i64 = 0}, 0, INT64_MAX, X},
+
+        {"latency_avg", "Average time between queueing and writing of a packet, in microseconds", OFFSET(latency_avg),
+         AV_OPT_TYPE_INT64, {.i64 = 0}, 0, INT64_MAX, X},
+
+        {"latency_max", "Maximum time between queueing and writing of a packet, in microseconds", OFFSET(latency_max),
+         AV_OPT_TYPE_INT64, {.i64 = 0}, 0, INT64_MAX, X},
+
+        {"queue_max", "Maximum number of messages in the queue", OFFSET(queue_max),
+         AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX, X},
+
         {NULL},
 };
 
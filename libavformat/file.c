@@ -35,6 +35,9 @@
 #endif
 #include <sys/stat.h>
 #include <stdlib.h>
+#if HAVE_MMAP
+#include <sys/mman.h>
+#endif
 #include "os_support.h"
 #include "url.h"
 
@@ -67,12 +70,27 @@
 
 /* standard file protocol */
 
+enum FileAdvice {
+    FILE_ADVICE_SEQUENTIAL = 1 << 0,
+    FILE_ADVICE_RANDOM     = 1 << 1,
+    FILE_ADVICE_WILLNEED   = 1 << 2,
+    FILE_ADVICE_NOREUSE    = 1 << 3,
+};
+
 typedef struct FileContext {
     const AVClass *class;
     int fd;
     int trunc;
     int blocksize;
     int follow;
+    int use_mmap;
+    int pread_size;
+    int advice;
+    /* read position when reading from the mapping or with pread() */
+    int64_t pos;
+    uint8_t *map;
+    int64_t map_size;
+    int use_pread;
 #if HAVE_DIRENT_H
     DIR *dir;
 #endif
@@ -82,6 +100,13 @@ static const AVOption file_options[] = {
     { "truncate", "truncate existing files on write", offsetof(FileContext, trunc), AV_OPT_TYPE_BOOL, { .i64 = 1 }, 0, 1, AV_OPT_FLAG_ENCODING_PARAM },
     { "blocksize", "set I/O operation maximum block size", offsetof(FileContext, blocksize), AV_OPT_TYPE_INT, { .i64 = INT_MAX }, 1, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM },
     { "follow", "Follow a file as it is being written", offsetof(FileContext, follow), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
+    { "mmap", "map the file in memory for reading", offsetof(FileContext, use_mmap), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
+    { "pread_size", "read with pread() in blocks of this size (0 to use read())", offsetof(FileContext, pread_size), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, AV_OPT_FLAG_DECODING_PARAM },
+    { "fadvise", "set the access pattern hints given to the kernel", offsetof(FileContext, advice), AV_OPT_TYPE_FLAGS, { .i64 = 0 }, 0, INT_MAX, AV_OPT_FLAG_DECODING_PARAM, "fadvise" },
+        { "sequential", "the file is read sequentially", 0, AV_OPT_TYPE_CONST, { .i64 = FILE_ADVICE_SEQUENTIAL }, 0, 0, AV_OPT_FLAG_DECODING_PARAM, "fadvise" },
+        { "random",     "the file is read in random order", 0, AV_OPT_TYPE_CONST, { .i64 = FILE_ADVICE_RANDOM }, 0, 0, AV_OPT_FLAG_DECODING_PARAM, "fadvise" },
+        { "willneed",   "start reading the whole file in the page cache", 0, AV_OPT_TYPE_CONST, { .i64 = FILE_ADVICE_WILLNEED }, 0, 0, AV_OPT_FLAG_DECODING_PARAM, "fadvise" },
+        { "noreuse",    "the data is read only once", 0, AV_OPT_TYPE_CONST, { .i64 = FILE_ADVICE_NOREUSE }, 0, 0, AV_OPT_FLAG_DECODING_PARAM, "fadvise" },
     { NULL }
 };
 
@@ -109,6 +134,21 @@ static int file_read(URLContext *h, unsigned char *buf, int size)
     FileContext *c = h->priv_data;
     int ret;
     size = FFMIN(size, c->blocksize);
+    if (c->map) {
+        if (c->pos >= c->map_size)
+            return AVERROR_EOF;
+        size = FFMIN(size, c->map_size - c->pos);
+        memcpy(buf, c->map + c->pos, size);
+        c->pos += size;
+        return size;
+    }
+#if HAVE_PREAD
+    if (c->use_pread) {
+        ret = pread(c->fd, buf, size, c->pos);
+        if (ret > 0)
+            c->pos += ret;
+    } else
+#endif
     ret = read(c->fd, buf, size);
     if (ret == 0 && c->follow)
         return AVERROR(EAGAIN);
@@ -199,6 +239,60 @@ static int file_move(URLContext *h_src, URLContext *h_dst)
 
 #if CONFIG_FILE_PROTOCOL
 
+static void file_setup_read(URLContext *h, const struct stat *st)
+{
+    FileContext *c = h->priv_data;
+
+#if HAVE_POSIX_FADVISE
+    static const struct {
+        int flag, advice;
+    } advices[] = {
+        { FILE_ADVICE_SEQUENTIAL, POSIX_FADV_SEQUENTIAL },
+        { FILE_ADVICE_RANDOM,     POSIX_FADV_RANDOM     },
+        { FILE_ADVICE_WILLNEED,   POSIX_FADV_WILLNEED   },
+        { FILE_ADVICE_NOREUSE,    POSIX_FADV_NOREUSE    },
+    };
+    int i, ret;
+
+    for (i = 0; i < FF_ARRAY_ELEMS(advices); i++) {
+        if (!(c->advice & advices[i].flag))
+            continue;
+        ret = posix_fadvise(c->fd, 0, 0, advices[i].advice);
+        if (ret)
+            av_log(h, AV_LOG_WARNING, "posix_fadvise() failed: %s\n", av_err2str(AVERROR(ret)));
+    }
+#else
+    if (c->advice)
+        av_log(h, AV_LOG_WARNING, "fadvise is not supported on this system\n");
+#endif
+
+    /* Large reads fill the whole AVIOContext buffer, which is allocated
+     * with the maximum packet size */
+    if (c->pread_size) {
+        h->max_packet_size = c->pread_size;
+#if HAVE_PREAD
+        c->use_pread = 1;
+#endif
+    }
+
+    if (c->use_mmap && !c->follow && st->st_size > 0) {
+#if HAVE_MMAP
+        void *map = MAP_FAILED;
+
+        if ((uint64_t)st->st_size <= SIZE_MAX)
+            map = mmap(NULL, st->st_size, PROT_READ, MAP_SHARED, c->fd, 0);
+        if (map == MAP_FAILED) {
+            av_log(h, AV_LOG_WARNING, "Could not map the file, reading it instead\n");
+        } else {
+            c->map      = map;
+            c->map_size = st->st_size;
+        }
+#else
+        av_log(h, AV_LOG_WARNING, "mmap is not supported on this system\n");
+#endif
+    }
+}
+
 static int file_open(URLContext *h, const char *filename, int flags)
 {
     FileContext *c = h->priv_data;
@@ -234,6 +328,9 @@ static int file_open(URLContext *h, const char *filename, int flags)
     if (!h->is_streamed && flags & AVIO_FLAG_WRITE)
         h->min_packet_size = h->max_packet_size = 262144;
 
+    if (!h->is_streamed && !(flags & AVIO_FLAG_WRITE) && S_ISREG(st.st_mode))
+        file_setup_read(h, &st);
+
     return 0;
 }
 
@@ -245,10 +342,28 @@ static int64_t file_seek(URLContext *h, int64_t pos, int whence)
 
     if (whence == AVSEEK_SIZE) {
         struct stat st;
+        if (c->map)
+            return c->map_size;
         ret = fstat(c->fd, &st);
         return ret < 0 ? AVERROR(errno) : (S_ISFIFO(st.st_mode) ? 0 : st.st_size);
     }
 
+    /* reads from the mapping and pread() use their own position */
+    if (c->map || c->use_pread) {
+        if (whence == SEEK_CUR) {
+            pos += c->pos;
+        } else if (whence == SEEK_END) {
+            if ((ret = file_seek(h, 0, AVSEEK_SIZE)) < 0)
+                return ret;
+            pos += ret;
+        } else if (whence != SEEK_SET) {
+            return AVERROR(EINVAL);
+        }
+        if (pos < 0)
+            return AVERROR(EINVAL);
+        return c->pos = pos;
+    }
+
     ret = lseek(c->fd, pos, whence);
 
     return ret < 0 ? AVERROR(errno) : ret;
@@ -257,6 +372,10 @@ static int64_t file_seek(URLContext *h, int64_t pos, int whence)
 static int file_close(URLContext *h)
 {
     FileContext *c = h->priv_data;
+#if HAVE_MMAP
+    if (c->map)
+        munmap(c->map, c->map_size);
+#endif
     return close(c->fd);
 }
 
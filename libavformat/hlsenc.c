@@ -45,8 +45,10 @@
 
 #include "avformat.h"
 #include "avio_internal.h"
+#include "httppool.h"
 #include "internal.h"
 #include "os_support.h"
+#include "segwriter.h"
 
 typedef enum {
   HLS_START_SEQUENCE_AS_START_NUMBER = 0,
@@ -102,6 +104,13 @@ typedef enum {
     PLAYLIST_TYPE_NB,
 } PlaylistType;
 
+typedef struct HLSPart {
+    double duration;
+    int64_t pos;
+    int64_t size;
+    int independent;
+} HLSPart;
+
 typedef struct VariantStream {
     unsigned number;
     int64_t sequence;
@@ -147,6 +156,20 @@ typedef struct VariantStream {
     unsigned int nb_streams;
     int m3u8_created; /* status of media play-list creation */
     char *baseurl;
+
+    /* partial segments of the segment being written and of the previous one */
+    HLSPart *parts;
+    unsigned int parts_size;
+    int nb_parts;
+    HLSPart *prev_parts;
+    unsigned int prev_parts_size;
+    int nb_prev_parts;
+    int64_t part_start_pts;
+    int64_t part_start_pos;
+    int part_independent;
+    double max_part_duration;
+
+    AVDictionary *segment_options; ///< options to open the segment being written with, with writer threads
 } VariantStream;
 
 typedef struct HLSContext {
@@ -156,6 +179,7 @@ typedef struct HLSContext {
 
     float time;            // Set by a private option.
     float init_time;       // Set by a private option.
+    float part_time;       // Set by a private option.
     int max_nb_segments;   // Set by a private option.
 #if FF_API_HLS_WRAP
     int  wrap;             // Set by a private option.
@@ -194,6 +218,16 @@ typedef struct HLSContext {
 
     char *method;
     char *user_agent;
+    int http_persistent;
+    HTTPPool *http_pool;
+    int64_t http_requests;
+    int64_t http_reused;
+    int64_t http_connections;
+    int64_t http_dropped;
+
+    int writer_threads;
+    int writer_queue_size;
+    SegmentWriter *writer;
 
     VariantStream *var_streams;
     unsigned int nb_varstreams;
@@ -244,6 +278,35 @@ static int mkdir_p(const char *path) {
     return ret;
 }
 
+static int hlsenc_io_open(AVFormatContext *s, AVIOContext **pb, const char *filename,
+                          AVDictionary **options)
+{
+    HLSContext *hls = s->priv_data;
+
+    return ff_http_pool_open(hls->http_pool, s, pb, filename, options);
+}
+
+static void hlsenc_io_close(AVFormatContext *s, AVIOContext **pb, const char *filename)
+{
+    HLSContext *hls = s->priv_data;
+
+    if (*pb && ff_http_pool_close(hls->http_pool, s, pb) < 0)
+        av_log(s, AV_LOG_WARNING, "Failed to upload '%s'\n", filename);
+}
+
+static void export_http_stats(HLSContext *hls)
+{
+    HTTPPoolStats stats;
+
+    if (!hls->http_pool)
+        return;
+    ff_http_pool_get_stats(hls->http_pool, &stats);
+    hls->http_requests    = stats.requests;
+    hls->http_reused      = stats.reused;
+    hls->http_connections = stats.connections;
+    hls->http_dropped     = stats.dropped;
+}
+
 static void set_http_options(AVFormatContext *s, AVDictionary **options, HLSContext *c)
 {
     const char *proto = avio_find_protocol_name(s->filename);
@@ -322,6 +385,32 @@ static void write_styp(AVIOContext *pb)
     ffio_wfourcc(pb, "msix");
 }
 
+static int hls_delete_file(AVFormatContext *s, HLSContext *hls,
+                           const char *path, const char *proto)
+{
+    AVDictionary *options = NULL;
+    AVIOContext *out = NULL;
+    int ret = 0;
+
+    if (hls->method || (proto && !av_strcasecmp(proto, "http"))) {
+        av_dict_set(&options, "method", "DELETE", 0);
+        /* after the files handed over before, which may still be in use */
+        if (hls->writer)
+            ret = ff_segment_writer_delete(hls->writer, path, options,
+                                           SEGMENT_WRITER_ORDERED);
+        else if ((ret = hlsenc_io_open(s, &out, path, &options)) >= 0)
+            hlsenc_io_close(s, &out, path);
+        av_dict_free(&options);
+    } else if (hls->writer) {
+        ret = ff_segment_writer_delete(hls->writer, path, NULL,
+                                       SEGMENT_WRITER_ORDERED);
+    } else if (unlink(path) < 0) {
+        av_log(hls, AV_LOG_ERROR, "failed to delete old segment %s: %s\n",
+                                 path, strerror(errno));
+    }
+    return ret;
+}
+
 static int hls_delete_old_segments(AVFormatContext *s, HLSContext *hls,
                                    VariantStream *vs) {
 
@@ -330,8 +419,6 @@ static int hls_delete_old_segments(AVFormatContext *s, HLSContext *hls,
     int ret = 0, path_size, sub_path_size;
     char *dirname = NULL, *p, *sub_path;
     char *path = NULL;
-    AVDictionary *options = NULL;
-    AVIOContext *out = NULL;
     const char *proto = NULL;
 
     segment = vs->segments;
@@ -383,15 +470,8 @@ static int hls_delete_old_segments(AVFormatContext *s, HLSContext *hls,
         }
 
         proto = avio_find_protocol_name(s->filename);
-        if (hls->method || (proto && !av_strcasecmp(proto, "http"))) {
-            av_dict_set(&options, "method", "DELETE", 0);
-            if ((ret = vs->avf->io_open(vs->avf, &out, path, AVIO_FLAG_WRITE, &options)) < 0)
-                goto fail;
-            ff_format_io_close(vs->avf, &out);
-        } else if (unlink(path) < 0) {
-            av_log(hls, AV_LOG_ERROR, "failed to delete old segment %s: %s\n",
-                                     path, strerror(errno));
-        }
+        if ((ret = hls_delete_file(s, hls, path, proto)) < 0)
+            goto fail;
 
         if ((segment->sub_filename[0] != '\0')) {
             sub_path_size = strlen(segment->sub_filename) + 1 + (dirname ? strlen(dirname) : 0);
@@ -404,18 +484,10 @@ static int hls_delete_old_segments(AVFormatContext *s, HLSContext *hls,
             av_strlcpy(sub_path, dirname, sub_path_size);
             av_strlcat(sub_path, segment->sub_filename, sub_path_size);
 
-            if (hls->method || (proto && !av_strcasecmp(proto, "http"))) {
-                av_dict_set(&options, "method", "DELETE", 0);
-                if ((ret = vs->avf->io_open(vs->avf, &out, sub_path, AVIO_FLAG_WRITE, &options)) < 0) {
-                    av_free(sub_path);
-                    goto fail;
-                }
-                ff_format_io_close(vs->avf, &out);
-            } else if (unlink(sub_path) < 0) {
-                av_log(hls, AV_LOG_ERROR, "failed to delete old segment %s: %s\n",
-                                         sub_path, strerror(errno));
-            }
+            ret = hls_delete_file(s, hls, sub_path, proto);
             av_free(sub_path);
+            if (ret < 0)
+                goto fail;
         }
         av_freep(&path);
         previous_segment = segment;
@@ -647,7 +719,9 @@ static int hls_mux_init(AVFormatContext *s, VariantStream *vs)
         if ((ret = avio_open_dyn_buf(&oc->pb)) < 0)
             return ret;
 
-        if ((ret = s->io_open(s, &vs->out, vs->base_output_dirname, AVIO_FLAG_WRITE, &options)) < 0) {
+        /* with writer threads, the init segment is handed over once built */
+        if (!hls->writer &&
+            (ret = hlsenc_io_open(s, &vs->out, vs->base_output_dirname, &options)) < 0) {
             av_log(s, AV_LOG_ERROR, "Failed to open segment '%s'\n", vs->fmp4_init_filename);
             return ret;
         }
@@ -663,7 +737,11 @@ static int hls_mux_init(AVFormatContext *s, VariantStream *vs)
 
         av_dict_copy(&options, hls->format_options, 0);
         av_dict_set(&options, "fflags", "-autobsf", 0);
-        av_dict_set(&options, "movflags", "frag_custom+dash+delay_moov", 0);
+        /* partial segments are addressed by byte ranges of the segment,
+         * which must not be rewritten once sent */
+        av_dict_set(&options, "movflags", hls->part_time > 0 ?
+                    "frag_custom+delay_moov+default_base_moof+skip_trailer" :
+                    "frag_custom+dash+delay_moov", 0);
         ret = avformat_init_output(oc, &options);
         if (ret < 0)
             return ret;
@@ -678,6 +756,42 @@ static int hls_mux_init(AVFormatContext *s, VariantStream *vs)
     return 0;
 }
 
+static int hls_append_part(VariantStream *vs, int64_t end_pos, double duration)
+{
+    HLSPart *parts, *part;
+
+    if (end_pos <= vs->part_start_pos)
+        return 0;
+
+    parts = av_fast_realloc(vs->parts, &vs->parts_size,
+                            (vs->nb_parts + 1) * sizeof(*vs->parts));
+    if (!parts)
+        return AVERROR(ENOMEM);
+    vs->parts = parts;
+
+    part = &vs->parts[vs->nb_parts++];
+    part->duration    = duration;
+    part->pos         = vs->part_start_pos;
+    part->size        = end_pos - vs->part_start_pos;
+    part->independent = vs->part_independent;
+    vs->part_start_pos = end_pos;
+    vs->max_part_duration = FFMAX(vs->max_part_duration, duration);
+    return 0;
+}
+
+static void write_parts(AVIOContext *out, VariantStream *vs,
+                        const HLSPart *parts, int nb_parts, const char *filename)
+{
+    int i;
+
+    for (i = 0; i < nb_parts; i++) {
+        avio_printf(out, "#EXT-X-PART:DURATION=%f,URI=\"%s%s\",BYTERANGE=\"%"PRId64"@%"PRId64"\"%s\n",
+                    parts[i].duration, vs->baseurl ? vs->baseurl : "", filename,
+                    parts[i].size, parts[i].pos,
+                    parts[i].independent ? ",INDEPENDENT=YES" : "");
+    }
+}
+
 static HLSSegment *find_segment_by_filename(HLSSegment *segment, const char *filename)
 {
     while (segment) {
@@ -779,8 +893,9 @@ static int sls_flag_check_duration_size(HLSContext *hls, VariantStream *vs)
 }
 
 static void sls_flag_file_rename(HLSContext *hls, VariantStream *vs, char *old_filename) {
+    /* with writer threads, the segment is written under its final name */
     if ((hls->flags & (HLS_SECOND_LEVEL_SEGMENT_SIZE | HLS_SECOND_LEVEL_SEGMENT_DURATION)) &&
-        strlen(vs->current_segment_final_filename_fmt)) {
+        strlen(vs->current_segment_final_filename_fmt) && !hls->writer) {
         ff_rename(old_filename, vs->avf->filename, hls);
     }
 }
@@ -1037,15 +1152,58 @@ static void write_m3u8_head_block(HLSContext *hls, AVIOContext *out, int version
 
 static void hls_rename_temp_file(AVFormatContext *s, AVFormatContext *oc)
 {
+    HLSContext *hls = s->priv_data;
     size_t len = strlen(oc->filename);
     char final_filename[sizeof(oc->filename)];
 
     av_strlcpy(final_filename, oc->filename, len);
     final_filename[len-4] = '\0';
-    ff_rename(oc->filename, final_filename, s);
+    /* with writer threads, the segment is renamed once written */
+    if (!hls->writer)
+        ff_rename(oc->filename, final_filename, s);
     oc->filename[len-4] = '\0';
 }
 
+/* Hand over the media segment to the writer threads, under its final name
+ * which is only known once it is complete with second level segment flags. */
+static int hls_submit_segment(AVFormatContext *s, VariantStream *vs)
+{
+    HLSContext *hls = s->priv_data;
+    AVFormatContext *oc = vs->avf;
+    char *temp_filename = NULL, *url = NULL;
+    int ret = AVERROR(ENOMEM);
+
+    if ((hls->flags & HLS_TEMP_FILE) &&
+        !(temp_filename = av_asprintf("%s.tmp", oc->filename)))
+        goto fail;
+    if ((hls->encrypt || hls->key_info_file) &&
+        !(url = av_asprintf("crypto:%s", temp_filename ? temp_filename : oc->filename)))
+        goto fail;
+
+    ret = ff_segment_writer_submit(hls->writer, &oc->pb,
+                                   url ? url : temp_filename ? temp_filename : oc->filename,
+                                   vs->segment_options, temp_filename, oc->filename, 0);
+fail:
+    ffio_free_dyn_buf(&oc->pb);
+    av_free(temp_filename);
+    av_free(url);
+    return ret;
+}
+
+static int hls_submit_vtt_segment(AVFormatContext *s, VariantStream *vs)
+{
+    HLSContext *hls = s->priv_data;
+    AVFormatContext *vtt_oc = vs->vtt_avf;
+    AVDictionary *options = NULL;
+    int ret;
+
+    set_http_options(s, &options, hls);
+    ret = ff_segment_writer_submit(hls->writer, &vtt_oc->pb, vtt_oc->filename,
+                                   options, NULL, NULL, 0);
+    av_dict_free(&options);
+    return ret;
+}
+
 static int get_relative_url(const char *master_url, const char *media_url,
                             char *rel_url, int rel_url_buf_size)
 {
@@ -1092,9 +1250,11 @@ static int create_master_playlist(AVFormatContext *s,
     if (hls->user_agent)
       av_dict_set(&options, "user-agent", hls->user_agent, 0);
 
-    ret = s->io_open(s, &master_pb, hls->master_m3u8_url, AVIO_FLAG_WRITE,\
-                     &options);
-    av_dict_free(&options);
+    /* with writer threads, the playlist is written after the media playlists */
+    if (hls->writer)
+        ret = avio_open_dyn_buf(&master_pb);
+    else
+        ret = hlsenc_io_open(s, &master_pb, hls->master_m3u8_url, &options);
     if (ret < 0) {
         av_log(NULL, AV_LOG_ERROR, "Failed to open master play list file '%s'\n",
                 hls->master_m3u8_url);
@@ -1162,7 +1322,15 @@ fail:
     if(ret >=0)
         hls->master_m3u8_created = 1;
     av_freep(&m3U8_rel_name);
-    ff_format_io_close(s, &master_pb);
+    if (hls->writer) {
+        if (ret >= 0 && master_pb)
+            ret = ff_segment_writer_submit(hls->writer, &master_pb, hls->master_m3u8_url,
+                                           options, NULL, NULL, SEGMENT_WRITER_ORDERED);
+        ffio_free_dyn_buf(&master_pb);
+    } else {
+        hlsenc_io_close(s, &master_pb, hls->master_m3u8_url);
+    }
+    av_dict_free(&options);
     return ret;
 }
 
@@ -1200,9 +1368,16 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
 
     set_http_options(s, &options, hls);
     snprintf(temp_filename, sizeof(temp_filename), use_rename ? "%s.tmp" : "%s", vs->m3u8_name);
-    if ((ret = s->io_open(s, &out, temp_filename, AVIO_FLAG_WRITE, &options)) < 0)
+    /* with writer threads, the playlist is written after the segments */
+    if (hls->writer)
+        ret = avio_open_dyn_buf(&out);
+    else
+        ret = hlsenc_io_open(s, &out, temp_filename, &options);
+    if (ret < 0)
         goto fail;
 
+    if (hls->part_time > 0)
+        target_duration = get_int_from_double(hls->time);
     for (en = vs->segments; en; en = en->next) {
         if (target_duration <= en->duration)
             target_duration = get_int_from_double(en->duration);
@@ -1215,6 +1390,13 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
     } else if (hls->pl_type == PLAYLIST_TYPE_VOD) {
         avio_printf(out, "#EXT-X-PLAYLIST-TYPE:VOD\n");
     }
+    if (hls->part_time > 0 && !last) {
+        /* no partial segment may be longer than the target */
+        double part_target = FFMAX(hls->part_time, vs->max_part_duration);
+
+        avio_printf(out, "#EXT-X-PART-INF:PART-TARGET=%f\n", part_target);
+        avio_printf(out, "#EXT-X-SERVER-CONTROL:PART-HOLD-BACK=%f\n", 3 * part_target);
+    }
 
     if((hls->flags & HLS_DISCONT_START) && sequence==hls->start_sequence && vs->discontinuity_set==0 ){
         avio_printf(out, "#EXT-X-DISCONTINUITY\n");
@@ -1242,6 +1424,8 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
             }
             avio_printf(out, "\n");
         }
+        if (hls->part_time > 0 && !last && en == vs->last_segment)
+            write_parts(out, vs, vs->prev_parts, vs->nb_prev_parts, en->filename);
         if (hls->flags & HLS_ROUND_DURATIONS)
             avio_printf(out, "#EXTINF:%ld,\n",  lrint(en->duration));
         else
@@ -1279,11 +1463,25 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
         avio_printf(out, "%s\n", en->filename);
     }
 
+    if (hls->part_time > 0 && !last) {
+        /* the parts of the first segment are listed before it is complete */
+        if (hls->segment_type == SEGMENT_TYPE_FMP4 && !vs->segments && vs->nb_parts)
+            avio_printf(out, "#EXT-X-MAP:URI=\"%s\"\n", vs->fmp4_init_filename);
+        write_parts(out, vs, vs->parts, vs->nb_parts,
+                    hls->use_localtime_mkdir ? vs->avf->filename
+                                             : av_basename(vs->avf->filename));
+    }
+
     if (last && (hls->flags & HLS_OMIT_ENDLIST)==0)
         avio_printf(out, "#EXT-X-ENDLIST\n");
 
     if( vs->vtt_m3u8_name ) {
-        if ((ret = s->io_open(s, &sub_out, vs->vtt_m3u8_name, AVIO_FLAG_WRITE, &options)) < 0)
+        set_http_options(s, &options, hls);
+        if (hls->writer)
+            ret = avio_open_dyn_buf(&sub_out);
+        else
+            ret = hlsenc_io_open(s, &sub_out, vs->vtt_m3u8_name, &options);
+        if (ret < 0)
             goto fail;
         write_m3u8_head_block(hls, sub_out, hls->version, target_duration, sequence);
 
@@ -1303,11 +1501,24 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
     }
 
 fail:
-    av_dict_free(&options);
-    ff_format_io_close(s, &out);
-    ff_format_io_close(s, &sub_out);
-    if (ret >= 0 && use_rename)
-        ff_rename(temp_filename, vs->m3u8_name, s);
+    if (hls->writer) {
+        if (ret >= 0)
+            ret = ff_segment_writer_submit(hls->writer, &out, temp_filename, options,
+                                           use_rename ? temp_filename : NULL,
+                                           vs->m3u8_name, SEGMENT_WRITER_ORDERED);
+        if (ret >= 0 && sub_out)
+            ret = ff_segment_writer_submit(hls->writer, &sub_out, vs->vtt_m3u8_name, options,
+                                           NULL, NULL, SEGMENT_WRITER_ORDERED);
+        ffio_free_dyn_buf(&out);
+        ffio_free_dyn_buf(&sub_out);
+        av_dict_free(&options);
+    } else {
+        av_dict_free(&options);
+        hlsenc_io_close(s, &out, temp_filename);
+        hlsenc_io_close(s, &sub_out, vs->vtt_m3u8_name);
+        if (ret >= 0 && use_rename)
+            ff_rename(temp_filename, vs->m3u8_name, s);
+    }
 
     if (ret >= 0 && hls->master_pl_name)
         if (create_master_playlist(s, vs) < 0)
@@ -1424,7 +1635,17 @@ static int hls_start(AVFormatContext *s, VariantStream *vs)
             snprintf(iv_string, sizeof(iv_string), "%032"PRIx64, vs->sequence);
         if ((err = av_dict_set(&options, "encryption_iv", iv_string, 0)) < 0)
            goto fail;
+    }
 
+    if (c->writer) {
+        /* the segment is built in memory and written by the writer threads
+         * once complete, with these options */
+        av_dict_free(&vs->segment_options);
+        vs->segment_options = options;
+        options = NULL;
+        if (!oc->pb && (err = avio_open_dyn_buf(&oc->pb)) < 0)
+            goto fail;
+    } else if (c->key_info_file || c->encrypt) {
         filename = av_asprintf("crypto:%s", oc->filename);
         if (!filename) {
             err = AVERROR(ENOMEM);
@@ -1436,11 +1657,15 @@ static int hls_start(AVFormatContext *s, VariantStream *vs)
         if (err < 0)
             return err;
     } else
-        if ((err = s->io_open(s, &oc->pb, oc->filename, AVIO_FLAG_WRITE, &options)) < 0)
+        if ((err = hlsenc_io_open(s, &oc->pb, oc->filename, &options)) < 0)
             goto fail;
     if (vs->vtt_basename) {
         set_http_options(s, &options, c);
-        if ((err = s->io_open(s, &vtt_oc->pb, vtt_oc->filename, AVIO_FLAG_WRITE, &options)) < 0)
+        if (c->writer)
+            err = avio_open_dyn_buf(&vtt_oc->pb);
+        else
+            err = hlsenc_io_open(s, &vtt_oc->pb, vtt_oc->filename, &options);
+        if (err < 0)
             goto fail;
     }
     av_dict_free(&options);
@@ -1681,6 +1906,9 @@ static int hls_write_header(AVFormatContext *s)
     VariantStream *vs = NULL;
     int fmp4_init_filename_len = strlen(hls->fmp4_init_filename) + 1;
 
+    if (hls->http_persistent && !(hls->http_pool = ff_http_pool_alloc()))
+        return AVERROR(ENOMEM);
+
     ret = update_variant_stream_info(s);
     if (ret < 0) {
         av_log(s, AV_LOG_ERROR, "Variant stream info update failed with status %x\n",
@@ -1695,6 +1923,33 @@ static int hls_write_header(AVFormatContext *s)
         goto fail;
     }
 
+    if (hls->part_time > 0) {
+        if (hls->segment_type != SEGMENT_TYPE_FMP4 ||
+            (hls->flags & (HLS_SINGLE_FILE | HLS_TEMP_FILE |
+                           HLS_SECOND_LEVEL_SEGMENT_DURATION |
+                           HLS_SECOND_LEVEL_SEGMENT_SIZE)) ||
+            hls->max_seg_size > 0 || hls->encrypt || hls->key_info_file) {
+            av_log(s, AV_LOG_WARNING, "Partial segments need fmp4 segments written "
+                   "in place and unencrypted, disabling hls_part_time\n");
+            hls->part_time = 0;
+        } else if (hls->part_time > hls->time) {
+            av_log(s, AV_LOG_WARNING, "hls_part_time is larger than hls_time, "
+                   "setting it to hls_time\n");
+            hls->part_time = hls->time;
+        }
+    }
+
+    if (hls->writer_threads > 0) {
+        if ((hls->flags & HLS_SINGLE_FILE) || hls->max_seg_size > 0 || hls->part_time > 0) {
+            av_log(s, AV_LOG_WARNING, "Segments written in place are not supported "
+                   "by writer threads, writing them synchronously\n");
+        } else if ((ret = ff_segment_writer_alloc(&hls->writer, s, hls->writer_threads,
+                                                  hls->writer_queue_size,
+                                                  hlsenc_io_open, hlsenc_io_close)) < 0) {
+            goto fail;
+        }
+    }
+
     if (hls->master_pl_name) {
         ret = update_master_pl_info(s);
         if (ret < 0) {
@@ -1730,6 +1985,7 @@ static int hls_write_header(AVFormatContext *s)
     vs->sequence       = hls->start_sequence;
     hls->recording_time = (hls->init_time ? hls->init_time : hls->time) * AV_TIME_BASE;
     vs->start_pts      = AV_NOPTS_VALUE;
+    vs->part_start_pts = AV_NOPTS_VALUE;
     vs->current_segment_final_filename_fmt[0] = '\0';
 
     if (hls->flags & HLS_PROGRAM_DATE_TIME) {
@@ -2047,6 +2303,50 @@ fail:
     return ret;
 }
 
+/* Write the init segment, built in memory in oc->pb, which is freed. */
+static int hls_write_init_file(AVFormatContext *s, VariantStream *vs)
+{
+    HLSContext *hls = s->priv_data;
+    AVFormatContext *oc = vs->avf;
+    AVDictionary *options = NULL;
+    uint8_t *buffer = NULL;
+    int ret = 0;
+
+    vs->init_range_length = avio_get_dyn_buf(oc->pb, &buffer);
+    if (hls->writer) {
+        set_http_options(s, &options, hls);
+        ret = ff_segment_writer_submit(hls->writer, &oc->pb, vs->base_output_dirname,
+                                       options, NULL, NULL, SEGMENT_WRITER_ORDERED);
+        av_dict_free(&options);
+    } else {
+        avio_write(vs->out, buffer, vs->init_range_length);
+        hlsenc_io_close(s, &vs->out, vs->base_output_dirname);
+        ffio_free_dyn_buf(&oc->pb);
+    }
+    return ret;
+}
+
+/* Write the init segment as soon as the stream parameters are known, so
+ * that the first parts of the first segment do not also carry the packets
+ * buffered until the first segment boundary. */
+static int hls_write_init_segment(AVFormatContext *s, VariantStream *vs)
+{
+    int ret;
+
+    /* only the moov is written here, the samples stay buffered */
+    if ((ret = av_write_frame(vs->avf, NULL)) < 0)
+        return ret;
+    if ((ret = hls_write_init_file(s, vs)) < 0)
+        return ret;
+
+    vs->fmp4_init_mode = 0;
+    vs->number--;
+    if ((ret = hls_start(s, vs)) < 0)
+        return ret;
+    vs->start_pos = 0;
+    return hls_window(s, 0, vs);
+}
+
 static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
 {
     HLSContext *hls = s->priv_data;
@@ -2056,8 +2356,6 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
     int is_ref_pkt = 1;
     int ret = 0, can_split = 1, i, j;
     int stream_index = 0;
-    int range_length = 0;
-    uint8_t *buffer = NULL;
     VariantStream *vs = NULL;
 
     for (i = 0; i < hls->nb_varstreams; i++) {
@@ -2129,6 +2427,7 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
         int64_t new_start_pos;
         char *old_filename = av_strdup(vs->avf->filename);
         int byterange_mode = (hls->flags & HLS_SINGLE_FILE) || (hls->max_seg_size > 0);
+        int submit_segment = 0;
 
         if (!old_filename) {
             return AVERROR(ENOMEM);
@@ -2139,20 +2438,48 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
         new_start_pos = avio_tell(vs->avf->pb);
         vs->size = new_start_pos - vs->start_pos;
 
+        if (hls->part_time > 0 && !vs->fmp4_init_mode) {
+            HLSPart *parts = vs->prev_parts;
+            unsigned int parts_size = vs->prev_parts_size;
+
+            if (vs->part_start_pts != AV_NOPTS_VALUE)
+                ret = hls_append_part(vs, new_start_pos,
+                                      (double)(pkt->pts - vs->part_start_pts) * st->time_base.num / st->time_base.den);
+            if (ret < 0) {
+                av_free(old_filename);
+                return ret;
+            }
+            vs->prev_parts      = vs->parts;
+            vs->prev_parts_size = vs->parts_size;
+            vs->nb_prev_parts   = vs->nb_parts;
+            vs->parts           = parts;
+            vs->parts_size      = parts_size;
+            vs->nb_parts        = 0;
+        }
+
         if (!byterange_mode) {
             if (hls->segment_type == SEGMENT_TYPE_FMP4 && !vs->init_range_length) {
-                avio_flush(oc->pb);
-                range_length = avio_close_dyn_buf(oc->pb, &buffer);
-                avio_write(vs->out, buffer, range_length);
-                vs->init_range_length = range_length;
-                avio_open_dyn_buf(&oc->pb);
+                ret = hls_write_init_file(s, vs);
                 vs->packets_written = 0;
-                ff_format_io_close(s, &vs->out);
+                if (ret < 0) {
+                    av_free(old_filename);
+                    return ret;
+                }
+            } else if (hls->writer) {
+                /* handed over below, once its final name is known */
+                submit_segment = 1;
             } else {
-                ff_format_io_close(s, &oc->pb);
+                hlsenc_io_close(s, &oc->pb, oc->filename);
             }
             if (vs->vtt_avf) {
-                ff_format_io_close(s, &vs->vtt_avf->pb);
+                if (hls->writer)
+                    ret = hls_submit_vtt_segment(s, vs);
+                else
+                    hlsenc_io_close(s, &vs->vtt_avf->pb, vs->vtt_avf->filename);
+                if (ret < 0) {
+                    av_free(old_filename);
+                    return ret;
+                }
             }
         }
         if ((hls->flags & HLS_TEMP_FILE) && oc->filename[0]) {
@@ -2193,7 +2520,10 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
             vs->number++;
         } else {
             sls_flag_file_rename(hls, vs, old_filename);
-            ret = hls_start(s, vs);
+            if (submit_segment)
+                ret = hls_submit_segment(s, vs);
+            if (ret >= 0)
+                ret = hls_start(s, vs);
         }
         av_free(old_filename);
 
@@ -2201,14 +2531,55 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
             return ret;
         }
 
+        vs->part_start_pts = AV_NOPTS_VALUE;
+        vs->part_start_pos = 0;
+
         if (!vs->fmp4_init_mode || byterange_mode)
             if ((ret = hls_window(s, 0, vs)) < 0) {
                 return ret;
             }
+        export_http_stats(hls);
+    }
+
+    if (hls->part_time > 0 && is_ref_pkt && oc == vs->avf && !vs->fmp4_init_mode) {
+        /* end the part before the packet which would make it longer than
+         * the target, or on the first packet after it if the duration of
+         * the packets is unknown */
+        int64_t part_end = pkt->duration > 0 ? pkt->pts + pkt->duration : pkt->pts;
+        int cmp = vs->part_start_pts == AV_NOPTS_VALUE ? -1 :
+                  av_compare_ts(part_end - vs->part_start_pts, st->time_base,
+                                hls->part_time * AV_TIME_BASE, AV_TIME_BASE_Q);
+
+        if (pkt->duration > 0 ? cmp > 0 : cmp >= 0) {
+            av_write_frame(oc, NULL); /* Flush the fragment of the part */
+            avio_flush(oc->pb);
+            ret = hls_append_part(vs, avio_tell(oc->pb),
+                                  (double)(pkt->pts - vs->part_start_pts) * st->time_base.num / st->time_base.den);
+            if (ret < 0)
+                return ret;
+            vs->part_start_pts = AV_NOPTS_VALUE;
+            if ((ret = hls_window(s, 0, vs)) < 0)
+                return ret;
+        }
+        if (vs->part_start_pts == AV_NOPTS_VALUE) {
+            vs->part_start_pts   = pkt->pts;
+            vs->part_independent = !vs->has_video || (pkt->flags & AV_PKT_FLAG_KEY);
+        }
     }
 
     vs->packets_written++;
     ret = ff_write_chained(oc, stream_index, pkt, s, 0);
+    if (ret < 0)
+        return ret;
+
+    if (hls->part_time > 0 && vs->fmp4_init_mode && oc == vs->avf) {
+        if ((ret = hls_write_init_segment(s, vs)) < 0)
+            return ret;
+        if (is_ref_pkt) {
+            vs->part_start_pts   = pkt->pts;
+            vs->part_independent = !vs->has_video || (pkt->flags & AV_PKT_FLAG_KEY);
+        }
+    }
 
     return ret;
 }
@@ -2221,6 +2592,7 @@ static int hls_write_trailer(struct AVFormatContext *s)
     char *old_filename = NULL;
     int i;
     VariantStream *vs = NULL;
+    int ret = 0, ret2;
 
     for (i = 0; i < hls->nb_varstreams; i++) {
         vs = &hls->var_streams[i];
@@ -2237,7 +2609,8 @@ static int hls_write_trailer(struct AVFormatContext *s)
     av_write_trailer(oc);
     if (oc->pb) {
         vs->size = avio_tell(vs->avf->pb) - vs->start_pos;
-        ff_format_io_close(s, &oc->pb);
+        if (!hls->writer)
+            hlsenc_io_close(s, &oc->pb, oc->filename);
 
         if ((hls->flags & HLS_TEMP_FILE) && oc->filename[0]) {
             hls_rename_temp_file(s, oc);
@@ -2248,12 +2621,22 @@ static int hls_write_trailer(struct AVFormatContext *s)
     }
 
     sls_flag_file_rename(hls, vs, old_filename);
+    if (hls->writer && oc->pb) {
+        ret2 = hls_submit_segment(s, vs);
+        if (ret2 < 0 && ret >= 0)
+            ret = ret2;
+    }
 
     if (vtt_oc) {
         if (vtt_oc->pb)
             av_write_trailer(vtt_oc);
         vs->size = avio_tell(vs->vtt_avf->pb) - vs->start_pos;
-        ff_format_io_close(s, &vtt_oc->pb);
+        if (hls->writer && vtt_oc->pb) {
+            ret2 = hls_submit_vtt_segment(s, vs);
+            if (ret2 < 0 && ret >= 0)
+                ret = ret2;
+        } else
+            hlsenc_io_close(s, &vtt_oc->pb, vtt_oc->filename);
     }
     av_freep(&vs->basename);
     av_freep(&vs->base_output_dirname);
@@ -2271,16 +2654,37 @@ static int hls_write_trailer(struct AVFormatContext *s)
 
     hls_free_segments(vs->segments);
     hls_free_segments(vs->old_segments);
+    av_freep(&vs->parts);
+    av_freep(&vs->prev_parts);
     av_free(old_filename);
     av_freep(&vs->m3u8_name);
     av_freep(&vs->streams);
     av_freep(&vs->baseurl);
+    av_dict_free(&vs->segment_options);
     }
 
     av_freep(&hls->key_basename);
     av_freep(&hls->var_streams);
     av_freep(&hls->master_m3u8_url);
-    return 0;
+    ret2 = hls->writer ? ff_segment_writer_flush(hls->writer) : 0;
+    if (ret2 < 0 && ret >= 0)
+        ret = ret2;
+    export_http_stats(hls);
+    return ret;
+}
+
+static void hls_deinit(AVFormatContext *s)
+{
+    HLSContext *hls = s->priv_data;
+    int i;
+
+    /* the writer threads may still use the connection pool */
+    ff_segment_writer_free(&hls->writer);
+    ff_http_pool_free(s, &hls->http_pool);
+
+    /* the trailer frees the variant streams, but is not called on errors */
+    for (i = 0; hls->var_streams && i < hls->nb_varstreams; i++)
+        av_dict_free(&hls->var_streams[i].segment_options);
 }
 
 #define OFFSET(x) offsetof(HLSContext, x)
@@ -2289,6 +2693,7 @@ static const AVOption options[] = {
     {"start_number",  "set first number in the sequence",        OFFSET(start_sequence),AV_OPT_TYPE_INT64,  {.i64 = 0},     0, INT64_MAX, E},
     {"hls_time",      "set segment length in seconds",           OFFSET(time),    AV_OPT_TYPE_FLOAT,  {.dbl = 2},     0, FLT_MAX, E},
     {"hls_init_time", "set segment length in seconds at init list",           OFFSET(init_time),    AV_OPT_TYPE_FLOAT,  {.dbl = 0},     0, FLT_MAX, E},
+    {"hls_part_time", "set partial segment length in seconds for low-latency playlists", OFFSET(part_time), AV_OPT_TYPE_FLOAT, {.dbl = 0}, 0, FLT_MAX, E},
     {"hls_list_size", "set maximum number of playlist entries",  OFFSET(max_nb_segments),    AV_OPT_TYPE_INT,    {.i64 = 5},     0, INT_MAX, E},
     {"hls_ts_options","set hls mpegts list of options for the container format used for hls", OFFSET(format_options_str), AV_OPT_TYPE_STRING, {.str = NULL},  0, 0,    E},
     {"hls_vtt_options","set hls vtt list of options for the container format used for hls", OFFSET(vtt_format_options_str), AV_OPT_TYPE_STRING, {.str = NULL},  0, 0,    E},
@@ -2337,6 +2742,14 @@ static const AVOption options[] = {
     {"var_stream_map", "Variant stream map string", OFFSET(var_stream_map), AV_OPT_TYPE_STRING, {.str = NULL},  0, 0,    E},
     {"master_pl_name", "Create HLS master playlist with this name", OFFSET(master_pl_name), AV_OPT_TYPE_STRING, {.str = NULL},  0, 0,    E},
     {"master_pl_publish_rate", "Publish master play list every after this many segment intervals", OFFSET(master_publish_rate), AV_OPT_TYPE_INT, {.i64 = 0}, 0, UINT_MAX, E},
+    {"http_persistent", "Use persistent HTTP connections", OFFSET(http_persistent), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, E },
+#define X AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY
+    {"http_requests", "Number of HTTP uploads and deletions sent with http_persistent", OFFSET(http_requests), AV_OPT_TYPE_INT64, {.i64 = 0}, 0, INT64_MAX, X },
+    {"http_reused", "Number of HTTP requests sent on an open connection", OFFSET(http_reused), AV_OPT_TYPE_INT64, {.i64 = 0}, 0, INT64_MAX, X },
+    {"http_connections", "Number of new HTTP connections", OFFSET(http_connections), AV_OPT_TYPE_INT64, {.i64 = 0}, 0, INT64_MAX, X },
+    {"http_dropped", "Number of idle HTTP connections closed by the server", OFFSET(http_dropped), AV_OPT_TYPE_INT64, {.i64 = 0}, 0, INT64_MAX, X },
+    {"writer_threads", "set the number of threads writing the segments and playlists", OFFSET(writer_threads), AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX, E },
+    {"writer_queue_size", "set the maximum number of files waiting to be written", OFFSET(writer_queue_size), AV_OPT_TYPE_INT, {.i64 = 4}, 1, INT_MAX, E },
     { NULL },
 };
 
@@ -2360,5 +2773,6 @@ AVOutputFormat ff_hls_muxer = {
     .write_header   = hls_write_header,
     .write_packet   = hls_write_packet,
     .write_trailer  = hls_write_trailer,
+    .deinit         = hls_deinit,
     .priv_class     = &hls_class,
 };
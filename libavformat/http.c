@@ -74,6 +74,7 @@ typedef struct HTTPContext {
     char *http_proxy;
     char *headers;
     char *mime_type;
+    char *etag;
     char *user_agent;
 #if FF_API_HTTP_USER_AGENT
     char *user_agent_deprecated;
@@ -144,6 +145,7 @@ static const AVOption options[] = {
     { "multiple_requests", "use persistent connections", OFFSET(multiple_requests), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, D | E },
     { "post_data", "set custom HTTP post data", OFFSET(post_data), AV_OPT_TYPE_BINARY, .flags = D | E },
     { "mime_type", "export the MIME type", OFFSET(mime_type), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY },
+    { "etag", "export the entity tag", OFFSET(etag), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY },
     { "cookies", "set cookies to be sent in applicable future requests, use newline delimited Set-Cookie HTTP field value syntax", OFFSET(cookies), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, D },
     { "icy", "request ICY metadata", OFFSET(icy), AV_OPT_TYPE_BOOL, { .i64 = 1 }, 0, 1, D },
     { "icy_metadata_headers", "return ICY metadata headers", OFFSET(icy_metadata_headers), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, AV_OPT_FLAG_EXPORT },
@@ -946,6 +948,9 @@ static int process_line(URLContext *h, char *line, int line_count,
         } else if (!av_strcasecmp(tag, "Content-Type")) {
             av_free(s->mime_type);
             s->mime_type = av_strdup(p);
+        } else if (!av_strcasecmp(tag, "ETag")) {
+            av_free(s->etag);
+            s->etag = av_strdup(p);
         } else if (!av_strcasecmp(tag, "Set-Cookie")) {
             if (parse_cookie(s, p, &s->cookie_dict))
                 av_log(h, AV_LOG_WARNING, "Unable to parse '%s'\n", p);
@@ -1586,6 +1591,93 @@ static int http_close(URLContext *h)
     return ret;
 }
 
+int ff_http_do_new_request2(URLContext *h, const char *uri, AVDictionary **opts)
+{
+    HTTPContext *s = h->priv_data;
+    AVDictionary *options = NULL;
+    char proto1[10], proto2[10], hostname1[1024], hostname2[1024];
+    int port1, port2, ret;
+
+    av_url_split(proto1, sizeof(proto1), NULL, 0, hostname1, sizeof(hostname1),
+                 &port1, NULL, 0, s->location);
+    av_url_split(proto2, sizeof(proto2), NULL, 0, hostname2, sizeof(hostname2),
+                 &port2, NULL, 0, uri);
+    if (strcmp(proto1, proto2) || strcmp(hostname1, hostname2) || port1 != port2) {
+        av_log(h, AV_LOG_ERROR, "Cannot reuse the connection to %s:%d for %s:%d\n",
+               hostname1, port1, hostname2, port2);
+        return AVERROR(EINVAL);
+    }
+
+    av_freep(&s->method);
+    if (opts && (ret = av_opt_set_dict(s, opts)) < 0)
+        return ret;
+
+    s->chunkend      = 0;
+    s->off           = 0;
+    s->icy_data_read = 0;
+    av_free(s->location);
+    s->location = av_strdup(uri);
+    if (!s->location)
+        return AVERROR(ENOMEM);
+
+    ret = http_open_cnx(h, &options);
+    av_dict_free(&options);
+    return ret;
+}
+
+int ff_http_finish_request(URLContext *h)
+{
+    HTTPContext *s = h->priv_data;
+    uint8_t buf[1024];
+    int new_location, ret;
+
+    if (!s->end_chunked_post && (ret = http_shutdown(h, h->flags)) < 0)
+        return ret;
+    /* without chunked encoding the end of the body is the end of the
+     * connection */
+    if (!s->hd || !s->multiple_requests || !s->chunked_post || s->post_data)
+        return 0;
+
+    if (!s->end_header) {
+        if ((ret = http_read_header(h, &new_location)) < 0)
+            return ret;
+    } else if (s->http_code < 200) {
+        /* the final reply to an Expect: 100-continue has not been read */
+        return 0;
+    }
+
+    if (s->chunksize == UINT64_MAX && s->filesize == UINT64_MAX) {
+        /* a body delimited by the end of the connection, unless the
+         * reply has none */
+        return s->http_code == 204 || s->http_code == 304 ? !s->willclose : 0;
+    }
+    if (s->willclose)
+        return 0;
+    while ((ret = http_buf_read(h, buf, sizeof(buf))) > 0)
+        ;
+    if (ret < 0 && ret != AVERROR_EOF)
+        return ret;
+
+    return !!s->hd;
+}
+
+int ff_http_connection_alive(URLContext *h)
+{
+    HTTPContext *s = h->priv_data;
+    uint8_t c;
+    int ret;
+
+    if (!s->hd || s->willclose)
+        return 0;
+
+    /* a kept-alive connection does not receive anything between two
+     * requests, anything else than EAGAIN means that it has been closed */
+    s->hd->flags |= AVIO_FLAG_NONBLOCK;
+    ret = ffurl_read(s->hd, &c, 1);
+    s->hd->flags &= ~AVIO_FLAG_NONBLOCK;
+    return ret == AVERROR(EAGAIN);
+}
+
 static int64_t http_seek_internal(URLContext *h, int64_t off, int whence, int force_reconnect)
 {
     HTTPContext *s = h->priv_data;
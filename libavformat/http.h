@@ -47,6 +47,40 @@ void ff_http_init_auth_state(URLContext *dest, const URLContext *src);
  */
 int ff_http_do_new_request(URLContext *h, const char *uri);
 
+/**
+ * Send a new HTTP request on the connection of h, reusing its options
+ * except for the method, which is reset to the default.
+ *
+ * The request must be to the same host and port, and the previous one
+ * must have been completed with ff_http_finish_request().
+ *
+ * @param h pointer to the resource
+ * @param uri uri used to perform the request
+ * @param options options applied to h before the request, may be NULL;
+ *                the applied entries are removed from it
+ * @return a negative value if an error condition occurred, 0
+ * otherwise
+ */
+int ff_http_do_new_request2(URLContext *h, const char *uri, AVDictionary **options);
+
+/**
+ * Complete an upload on a persistent connection: signal the end of the
+ * request body, read the reply and discard its body.
+ *
+ * @param h pointer to the resource
+ * @return a negative value if the request failed, 1 if the connection
+ * can be used for another request, 0 otherwise
+ */
+int ff_http_finish_request(URLContext *h);
+
+/**
+ * Check if an idle persistent connection is still open.
+ *
+ * @param h pointer to the resource
+ * @return 1 if a new request can be sent on the connection, 0 otherwise
+ */
+int ff_http_connection_alive(URLContext *h);
+
 int ff_http_averror(int status_code, int default_averror);
 
 #endif /* AVFORMAT_HTTP_H */
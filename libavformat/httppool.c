@@ -0,0 +1,211 @@
+/*
+ * Pool of persistent HTTP connections for muxers
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+
+#include "libavutil/avstring.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+
+#include "avio_internal.h"
+#include "http.h"
+#include "httppool.h"
+#include "internal.h"
+#include "url.h"
+
+typedef struct HTTPPoolEntry {
+    AVIOContext *pb;
+    char *key;              ///< protocol, credentials, host and port
+} HTTPPoolEntry;
+
+struct HTTPPool {
+    HTTPPoolEntry *idle;
+    int nb_idle;
+    unsigned idle_size;
+    HTTPPoolStats stats;
+    AVMutex mutex;          ///< protects idle and stats
+};
+
+static int is_http_url(const char *url)
+{
+    const char *proto = avio_find_protocol_name(url);
+
+    return proto && (!strcmp(proto, "http") || !strcmp(proto, "https"));
+}
+
+static char *connection_key(const char *url)
+{
+    char proto[10], auth[1024], hostname[1024];
+    int port;
+
+    av_url_split(proto, sizeof(proto), auth, sizeof(auth),
+                 hostname, sizeof(hostname), &port, NULL, 0, url);
+    return av_asprintf("%s://%s@%s:%d", proto, auth, hostname, port);
+}
+
+HTTPPool *ff_http_pool_alloc(void)
+{
+    HTTPPool *pool = av_mallocz(sizeof(HTTPPool));
+
+    if (pool && ff_mutex_init(&pool->mutex, NULL)) {
+        av_free(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+void ff_http_pool_free(AVFormatContext *s, HTTPPool **ppool)
+{
+    HTTPPool *pool = *ppool;
+    int i;
+
+    if (!pool)
+        return;
+
+    av_log(s, AV_LOG_VERBOSE, "HTTP connection pool: %u requests, %u reused "
+           "connections, %u new connections, %u dropped connections\n",
+           pool->stats.requests, pool->stats.reused,
+           pool->stats.connections, pool->stats.dropped);
+
+    for (i = 0; i < pool->nb_idle; i++) {
+        ff_format_io_close(s, &pool->idle[i].pb);
+        av_free(pool->idle[i].key);
+    }
+    av_freep(&pool->idle);
+    ff_mutex_destroy(&pool->mutex);
+    av_freep(ppool);
+}
+
+int ff_http_pool_open(HTTPPool *pool, AVFormatContext *s, AVIOContext **pb,
+                      const char *url, AVDictionary **options)
+{
+    AVDictionary *tmp = NULL;
+    char *key;
+    int i, ret;
+
+    if (!pool || !is_http_url(url))
+        return s->io_open(s, pb, url, AVIO_FLAG_WRITE, options);
+
+    if (!(key = connection_key(url)))
+        return AVERROR(ENOMEM);
+    ff_mutex_lock(&pool->mutex);
+    pool->stats.requests++;
+
+#if CONFIG_HTTP_PROTOCOL
+    for (i = pool->nb_idle - 1; i >= 0; i = FFMIN(i, pool->nb_idle) - 1) {
+        HTTPPoolEntry entry = pool->idle[i];
+        URLContext *h = ffio_geturlcontext(entry.pb);
+
+        if (strcmp(entry.key, key))
+            continue;
+        pool->idle[i] = pool->idle[--pool->nb_idle];
+        av_free(entry.key);
+
+        /* the connection is now owned by this request, the lock is not
+         * held while talking to the server */
+        ff_mutex_unlock(&pool->mutex);
+        if (ff_http_connection_alive(h) &&
+            ff_http_do_new_request2(h, url, options) >= 0) {
+            entry.pb->pos         = 0;
+            entry.pb->written     = 0;
+            entry.pb->eof_reached = 0;
+            entry.pb->error       = 0;
+            *pb = entry.pb;
+            ff_mutex_lock(&pool->mutex);
+            pool->stats.reused++;
+            ff_mutex_unlock(&pool->mutex);
+            av_free(key);
+            return 0;
+        }
+        /* the server closed the connection, send the request on a new one */
+        ff_format_io_close(s, &entry.pb);
+        ff_mutex_lock(&pool->mutex);
+        pool->stats.dropped++;
+    }
+#endif
+    ff_mutex_unlock(&pool->mutex);
+    av_free(key);
+
+    if (!options)
+        options = &tmp;
+    av_dict_set(options, "multiple_requests", "1", 0);
+    ret = s->io_open(s, pb, url, AVIO_FLAG_WRITE, options);
+    av_dict_free(&tmp);
+    if (ret < 0)
+        return ret;
+    ff_mutex_lock(&pool->mutex);
+    pool->stats.connections++;
+    ff_mutex_unlock(&pool->mutex);
+    return 0;
+}
+
+int ff_http_pool_close(HTTPPool *pool, AVFormatContext *s, AVIOContext **pb)
+{
+    URLContext *h = ffio_geturlcontext(*pb);
+    HTTPPoolEntry *idle;
+    char *key;
+    int ret;
+
+    if (!pool || !h || !is_http_url(h->filename)) {
+        ff_format_io_close(s, pb);
+        return 0;
+    }
+
+    avio_flush(*pb);
+    ret = (*pb)->error;
+#if CONFIG_HTTP_PROTOCOL
+    if (ret >= 0)
+        ret = ff_http_finish_request(h);
+#else
+    ret = FFMIN(ret, 0);
+#endif
+    if (ret <= 0) {
+        ff_format_io_close(s, pb);
+        return ret;
+    }
+
+    if (!(key = connection_key(h->filename))) {
+        ff_format_io_close(s, pb);
+        return 0;
+    }
+    ff_mutex_lock(&pool->mutex);
+    idle = av_fast_realloc(pool->idle, &pool->idle_size,
+                           (pool->nb_idle + 1) * sizeof(*pool->idle));
+    if (!idle) {
+        ff_mutex_unlock(&pool->mutex);
+        av_free(key);
+        ff_format_io_close(s, pb);
+        return 0;
+    }
+    pool->idle = idle;
+    pool->idle[pool->nb_idle].pb  = *pb;
+    pool->idle[pool->nb_idle].key = key;
+    pool->nb_idle++;
+    ff_mutex_unlock(&pool->mutex);
+    *pb = NULL;
+    return 0;
+}
+
+void ff_http_pool_get_stats(HTTPPool *pool, HTTPPoolStats *stats)
+{
+    ff_mutex_lock(&pool->mutex);
+    *stats = pool->stats;
+    ff_mutex_unlock(&pool->mutex);
+}
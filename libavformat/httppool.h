@@ -0,0 +1,74 @@
+/*
+ * Pool of persistent HTTP connections for muxers
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_HTTPPOOL_H
+#define AVFORMAT_HTTPPOOL_H
+
+#include "libavutil/dict.h"
+
+#include "avformat.h"
+
+/**
+ * A set of idle keep-alive HTTP connections, which muxers writing many
+ * files to a server can use to send each upload on an open connection
+ * instead of connecting again.
+ *
+ * Outputs which are not HTTP URLs, or not opened by the default
+ * AVFormatContext.io_open() callback, are opened and closed normally.
+ * A pool may be used from several threads at once, each connection being
+ * used by one request at a time.
+ */
+typedef struct HTTPPool HTTPPool;
+
+typedef struct HTTPPoolStats {
+    unsigned requests;      ///< HTTP outputs opened through the pool
+    unsigned reused;        ///< requests sent on an idle connection
+    unsigned connections;   ///< new connections
+    unsigned dropped;       ///< idle connections found closed by the server
+} HTTPPoolStats;
+
+HTTPPool *ff_http_pool_alloc(void);
+
+/**
+ * Close the idle connections with AVFormatContext.io_close() of s and free
+ * the pool. The statistics are logged at verbose level.
+ */
+void ff_http_pool_free(AVFormatContext *s, HTTPPool **pool);
+
+/**
+ * Open url for writing, with AVFormatContext.io_open() of s or on an idle
+ * connection to the same server.
+ *
+ * @param pool the pool, may be NULL to open url normally
+ */
+int ff_http_pool_open(HTTPPool *pool, AVFormatContext *s, AVIOContext **pb,
+                      const char *url, AVDictionary **options);
+
+/**
+ * Complete the upload to *pb and keep its connection open for later
+ * requests, or close it.
+ *
+ * @return a negative value if the upload failed, 0 otherwise
+ */
+int ff_http_pool_close(HTTPPool *pool, AVFormatContext *s, AVIOContext **pb);
+
+void ff_http_pool_get_stats(HTTPPool *pool, HTTPPoolStats *stats);
+
+#endif /* AVFORMAT_HTTPPOOL_H */
@@ -148,6 +148,11 @@ struct MpegTSContext {
 
     int resync_size;
 
+    /** program numbers to demux, all programs if empty */
+    char *programs_str;
+    int *programs;
+    int nb_programs;
+
     /******************************************/
     /* private mpegts data */
     /* scan context */
@@ -159,13 +164,25 @@ struct MpegTSContext {
     /** filters for various streams specified by PMT + for the PAT and PMT */
     MpegTSFilter *pids[NB_PID_MAX];
     int current_pid;
+
+    /** one bit per PID with a filter which is not discarded */
+    uint32_t pid_map[NB_PID_MAX / 32];
+    int pid_map_valid;
+    /** AVProgram.discard values pid_map was computed with */
+    enum AVDiscard *program_discard;
+    unsigned int program_discard_size;
+    int nb_program_discard;
 };
 
+#define PID_WANTED(ts, pid) ((ts)->pid_map[(pid) >> 5] & (1U << ((pid) & 31)))
+
 #define MPEGTS_OPTIONS \
     { "resync_size",   "set size limit for looking up a new synchronization", offsetof(MpegTSContext, resync_size), AV_OPT_TYPE_INT,  { .i64 =  MAX_RESYNC_SIZE}, 0, INT_MAX,  AV_OPT_FLAG_DECODING_PARAM }
 
 static const AVOption options[] = {
     MPEGTS_OPTIONS,
+    {"programs", "comma-separated list of the program numbers to demux, the others are not parsed", offsetof(MpegTSContext, programs_str), AV_OPT_TYPE_STRING,
+     {.str = NULL}, 0, 0, AV_OPT_FLAG_DECODING_PARAM },
     {"fix_teletext_pts", "try to fix pts values of dvb teletext streams", offsetof(MpegTSContext, fix_teletext_pts), AV_OPT_TYPE_BOOL,
      {.i64 = 1}, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
     {"ts_packetsize", "output option carrying the raw packet size", offsetof(MpegTSContext, raw_packet_size), AV_OPT_TYPE_INT,
@@ -275,6 +292,7 @@ static void clear_program(MpegTSContext *ts, unsigned int programid)
 {
     int i;
 
+    ts->pid_map_valid = 0;
     clear_avprogram(ts, programid);
     for (i = 0; i < ts->nb_prg; i++)
         if (ts->prg[i].id == programid) {
@@ -287,6 +305,7 @@ static void clear_programs(MpegTSContext *ts)
 {
     av_freep(&ts->prg);
     ts->nb_prg = 0;
+    ts->pid_map_valid = 0;
 }
 
 static void add_pat_entry(MpegTSContext *ts, unsigned int programid)
@@ -319,6 +338,7 @@ static void add_pid_to_pmt(MpegTSContext *ts, unsigned int programid,
             return;
 
     p->pids[p->nb_pids++] = pid;
+    ts->pid_map_valid = 0;
 }
 
 static void set_pmt_found(MpegTSContext *ts, unsigned int programid)
@@ -383,6 +403,57 @@ static int discard_pid(MpegTSContext *ts, unsigned int pid)
     return !used && discarded;
 }
 
+static void update_pid_map(MpegTSContext *ts)
+{
+    AVFormatContext *s = ts->stream;
+    enum AVDiscard *discard;
+    int i;
+
+    discard = av_fast_realloc(ts->program_discard, &ts->program_discard_size,
+                              s->nb_programs * sizeof(*discard));
+    if (discard) {
+        ts->program_discard = discard;
+        for (i = 0; i < s->nb_programs; i++)
+            discard[i] = s->programs[i]->discard;
+        ts->nb_program_discard = s->nb_programs;
+    } else {
+        ts->nb_program_discard = -1;
+    }
+
+    memset(ts->pid_map, 0, sizeof(ts->pid_map));
+    for (i = 0; i < NB_PID_MAX; i++)
+        if (ts->pids[i] && !(i && discard_pid(ts, i)))
+            ts->pid_map[i >> 5] |= 1U << (i & 31);
+    ts->pid_map_valid = 1;
+}
+
+/* programs may be discarded by the user between packets */
+static void check_program_discard(MpegTSContext *ts)
+{
+    AVFormatContext *s = ts->stream;
+    int i;
+
+    if (ts->nb_program_discard != s->nb_programs) {
+        ts->pid_map_valid = 0;
+        return;
+    }
+    for (i = 0; i < s->nb_programs; i++)
+        if (ts->program_discard[i] != s->programs[i]->discard)
+            ts->pid_map_valid = 0;
+}
+
+static int program_wanted(MpegTSContext *ts, int sid)
+{
+    int i;
+
+    if (!ts->nb_programs)
+        return 1;
+    for (i = 0; i < ts->nb_programs; i++)
+        if (ts->programs[i] == sid)
+            return 1;
+    return 0;
+}
+
 /**
  *  Assemble PES packets out of TS packets, and then call the "section_cb"
  *  function when they are complete.
@@ -454,6 +525,7 @@ static MpegTSFilter *mpegts_open_filter(MpegTSContext *ts, unsigned int pid,
     if (!filter)
         return NULL;
     ts->pids[pid] = filter;
+    ts->pid_map_valid = 0;
 
     filter->type    = type;
     filter->pid     = pid;
@@ -529,6 +601,7 @@ static void mpegts_close_filter(MpegTSContext *ts, MpegTSFilter *filter)
 
     av_free(filter);
     ts->pids[pid] = NULL;
+    ts->pid_map_valid = 0;
 }
 
 static int analyze(const uint8_t *buf, int size, int packet_size,
@@ -1942,6 +2015,9 @@ static void pmt_cb(MpegTSFilter *filter, const uint8_t *section, int section_len
         return;
     if (!ts->scan_all_pmts && ts->skip_changes)
         return;
+    /* the PMT PID may be shared with programs which are not demuxed */
+    if (!program_wanted(ts, h->id))
+        return;
 
     if (!ts->skip_clear)
         clear_program(ts, h->id);
@@ -2126,6 +2202,8 @@ static void pat_cb(MpegTSFilter *filter, const uint8_t *section, int section_len
 
         if (sid == 0x0000) {
             /* NIT info */
+        } else if (!program_wanted(ts, sid)) {
+            av_log(ts->stream, AV_LOG_TRACE, "program 0x%x not demuxed\n", sid);
         } else {
             MpegTSFilter *fil = ts->pids[pmt_pid];
             program = av_new_program(ts->stream, sid);
@@ -2223,7 +2301,7 @@ static void sdt_cb(MpegTSFilter *filter, const uint8_t *section, int section_len
                 if (!provider_name)
                     break;
                 name = getstr8(&p, p_end);
-                if (name) {
+                if (name && program_wanted(ts, sid)) {
                     AVProgram *program = av_new_program(ts->stream, sid);
                     if (program) {
                         av_dict_set(&program->metadata, "service_name", name, 0);
@@ -2256,14 +2334,17 @@ static int handle_packet(MpegTSContext *ts, const uint8_t *packet)
     int64_t pos;
 
     pid = AV_RB16(packet + 1) & 0x1fff;
-    if (pid && discard_pid(ts, pid))
-        return 0;
     is_start = packet[1] & 0x40;
-    tss = ts->pids[pid];
-    if (ts->auto_guess && !tss && is_start) {
+    if (!ts->pid_map_valid)
+        update_pid_map(ts);
+    if (!PID_WANTED(ts, pid)) {
+        /* discarded, or without filter */
+        if (ts->pids[pid] || !ts->auto_guess || !is_start ||
+            (pid && discard_pid(ts, pid)))
+            return 0;
         add_pes_stream(ts, pid, -1);
-        tss = ts->pids[pid];
     }
+    tss = ts->pids[pid];
     if (!tss)
         return 0;
     ts->current_pid = pid;
@@ -2469,6 +2550,45 @@ static int read_packet(AVFormatContext *s, uint8_t *buf, int raw_packet_size,
     return 0;
 }
 
+/**
+ * Drop the packets of the PIDs which are not demuxed straight from the I/O
+ * buffer: the sync bytes of all the packets in the buffer are checked at
+ * once, then the packets are skipped up to the first one to handle.
+ *
+ * @return number of packets dropped
+ */
+static int skip_packets(MpegTSContext *ts, int max_packets)
+{
+    AVIOContext *pb = ts->stream->pb;
+    const int raw_packet_size = ts->raw_packet_size;
+    const uint8_t *p = pb->buf_ptr;
+    int i, n = FFMIN((pb->buf_end - p) / raw_packet_size, max_packets);
+
+    for (i = 0; i + 4 <= n; i += 4)
+        if ((p[ i      * raw_packet_size] ^ 0x47) |
+            (p[(i + 1) * raw_packet_size] ^ 0x47) |
+            (p[(i + 2) * raw_packet_size] ^ 0x47) |
+            (p[(i + 3) * raw_packet_size] ^ 0x47))
+            break;
+    for (; i < n; i++)
+        if (p[i * raw_packet_size] != 0x47)
+            break;
+    n = i;
+
+    for (i = 0; i < n; i++, p += raw_packet_size) {
+        int pid = AV_RB16(p + 1) & 0x1fff;
+
+        if (PID_WANTED(ts, pid) ||
+            (ts->auto_guess && !ts->pids[pid] && (p[1] & 0x40)))
+            break;
+    }
+    if (i) {
+        ts->pos47_full = avio_tell(pb) + (i - 1) * raw_packet_size;
+        avio_skip(pb, i * raw_packet_size);
+    }
+    return i;
+}
+
 static void finished_reading_packet(AVFormatContext *s, int raw_packet_size)
 {
     AVIOContext *pb = s->pb;
@@ -2505,6 +2625,8 @@ static int handle_packets(MpegTSContext *ts, int64_t nb_packets)
         }
     }
 
+    check_program_discard(ts);
+
     ts->stop_parse = 0;
     packet_num = 0;
     memset(packet + TS_PACKET_SIZE, 0, AV_INPUT_BUFFER_PADDING_SIZE);
@@ -2518,6 +2640,14 @@ static int handle_packets(MpegTSContext *ts, int64_t nb_packets)
         if (ts->stop_parse > 0)
             break;
 
+        if (!ts->pid_map_valid)
+            update_pid_map(ts);
+        packet_num += skip_packets(ts, nb_packets ? nb_packets - packet_num : INT_MAX);
+        if (nb_packets != 0 && packet_num >= nb_packets) {
+            ret = AVERROR(EAGAIN);
+            break;
+        }
+
         ret = read_packet(s, packet, ts->raw_packet_size, &data);
         if (ret != 0)
             break;
@@ -2599,6 +2729,29 @@ static int parse_pcr(int64_t *ppcr_high, int *ppcr_low, const uint8_t *packet)
     return 0;
 }
 
+static int parse_programs(AVFormatContext *s, MpegTSContext *ts)
+{
+    const char *p = ts->programs_str;
+
+    while (p && *p) {
+        char *end;
+        long sid = strtol(p, &end, 0);
+
+        if (end == p || sid <= 0 || sid > 0xffff || (*end && *end != ',')) {
+            av_log(s, AV_LOG_ERROR, "Invalid program list '%s'\n", ts->programs_str);
+            return AVERROR(EINVAL);
+        }
+        if (av_reallocp_array(&ts->programs, ts->nb_programs + 1,
+                              sizeof(*ts->programs)) < 0) {
+            ts->nb_programs = 0;
+            return AVERROR(ENOMEM);
+        }
+        ts->programs[ts->nb_programs++] = sid;
+        p = *end ? end + 1 : end;
+    }
+    return 0;
+}
+
 static void seek_back(AVFormatContext *s, AVIOContext *pb, int64_t pos) {
 
     /* NOTE: We attempt to seek on non-seekable files as well, as the
@@ -2613,11 +2766,14 @@ static int mpegts_read_header(AVFormatContext *s)
     MpegTSContext *ts = s->priv_data;
     AVIOContext *pb   = s->pb;
     uint8_t buf[8 * 1024] = {0};
-    int len;
+    int len, ret;
     int64_t pos, probesize = s->probesize;
 
     s->internal->prefer_codec_framerate = 1;
 
+    if ((ret = parse_programs(s, ts)) < 0)
+        return ret;
+
     if (ffio_ensure_seekback(pb, probesize) < 0)
         av_log(s, AV_LOG_WARNING, "Failed to allocate buffers for seekback\n");
 
@@ -2643,16 +2799,17 @@ static int mpegts_read_header(AVFormatContext *s)
         mpegts_open_section_filter(ts, PAT_PID, pat_cb, ts, 1);
 
         handle_packets(ts, probesize / ts->raw_packet_size);
-        /* if could not find service, enable auto_guess */
+        /* if could not find service, enable auto_guess; streams found this
+         * way belong to no program, unless only some programs are demuxed */
 
-        ts->auto_guess = 1;
+        ts->auto_guess = !ts->nb_programs;
 
         av_log(ts->stream, AV_LOG_TRACE, "tuning done\n");
 
         s->ctx_flags |= AVFMTCTX_NOHEADER;
     } else {
         AVStream *st;
-        int pcr_pid, pid, nb_packets, nb_pcrs, ret, pcr_l;
+        int pcr_pid, pid, nb_packets, nb_pcrs, pcr_l;
         int64_t pcrs[2], pcr_h;
         int packet_count[2];
         uint8_t packet[TS_PACKET_SIZE];
@@ -2800,6 +2957,8 @@ static void mpegts_free(MpegTSContext *ts)
     int i;
 
     clear_programs(ts);
+    av_freep(&ts->programs);
+    av_freep(&ts->program_discard);
 
     for (i = 0; i < NB_PID_MAX; i++)
         if (ts->pids[i])
@@ -2910,6 +3069,7 @@ int avpriv_mpegts_parse_packet(MpegTSContext *ts, AVPacket *pkt,
 
     len1 = len;
     ts->pkt = pkt;
+    check_program_discard(ts);
     for (;;) {
         ts->stop_parse = 0;
         if (len < TS_PACKET_SIZE)
@@ -0,0 +1,504 @@
+/*
+ * Input read-ahead protocol with concurrent block requests.
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Read-ahead protocol: the input is split in fixed size blocks which are
+ * fetched by several threads, each with its own connection to the inner
+ * URL, so that several range requests are in flight at the same time.
+ * The blocks following the read position are requested in advance, and
+ * the fetched blocks are kept in a cache, so seeks back to data already
+ * read, or forward to data being read ahead, do not wait on the network.
+ */
+
+#include "libavutil/avstring.h"
+#include "libavutil/error.h"
+#include "libavutil/log.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+#include "libavutil/thread.h"
+#include "url.h"
+
+enum BlockState {
+    BLOCK_EMPTY,
+    BLOCK_QUEUED,   ///< waiting for a worker
+    BLOCK_LOADING,  ///< being fetched by a worker
+    BLOCK_READY,
+};
+
+typedef struct Block {
+    int64_t  pos;       ///< position of the block in the input
+    uint8_t *data;
+    int      size;      ///< bytes available, less than block_size at the end
+    int      error;     ///< error reading after size bytes, AVERROR_EOF at the end
+    enum BlockState state;
+    uint64_t last_use;
+} Block;
+
+typedef struct Worker {
+    URLContext *h;
+    URLContext *inner;
+    int64_t     inner_pos;
+    pthread_t   thread;
+    int         thread_started;
+} Worker;
+
+typedef struct Context {
+    AVClass        *class;
+
+    Block          *blocks;
+    Worker         *workers;
+    int             nb_workers;
+
+    int64_t         logical_pos;
+    int64_t         logical_size;
+    uint64_t        use_count;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond_work;
+    pthread_cond_t  cond_done;
+
+    int             abort_request;
+    AVIOInterruptCB interrupt_callback;
+
+    /* options */
+    int             block_size;
+    int             nb_requests;
+    int             nb_blocks;
+
+    /* statistics, exported */
+    int64_t         fills;
+    int64_t         hits;
+    int64_t         waits;
+} Context;
+
+static int readahead_check_interrupt(void *arg)
+{
+    URLContext *h = arg;
+    Context    *c = h->priv_data;
+
+    if (c->abort_request)
+        return 1;
+
+    if (ff_check_interrupt(&c->interrupt_callback))
+        c->abort_request = 1;
+
+    return c->abort_request;
+}
+
+static Block *next_queued_block(Context *c)
+{
+    Block *next = NULL;
+    int i;
+
+    for (i = 0; i < c->nb_blocks; i++) {
+        Block *b = &c->blocks[i];
+        if (b->state == BLOCK_QUEUED && (!next || b->pos < next->pos))
+            next = b;
+    }
+    return next;
+}
+
+static void fetch_block(Context *c, Worker *w, Block *b)
+{
+    int ret = 0, size = 0;
+
+    if (w->inner_pos != b->pos) {
+        int64_t pos = ffurl_seek(w->inner, b->pos, SEEK_SET);
+        if (pos < 0) {
+            ret = pos;
+            w->inner_pos = -1;
+        } else {
+            w->inner_pos = pos;
+        }
+    }
+
+    while (ret >= 0 && size < c->block_size) {
+        ret = ffurl_read(w->inner, b->data + size, c->block_size - size);
+        if (ret == 0)
+            ret = AVERROR_EOF;
+        if (ret > 0) {
+            size         += ret;
+            w->inner_pos += ret;
+        }
+    }
+
+    b->size  = size;
+    b->error = size < c->block_size ? ret : 0;
+}
+
+static void *readahead_worker(void *arg)
+{
+    Worker  *w = arg;
+    Context *c = w->h->priv_data;
+
+    pthread_mutex_lock(&c->mutex);
+    while (1) {
+        Block *b;
+
+        if (readahead_check_interrupt(w->h))
+            break;
+        if (!(b = next_queued_block(c))) {
+            pthread_cond_wait(&c->cond_work, &c->mutex);
+            continue;
+        }
+
+        b->state = BLOCK_LOADING;
+        pthread_mutex_unlock(&c->mutex);
+
+        fetch_block(c, w, b);
+
+        pthread_mutex_lock(&c->mutex);
+        b->state = BLOCK_READY;
+        c->fills++;
+        pthread_cond_broadcast(&c->cond_done);
+    }
+    pthread_cond_broadcast(&c->cond_done);
+    pthread_mutex_unlock(&c->mutex);
+
+    return NULL;
+}
+
+static Block *find_block(Context *c, int64_t pos)
+{
+    int i;
+
+    for (i = 0; i < c->nb_blocks; i++)
+        if (c->blocks[i].state != BLOCK_EMPTY && c->blocks[i].pos == pos)
+            return &c->blocks[i];
+    return NULL;
+}
+
+/**
+ * Find a block to store the data at pos: an empty block, or the least
+ * recently used one which is not being fetched and is outside of the
+ * read-ahead window starting at window_pos.
+ */
+static Block *get_free_block(Context *c, int64_t window_pos)
+{
+    int64_t window_end = window_pos + (int64_t)c->nb_requests * c->block_size;
+    Block *lru = NULL;
+    int i;
+
+    for (i = 0; i < c->nb_blocks; i++) {
+        Block *b = &c->blocks[i];
+        if (b->state == BLOCK_EMPTY)
+            return b;
+        if (b->state != BLOCK_READY || (b->pos >= window_pos && b->pos < window_end))
+            continue;
+        if (!lru || b->last_use < lru->last_use)
+            lru = b;
+    }
+    return lru;
+}
+
+static Block *queue_block(Context *c, int64_t pos, int64_t window_pos)
+{
+    Block *b = get_free_block(c, window_pos);
+
+    if (!b)
+        return NULL;
+    b->pos      = pos;
+    b->size     = 0;
+    b->error    = 0;
+    b->state    = BLOCK_QUEUED;
+    b->last_use = c->use_count;
+    pthread_cond_signal(&c->cond_work);
+    return b;
+}
+
+/**
+ * Make the blocks of the read-ahead window starting at the block at pos
+ * requested, after dropping the requests which are not started yet and
+ * fall outside of it.
+ */
+static void update_window(Context *c, int64_t pos)
+{
+    int64_t window_end = pos + (int64_t)c->nb_requests * c->block_size;
+    int i;
+
+    for (i = 0; i < c->nb_blocks; i++) {
+        Block *b = &c->blocks[i];
+        if (b->state == BLOCK_QUEUED && (b->pos < pos || b->pos >= window_end))
+            b->state = BLOCK_EMPTY;
+    }
+
+    for (i = 0; i < c->nb_requests; i++) {
+        int64_t block_pos = pos + (int64_t)i * c->block_size;
+        Block *b;
+
+        if (c->logical_size > 0 && block_pos >= c->logical_size)
+            break;
+        if ((b = find_block(c, block_pos))) {
+            if (b->state == BLOCK_READY && b->error < 0 && b->error != AVERROR_EOF)
+                b->state = BLOCK_EMPTY; // retry after a read error
+            else if (b->error)
+                break;
+            else
+                continue;
+        }
+        if (!queue_block(c, block_pos, pos))
+            break;
+    }
+}
+
+static int readahead_read(URLContext *h, unsigned char *buf, int size)
+{
+    Context *c        = h->priv_data;
+    int64_t block_pos = c->logical_pos - c->logical_pos % c->block_size;
+    int     waited    = 0;
+    int     ret;
+    Block  *b;
+
+    /* no block is ever requested there, do not wait for one */
+    if (c->logical_size > 0 && block_pos >= c->logical_size)
+        return AVERROR_EOF;
+
+    pthread_mutex_lock(&c->mutex);
+    update_window(c, block_pos);
+
+    while (1) {
+        if (readahead_check_interrupt(h)) {
+            ret = AVERROR_EXIT;
+            break;
+        }
+        b = find_block(c, block_pos);
+        if (!b) {
+            /* all the blocks are in use by fetches outside of the window */
+            waited = 1;
+            pthread_cond_wait(&c->cond_done, &c->mutex);
+            update_window(c, block_pos);
+            continue;
+        }
+        if (b->state != BLOCK_READY) {
+            waited = 1;
+            pthread_cond_wait(&c->cond_done, &c->mutex);
+            continue;
+        }
+
+        b->last_use = ++c->use_count;
+        ret = c->logical_pos - b->pos;
+        if (ret < b->size) {
+            size = FFMIN(size, b->size - ret);
+            memcpy(buf, b->data + ret, size);
+            c->logical_pos += size;
+            ret = size;
+        } else {
+            ret = b->error;
+        }
+        break;
+    }
+
+    if (ret > 0) {
+        if (waited)
+            c->waits++;
+        else
+            c->hits++;
+    }
+    pthread_mutex_unlock(&c->mutex);
+
+    return ret;
+}
+
+static int64_t readahead_seek(URLContext *h, int64_t pos, int whence)
+{
+    Context *c = h->priv_data;
+
+    if (whence == AVSEEK_SIZE)
+        return c->logical_size;
+    else if (whence == SEEK_CUR)
+        pos += c->logical_pos;
+    else if (whence == SEEK_END && c->logical_size > 0)
+        pos += c->logical_size;
+    else if (whence != SEEK_SET)
+        return AVERROR(EINVAL);
+    if (pos < 0)
+        return AVERROR(EINVAL);
+
+    /* the blocks are fetched on the next read, from the cache if possible */
+    c->logical_pos = pos;
+    return pos;
+}
+
+static int readahead_close(URLContext *h)
+{
+    Context *c = h->priv_data;
+    int i, ret;
+
+    pthread_mutex_lock(&c->mutex);
+    c->abort_request = 1;
+    pthread_cond_broadcast(&c->cond_work);
+    pthread_mutex_unlock(&c->mutex);
+
+    for (i = 0; c->workers && i < c->nb_workers; i++) {
+        Worker *w = &c->workers[i];
+        if (w->thread_started && (ret = pthread_join(w->thread, NULL)))
+            av_log(h, AV_LOG_ERROR, "pthread_join(): %s\n", av_err2str(ret));
+        ffurl_closep(&w->inner);
+    }
+    if (c->blocks)
+        for (i = 0; i < c->nb_blocks; i++)
+            av_freep(&c->blocks[i].data);
+    av_freep(&c->blocks);
+    av_freep(&c->workers);
+
+    pthread_cond_destroy(&c->cond_done);
+    pthread_cond_destroy(&c->cond_work);
+    pthread_mutex_destroy(&c->mutex);
+
+    av_log(h, AV_LOG_VERBOSE, "%"PRId64" blocks fetched, %"PRId64" reads from the cache, "
+           "%"PRId64" reads waiting for data\n", c->fills, c->hits, c->waits);
+
+    return 0;
+}
+
+static int readahead_open(URLContext *h, const char *arg, int flags, AVDictionary **options)
+{
+    Context         *c = h->priv_data;
+    AVIOInterruptCB  interrupt_callback = {.callback = readahead_check_interrupt, .opaque = h};
+    AVDictionary    *inner_options = NULL;
+    int              i, ret;
+
+    av_strstart(arg, "readahead:", &arg);
+
+    if (flags & AVIO_FLAG_WRITE)
+        return AVERROR(ENOSYS);
+
+    c->nb_blocks = FFMAX(c->nb_blocks, c->nb_requests + 1);
+
+    ret = pthread_mutex_init(&c->mutex, NULL);
+    if (ret != 0) {
+        av_log(h, AV_LOG_ERROR, "pthread_mutex_init failed : %s\n", av_err2str(ret));
+        return AVERROR(ret);
+    }
+    ret = pthread_cond_init(&c->cond_work, NULL);
+    if (ret != 0) {
+        av_log(h, AV_LOG_ERROR, "pthread_cond_init failed : %s\n", av_err2str(ret));
+        pthread_mutex_destroy(&c->mutex);
+        return AVERROR(ret);
+    }
+    ret = pthread_cond_init(&c->cond_done, NULL);
+    if (ret != 0) {
+        av_log(h, AV_LOG_ERROR, "pthread_cond_init failed : %s\n", av_err2str(ret));
+        pthread_cond_destroy(&c->cond_work);
+        pthread_mutex_destroy(&c->mutex);
+        return AVERROR(ret);
+    }
+
+    c->blocks  = av_mallocz_array(c->nb_blocks, sizeof(*c->blocks));
+    c->workers = av_mallocz_array(c->nb_requests, sizeof(*c->workers));
+    if (!c->blocks || !c->workers) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    for (i = 0; i < c->nb_blocks; i++) {
+        if (!(c->blocks[i].data = av_malloc(c->block_size))) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+    }
+
+    /* wrap interrupt callback */
+    c->interrupt_callback = h->interrupt_callback;
+
+    /* every worker has its own connection, opened with the same options */
+    if (options)
+        av_dict_copy(&inner_options, *options, 0);
+    for (i = 0; i < c->nb_requests; i++) {
+        Worker *w = &c->workers[i];
+        AVDictionary *tmp = NULL;
+
+        if (i)
+            av_dict_copy(&tmp, inner_options, 0);
+        ret = ffurl_open_whitelist(&w->inner, arg, flags, &interrupt_callback,
+                                   i ? &tmp : options,
+                                   h->protocol_whitelist, h->protocol_blacklist, h);
+        av_dict_free(&tmp);
+        if (ret < 0) {
+            av_log(h, AV_LOG_ERROR, "ffurl_open failed : %s, %s\n", av_err2str(ret), arg);
+            goto fail;
+        }
+        w->h = h;
+
+        if (!i) {
+            c->logical_size = ffurl_size(w->inner);
+            h->is_streamed  = w->inner->is_streamed;
+            /* the data can only be fetched sequentially */
+            if (h->is_streamed)
+                c->nb_requests = 1;
+        }
+    }
+    c->nb_workers = c->nb_requests;
+
+    for (i = 0; i < c->nb_workers; i++) {
+        Worker *w = &c->workers[i];
+        ret = pthread_create(&w->thread, NULL, readahead_worker, w);
+        if (ret) {
+            av_log(h, AV_LOG_ERROR, "pthread_create failed : %s\n", av_err2str(ret));
+            ret = AVERROR(ret);
+            goto fail;
+        }
+        w->thread_started = 1;
+    }
+
+    av_dict_free(&inner_options);
+    return 0;
+
+fail:
+    av_dict_free(&inner_options);
+    c->nb_workers = c->nb_requests;
+    readahead_close(h);
+    return ret;
+}
+
+#define OFFSET(x) offsetof(Context, x)
+#define D AV_OPT_FLAG_DECODING_PARAM
+#define X AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY
+
+static const AVOption options[] = {
+    { "readahead_block_size", "size of the blocks requested from the input", OFFSET(block_size), AV_OPT_TYPE_INT, { .i64 = 1024 * 1024 }, 4096, INT_MAX / 2, D },
+    { "readahead_requests", "number of concurrent block requests", OFFSET(nb_requests), AV_OPT_TYPE_INT, { .i64 = 4 }, 1, 64, D },
+    { "readahead_blocks", "number of blocks kept in memory", OFFSET(nb_blocks), AV_OPT_TYPE_INT, { .i64 = 16 }, 2, INT_MAX, D },
+    { "readahead_fills", "number of blocks fetched from the input", OFFSET(fills), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, X },
+    { "readahead_hits", "number of reads served without waiting", OFFSET(hits), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, X },
+    { "readahead_waits", "number of reads which waited for a block", OFFSET(waits), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, X },
+    { NULL },
+};
+
+#undef X
+#undef D
+#undef OFFSET
+
+static const AVClass readahead_context_class = {
+    .class_name = "readahead",
+    .item_name  = av_default_item_name,
+    .option     = options,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
+const URLProtocol ff_readahead_protocol = {
+    .name                = "readahead",
+    .url_open2           = readahead_open,
+    .url_read            = readahead_read,
+    .url_seek            = readahead_seek,
+    .url_close           = readahead_close,
+    .priv_data_size      = sizeof(Context),
+    .priv_data_class     = &readahead_context_class,
+};
@@ -30,6 +30,7 @@
 #include "avformat.h"
 #include "avio_internal.h"
 #include "internal.h"
+#include "segwriter.h"
 
 #include "libavutil/avassert.h"
 #include "libavutil/internal.h"
@@ -121,6 +122,10 @@ typedef struct SegmentContext {
     int use_rename;
     char temp_list_filename[1024];
 
+    int writer_threads;    ///< number of threads writing the segments
+    int writer_queue_size; ///< maximum number of segments waiting to be written
+    SegmentWriter *writer;
+
     SegmentListEntry cur_entry;
     SegmentListEntry *segment_list_entries;
     SegmentListEntry *segment_list_entries_end;
@@ -186,6 +191,29 @@ static int segment_mux_init(AVFormatContext *s)
     return 0;
 }
 
+static int segment_writer_open(AVFormatContext *s, AVIOContext **pb,
+                               const char *url, AVDictionary **options)
+{
+    return s->io_open(s, pb, url, AVIO_FLAG_WRITE, options);
+}
+
+static void segment_writer_close(AVFormatContext *s, AVIOContext **pb,
+                                 const char *url)
+{
+    ff_format_io_close(s, pb);
+}
+
+/* With writer threads, segments and lists are built in memory and written
+ * by the threads once complete. */
+static int segment_open(AVFormatContext *s, AVIOContext **pb, const char *url)
+{
+    SegmentContext *seg = s->priv_data;
+
+    if (seg->writer)
+        return avio_open_dyn_buf(pb);
+    return s->io_open(s, pb, url, AVIO_FLAG_WRITE, NULL);
+}
+
 static int set_segment_filename(AVFormatContext *s)
 {
     SegmentContext *seg = s->priv_data;
@@ -245,7 +273,7 @@ static int segment_start(AVFormatContext *s, int write_header)
     if ((err = set_segment_filename(s)) < 0)
         return err;
 
-    if ((err = s->io_open(s, &oc->pb, oc->filename, AVIO_FLAG_WRITE, NULL)) < 0) {
+    if ((err = segment_open(s, &oc->pb, oc->filename)) < 0) {
         av_log(s, AV_LOG_ERROR, "Failed to open segment '%s'\n", oc->filename);
         return err;
     }
@@ -275,7 +303,7 @@ static int segment_list_open(AVFormatContext *s)
     int ret;
 
     snprintf(seg->temp_list_filename, sizeof(seg->temp_list_filename), seg->use_rename ? "%s.tmp" : "%s", seg->list);
-    ret = s->io_open(s, &seg->list_pb, seg->temp_list_filename, AVIO_FLAG_WRITE, NULL);
+    ret = segment_open(s, &seg->list_pb, seg->temp_list_filename);
     if (ret < 0) {
         av_log(s, AV_LOG_ERROR, "Failed to open segment list '%s'\n", seg->list);
         return ret;
@@ -362,8 +390,15 @@ static int segment_end(AVFormatContext *s, int write_trailer, int is_last)
         av_log(s, AV_LOG_ERROR, "Failure occurred when ending segment '%s'\n",
                oc->filename);
 
+    /* hand over the segment before the list referencing it */
+    if (seg->writer && (err = ff_segment_writer_submit(seg->writer, &oc->pb, oc->filename,
+                                                       NULL, NULL, NULL, 0)) < 0) {
+        ret = err;
+        goto end;
+    }
+
     if (seg->list) {
-        if (seg->list_size || seg->list_type == LIST_TYPE_M3U8) {
+        if (seg->list_size || seg->list_type == LIST_TYPE_M3U8 || seg->writer) {
             SegmentListEntry *entry = av_mallocz(sizeof(*entry));
             if (!entry) {
                 ret = AVERROR(ENOMEM);
@@ -393,9 +428,17 @@ static int segment_end(AVFormatContext *s, int write_trailer, int is_last)
                 segment_list_print_entry(seg->list_pb, seg->list_type, entry, s);
             if (seg->list_type == LIST_TYPE_M3U8 && is_last)
                 avio_printf(seg->list_pb, "#EXT-X-ENDLIST\n");
-            ff_format_io_close(s, &seg->list_pb);
-            if (seg->use_rename)
-                ff_rename(seg->temp_list_filename, seg->list, s);
+            if (seg->writer) {
+                ret = ff_segment_writer_submit(seg->writer, &seg->list_pb, seg->temp_list_filename, NULL,
+                                               seg->use_rename ? seg->temp_list_filename : NULL,
+                                               seg->list, SEGMENT_WRITER_ORDERED);
+                if (ret < 0)
+                    goto end;
+            } else {
+                ff_format_io_close(s, &seg->list_pb);
+                if (seg->use_rename)
+                    ff_rename(seg->temp_list_filename, seg->list, s);
+            }
         } else {
             segment_list_print_entry(seg->list_pb, seg->list_type, &seg->cur_entry, s);
             avio_flush(seg->list_pb);
@@ -430,7 +473,10 @@ static int segment_end(AVFormatContext *s, int write_trailer, int is_last)
     }
 
 end:
-    ff_format_io_close(oc, &oc->pb);
+    if (seg->writer)
+        ffio_free_dyn_buf(&oc->pb);
+    else
+        ff_format_io_close(oc, &oc->pb);
 
     return ret;
 }
@@ -632,6 +678,10 @@ static int select_reference_stream(AVFormatContext *s)
 static void seg_free(AVFormatContext *s)
 {
     SegmentContext *seg = s->priv_data;
+    if (seg->writer) {
+        ffio_free_dyn_buf(&seg->list_pb);
+        ff_segment_writer_free(&seg->writer);
+    }
     ff_format_io_close(seg->avf, &seg->list_pb);
     avformat_free_context(seg->avf);
     seg->avf = NULL;
@@ -700,6 +750,13 @@ static int seg_init(AVFormatContext *s)
         }
     }
 
+    if (seg->writer_threads > 0) {
+        ret = ff_segment_writer_alloc(&seg->writer, s, seg->writer_threads, seg->writer_queue_size,
+                                      segment_writer_open, segment_writer_close);
+        if (ret < 0)
+            return ret;
+    }
+
     if (seg->list) {
         if (seg->list_type == LIST_TYPE_UNDEFINED) {
             if      (av_match_ext(seg->list, "csv" )) seg->list_type = LIST_TYPE_CSV;
@@ -708,7 +765,8 @@ static int seg_init(AVFormatContext *s)
             else if (av_match_ext(seg->list, "ffcat,ffconcat")) seg->list_type = LIST_TYPE_FFCONCAT;
             else                                      seg->list_type = LIST_TYPE_FLAT;
         }
-        if (!seg->list_size && seg->list_type != LIST_TYPE_M3U8) {
+        /* with writer threads, the whole list is written after each segment */
+        if (!seg->list_size && seg->list_type != LIST_TYPE_M3U8 && !seg->writer) {
             if ((ret = segment_list_open(s)) < 0)
                 return ret;
         } else {
@@ -744,9 +802,9 @@ static int seg_init(AVFormatContext *s)
     oc = seg->avf;
 
     if (seg->write_header_trailer) {
-        if ((ret = s->io_open(s, &oc->pb,
-                              seg->header_filename ? seg->header_filename : oc->filename,
-                              AVIO_FLAG_WRITE, NULL)) < 0) {
+        if ((ret = seg->header_filename ?
+                   s->io_open(s, &oc->pb, seg->header_filename, AVIO_FLAG_WRITE, NULL) :
+                   segment_open(s, &oc->pb, oc->filename)) < 0) {
             av_log(s, AV_LOG_ERROR, "Failed to open segment '%s'\n", oc->filename);
             return ret;
         }
@@ -769,7 +827,10 @@ static int seg_init(AVFormatContext *s)
     av_dict_free(&options);
 
     if (ret < 0) {
-        ff_format_io_close(oc, &oc->pb);
+        if (seg->writer && seg->write_header_trailer && !seg->header_filename)
+            ffio_free_dyn_buf(&oc->pb);
+        else
+            ff_format_io_close(oc, &oc->pb);
         return ret;
     }
     seg->segment_frame_count = 0;
@@ -830,7 +891,7 @@ static int seg_write_header(AVFormatContext *s)
         } else {
             close_null_ctxp(&oc->pb);
         }
-        if ((ret = oc->io_open(oc, &oc->pb, oc->filename, AVIO_FLAG_WRITE, NULL)) < 0)
+        if ((ret = segment_open(s, &oc->pb, oc->filename)) < 0)
             return ret;
         if (!seg->individual_header_trailer)
             oc->pb->seekable = 0;
@@ -971,6 +1032,11 @@ static int seg_write_trailer(struct AVFormatContext *s)
         ret = segment_end(s, 1, 1);
     }
 fail:
+    if (seg->writer) {
+        int err = ff_segment_writer_flush(seg->writer);
+        if (ret >= 0)
+            ret = err;
+    }
     if (seg->list)
         ff_format_io_close(s, &seg->list_pb);
 
@@ -1055,6 +1121,8 @@ static const AVOption options[] = {
     { "reset_timestamps", "reset timestamps at the beginning of each segment", OFFSET(reset_timestamps), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, E },
     { "initial_offset", "set initial timestamp offset", OFFSET(initial_offset), AV_OPT_TYPE_DURATION, {.i64 = 0}, -INT64_MAX, INT64_MAX, E },
     { "write_empty_segments", "allow writing empty 'filler' segments", OFFSET(write_empty), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, E },
+    { "writer_threads", "set the number of threads writing the segments", OFFSET(writer_threads), AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX, E },
+    { "writer_queue_size", "set the maximum number of segments waiting to be written", OFFSET(writer_queue_size), AV_OPT_TYPE_INT, {.i64 = 4}, 1, INT_MAX, E },
     { NULL },
 };
 
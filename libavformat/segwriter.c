@@ -0,0 +1,344 @@
+/*
+ * Asynchronous writer of segments and playlists for muxers
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+
+#include "libavutil/avstring.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+
+#include "avio_internal.h"
+#include "internal.h"
+#include "segwriter.h"
+
+typedef struct SegmentWriterJob {
+    uint8_t *data;
+    int size;
+    char *url;
+    AVDictionary *options;
+    char *rename_from;
+    char *rename_to;
+    int flags;
+    int delete;         ///< delete url instead of writing data to it
+    int started;
+    int done;
+} SegmentWriterJob;
+
+struct SegmentWriter {
+    AVFormatContext *s;
+    SegmentWriterOpenFunc io_open;
+    SegmentWriterCloseFunc io_close;
+
+    SegmentWriterJob *jobs; ///< queue_size jobs, in the order they were handed over
+    int queue_size;
+    int first;              ///< index of the oldest job not written yet
+    int nb_jobs;            ///< number of jobs not written yet
+    int error;              ///< first error which occurred while writing
+
+    int nb_files;
+    int64_t wait_time;      ///< time the muxer waited for a free queue slot
+
+    int nb_threads;
+#if HAVE_THREADS
+    pthread_t *threads;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int finished;
+#endif
+};
+
+static void free_job(SegmentWriterJob *job)
+{
+    av_freep(&job->data);
+    av_freep(&job->url);
+    av_dict_free(&job->options);
+    av_freep(&job->rename_from);
+    av_freep(&job->rename_to);
+}
+
+static int delete_job(SegmentWriter *w, SegmentWriterJob *job)
+{
+    AVIOContext *pb = NULL;
+    int ret;
+
+    if (!job->options) {
+        if ((ret = avpriv_io_delete(job->url)) < 0)
+            av_log(w->s, AV_LOG_ERROR, "Failed to delete '%s': %s\n",
+                   job->url, av_err2str(ret));
+        return 0;
+    }
+    if ((ret = w->io_open(w->s, &pb, job->url, &job->options)) < 0) {
+        av_log(w->s, AV_LOG_ERROR, "Failed to delete '%s'\n", job->url);
+        return ret;
+    }
+    w->io_close(w->s, &pb, job->url);
+    return 0;
+}
+
+static int write_job(SegmentWriter *w, SegmentWriterJob *job)
+{
+    AVIOContext *pb = NULL;
+    int ret;
+
+    if (job->delete)
+        return delete_job(w, job);
+
+    if ((ret = w->io_open(w->s, &pb, job->url, &job->options)) < 0) {
+        av_log(w->s, AV_LOG_ERROR, "Failed to open '%s'\n", job->url);
+        return ret;
+    }
+    avio_write(pb, job->data, job->size);
+    avio_flush(pb);
+    ret = pb->error;
+    w->io_close(w->s, &pb, job->url);
+    if (ret < 0) {
+        av_log(w->s, AV_LOG_ERROR, "Failed to write '%s'\n", job->url);
+        return ret;
+    }
+
+    if (job->rename_from)
+        ff_rename(job->rename_from, job->rename_to, w->s);
+    return 0;
+}
+
+#if HAVE_THREADS
+static SegmentWriterJob *next_job(SegmentWriter *w)
+{
+    int i;
+
+    for (i = 0; i < w->nb_jobs; i++) {
+        SegmentWriterJob *job = &w->jobs[(w->first + i) % w->queue_size];
+
+        if (job->started)
+            continue;
+        /* an ordered job waits for all the jobs before it */
+        if (!(job->flags & SEGMENT_WRITER_ORDERED) || !i)
+            return job;
+    }
+    return NULL;
+}
+
+static void *writer_thread(void *arg)
+{
+    SegmentWriter *w = arg;
+
+    pthread_mutex_lock(&w->mutex);
+    for (;;) {
+        SegmentWriterJob *job = next_job(w);
+        int ret;
+
+        if (!job) {
+            if (w->finished && !w->nb_jobs)
+                break;
+            pthread_cond_wait(&w->cond, &w->mutex);
+            continue;
+        }
+
+        job->started = 1;
+        pthread_mutex_unlock(&w->mutex);
+        ret = write_job(w, job);
+        pthread_mutex_lock(&w->mutex);
+
+        job->done = 1;
+        if (ret < 0 && !w->error)
+            w->error = ret;
+        /* retire the jobs in the order they were handed over */
+        while (w->nb_jobs && w->jobs[w->first].done) {
+            free_job(&w->jobs[w->first]);
+            memset(&w->jobs[w->first], 0, sizeof(*w->jobs));
+            w->first = (w->first + 1) % w->queue_size;
+            w->nb_jobs--;
+        }
+        pthread_cond_broadcast(&w->cond);
+    }
+    pthread_mutex_unlock(&w->mutex);
+
+    return NULL;
+}
+#endif
+
+int ff_segment_writer_alloc(SegmentWriter **pw, AVFormatContext *s,
+                            int nb_threads, int queue_size,
+                            SegmentWriterOpenFunc io_open,
+                            SegmentWriterCloseFunc io_close)
+{
+    SegmentWriter *w;
+#if HAVE_THREADS
+    int i, ret;
+#endif
+
+    if (!(w = av_mallocz(sizeof(*w))))
+        return AVERROR(ENOMEM);
+    w->s        = s;
+    w->io_open  = io_open;
+    w->io_close = io_close;
+    *pw = w;
+
+#if HAVE_THREADS
+    if (nb_threads <= 0)
+        return 0;
+
+    w->queue_size = FFMAX(queue_size, 1);
+    w->jobs       = av_mallocz_array(w->queue_size, sizeof(*w->jobs));
+    w->threads    = av_mallocz_array(nb_threads, sizeof(*w->threads));
+    if (!w->jobs || !w->threads) {
+        ff_segment_writer_free(pw);
+        return AVERROR(ENOMEM);
+    }
+    pthread_mutex_init(&w->mutex, NULL);
+    pthread_cond_init(&w->cond, NULL);
+
+    for (i = 0; i < nb_threads; i++) {
+        if ((ret = pthread_create(&w->threads[i], NULL, writer_thread, w))) {
+            av_log(s, AV_LOG_ERROR, "Failed to start writer thread: %s\n",
+                   av_err2str(AVERROR(ret)));
+            ff_segment_writer_free(pw);
+            return AVERROR(ret);
+        }
+        w->nb_threads++;
+    }
+#else
+    if (nb_threads > 0)
+        av_log(s, AV_LOG_WARNING, "Threads are not available, "
+               "segments will be written synchronously\n");
+#endif
+
+    return 0;
+}
+
+static int queue_job(SegmentWriter *w, SegmentWriterJob *job)
+{
+    int ret = 0;
+
+    if (!w->nb_threads) {
+        ret = write_job(w, job);
+        free_job(job);
+        w->nb_files++;
+        return ret;
+    }
+
+#if HAVE_THREADS
+    pthread_mutex_lock(&w->mutex);
+    if (w->nb_jobs == w->queue_size) {
+        int64_t start = av_gettime_relative();
+
+        while (w->nb_jobs == w->queue_size)
+            pthread_cond_wait(&w->cond, &w->mutex);
+        w->wait_time += av_gettime_relative() - start;
+    }
+    w->jobs[(w->first + w->nb_jobs) % w->queue_size] = *job;
+    w->nb_jobs++;
+    w->nb_files++;
+    ret = w->error;
+    pthread_cond_broadcast(&w->cond);
+    pthread_mutex_unlock(&w->mutex);
+#endif
+
+    return ret;
+}
+
+int ff_segment_writer_submit(SegmentWriter *w, AVIOContext **pb, const char *url,
+                             AVDictionary *options, const char *rename_from,
+                             const char *rename_to, int flags)
+{
+    SegmentWriterJob job = { 0 };
+
+    job.size  = avio_close_dyn_buf(*pb, &job.data);
+    *pb       = NULL;
+    job.flags = flags;
+    job.url   = av_strdup(url);
+    if (rename_from) {
+        job.rename_from = av_strdup(rename_from);
+        job.rename_to   = av_strdup(rename_to);
+    }
+    if (!job.url || (rename_from && (!job.rename_from || !job.rename_to)) ||
+        av_dict_copy(&job.options, options, 0) < 0) {
+        free_job(&job);
+        return AVERROR(ENOMEM);
+    }
+
+    return queue_job(w, &job);
+}
+
+int ff_segment_writer_delete(SegmentWriter *w, const char *url,
+                             AVDictionary *options, int flags)
+{
+    SegmentWriterJob job = { 0 };
+
+    job.delete = 1;
+    job.flags  = flags;
+    job.url    = av_strdup(url);
+    if (!job.url || av_dict_copy(&job.options, options, 0) < 0) {
+        free_job(&job);
+        return AVERROR(ENOMEM);
+    }
+
+    return queue_job(w, &job);
+}
+
+int ff_segment_writer_flush(SegmentWriter *w)
+{
+    int ret = 0;
+
+#if HAVE_THREADS
+    if (w->nb_threads) {
+        pthread_mutex_lock(&w->mutex);
+        while (w->nb_jobs)
+            pthread_cond_wait(&w->cond, &w->mutex);
+        ret = w->error;
+        pthread_mutex_unlock(&w->mutex);
+    }
+#endif
+
+    return ret;
+}
+
+void ff_segment_writer_free(SegmentWriter **pw)
+{
+    SegmentWriter *w = *pw;
+
+    if (!w)
+        return;
+
+#if HAVE_THREADS
+    if (w->nb_threads) {
+        int i;
+
+        pthread_mutex_lock(&w->mutex);
+        w->finished = 1;
+        pthread_cond_broadcast(&w->cond);
+        pthread_mutex_unlock(&w->mutex);
+        for (i = 0; i < w->nb_threads; i++)
+            pthread_join(w->threads[i], NULL);
+
+        av_log(w->s, AV_LOG_VERBOSE, "%d files written by %d threads, "
+               "muxer waited %0.3fs for a free queue slot\n",
+               w->nb_files, w->nb_threads, w->wait_time / 1000000.0);
+    }
+    if (w->jobs && w->threads) {
+        pthread_cond_destroy(&w->cond);
+        pthread_mutex_destroy(&w->mutex);
+    }
+    av_freep(&w->threads);
+#endif
+    av_freep(&w->jobs);
+    av_freep(pw);
+}
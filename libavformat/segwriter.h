@@ -0,0 +1,112 @@
+/*
+ * Asynchronous writer of segments and playlists for muxers
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_SEGWRITER_H
+#define AVFORMAT_SEGWRITER_H
+
+#include "libavutil/dict.h"
+
+#include "avformat.h"
+
+/**
+ * A pool of threads writing files which a segmenting muxer has built in
+ * memory, so that the muxer does not wait for the storage or the server.
+ *
+ * The muxer writes each segment or playlist to a dynamic buffer opened with
+ * avio_open_dyn_buf(), and hands it over to the writer once complete. Files
+ * are written in parallel, except ordered ones (playlists), which are only
+ * written once all the files handed over before them have been written, so
+ * that a playlist never references a segment which is not available yet.
+ * Files can also be handed over for deletion, ordered like the others.
+ *
+ * The number of files waiting to be written is bounded, the muxer blocks
+ * when handing over a file while the queue is full.
+ */
+typedef struct SegmentWriter SegmentWriter;
+
+/**
+ * Open the output url for writing, e.g. AVFormatContext.io_open() with
+ * AVIO_FLAG_WRITE. Called from the writer threads.
+ */
+typedef int (*SegmentWriterOpenFunc)(AVFormatContext *s, AVIOContext **pb,
+                                     const char *url, AVDictionary **options);
+
+typedef void (*SegmentWriterCloseFunc)(AVFormatContext *s, AVIOContext **pb,
+                                       const char *url);
+
+#define SEGMENT_WRITER_ORDERED 1 ///< write only once all previous files are written
+
+/**
+ * Allocate a writer.
+ *
+ * @param s           muxer, passed to the callbacks and used for logging
+ * @param nb_threads  number of writer threads; with 0, or if threads are not
+ *                    available, files are written synchronously when handed over
+ * @param queue_size  maximum number of files handed over but not written yet
+ */
+int ff_segment_writer_alloc(SegmentWriter **pw, AVFormatContext *s,
+                            int nb_threads, int queue_size,
+                            SegmentWriterOpenFunc io_open,
+                            SegmentWriterCloseFunc io_close);
+
+/**
+ * Hand over a file to write.
+ *
+ * @param pb          dynamic buffer holding the file, always closed and set
+ *                    to NULL
+ * @param url         url to open, may differ from rename_from by a protocol
+ *                    prefix (e.g. crypto:)
+ * @param options     options passed to io_open(), copied
+ * @param rename_from if not NULL, file to rename to rename_to once written
+ * @param flags       SEGMENT_WRITER_* flags
+ * @return 0, or the error of a file handed over before, or a negative
+ *         AVERROR code on failure
+ */
+int ff_segment_writer_submit(SegmentWriter *w, AVIOContext **pb, const char *url,
+                             AVDictionary *options, const char *rename_from,
+                             const char *rename_to, int flags);
+
+/**
+ * Hand over a file to delete, e.g. a segment which left the playlist.
+ *
+ * @param url     file to delete
+ * @param options if not NULL, url is opened with io_open() and these options
+ *                (e.g. method=DELETE for HTTP) and closed, instead of being
+ *                deleted with avpriv_io_delete()
+ * @param flags   SEGMENT_WRITER_* flags
+ * @return 0, or the error of a file handed over before, or a negative
+ *         AVERROR code on failure
+ */
+int ff_segment_writer_delete(SegmentWriter *w, const char *url,
+                             AVDictionary *options, int flags);
+
+/**
+ * Wait until all the files handed over are written.
+ *
+ * @return 0, or the first error which occurred while writing a file
+ */
+int ff_segment_writer_flush(SegmentWriter *w);
+
+/**
+ * Write the remaining files, stop the threads and free the writer.
+ */
+void ff_segment_writer_free(SegmentWriter **pw);
+
+#endif /* AVFORMAT_SEGWRITER_H */
@@ -538,11 +538,19 @@ static int tee_write_packet(AVFormatContext *avf, AVPacket *pkt)
     TeeContext *tee = avf->priv_data;
     AVFormatContext *avf2;
     AVBSFContext *bsfs;
-    AVPacket pkt2;
+    AVPacket pkt2, pkt_ref = { 0 };
     int ret_all = 0, ret;
     unsigned i, s;
     int s2;
 
+    /* Make the data refcounted once, so that the slaves, and the fifo
+     * queues in front of them, share it instead of copying it each. */
+    if (pkt && !pkt->buf) {
+        if ((ret = av_packet_ref(&pkt_ref, pkt)) < 0)
+            return ret;
+        pkt = &pkt_ref;
+    }
+
     for (i = 0; i < tee->nb_slaves; i++) {
         if (!(avf2 = tee->slaves[i].avf))
             continue;
@@ -603,6 +611,7 @@ static int tee_write_packet(AVFormatContext *avf, AVPacket *pkt)
                 ret_all = ret;
         }
     }
+    av_packet_unref(&pkt_ref);
     return ret_all;
 }
 
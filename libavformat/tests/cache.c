@@ -0,0 +1,305 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Read local files through the cache protocol with a bounded cache
+ * directory, and check the eviction, the reuse of the blocks by later opens
+ * of an unchanged file, their invalidation once it changed, and the bound
+ * shared by concurrent opens. Then check that a slow input is returned as
+ * it arrives.
+ */
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <io.h>
+#define pipe(fds) _pipe(fds, 65536, O_BINARY)
+#endif
+
+#include "libavutil/error.h"
+#include "libavutil/log.h"
+#include "libavformat/avformat.h"
+#include "libavformat/url.h"
+
+#define BLOCK_SIZE 4096
+#define DISK_SIZE  (4 * BLOCK_SIZE)
+
+static int hits, misses;
+
+static void log_callback(void *avcl, int level, const char *fmt, va_list vl)
+{
+    char line[1024];
+
+    vsnprintf(line, sizeof(line), fmt, vl);
+    sscanf(line, "Statistics, cache hits:%d cache misses:%d", &hits, &misses);
+}
+
+static int write_input(const char *filename, int64_t size, int seed)
+{
+    FILE *f = fopen(filename, "wb");
+    int64_t i;
+
+    if (!f) {
+        fprintf(stderr, "Failed to create %s\n", filename);
+        return 1;
+    }
+    for (i = 0; i < size; i++)
+        fputc((uint8_t)(i * 7 + seed), f);
+    fclose(f);
+    return 0;
+}
+
+static void remove_tree(const char *path)
+{
+    char sub[1024];
+    struct dirent *de;
+    DIR *dir = opendir(path);
+
+    if (!dir) {
+        unlink(path);
+        return;
+    }
+    while ((de = readdir(dir))) {
+        if (!strcmp(de->d_name, ".") || !strcmp(de->d_name, ".."))
+            continue;
+        snprintf(sub, sizeof(sub), "%s/%s", path, de->d_name);
+        remove_tree(sub);
+    }
+    closedir(dir);
+    rmdir(path);
+}
+
+static void print_cache_dir(const char *path)
+{
+    int nb_dirs = 0, nb_blocks = 0;
+    int64_t size = 0;
+    char sub[1024];
+    struct dirent *de, *be;
+    DIR *dir = opendir(path), *subdir;
+
+    while (dir && (de = readdir(dir))) {
+        if (de->d_name[0] == '.')
+            continue;
+        snprintf(sub, sizeof(sub), "%s/%s", path, de->d_name);
+        if (!(subdir = opendir(sub)))
+            continue;
+        nb_dirs++;
+        while ((be = readdir(subdir))) {
+            char file[2048];
+            struct stat st;
+
+            snprintf(file, sizeof(file), "%s/%s", sub, be->d_name);
+            if (be->d_name[0] != '.' && !stat(file, &st)) {
+                nb_blocks++;
+                size += st.st_size;
+            }
+        }
+        closedir(subdir);
+    }
+    if (dir)
+        closedir(dir);
+    printf("    cache directory: %d subdirectories, %d blocks, %"PRId64" bytes\n",
+           nb_dirs, nb_blocks, size);
+}
+
+static int open_cache(URLContext **h, const char *input, const char *cache_dir)
+{
+    char url[1024];
+    AVDictionary *opts = NULL;
+    int ret;
+
+    snprintf(url, sizeof(url), "cache:%s", input);
+    av_dict_set_int(&opts, "cache_block_size", BLOCK_SIZE, 0);
+    av_dict_set_int(&opts, "cache_disk_size", DISK_SIZE, 0);
+    if (cache_dir)
+        av_dict_set(&opts, "cache_dir", cache_dir, 0);
+    ret = ffurl_open_whitelist(h, url, AVIO_FLAG_READ, NULL, &opts,
+                               NULL, NULL, NULL);
+    av_dict_free(&opts);
+    if (ret < 0)
+        fprintf(stderr, "Failed to open %s\n", url);
+    return ret;
+}
+
+/**
+ * Read up to size bytes from pos, checking that they come from the input
+ * written with seed.
+ */
+static int64_t read_data(URLContext *h, int64_t pos, int64_t size, int seed, int *error)
+{
+    uint8_t buf[1000];
+    int64_t done = 0;
+    int i, ret = 0;
+
+    while (done < size) {
+        ret = ffurl_read(h, buf, FFMIN(sizeof(buf), size - done));
+        if (ret <= 0)
+            break;
+        for (i = 0; i < ret; i++)
+            if (buf[i] != (uint8_t)((pos + done + i) * 7 + seed)) {
+                *error = AVERROR_INVALIDDATA;
+                return done;
+            }
+        done += ret;
+    }
+    *error = ret < 0 ? ret : 0;
+    return done;
+}
+
+static void close_cache(URLContext **h)
+{
+    hits = misses = -1;
+    ffurl_closep(h);
+    printf("    cache hits %d, misses %d\n", hits, misses);
+}
+
+/**
+ * Read an input from pos to its end.
+ */
+static int test_read(const char *name, const char *input, const char *cache_dir,
+                     int64_t pos, int64_t size, int seed)
+{
+    URLContext *h = NULL;
+    int64_t done;
+    int error;
+
+    if (open_cache(&h, input, cache_dir) < 0)
+        return 1;
+    if (ffurl_seek(h, pos, SEEK_SET) != pos) {
+        printf("%s: seek to %"PRId64" failed\n", name, pos);
+        ffurl_closep(&h);
+        return 1;
+    }
+    done = read_data(h, pos, INT64_MAX, seed, &error);
+    printf("%s: read %"PRId64" bytes from %"PRId64", %s\n", name, done, pos,
+           error == AVERROR_EOF ? "eof" : av_err2str(error));
+    close_cache(&h);
+    print_cache_dir(cache_dir);
+    return done != size - pos || error != AVERROR_EOF;
+}
+
+/**
+ * Read two inputs alternately with two opens sharing the cache directory.
+ */
+static int test_shared(const char *input1, const char *input2, const char *cache_dir)
+{
+    URLContext *h1 = NULL, *h2 = NULL;
+    int64_t done1 = 0, done2 = 0, n1, n2;
+    int error1 = 0, error2 = 0, ret = 1;
+
+    if (open_cache(&h1, input1, cache_dir) < 0 ||
+        open_cache(&h2, input2, cache_dir) < 0)
+        goto end;
+    do {
+        n1 = error1 ? 0 : read_data(h1, done1, 1000, 1, &error1);
+        n2 = error2 ? 0 : read_data(h2, done2, 1000, 2, &error2);
+        done1 += n1;
+        done2 += n2;
+    } while (n1 || n2);
+    printf("shared: read %"PRId64" and %"PRId64" bytes, %s and %s\n", done1, done2,
+           error1 == AVERROR_EOF ? "eof" : av_err2str(error1),
+           error2 == AVERROR_EOF ? "eof" : av_err2str(error2));
+    ret = error1 != AVERROR_EOF || error2 != AVERROR_EOF;
+end:
+    ffurl_closep(&h1);
+    ffurl_closep(&h2);
+    print_cache_dir(cache_dir);
+    return ret;
+}
+
+/**
+ * Read a pipe whose data arrives in two parts.
+ */
+static int test_short_read(void)
+{
+    uint8_t data[5100];
+    char input[32];
+    URLContext *h = NULL;
+    int fds[2], i, error, ret;
+    int64_t done;
+
+    for (i = 0; i < sizeof(data); i++)
+        data[i] = i * 7 + 3;
+    if (pipe(fds) < 0 || write(fds[1], data, 100) != 100)
+        return 1;
+    snprintf(input, sizeof(input), "pipe:%d", fds[0]);
+    if (open_cache(&h, input, NULL) < 0)
+        return 1;
+
+    /* the first part is returned without waiting for a whole block */
+    ret = ffurl_read(h, data, BLOCK_SIZE);
+    printf("short read: read %d bytes of %d\n", ret, BLOCK_SIZE);
+    if (write(fds[1], data + 100, sizeof(data) - 100) != sizeof(data) - 100)
+        ret = -1;
+    close(fds[1]);
+    done = read_data(h, 100, INT64_MAX, 3, &error);
+    printf("short read: read %"PRId64" more bytes, %s\n", done,
+           error == AVERROR_EOF ? "eof" : av_err2str(error));
+    ffurl_closep(&h);
+    close(fds[0]);
+    return ret != 100 || done != sizeof(data) - 100 || error != AVERROR_EOF;
+}
+
+int main(int argc, char **argv)
+{
+    char input1[1024], input2[1024], cache_dir[1024];
+    int64_t size1 = 10 * BLOCK_SIZE + 100, size2 = 10 * BLOCK_SIZE;
+    int ret = 0;
+
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <temporary file prefix>\n", argv[0]);
+        return 1;
+    }
+    snprintf(input1,    sizeof(input1),    "%s.in1", argv[1]);
+    snprintf(input2,    sizeof(input2),    "%s.in2", argv[1]);
+    snprintf(cache_dir, sizeof(cache_dir), "%s.dir", argv[1]);
+    remove_tree(cache_dir);
+
+    av_register_all();
+    av_log_set_callback(log_callback);
+
+    /* only the last blocks read are kept */
+    if (write_input(input1, size1, 0))
+        return 1;
+    ret |= test_read("eviction", input1, cache_dir, 0, size1, 0);
+
+    /* they are read from the cache by the next open */
+    ret |= test_read("persistence", input1, cache_dir, 7 * BLOCK_SIZE, size1, 0);
+
+    /* and dropped once the file changed */
+    size1++;
+    if (write_input(input1, size1, 1))
+        return 1;
+    ret |= test_read("invalidation", input1, cache_dir, 7 * BLOCK_SIZE, size1, 1);
+
+    /* the opens sharing the directory keep within the same bound */
+    if (write_input(input2, size2, 2))
+        return 1;
+    ret |= test_shared(input1, input2, cache_dir);
+
+    ret |= test_short_read();
+
+    remove_tree(cache_dir);
+    unlink(input1);
+    unlink(input2);
+    return ret;
+}
@@ -185,6 +185,33 @@ static int initialize_fifo_tst_muxer_chain(AVFormatContext **oc)
     return ret;
 }
 
+/* Check the statistics exported by the fifo muxer while muxing: no packet is
+ * counted both as written and dropped, and packets are dropped only when
+ * expected. They cannot be read once the trailer is written, as it frees the
+ * muxer context. */
+static int check_stats(AVFormatContext *oc, int64_t nb_pkts, int drop)
+{
+    int64_t written_pkts, dropped_pkts;
+    int ret;
+
+    ret = av_opt_get_int(oc->priv_data, "written_pkts", 0, &written_pkts);
+    if (ret >= 0)
+        ret = av_opt_get_int(oc->priv_data, "dropped_pkts", 0, &dropped_pkts);
+    if (ret < 0) {
+        fprintf(stderr, "Failed to get statistics: %s\n", av_err2str(ret));
+        return ret;
+    }
+
+    if (written_pkts + dropped_pkts > nb_pkts || !drop != !dropped_pkts) {
+        fprintf(stderr, "Unexpected statistics: %"PRId64" packets written, "
+                "%"PRId64" dropped, %"PRId64" sent\n",
+                written_pkts, dropped_pkts, nb_pkts);
+        return AVERROR_BUG;
+    }
+
+    return 0;
+}
+
 static int fifo_basic_test(AVFormatContext *oc, AVDictionary **opts,
                              const FailingMuxerPacketData *pkt_data)
 {
@@ -224,6 +251,10 @@ static int fifo_basic_test(AVFormatContext *oc, AVDictionary **opts,
         goto write_trailer_and_fail;
     }
 
+    ret = check_stats(oc, 15, 0);
+    if (ret < 0)
+        goto write_trailer_and_fail;
+
     ret = av_write_trailer(oc);
     if (ret < 0) {
         fprintf(stderr, "Unexpected write_trailer error during flushing: %s\n",
@@ -330,6 +361,11 @@ static int fifo_overflow_drop_test(AVFormatContext *oc, AVDictionary **opts,
         goto fail;
     }
 
+    /* the queue has overflowed by now, as the consumer sleeps on each packet */
+    ret = check_stats(oc, 6, 1);
+    if (ret < 0)
+        goto fail;
+
     ret = av_write_trailer(oc);
     if (ret < 0)
         fprintf(stderr, "Unexpected write_trailer error: %s\n", av_err2str(ret));
@@ -427,6 +463,12 @@ const TestCase tests[] = {
         {fifo_overflow_drop_test, "overflow with packet dropping", "queue_size=3:drop_pkts_on_overflow=1",
          0, 0, 0, {0, 0, SLEEPTIME_50_MS}},
 
+        /* As above, but none of the packets is a keyframe, so the consumer drops
+         * every packet left after the overflow. */
+        {fifo_overflow_drop_test, "overflow with packet dropping until keyframe",
+         "queue_size=3:drop_pkts_on_overflow=1:restart_with_keyframe=1",
+         0, 0, 0, {0, 0, SLEEPTIME_50_MS}},
+
         {NULL}
 };
 
@@ -0,0 +1,246 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Upload files through the connection pool to a keep-alive HTTP server
+ * running on the loopback interface, and check which requests are sent
+ * on an open connection.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavutil/avstring.h"
+#include "libavutil/time.h"
+#include "libavformat/avformat.h"
+#include "libavformat/httppool.h"
+#include "libavformat/url.h"
+
+typedef struct Server {
+    URLContext *listener;
+    int close_after;        ///< requests served on a connection before closing it, 0 for no limit
+    int nb_requests;        ///< requests to serve before exiting
+
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int served;             ///< completed requests, the connection being closed if needed
+    int connections;
+    int64_t bytes;          ///< size of the received request bodies
+} Server;
+
+static int read_line(URLContext *h, char *line, int size)
+{
+    int len = 0, ret;
+    uint8_t c;
+
+    while ((ret = ffurl_read(h, &c, 1)) == 1 && c != '\n')
+        if (c != '\r' && len < size - 1)
+            line[len++] = c;
+    line[len] = 0;
+    return ret == 1 ? len : AVERROR_EOF;
+}
+
+static int read_body(URLContext *h, int64_t size)
+{
+    uint8_t buf[1024];
+    int ret;
+
+    while (size > 0) {
+        if ((ret = ffurl_read(h, buf, FFMIN(size, sizeof(buf)))) <= 0)
+            return AVERROR_EOF;
+        size -= ret;
+    }
+    return 0;
+}
+
+/* Read one request and reply to it, return the size of its body or an
+ * error if the client closed the connection. */
+static int64_t serve_request(URLContext *h)
+{
+    static const char reply[] = "HTTP/1.1 201 Created\r\nContent-Length: 0\r\n\r\n";
+    char line[1024];
+    int64_t size = 0, chunk;
+    int chunked = 0, ret;
+
+    if ((ret = read_line(h, line, sizeof(line))) < 0)
+        return ret;
+    while ((ret = read_line(h, line, sizeof(line))) > 0) {
+        if (!av_strcasecmp(line, "Transfer-Encoding: chunked"))
+            chunked = 1;
+        else if (av_stristart(line, "Content-Length:", NULL))
+            size = strtoll(line + 15, NULL, 10);
+    }
+    if (ret < 0)
+        return ret;
+
+    if (chunked) {
+        size = 0;
+        do {
+            if (read_line(h, line, sizeof(line)) < 0)
+                return AVERROR_EOF;
+            chunk = strtoll(line, NULL, 16);
+            if (read_body(h, chunk) < 0 || read_line(h, line, sizeof(line)) < 0)
+                return AVERROR_EOF;
+            size += chunk;
+        } while (chunk > 0);
+    } else if (read_body(h, size) < 0) {
+        return AVERROR_EOF;
+    }
+
+    if (ffurl_write(h, reply, sizeof(reply) - 1) < 0)
+        return AVERROR_EOF;
+    return size;
+}
+
+static void *server_thread(void *arg)
+{
+    Server *server = arg;
+    int served = 0;
+
+    while (served < server->nb_requests) {
+        URLContext *client = NULL;
+        int on_connection = 0;
+        int64_t size;
+
+        if (ffurl_accept(server->listener, &client) < 0)
+            break;
+        if (ffurl_handshake(client) < 0) {
+            ffurl_closep(&client);
+            break;
+        }
+        pthread_mutex_lock(&server->mutex);
+        server->connections++;
+        pthread_mutex_unlock(&server->mutex);
+
+        while ((size = serve_request(client)) >= 0) {
+            int last = ++on_connection == server->close_after ||
+                       served + 1 == server->nb_requests;
+
+            /* close the connection without telling the client, before the
+             * request is reported as served, or after the last request */
+            if (last)
+                ffurl_closep(&client);
+            pthread_mutex_lock(&server->mutex);
+            server->served = ++served;
+            server->bytes += size;
+            pthread_cond_signal(&server->cond);
+            pthread_mutex_unlock(&server->mutex);
+            if (last)
+                break;
+        }
+        ffurl_closep(&client);
+    }
+
+    /* wake up the client if it is waiting for a request that failed */
+    pthread_mutex_lock(&server->mutex);
+    server->served = server->nb_requests;
+    pthread_cond_signal(&server->cond);
+    pthread_mutex_unlock(&server->mutex);
+    return NULL;
+}
+
+static int test(int close_after, int nb_requests)
+{
+    char url[1024];
+    uint8_t data[3000];
+    AVFormatContext *s = avformat_alloc_context();
+    HTTPPool *pool = ff_http_pool_alloc();
+    HTTPPoolStats stats;
+    Server server = { .close_after = close_after, .nb_requests = nb_requests };
+    pthread_t thread;
+    int i, port, ret = 0;
+
+    if (!s || !pool) {
+        fprintf(stderr, "Failed to allocate the contexts\n");
+        exit(1);
+    }
+
+    /* find a free port */
+    for (port = 24000 + rand() % 8000; port < 65000; port += 97) {
+        snprintf(url, sizeof(url), "tcp://127.0.0.1:%d?listen=2&listen_timeout=10000", port);
+        if (ffurl_open_whitelist(&server.listener, url, AVIO_FLAG_READ_WRITE,
+                                 NULL, NULL, NULL, NULL, NULL) >= 0)
+            break;
+    }
+    if (!server.listener) {
+        fprintf(stderr, "Failed to listen on the loopback interface\n");
+        exit(1);
+    }
+    pthread_mutex_init(&server.mutex, NULL);
+    pthread_cond_init(&server.cond, NULL);
+    if (pthread_create(&thread, NULL, server_thread, &server)) {
+        fprintf(stderr, "Failed to start the server\n");
+        exit(1);
+    }
+
+    for (i = 0; i < sizeof(data); i++)
+        data[i] = i;
+
+    for (i = 0; i < nb_requests; i++) {
+        AVIOContext *pb = NULL;
+
+        snprintf(url, sizeof(url), "http://127.0.0.1:%d/segment%d.ts", port, i);
+        if (ff_http_pool_open(pool, s, &pb, url, NULL) < 0) {
+            printf("request %d: open failed\n", i);
+            ret = 1;
+            break;
+        }
+        avio_write(pb, data, 1000 * (i % 3 + 1));
+        if (ff_http_pool_close(pool, s, &pb) < 0) {
+            printf("request %d: upload failed\n", i);
+            ret = 1;
+        }
+
+        pthread_mutex_lock(&server.mutex);
+        while (server.served <= i)
+            pthread_cond_wait(&server.cond, &server.mutex);
+        pthread_mutex_unlock(&server.mutex);
+    }
+
+    pthread_join(thread, NULL);
+    ff_http_pool_get_stats(pool, &stats);
+    printf("close after %d: %u requests, %u reused, %u new, %u dropped, "
+           "%d server connections, %"PRId64" bytes\n", close_after,
+           stats.requests, stats.reused, stats.connections, stats.dropped,
+           server.connections, server.bytes);
+
+    ff_http_pool_free(s, &pool);
+    ffurl_closep(&server.listener);
+    pthread_cond_destroy(&server.cond);
+    pthread_mutex_destroy(&server.mutex);
+    avformat_free_context(s);
+    return ret;
+}
+
+int main(void)
+{
+    int ret = 0;
+
+    av_register_all();
+    avformat_network_init();
+    srand(av_gettime_relative());
+
+    ret |= test(0, 6);
+    ret |= test(2, 6);
+    ret |= test(1, 3);
+
+    avformat_network_deinit();
+    return ret;
+}
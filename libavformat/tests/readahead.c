@@ -0,0 +1,122 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Read a local file through the readahead protocol, to its end and after
+ * seeking around it, and check the data and the end of file reports.
+ */
+
+#include <stdio.h>
+
+#include "libavutil/error.h"
+#include "libavformat/avformat.h"
+#include "libavformat/url.h"
+
+#define BLOCK_SIZE 4096
+
+static int64_t read_to_end(URLContext *h, int64_t pos, int *error)
+{
+    uint8_t buf[1000];
+    int64_t size = 0;
+    int i, ret;
+
+    while ((ret = ffurl_read(h, buf, sizeof(buf))) > 0) {
+        for (i = 0; i < ret; i++)
+            if (buf[i] != (uint8_t)((pos + size + i) * 7)) {
+                *error = AVERROR_INVALIDDATA;
+                return size;
+            }
+        size += ret;
+    }
+    *error = ret;
+    return size;
+}
+
+static int test(const char *filename, int64_t file_size)
+{
+    static const int64_t offsets[] = { -100, -BLOCK_SIZE, 0, 5000 };
+    char url[1024];
+    URLContext *h = NULL;
+    AVDictionary *opts = NULL;
+    FILE *f;
+    int64_t i, size;
+    int error, ret = 0;
+
+    if (!(f = fopen(filename, "wb"))) {
+        fprintf(stderr, "Failed to create %s\n", filename);
+        return 1;
+    }
+    for (i = 0; i < file_size; i++)
+        fputc((uint8_t)(i * 7), f);
+    fclose(f);
+
+    snprintf(url, sizeof(url), "readahead:file:%s", filename);
+    av_dict_set_int(&opts, "readahead_block_size", BLOCK_SIZE, 0);
+    av_dict_set_int(&opts, "readahead_requests", 2, 0);
+    av_dict_set_int(&opts, "readahead_blocks", 3, 0);
+    if (ffurl_open_whitelist(&h, url, AVIO_FLAG_READ, NULL, &opts,
+                             NULL, NULL, NULL) < 0) {
+        fprintf(stderr, "Failed to open %s\n", url);
+        av_dict_free(&opts);
+        return 1;
+    }
+    av_dict_free(&opts);
+
+    size = read_to_end(h, 0, &error);
+    printf("size %"PRId64": read %"PRId64" bytes, %s\n", file_size, size,
+           error == AVERROR_EOF ? "eof" : av_err2str(error));
+    if (size != file_size || error != AVERROR_EOF)
+        ret = 1;
+
+    /* the last offset is past the end of the file */
+    for (i = 0; i < FF_ARRAY_ELEMS(offsets); i++) {
+        int64_t pos = file_size + offsets[i];
+
+        if (ffurl_seek(h, pos, SEEK_SET) != pos) {
+            printf("seek to %"PRId64" failed\n", pos);
+            ret = 1;
+            continue;
+        }
+        size = read_to_end(h, pos, &error);
+        printf("size %"PRId64": read %"PRId64" bytes from %"PRId64", %s\n",
+               file_size, size, pos,
+               error == AVERROR_EOF ? "eof" : av_err2str(error));
+        if (size != FFMAX(-offsets[i], 0) || error != AVERROR_EOF)
+            ret = 1;
+    }
+
+    ffurl_closep(&h);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    int ret = 0;
+
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <temporary file>\n", argv[0]);
+        return 1;
+    }
+
+    av_register_all();
+
+    ret |= test(argv[1], 4 * BLOCK_SIZE);
+    ret |= test(argv[1], 3 * BLOCK_SIZE + 123);
+
+    return ret;
+}
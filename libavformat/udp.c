@@ -26,6 +26,7 @@
 
 #define _DEFAULT_SOURCE
 #define _BSD_SOURCE     /* Needed for using struct ip_mreq with recent glibc */
+#define _GNU_SOURCE     /* Needed for recvmmsg() */
 
 #include "avformat.h"
 #include "avio_internal.h"
@@ -62,6 +63,11 @@
 
 #if HAVE_PTHREAD_CANCEL
 #include <pthread.h>
+#include <stdatomic.h>
+#endif
+
+#ifdef SO_TXTIME
+#include <linux/net_tstamp.h>
 #endif
 
 #ifndef HAVE_PTHREAD_CANCEL
@@ -76,6 +82,7 @@
 #define UDP_TX_BUF_SIZE 32768
 #define UDP_MAX_PKT_SIZE 65536
 #define UDP_HEADER_SIZE 8
+#define UDP_TXTIME_LOOKAHEAD 2000 /* in microseconds */
 
 typedef struct UDPContext {
     const AVClass *class;
@@ -96,17 +103,55 @@ typedef struct UDPContext {
     /* Circular Buffer variables for use in UDP receive code */
     int circular_buffer_size;
     AVFifoBuffer *fifo;
-    int circular_buffer_error;
     int64_t bitrate; /* number of bits to send per second */
     int64_t burst_bits;
     int close_req;
+    int recv_batch;
+    int send_batch;
+    int txtime;
+    int64_t recv_packets;
+    int64_t kernel_drops;
+    int64_t fifo_overruns;
+    int64_t send_rate;
+    int64_t send_jitter;
+    int64_t send_jitter_max;
 #if HAVE_PTHREAD_CANCEL
+    atomic_int circular_buffer_error;
     pthread_t circular_buffer_thread;
     pthread_mutex_t mutex;
     pthread_cond_t cond;
     int thread_started;
+
+    /* Receive ring, see circular_buffer_task_rx() */
+    uint8_t *ring;
+    atomic_uint ring_read;
+    atomic_uint ring_write;
+    atomic_int reader_waiting;
+    atomic_int_least64_t nb_recv_packets;
+    atomic_int_least64_t nb_kernel_drops;
+    atomic_int_least64_t nb_fifo_overruns;
+    uint8_t *recv_buf;
+    int *recv_len;
+
+    /* Send slots, see circular_buffer_task_tx() */
+    uint8_t *send_buf;
+    int send_slot_size;
+    int *send_len;
+    int64_t *send_time;
+    atomic_int_least64_t nb_sent_packets;
+    atomic_int_least64_t nb_sent_bytes;
+    atomic_int_least64_t first_send_time;
+    atomic_int_least64_t last_send_time;
+    atomic_int_least64_t nb_jitter;
+    atomic_int_least64_t jitter_sum;
+    atomic_int_least64_t jitter_max;
+#if HAVE_RECVMMSG || HAVE_SENDMMSG
+    struct mmsghdr *msgs;
+    struct iovec *iov;
+    uint8_t *control;
+    int control_size;
+#endif
 #endif
-    uint8_t tmp[UDP_MAX_PKT_SIZE+4];
     int remaining_in_dg;
     char *localaddr;
     int timeout;
@@ -118,6 +163,7 @@ typedef struct UDPContext {
 #define OFFSET(x) offsetof(UDPContext, x)
 #define D AV_OPT_FLAG_DECODING_PARAM
 #define E AV_OPT_FLAG_ENCODING_PARAM
+#define X AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY
 static const AVOption options[] = {
     { "buffer_size",    "System data size (in bytes)",                     OFFSET(buffer_size),    AV_OPT_TYPE_INT,    { .i64 = -1 },    -1, INT_MAX, .flags = D|E },
     { "bitrate",        "Bits to send per second",                         OFFSET(bitrate),        AV_OPT_TYPE_INT64,  { .i64 = 0  },     0, INT64_MAX, .flags = E },
@@ -134,6 +180,15 @@ static const AVOption options[] = {
     { "connect",        "set if connect() should be called on socket",     OFFSET(is_connected),   AV_OPT_TYPE_BOOL,   { .i64 =  0 },     0, 1,       .flags = D|E },
     { "fifo_size",      "set the UDP receiving circular buffer size, expressed as a number of packets with size of 188 bytes", OFFSET(circular_buffer_size), AV_OPT_TYPE_INT, {.i64 = 7*4096}, 0, INT_MAX, D },
     { "overrun_nonfatal", "survive in case of UDP receiving circular buffer overrun", OFFSET(overrun_nonfatal), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1,    D },
+    { "recv_batch",     "maximum number of datagrams received per system call", OFFSET(recv_batch), AV_OPT_TYPE_INT, { .i64 = 16 },    1, 1024,    D },
+    { "send_batch",     "maximum number of datagrams sent per system call", OFFSET(send_batch), AV_OPT_TYPE_INT, { .i64 = 16 },    1, 1024,    E },
+    { "txtime",         "let the kernel pace the datagrams with SO_TXTIME", OFFSET(txtime), AV_OPT_TYPE_BOOL, { .i64 = 0 },     0, 1,       E },
+    { "recv_packets",   "number of datagrams received by the circular buffer thread", OFFSET(recv_packets), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, X },
+    { "kernel_drops",   "number of datagrams dropped by the kernel for lack of socket buffer space", OFFSET(kernel_drops), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, X },
+    { "fifo_overruns",  "number of datagrams dropped for lack of circular buffer space", OFFSET(fifo_overruns), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, X },
+    { "send_rate",      "achieved sending rate in bits per second", OFFSET(send_rate), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, X },
+    { "send_jitter",    "average delay in microseconds of the datagrams sent after their scheduled time", OFFSET(send_jitter), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, X },
+    { "send_jitter_max", "maximum delay in microseconds of the datagrams sent after their scheduled time", OFFSET(send_jitter_max), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, X },
     { "timeout",        "set raise error timeout (only in read mode)",     OFFSET(timeout),        AV_OPT_TYPE_INT,    { .i64 = 0 },      0, INT_MAX, D },
     { "sources",        "Source list",                                     OFFSET(sources),        AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
     { "block",          "Block list",                                      OFFSET(block),          AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
@@ -496,63 +551,247 @@ static int udp_get_file_handle(URLContext *h)
 }
 
 #if HAVE_PTHREAD_CANCEL
+/*
+ * Received datagrams are passed to udp_read() through a ring of
+ * circular_buffer_size bytes, each one preceded by its size as 4 bytes
+ * little-endian, wrapping around the end of the buffer. The receiving
+ * thread is the only one to move ring_write and udp_read() the only one to
+ * move ring_read, so no lock is needed; the mutex and condition are only
+ * used to wake up a reader waiting for data.
+ */
+static unsigned ring_used(UDPContext *s, unsigned read, unsigned write)
+{
+    return (write + s->circular_buffer_size - read) % s->circular_buffer_size;
+}
+
+static void ring_write_data(UDPContext *s, unsigned pos, const uint8_t *src, int size)
+{
+    int len;
+
+    pos %= s->circular_buffer_size;
+    len = FFMIN(size, s->circular_buffer_size - pos);
+    memcpy(s->ring + pos, src, len);
+    memcpy(s->ring, src + len, size - len);
+}
+
+static void ring_read_data(UDPContext *s, unsigned pos, uint8_t *dst, int size)
+{
+    int len;
+
+    pos %= s->circular_buffer_size;
+    len = FFMIN(size, s->circular_buffer_size - pos);
+    memcpy(dst, s->ring + pos, len);
+    memcpy(dst + len, s->ring, size - len);
+}
+
+static void wake_reader(UDPContext *s)
+{
+    if (atomic_load(&s->reader_waiting)) {
+        pthread_mutex_lock(&s->mutex);
+        pthread_cond_signal(&s->cond);
+        pthread_mutex_unlock(&s->mutex);
+    }
+}
+
+/**
+ * Receive up to recv_batch datagrams, blocking until at least one is
+ * available. Datagram i is stored at recv_buf + i * UDP_MAX_PKT_SIZE and
+ * its size in recv_len[i].
+ *
+ * @return the number of datagrams received, or a negative value on error,
+ *         as recv()
+ */
+static int recv_datagrams(UDPContext *s)
+{
+#if HAVE_RECVMMSG
+    int i, nb;
+
+    for (i = 0; i < s->recv_batch; i++) {
+        s->msgs[i].msg_hdr.msg_controllen = s->control ? s->control_size : 0;
+        s->msgs[i].msg_hdr.msg_flags      = 0;
+    }
+    nb = recvmmsg(s->udp_fd, s->msgs, s->recv_batch, MSG_WAITFORONE, NULL);
+    for (i = 0; i < nb; i++) {
+#ifdef SO_RXQ_OVFL
+        struct msghdr *hdr = &s->msgs[i].msg_hdr;
+        struct cmsghdr *cmsg;
+
+        for (cmsg = CMSG_FIRSTHDR(hdr); cmsg; cmsg = CMSG_NXTHDR(hdr, cmsg)) {
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL) {
+                /* number of datagrams dropped by the socket since it was
+                 * created, not since the last one */
+                uint32_t drops;
+                memcpy(&drops, CMSG_DATA(cmsg), sizeof(drops));
+                atomic_store(&s->nb_kernel_drops, drops);
+            }
+        }
+#endif
+        s->recv_len[i] = s->msgs[i].msg_len;
+    }
+    return nb;
+#else
+    int len = recv(s->udp_fd, s->recv_buf, UDP_MAX_PKT_SIZE, 0);
+    if (len < 0)
+        return len;
+    s->recv_len[0] = len;
+    return 1;
+#endif
+}
+
 static void *circular_buffer_task_rx( void *_URLContext)
 {
     URLContext *h = _URLContext;
     UDPContext *s = h->priv_data;
     int old_cancelstate;
+    unsigned write = 0;
 
     pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &old_cancelstate);
-    pthread_mutex_lock(&s->mutex);
     if (ff_socket_nonblock(s->udp_fd, 0) < 0) {
         av_log(h, AV_LOG_ERROR, "Failed to set blocking mode");
-        s->circular_buffer_error = AVERROR(EIO);
+        atomic_store(&s->circular_buffer_error, AVERROR(EIO));
         goto end;
     }
     while(1) {
-        int len;
+        int i, nb;
 
-        pthread_mutex_unlock(&s->mutex);
         /* Blocking operations are always cancellation points;
            see "General Information" / "Thread Cancelation Overview"
            in Single Unix. */
         pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &old_cancelstate);
-        len = recv(s->udp_fd, s->tmp+4, sizeof(s->tmp)-4, 0);
+        nb = recv_datagrams(s);
         pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &old_cancelstate);
-        pthread_mutex_lock(&s->mutex);
-        if (len < 0) {
+        if (nb < 0) {
             if (ff_neterrno() != AVERROR(EAGAIN) && ff_neterrno() != AVERROR(EINTR)) {
-                s->circular_buffer_error = ff_neterrno();
+                atomic_store(&s->circular_buffer_error, ff_neterrno());
                 goto end;
             }
             continue;
         }
-        AV_WL32(s->tmp, len);
-
-        if(av_fifo_space(s->fifo) < len + 4) {
-            /* No Space left */
-            if (s->overrun_nonfatal) {
-                av_log(h, AV_LOG_WARNING, "Circular buffer overrun. "
-                        "Surviving due to overrun_nonfatal option\n");
-                continue;
-            } else {
-                av_log(h, AV_LOG_ERROR, "Circular buffer overrun. "
-                        "To avoid, increase fifo_size URL option. "
-                        "To survive in such case, use overrun_nonfatal option\n");
-                s->circular_buffer_error = AVERROR(EIO);
-                goto end;
+        atomic_fetch_add(&s->nb_recv_packets, nb);
+
+        for (i = 0; i < nb; i++) {
+            unsigned read = atomic_load_explicit(&s->ring_read, memory_order_acquire);
+            int len = s->recv_len[i];
+            uint8_t tmp[4];
+
+            if (s->circular_buffer_size - 1 - ring_used(s, read, write) < len + 4) {
+                /* No Space left */
+                atomic_fetch_add(&s->nb_fifo_overruns, 1);
+                if (s->overrun_nonfatal) {
+                    av_log(h, AV_LOG_WARNING, "Circular buffer overrun. "
+                            "Surviving due to overrun_nonfatal option\n");
+                    continue;
+                } else {
+                    av_log(h, AV_LOG_ERROR, "Circular buffer overrun. "
+                            "To avoid, increase fifo_size URL option. "
+                            "To survive in such case, use overrun_nonfatal option\n");
+                    atomic_store(&s->ring_write, write);
+                    atomic_store(&s->circular_buffer_error, AVERROR(EIO));
+                    goto end;
+                }
             }
+            AV_WL32(tmp, len);
+            ring_write_data(s, write,     tmp, 4);
+            ring_write_data(s, write + 4, s->recv_buf + i * UDP_MAX_PKT_SIZE, len);
+            write = (write + len + 4) % s->circular_buffer_size;
         }
-        av_fifo_generic_write(s->fifo, s->tmp, len+4, NULL);
-        pthread_cond_signal(&s->cond);
+        atomic_store(&s->ring_write, write);
+        wake_reader(s);
     }
 
 end:
+    pthread_mutex_lock(&s->mutex);
     pthread_cond_signal(&s->cond);
     pthread_mutex_unlock(&s->mutex);
     return NULL;
 }
 
+/**
+ * Send nb datagrams from the send slots, starting at slot first. When
+ * SO_TXTIME is in use, each one leaves at its send_time.
+ *
+ * @return 0 or a negative AVERROR code
+ */
+static int send_datagrams(UDPContext *s, int first, int nb)
+{
+#if HAVE_SENDMMSG
+    int i, done = 0;
+
+    for (i = 0; i < nb; i++) {
+        int slot = (first + i) % s->send_batch;
+        struct msghdr *hdr = &s->msgs[i].msg_hdr;
+
+        s->iov[i].iov_base = s->send_buf + slot * s->send_slot_size;
+        s->iov[i].iov_len  = s->send_len[slot];
+        hdr->msg_iov    = &s->iov[i];
+        hdr->msg_iovlen = 1;
+        if (!s->is_connected) {
+            hdr->msg_name    = &s->dest_addr;
+            hdr->msg_namelen = s->dest_addr_len;
+        }
+#ifdef SO_TXTIME
+        if (s->txtime) {
+            struct cmsghdr *cmsg;
+            uint64_t txtime = s->send_time[slot] * 1000;
+
+            hdr->msg_control    = s->control + i * s->control_size;
+            hdr->msg_controllen = s->control_size;
+            cmsg = CMSG_FIRSTHDR(hdr);
+            cmsg->cmsg_level = SOL_SOCKET;
+            cmsg->cmsg_type  = SCM_TXTIME;
+            cmsg->cmsg_len   = CMSG_LEN(sizeof(txtime));
+            memcpy(CMSG_DATA(cmsg), &txtime, sizeof(txtime));
+        }
+#endif
+    }
+    while (done < nb) {
+        int ret = sendmmsg(s->udp_fd, s->msgs + done, nb - done, 0);
+        if (ret < 0) {
+            ret = ff_neterrno();
+            if (ret != AVERROR(EAGAIN) && ret != AVERROR(EINTR))
+                return ret;
+            continue;
+        }
+        done += ret;
+    }
+#else
+    int i;
+
+    for (i = 0; i < nb; i++) {
+        int slot = (first + i) % s->send_batch;
+        const uint8_t *p = s->send_buf + slot * s->send_slot_size;
+        int ret;
+
+        do {
+            if (!s->is_connected) {
+                ret = sendto (s->udp_fd, p, s->send_len[slot], 0,
+                            (struct sockaddr *) &s->dest_addr,
+                            s->dest_addr_len);
+            } else
+                ret = send(s->udp_fd, p, s->send_len[slot], 0);
+            if (ret < 0) {
+                ret = ff_neterrno();
+                if (ret != AVERROR(EAGAIN) && ret != AVERROR(EINTR))
+                    return ret;
+            }
+        } while (ret < 0);
+    }
+#endif
+    return 0;
+}
+
+/*
+ * The datagrams written by udp_write() are moved from the fifo to up to
+ * send_batch send slots, and sent by groups of those due at the current
+ * time. Pacing is a token bucket of burst_bits filled at bitrate: the
+ * scheduled time of a datagram is target_timestamp, computed from the
+ * number of bits sent since start_timestamp, which is moved forward to
+ * limit the burst after an idle period. A late wakeup is caught up on by
+ * sending several datagrams at once, as long as the delay does not exceed
+ * the duration of a datagram.
+ * With SO_TXTIME, the datagrams due within UDP_TXTIME_LOOKAHEAD are handed
+ * to the kernel early with their scheduled time instead.
+ */
 static void *circular_buffer_task_tx( void *_URLContext)
 {
     URLContext *h = _URLContext;
@@ -563,86 +802,103 @@ static void *circular_buffer_task_tx( void *_URLContext)
     int64_t sent_bits = 0;
     int64_t burst_interval = s->bitrate ? (s->burst_bits * 1000000 / s->bitrate) : 0;
     int64_t max_delay = s->bitrate ?  ((int64_t)h->max_packet_size * 8 * 1000000 / s->bitrate + 1) : 0;
+    int64_t lookahead = s->txtime ? UDP_TXTIME_LOOKAHEAD : 0;
+    int first = 0, nb_pending = 0, waited = 0;
+
+    burst_interval = FFMAX(burst_interval, max_delay);
 
     pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &old_cancelstate);
     pthread_mutex_lock(&s->mutex);
 
     if (ff_socket_nonblock(s->udp_fd, 0) < 0) {
         av_log(h, AV_LOG_ERROR, "Failed to set blocking mode");
-        s->circular_buffer_error = AVERROR(EIO);
+        atomic_store(&s->circular_buffer_error, AVERROR(EIO));
         goto end;
     }
 
     for(;;) {
-        int len;
-        const uint8_t *p;
-        uint8_t tmp[4];
+        int i, nb, ret;
         int64_t timestamp;
 
-        len=av_fifo_size(s->fifo);
+        while (nb_pending < s->send_batch && av_fifo_size(s->fifo) >= 4) {
+            int slot = (first + nb_pending) % s->send_batch;
+            uint8_t tmp[4];
+            int len;
 
-        while (len<4) {
+            av_fifo_generic_read(s->fifo, tmp, 4, NULL);
+            len = AV_RL32(tmp);
+
+            av_assert0(len >= 0);
+            av_assert0(len <= s->send_slot_size);
+
+            av_fifo_generic_read(s->fifo, s->send_buf + slot * s->send_slot_size, len, NULL);
+            s->send_len[slot] = len;
+            nb_pending++;
+        }
+
+        if (!nb_pending) {
             if (s->close_req)
                 goto end;
             if (pthread_cond_wait(&s->cond, &s->mutex) < 0) {
                 goto end;
             }
-            len=av_fifo_size(s->fifo);
+            continue;
         }
 
-        av_fifo_generic_read(s->fifo, tmp, 4, NULL);
-        len=AV_RL32(tmp);
-
-        av_assert0(len >= 0);
-        av_assert0(len <= sizeof(s->tmp));
-
-        av_fifo_generic_read(s->fifo, s->tmp, len, NULL);
-
         pthread_mutex_unlock(&s->mutex);
         pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &old_cancelstate);
 
-        if (s->bitrate) {
-            timestamp = av_gettime_relative();
-            if (timestamp < target_timestamp) {
-                int64_t delay = target_timestamp - timestamp;
-                if (delay > max_delay) {
-                    delay = max_delay;
-                    start_timestamp = timestamp + delay;
-                    sent_bits = 0;
-                }
-                av_usleep(delay);
-            } else {
-                if (timestamp - burst_interval > target_timestamp) {
-                    start_timestamp = timestamp - burst_interval;
-                    sent_bits = 0;
-                }
+        timestamp = av_gettime_relative();
+        for (nb = 0; nb < nb_pending; nb++) {
+            int slot = (first + nb) % s->send_batch;
+
+            if (target_timestamp > timestamp + lookahead)
+                break;
+            s->send_time[slot] = FFMAX(timestamp, target_timestamp);
+            if (waited) {
+                /* the datagram was pending at its scheduled time, any
+                 * delay is due to the pacing */
+                int64_t delay = s->send_time[slot] - target_timestamp;
+                atomic_fetch_add(&s->nb_jitter, 1);
+                atomic_fetch_add(&s->jitter_sum, delay);
+                if (delay > atomic_load(&s->jitter_max))
+                    atomic_store(&s->jitter_max, delay);
+            }
+
+            if (timestamp - burst_interval > target_timestamp) {
+                start_timestamp = timestamp - burst_interval;
+                sent_bits = 0;
             }
-            sent_bits += len * 8;
+            sent_bits += s->send_len[slot] * 8;
             target_timestamp = start_timestamp + sent_bits * 1000000 / s->bitrate;
         }
 
-        p = s->tmp;
-        while (len) {
-            int ret;
-            av_assert0(len > 0);
-            if (!s->is_connected) {
-                ret = sendto (s->udp_fd, p, len, 0,
-                            (struct sockaddr *) &s->dest_addr,
-                            s->dest_addr_len);
-            } else
-                ret = send(s->udp_fd, p, len, 0);
-            if (ret >= 0) {
-                len -= ret;
-                p   += ret;
-            } else {
-                ret = ff_neterrno();
-                if (ret != AVERROR(EAGAIN) && ret != AVERROR(EINTR)) {
-                    pthread_mutex_lock(&s->mutex);
-                    s->circular_buffer_error = ret;
-                    pthread_mutex_unlock(&s->mutex);
-                    return NULL;
-                }
+        if (!nb) {
+            int64_t delay = target_timestamp - lookahead - timestamp;
+            if (delay > max_delay) {
+                delay = max_delay;
+                start_timestamp = target_timestamp = timestamp + delay;
+                sent_bits = 0;
             }
+            av_usleep(delay);
+            waited = 1;
+        } else {
+            waited = 0;
+            ret = send_datagrams(s, first, nb);
+            if (ret < 0) {
+                pthread_mutex_lock(&s->mutex);
+                atomic_store(&s->circular_buffer_error, ret);
+                pthread_mutex_unlock(&s->mutex);
+                return NULL;
+            }
+            if (!atomic_load(&s->nb_sent_packets))
+                atomic_store(&s->first_send_time, s->send_time[first]);
+            atomic_store(&s->last_send_time, s->send_time[(first + nb - 1) % s->send_batch]);
+            atomic_fetch_add(&s->nb_sent_packets, nb);
+            for (i = 0; i < nb; i++)
+                atomic_fetch_add(&s->nb_sent_bytes, s->send_len[(first + i) % s->send_batch]);
+            first       = (first + nb) % s->send_batch;
+            nb_pending -= nb;
         }
 
         pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &old_cancelstate);
@@ -654,7 +910,138 @@ end:
     return NULL;
 }
 
+static int udp_alloc_rx(URLContext *h)
+{
+    UDPContext *s = h->priv_data;
+#if HAVE_RECVMMSG
+    int i;
+#else
+    s->recv_batch = 1;
+#endif
 
+    s->ring     = av_malloc(s->circular_buffer_size);
+    s->recv_buf = av_malloc_array(s->recv_batch, UDP_MAX_PKT_SIZE);
+    s->recv_len = av_malloc_array(s->recv_batch, sizeof(*s->recv_len));
+    if (!s->ring || !s->recv_buf || !s->recv_len)
+        return AVERROR(ENOMEM);
+    atomic_init(&s->ring_read, 0);
+    atomic_init(&s->ring_write, 0);
+    atomic_init(&s->reader_waiting, 0);
+    atomic_init(&s->nb_recv_packets, 0);
+    atomic_init(&s->nb_kernel_drops, 0);
+    atomic_init(&s->nb_fifo_overruns, 0);
+
+#if HAVE_RECVMMSG
+    s->msgs = av_mallocz_array(s->recv_batch, sizeof(*s->msgs));
+    s->iov  = av_mallocz_array(s->recv_batch, sizeof(*s->iov));
+    if (!s->msgs || !s->iov)
+        return AVERROR(ENOMEM);
+#ifdef SO_RXQ_OVFL
+    {
+        int one = 1;
+        if (setsockopt(s->udp_fd, SOL_SOCKET, SO_RXQ_OVFL, &one, sizeof(one)) < 0) {
+            log_net_error(h, AV_LOG_DEBUG, "setsockopt(SO_RXQ_OVFL)");
+        } else {
+            s->control_size = CMSG_SPACE(sizeof(uint32_t));
+            s->control = av_mallocz_array(s->recv_batch, s->control_size);
+            if (!s->control)
+                return AVERROR(ENOMEM);
+        }
+    }
+#endif
+    for (i = 0; i < s->recv_batch; i++) {
+        s->iov[i].iov_base = s->recv_buf + i * UDP_MAX_PKT_SIZE;
+        s->iov[i].iov_len  = UDP_MAX_PKT_SIZE;
+        s->msgs[i].msg_hdr.msg_iov    = &s->iov[i];
+        s->msgs[i].msg_hdr.msg_iovlen = 1;
+        if (s->control)
+            s->msgs[i].msg_hdr.msg_control = s->control + i * s->control_size;
+    }
+#endif
+    return 0;
+}
+
+static int udp_alloc_tx(URLContext *h)
+{
+    UDPContext *s = h->priv_data;
+
+    s->send_slot_size = s->pkt_size > 0 ? s->pkt_size : UDP_MAX_PKT_SIZE;
+    s->send_buf  = av_malloc_array(s->send_batch, s->send_slot_size);
+    s->send_len  = av_malloc_array(s->send_batch, sizeof(*s->send_len));
+    s->send_time = av_malloc_array(s->send_batch, sizeof(*s->send_time));
+    if (!s->send_buf || !s->send_len || !s->send_time)
+        return AVERROR(ENOMEM);
+    atomic_init(&s->nb_sent_packets, 0);
+    atomic_init(&s->nb_sent_bytes, 0);
+    atomic_init(&s->first_send_time, 0);
+    atomic_init(&s->last_send_time, 0);
+    atomic_init(&s->nb_jitter, 0);
+    atomic_init(&s->jitter_sum, 0);
+    atomic_init(&s->jitter_max, 0);
+
+#if HAVE_SENDMMSG
+    s->msgs = av_mallocz_array(s->send_batch, sizeof(*s->msgs));
+    s->iov  = av_mallocz_array(s->send_batch, sizeof(*s->iov));
+    if (!s->msgs || !s->iov)
+        return AVERROR(ENOMEM);
+#endif
+
+    if (s->txtime) {
+#if HAVE_SENDMMSG && defined(SO_TXTIME)
+        /* the departure times are computed with av_gettime_relative() */
+        struct sock_txtime txtime = { .clockid = CLOCK_MONOTONIC };
+
+        if (!av_gettime_relative_is_monotonic()) {
+            av_log(h, AV_LOG_WARNING, "'txtime' requires a monotonic clock, disabling it\n");
+            s->txtime = 0;
+        } else if (setsockopt(s->udp_fd, SOL_SOCKET, SO_TXTIME, &txtime, sizeof(txtime)) < 0) {
+            log_net_error(h, AV_LOG_WARNING, "setsockopt(SO_TXTIME)");
+            s->txtime = 0;
+        } else {
+            s->control_size = CMSG_SPACE(sizeof(uint64_t));
+            s->control = av_mallocz_array(s->send_batch, s->control_size);
+            if (!s->control)
+                return AVERROR(ENOMEM);
+        }
+#else
+        av_log(h, AV_LOG_WARNING,
+               "'txtime' option was set but it is not supported on this build\n");
+        s->txtime = 0;
+#endif
+    }
+    return 0;
+}
+
+static void udp_free_buffers(UDPContext *s)
+{
+    av_freep(&s->ring);
+    av_freep(&s->recv_buf);
+    av_freep(&s->recv_len);
+    av_freep(&s->send_buf);
+    av_freep(&s->send_len);
+    av_freep(&s->send_time);
+#if HAVE_RECVMMSG || HAVE_SENDMMSG
+    av_freep(&s->msgs);
+    av_freep(&s->iov);
+    av_freep(&s->control);
+#endif
+}
+
+static void udp_update_stats(UDPContext *s)
+{
+    int64_t duration = atomic_load(&s->last_send_time) - atomic_load(&s->first_send_time);
+    int64_t nb_jitter = atomic_load(&s->nb_jitter);
+
+    s->recv_packets  = atomic_load(&s->nb_recv_packets);
+    s->kernel_drops  = atomic_load(&s->nb_kernel_drops);
+    s->fifo_overruns = atomic_load(&s->nb_fifo_overruns);
+
+    if (duration > 0)
+        s->send_rate = av_rescale(atomic_load(&s->nb_sent_bytes), 8 * 1000000, duration);
+    if (nb_jitter)
+        s->send_jitter = atomic_load(&s->jitter_sum) / nb_jitter;
+    s->send_jitter_max = atomic_load(&s->jitter_max);
+}
 #endif
 
 static int parse_source_list(char *buf, char **sources, int *num_sources,
@@ -763,6 +1150,9 @@ static int udp_open(URLContext *h, const char *uri, int flags)
                        "'circular_buffer_size' option was set but it is not supported "
                        "on this build (pthread support is required)\n");
         }
+        if (av_find_info_tag(buf, sizeof(buf), "recv_batch", p)) {
+            s->recv_batch = av_clip(strtol(buf, NULL, 10), 1, 1024);
+        }
         if (av_find_info_tag(buf, sizeof(buf), "bitrate", p)) {
             s->bitrate = strtoll(buf, NULL, 10);
             if (!HAVE_PTHREAD_CANCEL)
@@ -773,6 +1163,12 @@ static int udp_open(URLContext *h, const char *uri, int flags)
         if (av_find_info_tag(buf, sizeof(buf), "burst_bits", p)) {
             s->burst_bits = strtoll(buf, NULL, 10);
         }
+        if (av_find_info_tag(buf, sizeof(buf), "send_batch", p)) {
+            s->send_batch = av_clip(strtol(buf, NULL, 10), 1, 1024);
+        }
+        if (av_find_info_tag(buf, sizeof(buf), "txtime", p)) {
+            s->txtime = strtol(buf, NULL, 10);
+        }
         if (av_find_info_tag(buf, sizeof(buf), "localaddr", p)) {
             av_strlcpy(localaddr, buf, sizeof(localaddr));
         }
@@ -967,7 +1363,13 @@ static int udp_open(URLContext *h, const char *uri, int flags)
         int ret;
 
         /* start the task going */
-        s->fifo = av_fifo_alloc(s->circular_buffer_size);
+        if (is_output) {
+            s->fifo = av_fifo_alloc(s->circular_buffer_size);
+            if (!s->fifo || udp_alloc_tx(h) < 0)
+                goto fail;
+        } else if (udp_alloc_rx(h) < 0) {
+            goto fail;
+        }
         ret = pthread_mutex_init(&s->mutex, NULL);
         if (ret != 0) {
             av_log(h, AV_LOG_ERROR, "pthread_mutex_init failed : %s\n", strerror(ret));
@@ -998,6 +1400,9 @@ static int udp_open(URLContext *h, const char *uri, int flags)
     if (udp_fd >= 0)
         closesocket(udp_fd);
     av_fifo_freep(&s->fifo);
+#if HAVE_PTHREAD_CANCEL
+    udp_free_buffers(s);
+#endif
     for (i = 0; i < num_include_sources; i++)
         av_freep(&include_sources[i]);
     for (i = 0; i < num_exclude_sources; i++)
@@ -1022,30 +1427,31 @@ static int udp_read(URLContext *h, uint8_t *buf, int size)
 #if HAVE_PTHREAD_CANCEL
     int avail, nonblock = h->flags & AVIO_FLAG_NONBLOCK;
 
-    if (s->fifo) {
-        pthread_mutex_lock(&s->mutex);
+    if (s->ring) {
+        udp_update_stats(s);
         do {
-            avail = av_fifo_size(s->fifo);
-            if (avail) { // >=size) {
+            unsigned read  = atomic_load_explicit(&s->ring_read, memory_order_relaxed);
+            unsigned write = atomic_load_explicit(&s->ring_write, memory_order_acquire);
+            int err;
+
+            if (read != write) {
                 uint8_t tmp[4];
+                int len;
 
-                av_fifo_generic_read(s->fifo, tmp, 4, NULL);
-                avail= AV_RL32(tmp);
+                ring_read_data(s, read, tmp, 4);
+                len = avail = AV_RL32(tmp);
                 if(avail > size){
                     av_log(h, AV_LOG_WARNING, "Part of datagram lost due to insufficient buffer size\n");
                     avail= size;
                 }
 
-                av_fifo_generic_read(s->fifo, buf, avail, NULL);
-                av_fifo_drain(s->fifo, AV_RL32(tmp) - avail);
-                pthread_mutex_unlock(&s->mutex);
+                ring_read_data(s, read + 4, buf, avail);
+                atomic_store_explicit(&s->ring_read, (read + 4 + len) % s->circular_buffer_size,
+                                      memory_order_release);
                 return avail;
-            } else if(s->circular_buffer_error){
-                int err = s->circular_buffer_error;
-                pthread_mutex_unlock(&s->mutex);
+            } else if ((err = atomic_load(&s->circular_buffer_error))) {
                 return err;
             } else if(nonblock) {
-                pthread_mutex_unlock(&s->mutex);
                 return AVERROR(EAGAIN);
             }
             else {
@@ -1054,10 +1460,18 @@ static int udp_read(URLContext *h, uint8_t *buf, int size)
                 int64_t t = av_gettime() + 100000;
                 struct timespec tv = { .tv_sec  =  t / 1000000,
                                        .tv_nsec = (t % 1000000) * 1000 };
-                if (pthread_cond_timedwait(&s->cond, &s->mutex, &tv) < 0) {
-                    pthread_mutex_unlock(&s->mutex);
-                    return AVERROR(errno == ETIMEDOUT ? EAGAIN : errno);
-                }
+                err = 0;
+                pthread_mutex_lock(&s->mutex);
+                atomic_store(&s->reader_waiting, 1);
+                /* checked again after reader_waiting is set, as the
+                 * receiving thread only signals when it sees it set */
+                if (atomic_load(&s->ring_write) == read &&
+                    !atomic_load(&s->circular_buffer_error))
+                    err = pthread_cond_timedwait(&s->cond, &s->mutex, &tv);
+                atomic_store(&s->reader_waiting, 0);
+                pthread_mutex_unlock(&s->mutex);
+                if (err && err != ETIMEDOUT)
+                    return AVERROR(err);
                 nonblock = 1;
             }
         } while( 1);
@@ -1083,14 +1497,18 @@ static int udp_write(URLContext *h, const uint8_t *buf, int size)
     if (s->fifo) {
         uint8_t tmp[4];
 
+        if (size > s->send_slot_size)
+            return AVERROR(EINVAL);
+
+        udp_update_stats(s);
         pthread_mutex_lock(&s->mutex);
 
         /*
           Return error if last tx failed.
           Here we can't know on which packet error was, but it needs to know that error exists.
         */
-        if (s->circular_buffer_error<0) {
-            int err=s->circular_buffer_error;
+        if (atomic_load(&s->circular_buffer_error) < 0) {
+            int err = atomic_load(&s->circular_buffer_error);
             pthread_mutex_unlock(&s->mutex);
             return err;
         }
@@ -1155,6 +1573,22 @@ static int udp_close(URLContext *h)
 #endif
     closesocket(s->udp_fd);
     av_fifo_freep(&s->fifo);
+#if HAVE_PTHREAD_CANCEL
+    if (s->ring) {
+        udp_update_stats(s);
+        av_log(h, s->kernel_drops || s->fifo_overruns ? AV_LOG_WARNING : AV_LOG_VERBOSE,
+               "%"PRId64" datagrams received, %"PRId64" dropped by the kernel, "
+               "%"PRId64" dropped on circular buffer overrun\n",
+               s->recv_packets, s->kernel_drops, s->fifo_overruns);
+    } else if (s->send_buf) {
+        udp_update_stats(s);
+        av_log(h, AV_LOG_VERBOSE, "%"PRId64" datagrams sent at %"PRId64" bits/s, "
+               "delay after the scheduled time %"PRId64" us on average, %"PRId64" us at most\n",
+               (int64_t)atomic_load(&s->nb_sent_packets), s->send_rate,
+               s->send_jitter, s->send_jitter_max);
+    }
+    udp_free_buffers(s);
+#endif
     return 0;
 }
 
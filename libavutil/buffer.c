@@ -230,7 +230,10 @@ AVBufferPool *av_buffer_pool_init2(int size, void *opaque,
     pool->alloc2    = alloc;
     pool->pool_free = pool_free;
 
+    atomic_init(&pool->free_list, 0);
     atomic_init(&pool->refcount, 1);
+    atomic_init(&pool->nb_hits, 0);
+    atomic_init(&pool->max_in_use, 0);
 
     return pool;
 }
@@ -246,24 +249,37 @@ AVBufferPool *av_buffer_pool_init(int size, AVBufferRef* (*alloc)(int size))
     pool->size     = size;
     pool->alloc    = alloc ? alloc : av_buffer_alloc;
 
+    atomic_init(&pool->free_list, 0);
     atomic_init(&pool->refcount, 1);
+    atomic_init(&pool->nb_hits, 0);
+    atomic_init(&pool->max_in_use, 0);
 
     return pool;
 }
 
+static BufferPoolEntry *pool_entry(AVBufferPool *pool, uintptr_t index)
+{
+    uintptr_t i = index - 1;
+    int chunk   = av_log2((i >> POOL_CHUNK_BITS) + 1);
+
+    return &pool->chunks[chunk][i - ((POOL_CHUNK_SIZE << chunk) - POOL_CHUNK_SIZE)];
+}
+
 /*
  * This function gets called when the pool has been uninited and
  * all the buffers returned to it.
  */
 static void buffer_pool_free(AVBufferPool *pool)
 {
-    while (pool->pool) {
-        BufferPoolEntry *buf = pool->pool;
-        pool->pool = buf->next;
+    uintptr_t i;
+    int chunk;
 
+    for (i = 1; i <= pool->nb_entries; i++) {
+        BufferPoolEntry *buf = pool_entry(pool, i);
         buf->free(buf->opaque, buf->data);
-        av_freep(&buf);
     }
+    for (chunk = 0; chunk < POOL_MAX_CHUNKS; chunk++)
+        av_freep(&pool->chunks[chunk]);
     ff_mutex_destroy(&pool->mutex);
 
     if (pool->pool_free)
@@ -285,6 +301,41 @@ void av_buffer_pool_uninit(AVBufferPool **ppool)
         buffer_pool_free(pool);
 }
 
+static void pool_push(AVBufferPool *pool, BufferPoolEntry *buf)
+{
+    uintptr_t head = atomic_load_explicit(&pool->free_list, memory_order_relaxed);
+    uintptr_t new_head;
+
+    do {
+        atomic_store_explicit(&buf->next, head & POOL_INDEX_MASK,
+                              memory_order_relaxed);
+        new_head = ((head & ~POOL_INDEX_MASK) + POOL_TAG_ONE) | buf->index;
+    } while (!atomic_compare_exchange_weak_explicit(&pool->free_list, &head, new_head,
+                                                    memory_order_release,
+                                                    memory_order_relaxed));
+}
+
+static BufferPoolEntry *pool_pop(AVBufferPool *pool)
+{
+    uintptr_t head = atomic_load_explicit(&pool->free_list, memory_order_acquire);
+    uintptr_t new_head;
+    BufferPoolEntry *buf;
+
+    do {
+        if (!(head & POOL_INDEX_MASK))
+            return NULL;
+        /* the entry may be popped by another thread in the meantime, in
+         * which case next is stale but the tag makes the exchange fail */
+        buf      = pool_entry(pool, head & POOL_INDEX_MASK);
+        new_head = ((head & ~POOL_INDEX_MASK) + POOL_TAG_ONE) |
+                   atomic_load_explicit(&buf->next, memory_order_relaxed);
+    } while (!atomic_compare_exchange_weak_explicit(&pool->free_list, &head, new_head,
+                                                    memory_order_acquire,
+                                                    memory_order_acquire));
+
+    return buf;
+}
+
 static void pool_release_buffer(void *opaque, uint8_t *data)
 {
     BufferPoolEntry *buf = opaque;
@@ -293,15 +344,30 @@ static void pool_release_buffer(void *opaque, uint8_t *data)
     if(CONFIG_MEMORY_POISONING)
         memset(buf->data, FF_MEMORY_POISON, pool->size);
 
-    ff_mutex_lock(&pool->mutex);
-    buf->next = pool->pool;
-    pool->pool = buf;
-    ff_mutex_unlock(&pool->mutex);
+    pool_push(pool, buf);
 
     if (atomic_fetch_add_explicit(&pool->refcount, -1, memory_order_acq_rel) == 1)
         buffer_pool_free(pool);
 }
 
+/* must be called with the pool mutex held */
+static BufferPoolEntry *pool_add_entry(AVBufferPool *pool)
+{
+    uintptr_t i = pool->nb_entries;
+    int chunk   = av_log2((i >> POOL_CHUNK_BITS) + 1);
+
+    if (chunk >= POOL_MAX_CHUNKS)
+        return NULL;
+    if (!pool->chunks[chunk]) {
+        pool->chunks[chunk] = av_mallocz_array(POOL_CHUNK_SIZE << chunk,
+                                               sizeof(*pool->chunks[chunk]));
+        if (!pool->chunks[chunk])
+            return NULL;
+    }
+
+    return pool_entry(pool, i + 1);
+}
+
 /* allocate a new buffer and override its free() callback so that
  * it is returned to the pool on free */
 static AVBufferRef *pool_alloc_buffer(AVBufferPool *pool)
@@ -309,14 +375,19 @@ static AVBufferRef *pool_alloc_buffer(AVBufferPool *pool)
     BufferPoolEntry *buf;
     AVBufferRef     *ret;
 
-    ret = pool->alloc2 ? pool->alloc2(pool->opaque, pool->size) :
-                         pool->alloc(pool->size);
-    if (!ret)
-        return NULL;
+    /* the allocation callbacks are not required to be thread-safe */
+    ff_mutex_lock(&pool->mutex);
 
-    buf = av_mallocz(sizeof(*buf));
+    buf = pool_add_entry(pool);
     if (!buf) {
-        av_buffer_unref(&ret);
+        ff_mutex_unlock(&pool->mutex);
+        return NULL;
+    }
+
+    ret = pool->alloc2 ? pool->alloc2(pool->opaque, pool->size) :
+                         pool->alloc(pool->size);
+    if (!ret) {
+        ff_mutex_unlock(&pool->mutex);
         return NULL;
     }
 
@@ -324,6 +395,9 @@ static AVBufferRef *pool_alloc_buffer(AVBufferPool *pool)
     buf->opaque = ret->buffer->opaque;
     buf->free   = ret->buffer->free;
     buf->pool   = pool;
+    buf->index  = ++pool->nb_entries;
+
+    ff_mutex_unlock(&pool->mutex);
 
     ret->buffer->opaque = buf;
     ret->buffer->free   = pool_release_buffer;
@@ -335,23 +409,42 @@ AVBufferRef *av_buffer_pool_get(AVBufferPool *pool)
 {
     AVBufferRef *ret;
     BufferPoolEntry *buf;
+    unsigned in_use, max_in_use;
 
-    ff_mutex_lock(&pool->mutex);
-    buf = pool->pool;
+    buf = pool_pop(pool);
     if (buf) {
         ret = av_buffer_create(buf->data, pool->size, pool_release_buffer,
                                buf, 0);
-        if (ret) {
-            pool->pool = buf->next;
-            buf->next = NULL;
+        if (!ret) {
+            pool_push(pool, buf);
+            return NULL;
         }
+        atomic_fetch_add_explicit(&pool->nb_hits, 1, memory_order_relaxed);
     } else {
         ret = pool_alloc_buffer(pool);
+        if (!ret)
+            return NULL;
     }
-    ff_mutex_unlock(&pool->mutex);
 
-    if (ret)
-        atomic_fetch_add_explicit(&pool->refcount, 1, memory_order_relaxed);
+    /* the caller holds the pool reference, so in_use is refcount - 1 */
+    in_use     = atomic_fetch_add_explicit(&pool->refcount, 1, memory_order_relaxed);
+    max_in_use = atomic_load_explicit(&pool->max_in_use, memory_order_relaxed);
+    while (in_use > max_in_use &&
+           !atomic_compare_exchange_weak_explicit(&pool->max_in_use, &max_in_use, in_use,
+                                                  memory_order_relaxed,
+                                                  memory_order_relaxed))
+        ;
 
     return ret;
 }
+
+void av_buffer_pool_get_stats(AVBufferPool *pool, AVBufferPoolStats *stats)
+{
+    stats->hits       = atomic_load_explicit(&pool->nb_hits, memory_order_relaxed);
+    stats->in_use     = atomic_load_explicit(&pool->refcount, memory_order_relaxed) - 1;
+    stats->max_in_use = atomic_load_explicit(&pool->max_in_use, memory_order_relaxed);
+
+    ff_mutex_lock(&pool->mutex);
+    stats->misses     = pool->nb_entries;
+    ff_mutex_unlock(&pool->mutex);
+}
@@ -284,6 +284,49 @@ void av_buffer_pool_uninit(AVBufferPool **pool);
  */
 AVBufferRef *av_buffer_pool_get(AVBufferPool *pool);
 
+/**
+ * Usage statistics of a buffer pool, to help choosing its size or the number
+ * of buffers to preallocate.
+ *
+ * sizeof(AVBufferPoolStats) is a part of the public ABI.
+ */
+typedef struct AVBufferPoolStats {
+    /**
+     * Number of av_buffer_pool_get() calls served with a buffer already
+     * present in the pool. It is counted modulo 2^32 on platforms with 32-bit
+     * pointers.
+     */
+    uint64_t hits;
+
+    /**
+     * Number of av_buffer_pool_get() calls for which a new buffer had to be
+     * allocated, i.e. the total number of buffers allocated by the pool.
+     */
+    uint64_t misses;
+
+    /**
+     * Number of buffers currently in use, i.e. obtained from the pool and not
+     * released yet.
+     */
+    unsigned in_use;
+
+    /**
+     * Highest value of in_use over the lifetime of the pool.
+     */
+    unsigned max_in_use;
+} AVBufferPoolStats;
+
+/**
+ * Get usage statistics of a buffer pool. This function may be called
+ * simultaneously with av_buffer_pool_get() and the release of buffers from
+ * other threads, in which case the returned values are not necessarily
+ * consistent with each other.
+ *
+ * @param pool  the pool, which must not have been uninitialized
+ * @param stats the statistics are written here
+ */
+void av_buffer_pool_get_stats(AVBufferPool *pool, AVBufferPoolStats *stats);
+
 /**
  * @}
  */
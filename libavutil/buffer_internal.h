@@ -70,12 +70,44 @@ typedef struct BufferPoolEntry {
     void (*free)(void *opaque, uint8_t *data);
 
     AVBufferPool *pool;
-    struct BufferPoolEntry *next;
+
+    /*
+     * Index of this entry and of the next entry in the free list, both
+     * offset by one so that 0 means none.
+     */
+    uintptr_t index;
+    atomic_uintptr_t next;
 } BufferPoolEntry;
 
+/*
+ * The free list is a lock-free stack of pool entries, referred to by index.
+ * Its head holds the index of the first entry in the lower half of its bits
+ * and a tag, incremented on every update, in the upper half. The tag prevents
+ * a thread from replacing the head with a stale next index when the entry it
+ * popped has been popped and pushed back by other threads meanwhile.
+ */
+#define POOL_INDEX_BITS  (sizeof(uintptr_t) * 4)
+#define POOL_INDEX_MASK  (((uintptr_t)1 << POOL_INDEX_BITS) - 1)
+#define POOL_TAG_ONE     ((uintptr_t)1 << POOL_INDEX_BITS)
+
+/*
+ * Entries are allocated in chunks which are never moved nor freed while the
+ * pool is alive, so that stale indices can be dereferenced safely. Chunk n
+ * holds POOL_CHUNK_SIZE << n entries.
+ */
+#define POOL_CHUNK_BITS  4
+#define POOL_CHUNK_SIZE  (1 << POOL_CHUNK_BITS)
+#define POOL_MAX_CHUNKS  (POOL_INDEX_BITS - POOL_CHUNK_BITS)
+
 struct AVBufferPool {
     AVMutex mutex;
-    BufferPoolEntry *pool;
+    atomic_uintptr_t free_list;
+
+    /*
+     * Protected by mutex, which is only taken when allocating a new buffer.
+     */
+    BufferPoolEntry *chunks[POOL_MAX_CHUNKS];
+    uintptr_t nb_entries;
 
     /*
      * This is used to track when the pool is to be freed.
@@ -88,6 +120,14 @@ struct AVBufferPool {
      */
     atomic_uint refcount;
 
+    /*
+     * Statistics returned by av_buffer_pool_get_stats().
+     * nb_hits is pointer-sized like the other atomics, as the stdatomic compat
+     * implementations do not provide 64-bit atomics on 32-bit platforms.
+     */
+    atomic_uintptr_t nb_hits;
+    atomic_uint max_in_use;
+
     int size;
     void *opaque;
     AVBufferRef* (*alloc)(int size);
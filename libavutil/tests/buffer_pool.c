@@ -0,0 +1,117 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * This test program gets and releases buffers of a pool from several
+ * threads, checking that a buffer is never handed out twice and that the
+ * pool statistics add up.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/buffer.h"
+#include "libavutil/thread.h"
+
+#define NB_THREADS    8
+#define NB_ITERATIONS 20000
+#define NB_BUFFERS    4
+#define BUFFER_SIZE   64
+
+typedef struct ThreadContext {
+    AVBufferPool *pool;
+    int id;
+    int ret;
+} ThreadContext;
+
+static void *thread_main(void *arg)
+{
+    ThreadContext *tc = arg;
+    AVBufferRef *bufs[NB_BUFFERS];
+    int i, j;
+
+    for (i = 0; i < NB_ITERATIONS; i++) {
+        int nb = 1 + (i + tc->id) % NB_BUFFERS;
+
+        for (j = 0; j < nb; j++) {
+            bufs[j] = av_buffer_pool_get(tc->pool);
+            if (!bufs[j]) {
+                tc->ret = 1;
+                return NULL;
+            }
+            memset(bufs[j]->data, tc->id * NB_BUFFERS + j, BUFFER_SIZE);
+        }
+        for (j = 0; j < nb; j++) {
+            if (bufs[j]->data[0]               != tc->id * NB_BUFFERS + j ||
+                bufs[j]->data[BUFFER_SIZE - 1] != tc->id * NB_BUFFERS + j)
+                tc->ret = 2;
+            av_buffer_unref(&bufs[j]);
+        }
+    }
+
+    return NULL;
+}
+
+int main(void)
+{
+    ThreadContext tc[NB_THREADS];
+    pthread_t threads[NB_THREADS];
+    AVBufferPoolStats stats;
+    AVBufferPool *pool;
+    uint64_t nb_gets = 0;
+    int i, j, ret = 0;
+
+    pool = av_buffer_pool_init(BUFFER_SIZE, NULL);
+    if (!pool)
+        return 1;
+
+    for (i = 0; i < NB_THREADS; i++) {
+        tc[i].pool = pool;
+        tc[i].id   = i;
+        tc[i].ret  = 0;
+        if ((ret = pthread_create(&threads[i], NULL, thread_main, &tc[i]))) {
+            fprintf(stderr, "pthread_create failed: %s.\n", strerror(ret));
+            return 1;
+        }
+    }
+    for (i = 0; i < NB_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+        if (tc[i].ret) {
+            fprintf(stderr, "thread %d failed: %d\n", i, tc[i].ret);
+            ret = 2;
+        }
+        for (j = 0; j < NB_ITERATIONS; j++)
+            nb_gets += 1 + (j + i) % NB_BUFFERS;
+    }
+
+    av_buffer_pool_get_stats(pool, &stats);
+    if (stats.hits + stats.misses != nb_gets ||
+        stats.misses > NB_THREADS * NB_BUFFERS ||
+        stats.max_in_use > stats.misses || stats.max_in_use < NB_BUFFERS ||
+        stats.in_use) {
+        fprintf(stderr, "inconsistent stats: hits %"PRIu64" misses %"PRIu64
+                " in_use %u max_in_use %u, expected %"PRIu64" requests\n",
+                stats.hits, stats.misses, stats.in_use, stats.max_in_use, nb_gets);
+        ret = 3;
+    }
+
+    av_buffer_pool_uninit(&pool);
+
+    return ret;
+}
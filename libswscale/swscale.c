@@ -228,9 +228,10 @@ static void lumRangeFromJpeg16_c(int16_t *_dst, int width)
     if (DEBUG_SWSCALE_BUFFERS)                  \
         av_log(c, AV_LOG_DEBUG, __VA_ARGS__)
 
-static int swscale(SwsContext *c, const uint8_t *src[],
-                   int srcStride[], int srcSliceY,
-                   int srcSliceH, uint8_t *dst[], int dstStride[])
+static int swscale_band(SwsContext *c, const uint8_t *src[],
+                        int srcStride[], int srcSliceY,
+                        int srcSliceH, uint8_t *dst[], int dstStride[],
+                        int dstSliceY, int dstSliceH)
 {
     /* load a few things into local vars to make the code more readable?
      * and faster */
@@ -337,7 +338,7 @@ static int swscale(SwsContext *c, const uint8_t *src[],
     if (srcSliceY == 0) {
         lumBufIndex  = -1;
         chrBufIndex  = -1;
-        dstY         = 0;
+        dstY         = dstSliceY;
         lastInLumBuf = -1;
         lastInChrBuf = -1;
     }
@@ -369,7 +370,7 @@ static int swscale(SwsContext *c, const uint8_t *src[],
         hout_slice->width = dstW;
     }
 
-    for (; dstY < dstH; dstY++) {
+    for (; dstY < dstSliceY + dstSliceH; dstY++) {
         const int chrDstY = dstY >> c->chrDstVSubSample;
         int use_mmx_vfilter= c->use_mmx_vfilter;
 
@@ -531,6 +532,74 @@ static int swscale(SwsContext *c, const uint8_t *src[],
     return dstY - lastDstY;
 }
 
+static int swscale(SwsContext *c, const uint8_t *src[],
+                   int srcStride[], int srcSliceY,
+                   int srcSliceH, uint8_t *dst[], int dstStride[])
+{
+    return swscale_band(c, src, srcStride, srcSliceY, srcSliceH,
+                        dst, dstStride, 0, c->dstH);
+}
+
+int ff_sws_slice_threads_supported(SwsContext *c)
+{
+    /* error diffusion carries state from one output line to the next */
+    return c->swscale == swscale && c->dither != SWS_DITHER_ED &&
+           !c->cascaded_context[0];
+}
+
+void ff_sws_slice_worker(void *priv, int jobnr, int threadnr,
+                         int nb_jobs, int nb_threads)
+{
+    SwsContext *parent = priv;
+    SwsContext *c      = parent->slice_ctx[threadnr];
+    /* keep chroma lines of the destination inside one band */
+    const int align    = 1 << c->chrDstVSubSample;
+    const int band_h   = FFALIGN((c->dstH + nb_jobs - 1) / nb_jobs, align);
+    const int band_y   = jobnr * band_h;
+    const uint8_t *src[4];
+    uint8_t *dst[4];
+    int srcStride[4], dstStride[4];
+
+    parent->slice_err[jobnr] = 0;
+    if (band_y >= c->dstH)
+        return;
+
+    /* swscale_band() modifies the pointers and strides it is given */
+    memcpy(src,       parent->slice_src,       sizeof(src));
+    memcpy(srcStride, parent->slice_srcStride, sizeof(srcStride));
+    memcpy(dst,       parent->slice_dst,       sizeof(dst));
+    memcpy(dstStride, parent->slice_dstStride, sizeof(dstStride));
+
+    parent->slice_err[jobnr] = swscale_band(c, src, srcStride, 0, c->srcH,
+                                            dst, dstStride, band_y,
+                                            FFMIN(band_h, c->dstH - band_y));
+}
+
+static int swscale_threaded(SwsContext *c, const uint8_t *src[],
+                            int srcStride[], uint8_t *dst[], int dstStride[])
+{
+    int i, ret = 0;
+
+    for (i = 0; i < c->nb_slice_ctx; i++) {
+        if (usePal(c->srcFormat)) {
+            memcpy(c->slice_ctx[i]->pal_yuv, c->pal_yuv, sizeof(c->pal_yuv));
+            memcpy(c->slice_ctx[i]->pal_rgb, c->pal_rgb, sizeof(c->pal_rgb));
+        }
+    }
+    memcpy(c->slice_src,       src,       sizeof(c->slice_src));
+    memcpy(c->slice_srcStride, srcStride, sizeof(c->slice_srcStride));
+    memcpy(c->slice_dst,       dst,       sizeof(c->slice_dst));
+    memcpy(c->slice_dstStride, dstStride, sizeof(c->slice_dstStride));
+
+    avpriv_slicethread_execute(c->slicethread, c->nb_slice_ctx, 0);
+
+    for (i = 0; i < c->nb_slice_ctx; i++)
+        ret += c->slice_err[i];
+
+    c->dstY = c->dstH;
+    return ret;
+}
+
 av_cold void ff_sws_init_range_convert(SwsContext *c)
 {
     c->lumConvertRange = NULL;
@@ -977,7 +1046,10 @@ int attribute_align_arg sws_scale(struct SwsContext *c,
     /* reset slice direction at end of frame */
     if (srcSliceY_internal + srcSliceH == c->srcH)
         c->sliceDir = 0;
-    ret = c->swscale(c, src2, srcStride2, srcSliceY_internal, srcSliceH, dst2, dstStride2);
+    if (c->slice_ctx_initialized && srcSliceY_internal == 0 && srcSliceH == c->srcH)
+        ret = swscale_threaded(c, src2, srcStride2, dst2, dstStride2);
+    else
+        ret = c->swscale(c, src2, srcStride2, srcSliceY_internal, srcSliceH, dst2, dstStride2);
 
 
     if (c->dstXYZ && !(c->srcXYZ && c->srcW==c->dstW && c->srcH==c->dstH)) {
@@ -32,6 +32,7 @@
 #include "libavutil/pixfmt.h"
 #include "libavutil/pixdesc.h"
 #include "libavutil/ppc/util_altivec.h"
+#include "libavutil/slicethread.h"
 
 #define STR(s) AV_TOSTRING(s) // AV_STRINGIFY is too long
 
@@ -321,6 +322,21 @@ typedef struct SwsContext {
     uint8_t *cascaded1_tmp[4];
     int cascaded_mainindex;
 
+    /* The slice_* fields allow splitting the destination of a scaler task
+     * into horizontal bands that are scaled concurrently, each by its own
+     * single threaded context with private slice/ring buffer state.
+     */
+    int nb_threads;               ///< Requested number of threads, 0 for automatic.
+    AVSliceThread *slicethread;
+    struct SwsContext **slice_ctx;
+    int *slice_err;
+    int nb_slice_ctx;
+    int slice_ctx_initialized;    ///< The slice contexts are initialized and used by sws_scale().
+    const uint8_t *slice_src[4];  ///< Source of the frame being scaled by the slice threads.
+    int slice_srcStride[4];
+    uint8_t *slice_dst[4];        ///< Destination of the frame being scaled by the slice threads.
+    int slice_dstStride[4];
+
     double gamma_value;
     int gamma_flag;
     int is_internal_gamma;
@@ -830,6 +846,19 @@ void ff_get_unscaled_swscale_aarch64(SwsContext *c);
  */
 SwsFunc ff_getSwsFunc(SwsContext *c);
 
+/**
+ * Return 1 if the initialized context c can scale a whole frame as
+ * independent destination bands, 0 otherwise.
+ */
+int ff_sws_slice_threads_supported(SwsContext *c);
+
+/**
+ * avpriv_slicethread worker scaling one destination band of the frame
+ * stored in the slice_* fields of the parent context priv.
+ */
+void ff_sws_slice_worker(void *priv, int jobnr, int threadnr,
+                         int nb_jobs, int nb_threads);
+
 void ff_sws_init_input_funcs(SwsContext *c);
 void ff_sws_init_output_funcs(SwsContext *c,
                               yuv2planar1_fn *yuv2plane1,
@@ -0,0 +1,158 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Check that scaling a frame with slice threads gives the same output as
+ * the single threaded scaler.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/imgutils.h"
+#include "libavutil/lfg.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+#include "libavutil/pixdesc.h"
+#include "libswscale/swscale.h"
+
+#define NB_THREADS 4
+
+static const struct {
+    enum AVPixelFormat src_fmt, dst_fmt;
+    int src_w, src_h, dst_w, dst_h;
+    int flags;
+} tests[] = {
+    { AV_PIX_FMT_YUV420P,     AV_PIX_FMT_YUV420P, 352, 288, 640, 360, SWS_BILINEAR },
+    { AV_PIX_FMT_YUV420P,     AV_PIX_FMT_YUV420P, 640, 480, 320, 240, SWS_BICUBIC  },
+    { AV_PIX_FMT_YUV420P,     AV_PIX_FMT_RGB24,   352, 288, 352, 288, SWS_BICUBIC  },
+    { AV_PIX_FMT_RGB24,       AV_PIX_FMT_YUV420P, 320, 240, 176, 144, SWS_LANCZOS  },
+    { AV_PIX_FMT_BGRA,        AV_PIX_FMT_YUV444P, 200, 150, 400, 300, SWS_BILINEAR },
+    { AV_PIX_FMT_YUV422P10LE, AV_PIX_FMT_YUV420P, 320, 240, 640, 480, SWS_BICUBIC  },
+    { AV_PIX_FMT_YUV420P,     AV_PIX_FMT_GBRP16LE, 176, 144, 352, 288, SWS_SPLINE  },
+    { AV_PIX_FMT_GRAY8,       AV_PIX_FMT_YUV420P, 160, 120, 161, 121, SWS_AREA     },
+};
+
+static struct SwsContext *alloc_context(int idx, int threads)
+{
+    struct SwsContext *c = sws_alloc_context();
+
+    if (!c)
+        return NULL;
+    av_opt_set_int(c, "srcw",       tests[idx].src_w,   0);
+    av_opt_set_int(c, "srch",       tests[idx].src_h,   0);
+    av_opt_set_int(c, "src_format", tests[idx].src_fmt, 0);
+    av_opt_set_int(c, "dstw",       tests[idx].dst_w,   0);
+    av_opt_set_int(c, "dsth",       tests[idx].dst_h,   0);
+    av_opt_set_int(c, "dst_format", tests[idx].dst_fmt, 0);
+    av_opt_set_int(c, "sws_flags",  tests[idx].flags,   0);
+    av_opt_set_int(c, "threads",    threads,            0);
+    if (sws_init_context(c, NULL, NULL) < 0) {
+        sws_freeContext(c);
+        return NULL;
+    }
+    return c;
+}
+
+/* 0: default colorspace, 1: full range input, 2: BT.601 to BT.709
+ * The return value is ignored like vf_scale does, it is negative for
+ * YUV to YUV conversions even when the ranges were applied. */
+static void set_colorspace(struct SwsContext *c, int mode)
+{
+    const int *bt601 = sws_getCoefficients(SWS_CS_ITU601);
+    const int *bt709 = sws_getCoefficients(SWS_CS_ITU709);
+
+    switch (mode) {
+    case 1:
+        sws_setColorspaceDetails(c, bt601, 1, bt601, 0, 0, 1 << 16, 1 << 16);
+        break;
+    case 2:
+        sws_setColorspaceDetails(c, bt601, 0, bt709, 0, 0, 1 << 16, 1 << 16);
+        break;
+    }
+}
+
+static int scale(int idx, int threads, int mode, uint8_t *src[4], int src_stride[4],
+                 uint8_t *dst[4], int dst_stride[4])
+{
+    struct SwsContext *c = alloc_context(idx, threads);
+    int ret;
+
+    if (!c)
+        return AVERROR(ENOMEM);
+    set_colorspace(c, mode);
+    ret = sws_scale(c, (const uint8_t * const *)src, src_stride, 0,
+                    tests[idx].src_h, dst, dst_stride);
+    sws_freeContext(c);
+    return ret;
+}
+
+int main(void)
+{
+    static const char *modes[] = { "default", "full range", "bt601 to bt709" };
+    AVLFG lfg;
+    int i, j, mode, ret = 0;
+
+    av_lfg_init(&lfg, 0xdeadbeef);
+
+    for (i = 0; i < FF_ARRAY_ELEMS(tests); i++) {
+        for (mode = 0; mode < FF_ARRAY_ELEMS(modes); mode++) {
+            uint8_t *src[4], *ref[4], *out[4];
+            int src_stride[4], ref_stride[4], out_stride[4];
+            int src_size, dst_size;
+
+            src_size = av_image_alloc(src, src_stride, tests[i].src_w, tests[i].src_h,
+                                      tests[i].src_fmt, 16);
+            dst_size = av_image_alloc(ref, ref_stride, tests[i].dst_w, tests[i].dst_h,
+                                      tests[i].dst_fmt, 16);
+            if (src_size < 0 || dst_size < 0 ||
+                av_image_alloc(out, out_stride, tests[i].dst_w, tests[i].dst_h,
+                               tests[i].dst_fmt, 16) < 0) {
+                fprintf(stderr, "Failed to allocate the images\n");
+                return 1;
+            }
+            for (j = 0; j < src_size; j++)
+                src[0][j] = av_lfg_get(&lfg);
+            /* keep high bit depth samples in range */
+            if (tests[i].src_fmt == AV_PIX_FMT_YUV422P10LE)
+                for (j = 1; j < src_size; j += 2)
+                    src[0][j] &= 3;
+            memset(ref[0], 0, dst_size);
+            memset(out[0], 0, dst_size);
+
+            if (scale(i, 1, mode, src, src_stride, ref, ref_stride) < 0 ||
+                scale(i, NB_THREADS, mode, src, src_stride, out, out_stride) < 0) {
+                fprintf(stderr, "Failed to scale\n");
+                return 1;
+            }
+
+            printf("%s %dx%d -> %s %dx%d, %s: %s\n",
+                   av_get_pix_fmt_name(tests[i].src_fmt), tests[i].src_w, tests[i].src_h,
+                   av_get_pix_fmt_name(tests[i].dst_fmt), tests[i].dst_w, tests[i].dst_h,
+                   modes[mode], memcmp(ref[0], out[0], dst_size) ? "differs" : "identical");
+            if (memcmp(ref[0], out[0], dst_size))
+                ret = 1;
+
+            av_freep(&src[0]);
+            av_freep(&ref[0]);
+            av_freep(&out[0]);
+        }
+    }
+
+    return ret;
+}
@@ -845,9 +845,22 @@ static void fill_xyztables(struct SwsContext *c)
     }
 }
 
-int sws_setColorspaceDetails(struct SwsContext *c, const int inv_table[4],
-                             int srcRange, const int table[4], int dstRange,
-                             int brightness, int contrast, int saturation)
+static void free_slice_contexts(SwsContext *c)
+{
+    int i;
+
+    avpriv_slicethread_free(&c->slicethread);
+    for (i = 0; i < c->nb_slice_ctx; i++)
+        sws_freeContext(c->slice_ctx[i]);
+    av_freep(&c->slice_ctx);
+    av_freep(&c->slice_err);
+    c->nb_slice_ctx = 0;
+    c->slice_ctx_initialized = 0;
+}
+
+static int set_colorspace_details(struct SwsContext *c, const int inv_table[4],
+                                  int srcRange, const int table[4], int dstRange,
+                                  int brightness, int contrast, int saturation)
 {
     const AVPixFmtDescriptor *desc_dst;
     const AVPixFmtDescriptor *desc_src;
@@ -980,6 +993,34 @@ int sws_setColorspaceDetails(struct SwsContext *c, const int inv_table[4],
     return 0;
 }
 
+int sws_setColorspaceDetails(struct SwsContext *c, const int inv_table[4],
+                             int srcRange, const int table[4], int dstRange,
+                             int brightness, int contrast, int saturation)
+{
+    int i, ret;
+
+    /* The slice contexts are set up like the parent, so only the result
+     * for the parent is returned; it is negative for YUV to YUV even though
+     * the range conversion was updated. */
+    ret = set_colorspace_details(c, inv_table, srcRange, table, dstRange,
+                                 brightness, contrast, saturation);
+    if (!c->slice_ctx_initialized)
+        return ret;
+
+    /* A YUV to YUV conversion between different matrices goes through a
+     * cascade of contexts, which the parent owns and runs unthreaded. */
+    if (c->cascaded_context[0]) {
+        free_slice_contexts(c);
+        return ret;
+    }
+
+    for (i = 0; i < c->nb_slice_ctx; i++)
+        set_colorspace_details(c->slice_ctx[i], inv_table, srcRange,
+                               table, dstRange,
+                               brightness, contrast, saturation);
+    return ret;
+}
+
 int sws_getColorspaceDetails(struct SwsContext *c, int **inv_table,
                              int *srcRange, int **table, int *dstRange,
                              int *brightness, int *contrast, int *saturation)
@@ -1150,8 +1191,8 @@ static enum AVPixelFormat alphaless_fmt(enum AVPixelFormat fmt)
     }
 }
 
-av_cold int sws_init_context(SwsContext *c, SwsFilter *srcFilter,
-                             SwsFilter *dstFilter)
+static av_cold int sws_init_single_context(SwsContext *c, SwsFilter *srcFilter,
+                                           SwsFilter *dstFilter)
 {
     int i;
     int usesVFilter, usesHFilter;
@@ -1836,6 +1877,67 @@ fail: // FIXME replace things by appropriate error codes
     return -1;
 }
 
+static av_cold int context_init_threaded(SwsContext *c, SwsFilter *srcFilter,
+                                         SwsFilter *dstFilter)
+{
+    int i, ret, nb_threads;
+
+    nb_threads = avpriv_slicethread_create(&c->slicethread, c,
+                                           ff_sws_slice_worker, NULL,
+                                           c->nb_threads);
+    if (nb_threads == 1 || nb_threads == AVERROR(EINVAL)) {
+        /* a single thread was requested or threading is unsupported */
+        avpriv_slicethread_free(&c->slicethread);
+        return sws_init_single_context(c, srcFilter, dstFilter);
+    } else if (nb_threads < 0)
+        return nb_threads;
+
+    c->slice_ctx = av_mallocz_array(nb_threads, sizeof(*c->slice_ctx));
+    c->slice_err = av_mallocz_array(nb_threads, sizeof(*c->slice_err));
+    if (!c->slice_ctx || !c->slice_err)
+        return AVERROR(ENOMEM);
+
+    /* copy the options before they are altered by the initialization below */
+    for (i = 0; i < nb_threads; i++) {
+        c->slice_ctx[i] = sws_alloc_context();
+        if (!c->slice_ctx[i])
+            return AVERROR(ENOMEM);
+        c->nb_slice_ctx++;
+        ret = av_opt_copy(c->slice_ctx[i], c);
+        if (ret < 0)
+            return ret;
+        c->slice_ctx[i]->nb_threads = 1;
+    }
+
+    ret = sws_init_single_context(c, srcFilter, dstFilter);
+    if (ret < 0)
+        return ret;
+
+    if (!ff_sws_slice_threads_supported(c) ||
+        c->dstH < 2 * nb_threads << c->chrDstVSubSample) {
+        free_slice_contexts(c);
+        return 0;
+    }
+
+    for (i = 0; i < nb_threads; i++) {
+        ret = sws_init_single_context(c->slice_ctx[i], srcFilter, dstFilter);
+        if (ret < 0)
+            return ret;
+    }
+    c->slice_ctx_initialized = 1;
+
+    return 0;
+}
+
+av_cold int sws_init_context(SwsContext *c, SwsFilter *srcFilter,
+                             SwsFilter *dstFilter)
+{
+    if (c->nb_threads != 1)
+        return context_init_threaded(c, srcFilter, dstFilter);
+
+    return sws_init_single_context(c, srcFilter, dstFilter);
+}
+
 SwsContext *sws_alloc_set_opts(int srcW, int srcH, enum AVPixelFormat srcFormat,
                                int dstW, int dstH, enum AVPixelFormat dstFormat,
                                int flags, const double *param)
@@ -2326,6 +2428,8 @@ void sws_freeContext(SwsContext *c)
     av_freep(&c->yuvTable);
     av_freep(&c->formatConvBuffer);
 
+    free_slice_contexts(c);
+
     sws_freeContext(c->cascaded_context[0]);
     sws_freeContext(c->cascaded_context[1]);
     sws_freeContext(c->cascaded_context[2]);
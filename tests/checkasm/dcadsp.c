@@ -0,0 +1,74 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+
+#include "libavutil/common.h"
+#include "libavutil/internal.h"
+#include "libavcodec/dcadsp.h"
+#include "libavcodec/dca_xll.h"
+#include "libavcodec/mathops.h"
+
+#include "checkasm.h"
+
+#define BUF_SIZE 256
+
+static void check_adapt_pred(DCADSPContext *dsp)
+{
+    LOCAL_ALIGNED_16(int32_t, src,  [BUF_SIZE]);
+    LOCAL_ALIGNED_16(int32_t, buf0, [BUF_SIZE]);
+    LOCAL_ALIGNED_16(int32_t, buf1, [BUF_SIZE]);
+    int32_t coeff[DCA_XLL_ADAPT_PRED_ORDER_MAX];
+    static const int lens[] = { BUF_SIZE, 17, 2 };
+    int i, order;
+
+    declare_func(void, int32_t *buf, const int32_t *coeff,
+                 ptrdiff_t order, ptrdiff_t len);
+
+    for (order = 1; order <= DCA_XLL_ADAPT_PRED_ORDER_MAX; order++) {
+        if (check_func(dsp->adapt_pred, "adapt_pred_%d", order)) {
+            for (i = 0; i < FF_ARRAY_ELEMS(lens); i++) {
+                int j;
+
+                /* 24-bit residuals and 16-bit coefficients */
+                for (j = 0; j < BUF_SIZE; j++)
+                    src[j] = sign_extend(rnd(), 24);
+                for (j = 0; j < order; j++)
+                    coeff[j] = sign_extend(rnd(), 16);
+
+                memcpy(buf0, src, BUF_SIZE * sizeof(*src));
+                memcpy(buf1, src, BUF_SIZE * sizeof(*src));
+                call_ref(buf0, coeff, order, lens[i]);
+                call_new(buf1, coeff, order, lens[i]);
+                if (memcmp(buf0, buf1, BUF_SIZE * sizeof(*buf0)))
+                    fail();
+            }
+            memcpy(buf1, src, BUF_SIZE * sizeof(*src));
+            bench_new(buf1, coeff, order, BUF_SIZE);
+        }
+    }
+    report("adapt_pred");
+}
+
+void checkasm_check_dcadsp(void)
+{
+    DCADSPContext dsp;
+
+    ff_dcadsp_init(&dsp);
+    check_adapt_pred(&dsp);
+}
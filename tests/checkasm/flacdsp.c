@@ -21,12 +21,14 @@
 #include <string.h>
 #include "checkasm.h"
 #include "libavcodec/flacdsp.h"
+#include "libavcodec/mathops.h"
 #include "libavutil/common.h"
 #include "libavutil/internal.h"
 #include "libavutil/intreadwrite.h"
 
 #define BUF_SIZE 256
 #define MAX_CHANNELS 8
+#define LPC_ENC_LEN 4096
 
 #define randomize_buffers()                                 \
     do {                                                    \
@@ -53,6 +55,30 @@ static void check_decorrelate(uint8_t **ref_dst, uint8_t **ref_src, uint8_t **ne
     bench_new(new_dst, (int32_t **)new_src, channels, BUF_SIZE / sizeof(int32_t), 8);
 }
 
+static void check_lpc_encode(int32_t *ref_res, int32_t *new_res, int32_t *smp,
+                             int sample_bits, int coef_bits, int order, int shift,
+                             int len)
+{
+    LOCAL_ALIGNED_16(int32_t, coefs, [32]);
+    int i;
+
+    declare_func(void, int32_t *res, const int32_t *smp, int len, int order,
+                 const int32_t coefs[32], int shift);
+
+    for (i = 0; i < len + 4; i++)
+        smp[i] = sign_extend(rnd(), sample_bits);
+    for (i = 0; i < 32; i++)
+        coefs[i] = sign_extend(rnd(), coef_bits);
+
+    memset(ref_res, 0, (len + 4) * sizeof(*ref_res));
+    memset(new_res, 0, (len + 4) * sizeof(*new_res));
+    call_ref(ref_res, smp, len, order, coefs, shift);
+    call_new(new_res, smp, len, order, coefs, shift);
+    if (memcmp(ref_res, new_res, len * sizeof(*ref_res)))
+        fail();
+    bench_new(new_res, smp, len, order, coefs, shift);
+}
+
 void checkasm_check_flacdsp(void)
 {
     LOCAL_ALIGNED_16(uint8_t, ref_dst, [BUF_SIZE*MAX_CHANNELS]);
@@ -87,4 +113,25 @@ void checkasm_check_flacdsp(void)
     }
 
     report("decorrelate");
+
+    {
+        /* room for the 32 warm-up samples and for SIMD overwrites */
+        LOCAL_ALIGNED_16(int32_t, smp,     [LPC_ENC_LEN + 36]);
+        LOCAL_ALIGNED_16(int32_t, ref_res, [LPC_ENC_LEN + 36]);
+        LOCAL_ALIGNED_16(int32_t, new_res, [LPC_ENC_LEN + 36]);
+        static const int orders[] = { 1, 2, 8, 12, 32 };
+
+        ff_flacdsp_init(&h, AV_SAMPLE_FMT_S32, 2, 24);
+        for (i = 0; i < FF_ARRAY_ELEMS(orders); i++) {
+            int order = orders[i];
+            /* keep the 32-bit sums of the 16-bit version from overflowing */
+            if (check_func(h.lpc16_encode, "flac_enc_lpc_16_%d", order))
+                check_lpc_encode(ref_res, new_res, smp, 16, 15 - av_log2(order),
+                                 order, 12, LPC_ENC_LEN);
+            if (check_func(h.lpc32_encode, "flac_enc_lpc_32_%d", order))
+                check_lpc_encode(ref_res, new_res, smp, 25, 15, order, 15,
+                                 LPC_ENC_LEN);
+        }
+        report("lpc_encode");
+    }
 }
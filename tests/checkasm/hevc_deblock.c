@@ -0,0 +1,146 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+
+#include "libavutil/intreadwrite.h"
+
+#include "libavcodec/hevcdsp.h"
+
+#include "checkasm.h"
+
+#define SIZE     16                  /* block of SIZE x SIZE pixels around the edge */
+#define BUF_SIZE (SIZE * SIZE * 2)
+
+/* Smooth content with a step at the edge, so that all the filter decisions
+ * (no filtering, normal and strong filtering) are taken. */
+static void randomize_block(uint8_t *buf, ptrdiff_t stride, int bit_depth, int dir)
+{
+    int shift = bit_depth - 8;
+    int base  = (32 + rnd() % 192) << shift;
+    int step  = ((int)(rnd() % 33) - 16) << shift;
+    int noise = (1 << (rnd() % 4)) << shift;
+    int x, y;
+
+    for (y = 0; y < SIZE; y++) {
+        for (x = 0; x < SIZE; x++) {
+            int q = (dir ? x : y) >= SIZE / 2;
+            int v = base + q * step + (int)(rnd() % noise) - noise / 2;
+
+            v = av_clip_uintp2(v, bit_depth);
+            if (bit_depth > 8)
+                AV_WN16A(buf + y * stride + 2 * x, v);
+            else
+                buf[y * stride + x] = v;
+        }
+    }
+}
+
+static void check_deblock_luma(HEVCDSPContext *h, uint8_t *buf0, uint8_t *buf1,
+                               int bit_depth)
+{
+    static const char *const dir_name[2] = { "h", "v" };
+    ptrdiff_t stride = SIZE << (bit_depth > 8);
+    int offset = SIZE / 2 * stride + (SIZE / 2 << (bit_depth > 8));
+    uint8_t no_p[2] = { 0, 0 }, no_q[2] = { 0, 0 };
+    int32_t tc_max[2] = { 24, 24 };
+    int dir, i;
+
+    for (dir = 0; dir < 2; dir++) {
+        void (*func)(uint8_t *pix, ptrdiff_t stride, int beta, int32_t *tc,
+                     uint8_t *no_p, uint8_t *no_q) =
+            dir ? h->hevc_v_loop_filter_luma : h->hevc_h_loop_filter_luma;
+        declare_func(void, uint8_t *pix, ptrdiff_t stride, int beta, int32_t *tc,
+                     uint8_t *no_p, uint8_t *no_q);
+
+        if (check_func(func, "hevc_%s_loop_filter_luma_%d", dir_name[dir], bit_depth)) {
+            for (i = 0; i < 32; i++) {
+                int beta = rnd() % 65;
+                int32_t tc[2] = { rnd() % 25, rnd() % 25 };
+
+                randomize_block(buf0, stride, bit_depth, dir);
+                memcpy(buf1, buf0, BUF_SIZE);
+                call_ref(buf0 + offset, stride, beta, tc, no_p, no_q);
+                call_new(buf1 + offset, stride, beta, tc, no_p, no_q);
+                if (memcmp(buf0, buf1, BUF_SIZE)) {
+                    fail();
+                    break;
+                }
+            }
+            bench_new(buf1 + offset, stride, 64, tc_max, no_p, no_q);
+        }
+    }
+}
+
+static void check_deblock_chroma(HEVCDSPContext *h, uint8_t *buf0, uint8_t *buf1,
+                                 int bit_depth)
+{
+    static const char *const dir_name[2] = { "h", "v" };
+    ptrdiff_t stride = SIZE << (bit_depth > 8);
+    int offset = SIZE / 2 * stride + (SIZE / 2 << (bit_depth > 8));
+    uint8_t no_p[2] = { 0, 0 }, no_q[2] = { 0, 0 };
+    int32_t tc_max[2] = { 24, 24 };
+    int dir, i;
+
+    for (dir = 0; dir < 2; dir++) {
+        void (*func)(uint8_t *pix, ptrdiff_t stride, int32_t *tc,
+                     uint8_t *no_p, uint8_t *no_q) =
+            dir ? h->hevc_v_loop_filter_chroma : h->hevc_h_loop_filter_chroma;
+        declare_func(void, uint8_t *pix, ptrdiff_t stride, int32_t *tc,
+                     uint8_t *no_p, uint8_t *no_q);
+
+        if (check_func(func, "hevc_%s_loop_filter_chroma_%d", dir_name[dir], bit_depth)) {
+            for (i = 0; i < 32; i++) {
+                int32_t tc[2] = { rnd() % 25, rnd() % 25 };
+
+                randomize_block(buf0, stride, bit_depth, dir);
+                memcpy(buf1, buf0, BUF_SIZE);
+                call_ref(buf0 + offset, stride, tc, no_p, no_q);
+                call_new(buf1 + offset, stride, tc, no_p, no_q);
+                if (memcmp(buf0, buf1, BUF_SIZE)) {
+                    fail();
+                    break;
+                }
+            }
+            bench_new(buf1 + offset, stride, tc_max, no_p, no_q);
+        }
+    }
+}
+
+void checkasm_check_hevc_deblock(void)
+{
+    LOCAL_ALIGNED_32(uint8_t, buf0, [BUF_SIZE]);
+    LOCAL_ALIGNED_32(uint8_t, buf1, [BUF_SIZE]);
+    int bit_depth;
+
+    for (bit_depth = 8; bit_depth <= 10; bit_depth++) {
+        HEVCDSPContext h;
+
+        ff_hevc_dsp_init(&h, bit_depth);
+        check_deblock_luma(&h, buf0, buf1, bit_depth);
+    }
+    report("deblock_luma");
+
+    for (bit_depth = 8; bit_depth <= 10; bit_depth++) {
+        HEVCDSPContext h;
+
+        ff_hevc_dsp_init(&h, bit_depth);
+        check_deblock_chroma(&h, buf0, buf1, bit_depth);
+    }
+    report("deblock_chroma");
+}
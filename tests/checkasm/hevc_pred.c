@@ -0,0 +1,128 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+
+#include "libavutil/intreadwrite.h"
+
+#include "libavcodec/hevcpred.h"
+
+#include "checkasm.h"
+
+#define STRIDE   64                  /* in pixels */
+#define BUF_SIZE (STRIDE * 32 * 2)
+#define REF_SIZE ((2 * 32 + 1) * 2)
+
+#define randomize_pixels(buf, size, bit_depth)                             \
+    do {                                                                   \
+        int j;                                                             \
+        for (j = 0; j < size; j++) {                                       \
+            if (bit_depth > 8)                                             \
+                AV_WN16A(buf + 2 * j, rnd() & ((1 << bit_depth) - 1));     \
+            else                                                           \
+                buf[j] = rnd();                                            \
+        }                                                                  \
+    } while (0)
+
+static void check_pred_planar(HEVCPredContext *h, uint8_t *dst0, uint8_t *dst1,
+                              const uint8_t *top, const uint8_t *left,
+                              int bit_depth)
+{
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        int size = 4 << i;
+        declare_func(void, uint8_t *src, const uint8_t *top,
+                     const uint8_t *left, ptrdiff_t stride);
+
+        if (check_func(h->pred_planar[i], "hevc_pred_planar_%dx%d_%d", size, size, bit_depth)) {
+            memset(dst0, 0, BUF_SIZE);
+            memset(dst1, 0, BUF_SIZE);
+            call_ref(dst0, top, left, STRIDE);
+            call_new(dst1, top, left, STRIDE);
+            if (memcmp(dst0, dst1, BUF_SIZE))
+                fail();
+            bench_new(dst1, top, left, STRIDE);
+        }
+    }
+}
+
+static void check_pred_angular(HEVCPredContext *h, uint8_t *dst0, uint8_t *dst1,
+                               const uint8_t *top, const uint8_t *left,
+                               int bit_depth)
+{
+    int i, mode, c_idx;
+
+    for (i = 0; i < 4; i++) {
+        int size = 4 << i;
+        declare_func(void, uint8_t *src, const uint8_t *top,
+                     const uint8_t *left, ptrdiff_t stride,
+                     int c_idx, int mode);
+
+        if (check_func(h->pred_angular[i], "hevc_pred_angular_%dx%d_%d", size, size, bit_depth)) {
+            for (mode = 2; mode <= 34; mode++) {
+                for (c_idx = 0; c_idx <= 1; c_idx++) {
+                    memset(dst0, 0, BUF_SIZE);
+                    memset(dst1, 0, BUF_SIZE);
+                    call_ref(dst0, top, left, STRIDE, c_idx, mode);
+                    call_new(dst1, top, left, STRIDE, c_idx, mode);
+                    if (memcmp(dst0, dst1, BUF_SIZE)) {
+                        fail();
+                        return;
+                    }
+                }
+            }
+            /* a diagonal mode needing the projection of the other side */
+            bench_new(dst1, top, left, STRIDE, 1, 22);
+        }
+    }
+}
+
+void checkasm_check_hevc_pred(void)
+{
+    LOCAL_ALIGNED_32(uint8_t, dst0, [BUF_SIZE]);
+    LOCAL_ALIGNED_32(uint8_t, dst1, [BUF_SIZE]);
+    LOCAL_ALIGNED_32(uint8_t, top,  [REF_SIZE]);
+    LOCAL_ALIGNED_32(uint8_t, left, [REF_SIZE]);
+    int bit_depth;
+
+    for (bit_depth = 8; bit_depth <= 10; bit_depth++) {
+        HEVCPredContext h;
+        int ps = bit_depth > 8 ? 2 : 1;
+
+        ff_hevc_pred_init(&h, bit_depth);
+        randomize_pixels(top,  REF_SIZE / 2, bit_depth);
+        randomize_pixels(left, REF_SIZE / 2, bit_depth);
+        /* top[-1] and left[-1] are the same corner sample */
+        memcpy(left, top, ps);
+        check_pred_planar(&h, dst0, dst1, top + ps, left + ps, bit_depth);
+    }
+    report("pred_planar");
+
+    for (bit_depth = 8; bit_depth <= 10; bit_depth++) {
+        HEVCPredContext h;
+        int ps = bit_depth > 8 ? 2 : 1;
+
+        ff_hevc_pred_init(&h, bit_depth);
+        randomize_pixels(top,  REF_SIZE / 2, bit_depth);
+        randomize_pixels(left, REF_SIZE / 2, bit_depth);
+        memcpy(left, top, ps);
+        check_pred_angular(&h, dst0, dst1, top + ps, left + ps, bit_depth);
+    }
+    report("pred_angular");
+}
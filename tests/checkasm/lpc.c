@@ -0,0 +1,103 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+#include "checkasm.h"
+#include "libavcodec/lpc.h"
+#include "libavcodec/mathops.h"
+#include "libavutil/common.h"
+#include "libavutil/internal.h"
+#include "libavutil/mem.h"
+
+#define BUF_SIZE 4096
+#define MAX_LAG  32
+#define EPS      0.005
+
+static void check_welch_window(LPCContext *s, int len)
+{
+    LOCAL_ALIGNED_16(int32_t, src,     [BUF_SIZE]);
+    LOCAL_ALIGNED_16(double,  ref_dst, [BUF_SIZE]);
+    LOCAL_ALIGNED_16(double,  new_dst, [BUF_SIZE]);
+    int i;
+
+    declare_func(void, const int32_t *data, int len, double *w_data);
+
+    for (i = 0; i < len; i++)
+        src[i] = sign_extend(rnd(), 24);
+
+    call_ref(src, len, ref_dst);
+    call_new(src, len, new_dst);
+    /* the middle sample of odd lengths is left untouched by the C version */
+    if (!double_near_abs_eps_array(ref_dst, new_dst, EPS, len >> 1) ||
+        !double_near_abs_eps_array(ref_dst + len - (len >> 1),
+                                   new_dst + len - (len >> 1), EPS, len >> 1))
+        fail();
+    bench_new(src, len, new_dst);
+}
+
+static void check_autocorr(LPCContext *s, int len, int lag)
+{
+    LOCAL_ALIGNED_16(double, buf, [MAX_LAG + BUF_SIZE + 2]);
+    double ref_autoc[MAX_LAG + 1], new_autoc[MAX_LAG + 1];
+    double *data = buf + MAX_LAG;
+    int i;
+
+    declare_func(void, const double *data, int len, int lag, double *autoc);
+
+    /* like the windowed samples of the LPC context, the padding is zeroed */
+    memset(buf, 0, sizeof(*buf) * (MAX_LAG + BUF_SIZE + 2));
+    for (i = 0; i < len; i++)
+        data[i] = sign_extend(rnd(), 16) / 32768.0;
+
+    call_ref(data, len, lag, ref_autoc);
+    call_new(data, len, lag, new_autoc);
+    for (i = 0; i <= lag; i++) {
+        if (!double_near_abs_eps(ref_autoc[i], new_autoc[i],
+                                 EPS * FFMAX(1.0, fabs(ref_autoc[i])))) {
+            fail();
+            break;
+        }
+    }
+    bench_new(data, len, lag, new_autoc);
+}
+
+void checkasm_check_lpc(void)
+{
+    static const int lens[] = { 4095, 4096 };
+    static const int lags[] = { 8, 12, 32 };
+    LPCContext s;
+    int i, j;
+
+    if (ff_lpc_init(&s, BUF_SIZE, MAX_LAG, FF_LPC_TYPE_DEFAULT) < 0)
+        return;
+
+    for (i = 0; i < FF_ARRAY_ELEMS(lens); i++)
+        if (check_func(s.lpc_apply_welch_window, "lpc_apply_welch_window_%s",
+                       lens[i] & 1 ? "odd" : "even"))
+            check_welch_window(&s, lens[i]);
+    report("apply_welch_window");
+
+    for (i = 0; i < FF_ARRAY_ELEMS(lags); i++)
+        for (j = 0; j < FF_ARRAY_ELEMS(lens); j++)
+            if (check_func(s.lpc_compute_autocorr, "lpc_compute_autocorr_%d_%s",
+                           lags[i], lens[j] & 1 ? "odd" : "even"))
+                check_autocorr(&s, lens[j], lags[i]);
+    report("compute_autocorr");
+
+    ff_lpc_end(&s);
+}
@@ -0,0 +1,132 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+#include "checkasm.h"
+#include "libavfilter/overlay.h"
+#include "libavutil/common.h"
+#include "libavutil/internal.h"
+#include "libavutil/mem.h"
+
+#define WIDTH 64
+#define ALINESIZE (WIDTH * 2 + 16)
+
+static const uint8_t alpha_values[] = { 0, 1, 127, 128, 254, 255 };
+
+/* alpha is mostly random, with the values taking special paths mixed in */
+static void randomize_buffers(uint8_t *buf, int size, int alpha_step, int alpha_pos)
+{
+    int i;
+
+    for (i = 0; i < size; i++)
+        buf[i] = rnd();
+    if (alpha_step)
+        for (i = alpha_pos; i < size; i += alpha_step)
+            if (rnd() & 1)
+                buf[i] = alpha_values[rnd() % FF_ARRAY_ELEMS(alpha_values)];
+}
+
+/* The new function may leave a tail of pixels to the caller, which must be
+ * left untouched. */
+static void check_output(const uint8_t *dst0, const uint8_t *dst1,
+                         const uint8_t *orig, int n0, int n1, int w, int bpp)
+{
+    if (n1 > n0 || n0 != w ||
+        memcmp(dst0, dst1, n1 * bpp) ||
+        memcmp(dst1 + n1 * bpp, orig + n1 * bpp, (w - n1) * bpp))
+        fail();
+}
+
+static void check_blend_row(int (*blend_row)(uint8_t *d, const uint8_t *s, const uint8_t *a,
+                                             ptrdiff_t alinesize, int w),
+                            const char *name)
+{
+    LOCAL_ALIGNED_16(uint8_t, dst0, [WIDTH]);
+    LOCAL_ALIGNED_16(uint8_t, dst1, [WIDTH]);
+    LOCAL_ALIGNED_16(uint8_t, orig, [WIDTH]);
+    LOCAL_ALIGNED_16(uint8_t, src,  [WIDTH]);
+    LOCAL_ALIGNED_16(uint8_t, a,    [ALINESIZE * 2]);
+    static const int widths[] = { WIDTH, WIDTH - 1, 7, 1 };
+    int i, n0, n1;
+
+    declare_func(int, uint8_t *d, const uint8_t *s, const uint8_t *a,
+                 ptrdiff_t alinesize, int w);
+
+    if (check_func(blend_row, "%s", name)) {
+        for (i = 0; i < FF_ARRAY_ELEMS(widths); i++) {
+            int w = widths[i];
+
+            randomize_buffers(orig, WIDTH, 0, 0);
+            randomize_buffers(src,  WIDTH, 0, 0);
+            randomize_buffers(a,    ALINESIZE * 2, 1, 0);
+            memcpy(dst0, orig, WIDTH);
+            memcpy(dst1, orig, WIDTH);
+
+            n0 = call_ref(dst0, src, a, ALINESIZE, w);
+            n1 = call_new(dst1, src, a, ALINESIZE, w);
+            check_output(dst0, dst1, orig, n0, n1, w, 1);
+        }
+        bench_new(dst1, src, a, ALINESIZE, WIDTH);
+    }
+}
+
+static void check_blend_row_rgba(int (*blend_row)(uint8_t *d, const uint8_t *s,
+                                                  int w, int alpha_pos),
+                                 int alpha_pos)
+{
+    LOCAL_ALIGNED_16(uint8_t, dst0, [WIDTH * 4]);
+    LOCAL_ALIGNED_16(uint8_t, dst1, [WIDTH * 4]);
+    LOCAL_ALIGNED_16(uint8_t, orig, [WIDTH * 4]);
+    LOCAL_ALIGNED_16(uint8_t, src,  [WIDTH * 4]);
+    static const int widths[] = { WIDTH, WIDTH - 1, 3, 1 };
+    int i, n0, n1;
+
+    declare_func(int, uint8_t *d, const uint8_t *s, int w, int alpha_pos);
+
+    if (check_func(blend_row, "blend_row_rgba_%d", alpha_pos)) {
+        for (i = 0; i < FF_ARRAY_ELEMS(widths); i++) {
+            int w = widths[i];
+
+            randomize_buffers(orig, WIDTH * 4, 4, alpha_pos);
+            randomize_buffers(src,  WIDTH * 4, 4, alpha_pos);
+            memcpy(dst0, orig, WIDTH * 4);
+            memcpy(dst1, orig, WIDTH * 4);
+
+            n0 = call_ref(dst0, src, w, alpha_pos);
+            n1 = call_new(dst1, src, w, alpha_pos);
+            check_output(dst0, dst1, orig, n0, n1, w, 4);
+        }
+        bench_new(dst1, src, WIDTH, alpha_pos);
+    }
+}
+
+void checkasm_check_overlay(void)
+{
+    OverlayDSPContext dsp;
+
+    ff_overlay_dsp_init(&dsp);
+
+    check_blend_row(dsp.blend_row_444, "blend_row_444");
+    check_blend_row(dsp.blend_row_422, "blend_row_422");
+    check_blend_row(dsp.blend_row_420, "blend_row_420");
+    report("blend_row");
+
+    check_blend_row_rgba(dsp.blend_row_rgba, 0);
+    check_blend_row_rgba(dsp.blend_row_rgba, 3);
+    report("blend_row_rgba");
+}
@@ -0,0 +1,117 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include "checkasm.h"
+#include "libavfilter/tonemap.h"
+#include "libavutil/common.h"
+#include "libavutil/internal.h"
+
+#define WIDTH 64
+#define PEAK  10.0
+
+/* the tolerance documented for TonemapDSPContext.tonemap_row */
+#define EPS   1e-5f
+
+static const struct {
+    enum TonemapAlgorithm algorithm;
+    const char *name;
+    double param;
+} algorithms[] = {
+    { TONEMAP_NONE,     "none",     1.0 },
+    { TONEMAP_LINEAR,   "linear",   1.0 },
+    { TONEMAP_CLIP,     "clip",     1.0 },
+    { TONEMAP_REINHARD, "reinhard", 1.0 },
+    { TONEMAP_HABLE,    "hable",    1.0 },
+    { TONEMAP_MOBIUS,   "mobius",   0.3 },
+};
+
+/* BT.2020 luma weights in the G, B, R plane order */
+static const double luma[3] = { 0.6780, 0.0593, 0.2627 };
+
+static void randomize_buffers(float *buf, int size)
+{
+    int i;
+
+    /* mostly within the signal peak, with some overshoots and dark pixels */
+    for (i = 0; i < size; i++) {
+        float v = rnd() / (float)UINT32_MAX;
+        buf[i] = (rnd() & 7) ? v * PEAK * 1.1 : v * v * v * 0.01;
+    }
+}
+
+static void check_output(const float *ref, const float *new, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+        if (!float_near_abs_eps(ref[i], new[i], EPS * FFMAX(1.0f, fabsf(ref[i])))) {
+            fprintf(stderr, "%d: %g != %g\n", i, ref[i], new[i]);
+            fail();
+            return;
+        }
+    }
+}
+
+static void check_tonemap_row(int algo, int desat)
+{
+    LOCAL_ALIGNED_32(float, src, [3], [WIDTH]);
+    LOCAL_ALIGNED_32(float, dst0, [3], [WIDTH]);
+    LOCAL_ALIGNED_32(float, dst1, [3], [WIDTH]);
+    static TonemapParams params;
+    TonemapDSPContext dsp;
+    const float *srcp[3] = { src[0],  src[1],  src[2]  };
+    float *dstp0[3]      = { dst0[0], dst0[1], dst0[2] };
+    float *dstp1[3]      = { dst1[0], dst1[1], dst1[2] };
+    int i, n0, n1;
+
+    declare_func(int, float *const dst[3], const float *const src[3], int w,
+                 const TonemapParams *p);
+
+    ff_tonemap_dsp_init(&dsp, algorithms[algo].algorithm);
+    ff_tonemap_params_init(&params, algorithms[algo].algorithm,
+                           algorithms[algo].param, desat, PEAK, luma);
+
+    if (check_func(dsp.tonemap_row, "tonemap_row_%s%s", algorithms[algo].name,
+                   desat ? "_desat" : "")) {
+        randomize_buffers(src[0], 3 * WIDTH);
+        memset(dst0, 0, sizeof(dst0[0]) * 3);
+        memset(dst1, 0, sizeof(dst1[0]) * 3);
+
+        n0 = call_ref(dstp0, srcp, WIDTH, &params);
+        n1 = call_new(dstp1, srcp, WIDTH, &params);
+        if (n0 != WIDTH || n1 > n0 || n1 <= 0)
+            fail();
+        for (i = 0; i < 3; i++)
+            check_output(dst0[i], dst1[i], n1);
+
+        bench_new(dstp1, srcp, WIDTH, &params);
+    }
+}
+
+void checkasm_check_tonemap(void)
+{
+    int i;
+
+    for (i = 0; i < FF_ARRAY_ELEMS(algorithms); i++) {
+        check_tonemap_row(i, 0);
+        check_tonemap_row(i, 2);
+    }
+    report("tonemap_row");
+}
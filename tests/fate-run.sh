@@ -153,6 +153,31 @@ md5(){
     do_md5sum $encfile | awk '{print $1}'
 }
 
+# the playlists or manifests written by a segmenting muxer to pipe:1, without
+# the wall clock times
+segment_playlists(){
+    ffmpeg "$@" -flags +bitexact -fflags +bitexact pipe:1 |
+        sed -e '/availabilityStartTime=/d' -e '/publishTime=/d'
+}
+
+hls_files(){
+    ffmpeg "$@" -flags +bitexact -fflags +bitexact -f hls \
+        -hls_segment_filename ${outdir}/${test}-%d.ts ${outdir}/${test}.m3u8 || return
+    sed "s/${test}-//" ${outdir}/${test}.m3u8
+    for seg in $(grep -v "^#" ${outdir}/${test}.m3u8); do
+        echo "${seg#${test}-} $(do_md5sum ${outdir}/$seg | awk '{print $1}')"
+    done
+}
+
+threads_cmp(){
+    nb_threads=$1
+    shift
+    single=$(md5 "$@" -threads 1) || return
+    multi=$(md5 "$@" -threads $nb_threads) || return
+    test "$single" = "$multi" && echo "identical with $nb_threads threads" ||
+        echo "1 thread: $single, $nb_threads threads: $multi"
+}
+
 pcm(){
     ffmpeg "$@" -vn -f s16le -
 }
@@ -158,6 +158,16 @@ fate-aac-aref-encode: CMP_TARGET = 669
 fate-aac-aref-encode: SIZE_TOLERANCE = 2464
 fate-aac-aref-encode: FUZZ = 89
 
+# The slice threads must give the same output as a single thread, with a
+# bitrate and with a constant quantizer.
+FATE_AAC_ENCODE_THREADS += fate-aac-threads-encode
+fate-aac-threads-encode: ./tests/data/asynth-22050-6.wav
+fate-aac-threads-encode: CMD = threads_cmp 4 -i $(TARGET_PATH)/tests/data/asynth-22050-6.wav -c:a aac -b:a 192k -fflags +bitexact -flags +bitexact -f adts
+
+FATE_AAC_ENCODE_THREADS += fate-aac-threads-qscale-encode
+fate-aac-threads-qscale-encode: ./tests/data/asynth-22050-6.wav
+fate-aac-threads-qscale-encode: CMD = threads_cmp 4 -i $(TARGET_PATH)/tests/data/asynth-22050-6.wav -c:a aac -q:a 2 -fflags +bitexact -flags +bitexact -f adts
+
 FATE_AAC_ENCODE += fate-aac-ln-encode
 fate-aac-ln-encode: CMD = enc_dec_pcm adts wav s16le $(TARGET_SAMPLES)/audio-reference/luckynight_2ch_44kHz_s16.wav -c:a aac -aac_is 0 -aac_pns 0 -aac_ms 0 -aac_tns 0 -b:a 512k
 fate-aac-ln-encode: CMP = stddev
@@ -263,10 +273,12 @@ $(FATE_AAC_ALL): CMP  = oneoff
 $(FATE_AAC_ALL): FUZZ = 2
 
 FATE_AAC_ENCODE-$(call ENCMUX, AAC, ADTS) += $(FATE_AAC_ENCODE)
+FATE_AAC_ENCODE_THREADS-$(call ENCMUX, AAC, ADTS) += $(FATE_AAC_ENCODE_THREADS)
 
 FATE_AAC_BSF-$(call ALLYES, AAC_DEMUXER AAC_ADTSTOASC_BSF MATROSKA_MUXER) += fate-aac-autobsf-adtstoasc
 
 FATE_SAMPLES_FFMPEG += $(FATE_AAC_ALL) $(FATE_AAC_ENCODE-yes) $(FATE_AAC_BSF-yes)
+FATE_FFMPEG += $(FATE_AAC_ENCODE_THREADS-yes)
 
-fate-aac: $(FATE_AAC_ALL) $(FATE_AAC_ENCODE) $(FATE_AAC_BSF-yes)
+fate-aac: $(FATE_AAC_ALL) $(FATE_AAC_ENCODE) $(FATE_AAC_ENCODE_THREADS-yes) $(FATE_AAC_BSF-yes)
 fate-aac-latm: $(FATE_AAC_LATM-yes)
@@ -0,0 +1,10 @@
+# The manifests of a live stream with chunks of at most 0.3 s, the segments
+# being 1 s long, announce them with an availabilityTimeOffset of 0.72 s.
+FATE_DASHENC-$(call ALLYES, DASH_MUXER MP4_MUXER MPEG4_ENCODER TESTSRC_FILTER LAVFI_INDEV) += fate-dash-streaming
+fate-dash-streaming: CMD = segment_playlists -f lavfi -i testsrc=size=64x48:rate=25:d=2 -c:v mpeg4 -g 25 \
+    -f dash -streaming 1 -frag_duration 300000 -min_seg_duration 1000000 \
+    -init_seg_name tests/data/fate/dash-streaming-init-\$$RepresentationID\$$.m4s \
+    -media_seg_name tests/data/fate/dash-streaming-\$$RepresentationID\$$-\$$Number\$$.m4s
+
+FATE_FFMPEG += $(FATE_DASHENC-yes)
+fate-dashenc: $(FATE_DASHENC-yes)
@@ -26,6 +26,9 @@ FATE_DCADEC_LOSSLESS += fate-dca-$(1) fate-dca-$(1)-dmix_2 fate-dca-$(1)-dmix_6
 fate-dca-$(1): CMD = framemd5 -i $(TARGET_SAMPLES)/dts/dcadec-suite/$(1).dtshd -c:a pcm_$(2)
 fate-dca-$(1)-dmix_2: CMD = framemd5 -request_channel_layout 0x3   -i $(TARGET_SAMPLES)/dts/dcadec-suite/$(1).dtshd -c:a pcm_$(2)
 fate-dca-$(1)-dmix_6: CMD = framemd5 -request_channel_layout 0x60f -i $(TARGET_SAMPLES)/dts/dcadec-suite/$(1).dtshd -c:a pcm_$(2)
+FATE_DCADEC_LOSSLESS += fate-dca-$(1)-slice-threads
+fate-dca-$(1)-slice-threads: CMD = threads=4 thread_type=slice framemd5 -i $(TARGET_SAMPLES)/dts/dcadec-suite/$(1).dtshd -c:a pcm_$(2)
+fate-dca-$(1)-slice-threads: REF = $(SRC_PATH)/tests/ref/fate/dca-$(1)
 endef
 
 define FATE_DCADEC_LOSSY_SUITE
@@ -70,6 +73,11 @@ fate-dca-core: REF = $(SAMPLES)/dts/dts.pcm
 FATE_DCA-$(call DEMDEC, DTS, DCA) += fate-dca-xll
 fate-dca-xll: CMD = md5 -i $(TARGET_SAMPLES)/dts/master_audio_7.1_24bit.dts -f s24le
 
+# The channel sets are filtered in parallel with slice threads
+FATE_DCA-$(call DEMDEC, DTS, DCA) += fate-dca-xll-slice-threads
+fate-dca-xll-slice-threads: CMD = threads=4 thread_type=slice md5 -i $(TARGET_SAMPLES)/dts/master_audio_7.1_24bit.dts -f s24le
+fate-dca-xll-slice-threads: REF = $(SRC_PATH)/tests/ref/fate/dca-xll
+
 FATE_DCA-$(call DEMDEC, DTS, DCA) += fate-dts_es
 fate-dts_es: CMD = pcm -i $(TARGET_SAMPLES)/dts/dts_es.dts
 fate-dts_es: CMP = oneoff
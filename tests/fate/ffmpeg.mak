@@ -30,6 +30,46 @@ fate-ffmpeg-filter_complex: CMD = framecrc -filter_complex color=d=1:r=5 -fflags
 FATE_FFMPEG-$(call ALLYES, AEVALSRC_FILTER ASETNSAMPLES_FILTER AC3_FIXED_ENCODER) += fate-ffmpeg-filter_complex_audio
 fate-ffmpeg-filter_complex_audio: CMD = framecrc -filter_complex "aevalsrc=0:d=0.1,asetnsamples=1537" -c ac3_fixed
 
+# The encoder threads must not change the output
+FATE_FFMPEG-$(call ALLYES, TESTSRC2_FILTER AEVALSRC_FILTER ATRIM_FILTER MPEG4_ENCODER AC3_FIXED_ENCODER) += fate-ffmpeg-enc-threads fate-ffmpeg-enc-nothreads
+fate-ffmpeg-enc-threads: CMD = framecrc -enc_thread_queue_size 4 \
+    -filter_complex "testsrc2=d=1:r=10:s=176x144,format=yuv420p,split[v0][v1];aevalsrc=sin(440*2*PI*t):n=1536,atrim=end_sample=30720[a]" \
+    -map "[v0]" -map "[v1]" -map "[a]" -c:v mpeg4 -c:a ac3_fixed -s:v:1 88x72 -fflags +bitexact -flags +bitexact
+fate-ffmpeg-enc-nothreads: CMD = framecrc -enc_thread_queue_size 0 \
+    -filter_complex "testsrc2=d=1:r=10:s=176x144,format=yuv420p,split[v0][v1];aevalsrc=sin(440*2*PI*t):n=1536,atrim=end_sample=30720[a]" \
+    -map "[v0]" -map "[v1]" -map "[a]" -c:v mpeg4 -c:a ac3_fixed -s:v:1 88x72 -fflags +bitexact -flags +bitexact
+fate-ffmpeg-enc-nothreads: REF = $(SRC_PATH)/tests/ref/fate/ffmpeg-enc-threads
+
+# Neither do the decoder and filtergraph threads
+FATE_FFMPEG-$(call ALLYES, RAWVIDEO_DEMUXER RAWVIDEO_DECODER WAV_DEMUXER PCM_S16LE_DECODER SCALE_FILTER HFLIP_FILTER MPEG4_ENCODER PCM_S16LE_ENCODER) += fate-ffmpeg-dec-filter-threads fate-ffmpeg-dec-filter-nothreads
+fate-ffmpeg-dec-filter-threads fate-ffmpeg-dec-filter-nothreads: tests/data/vsynth1.yuv tests/data/asynth-44100-2.wav
+fate-ffmpeg-dec-filter-threads: CMD = framecrc -dec_thread -filter_thread_queue_size 4 \
+    -f rawvideo -s 352x288 -pix_fmt yuv420p -i $(TARGET_PATH)/tests/data/vsynth1.yuv -i $(TARGET_PATH)/tests/data/asynth-44100-2.wav \
+    -map 0:v -map 0:v -map 1:a -filter:v:0 scale=176:144 -filter:v:1 hflip -c:v mpeg4 -c:a pcm_s16le -fflags +bitexact -flags +bitexact
+fate-ffmpeg-dec-filter-nothreads: CMD = framecrc -nodec_thread -filter_thread_queue_size 0 -enc_thread_queue_size 0 \
+    -f rawvideo -s 352x288 -pix_fmt yuv420p -i $(TARGET_PATH)/tests/data/vsynth1.yuv -i $(TARGET_PATH)/tests/data/asynth-44100-2.wav \
+    -map 0:v -map 0:v -map 1:a -filter:v:0 scale=176:144 -filter:v:1 hflip -c:v mpeg4 -c:a pcm_s16le -fflags +bitexact -flags +bitexact
+fate-ffmpeg-dec-filter-nothreads: REF = $(SRC_PATH)/tests/ref/fate/ffmpeg-dec-filter-threads
+
+# Frames decoded into filter buffers across a size change, the same as decoded
+# into buffers of the decoder
+tests/data/bmp-resize.bmp: TAG = GEN
+tests/data/bmp-resize.bmp: ffmpeg$(PROGSSUF)$(EXESUF) tests/data/vsynth1.yuv | tests/data
+	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< -nostdin \
+        -f rawvideo -s 352x288 -pix_fmt yuv420p -i $(TARGET_PATH)/tests/data/vsynth1.yuv -frames:v 5 \
+        -c:v bmp -pix_fmt bgr24 -f image2pipe -y $(TARGET_PATH)/$@ 2>/dev/null
+	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< -nostdin \
+        -f rawvideo -s 352x288 -pix_fmt yuv420p -i $(TARGET_PATH)/tests/data/vsynth1.yuv -frames:v 5 -s 176x144 \
+        -c:v bmp -pix_fmt bgr24 -f image2pipe - 2>/dev/null >> $(TARGET_PATH)/$@
+
+FATE_FFMPEG-$(call ALLYES, BMP_ENCODER IMAGE2PIPE_MUXER IMAGE_BMP_PIPE_DEMUXER BMP_DECODER SCALE_FILTER PAD_FILTER) += fate-ffmpeg-filter-buffers-resize fate-ffmpeg-nofilter-buffers-resize
+fate-ffmpeg-filter-buffers-resize fate-ffmpeg-nofilter-buffers-resize: tests/data/bmp-resize.bmp
+fate-ffmpeg-filter-buffers-resize: CMD = framecrc -f bmp_pipe -filter_buffers 1 -i $(TARGET_PATH)/tests/data/bmp-resize.bmp \
+    -vf pad=iw+16:ih+16:8:8
+fate-ffmpeg-nofilter-buffers-resize: CMD = framecrc -f bmp_pipe -filter_buffers 0 -i $(TARGET_PATH)/tests/data/bmp-resize.bmp \
+    -vf pad=iw+16:ih+16:8:8
+fate-ffmpeg-nofilter-buffers-resize: REF = $(SRC_PATH)/tests/ref/fate/ffmpeg-filter-buffers-resize
+
 # Ticket 6375, use case of NoX
 FATE_SAMPLES_FFMPEG-$(call ALLYES, MOV_DEMUXER PNG_DECODER ALAC_DECODER PCM_S16LE_ENCODER RAWVIDEO_ENCODER) += fate-ffmpeg-attached_pics
 fate-ffmpeg-attached_pics: CMD = threads=2 framecrc -i $(TARGET_SAMPLES)/lossless-audio/inside.m4a -c:a pcm_s16le -max_muxing_queue_size 16
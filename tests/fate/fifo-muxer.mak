@@ -15,6 +15,14 @@ fate-fifo-muxer-tst: libavformat/tests/fifo_muxer$(EXESUF)
 fate-fifo-muxer-tst: CMD = run libavformat/tests/fifo_muxer$(EXESUF)
 FATE_FIFO_MUXER-$(call ALLYES, FIFO_MUXER NETWORK) += fate-fifo-muxer-tst
 
+# The statistics logged when the output is closed count each packet once.
+fate-fifo-muxer-stats: CMD = ffmpeg -v verbose -f lavfi -i testsrc=size=64x48:rate=25:d=1 -map 0\
+                             -c:v rawvideo -f fifo -fifo_format null - 2>&1 |\
+                             grep -o "[0-9]* packets written, [0-9]* dropped"
+fate-fifo-muxer-stats: CMP = oneline
+fate-fifo-muxer-stats: REF = 25 packets written, 0 dropped
+FATE_FIFO_MUXER-$(call ALLYES, FIFO_MUXER NULL_MUXER LAVFI_INDEV TESTSRC_FILTER RAWVIDEO_ENCODER) += fate-fifo-muxer-stats
+
 FATE_SAMPLES_FFMPEG += $(FATE_SAMPLES_FIFO_MUXER-yes)
 FATE_FFMPEG += $(FATE_FIFO_MUXER-yes)
 fate-fifo-muxer: $(FATE_FIFO_MUXER-yes) $(FATE_SAMPLES_FIFO_MUXER-yes)
@@ -113,6 +113,11 @@ FATE_FILTER-$(call ALLYES, FRAMERATE_FILTER TESTSRC2_FILTER) += fate-filter-fram
 fate-filter-framerate-up: CMD = framecrc -lavfi testsrc2=r=2:d=10,framerate=fps=10 -t 1
 fate-filter-framerate-down: CMD = framecrc -lavfi testsrc2=r=2:d=10,framerate=fps=1 -t 1
 
+FATE_FILTER_MULTISCALE = fate-filter-multiscale-yuv420p fate-filter-multiscale-nv12 fate-filter-multiscale-rgb24 fate-filter-multiscale-yuyv422
+fate-filter-multiscale-%: CMD = framecrc -lavfi "testsrc2=s=320x240:r=5:d=1,format=$(@:fate-filter-multiscale-%=%),multiscale=sizes=160x120|96x72|40x30:flags=bicubic:format=yuv420p"
+FATE_FILTER-$(call ALLYES, TESTSRC2_FILTER FORMAT_FILTER MULTISCALE_FILTER) += $(FATE_FILTER_MULTISCALE)
+fate-filter-multiscale: $(FATE_FILTER_MULTISCALE)
+
 FATE_FILTER_VSYNTH-$(CONFIG_BOXBLUR_FILTER) += fate-filter-boxblur
 fate-filter-boxblur: CMD = framecrc -c:v pgmyuv -i $(SRC) -vf boxblur=2:1
 
@@ -761,6 +766,12 @@ fate-filter-refcmp-ssim-rgb: CMD = refcmp_metadata ssim rgb24 0.015
 FATE_FILTER_SAMPLES-$(call ALLYES, $(REFCMP_DEPS) SSIM_FILTER) += fate-filter-refcmp-ssim-yuv
 fate-filter-refcmp-ssim-yuv: CMD = refcmp_metadata ssim yuv422p 0.015
 
+FATE_FILTER-$(call ALLYES, $(REFCMP_DEPS) SSIM_FILTER) += fate-filter-refcmp-ssim-psnr-rgb
+fate-filter-refcmp-ssim-psnr-rgb: CMD = refcmp_metadata ssim=psnr=1 rgb24 0.015
+
+FATE_FILTER-$(call ALLYES, $(REFCMP_DEPS) SSIM_FILTER) += fate-filter-refcmp-ssim-psnr-yuv
+fate-filter-refcmp-ssim-psnr-yuv: CMD = refcmp_metadata ssim=psnr=1 yuv422p 0.015
+
 FATE_SAMPLES_FFPROBE += $(FATE_METADATA_FILTER-yes)
 FATE_SAMPLES_FFMPEG += $(FATE_FILTER_SAMPLES-yes)
 FATE_FFMPEG += $(FATE_FILTER-yes)
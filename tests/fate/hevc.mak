@@ -222,6 +222,31 @@ $(foreach N,$(HEVC_SAMPLES_422_10BIN),$(eval $(call FATE_HEVC_TEST_422_10BIN,$(N
 $(foreach N,$(HEVC_SAMPLES_444_8BIT),$(eval $(call FATE_HEVC_TEST_444_8BIT,$(N))))
 $(foreach N,$(HEVC_SAMPLES_444_12BIT),$(eval $(call FATE_HEVC_TEST_444_12BIT,$(N))))
 
+# Frame threads decoding the rows of WPP streams in parallel must give the
+# output of a single thread, streams using tiles are decoded without row threads
+HEVC_SAMPLES_WPP =                \
+    WPP_A_ericsson_MAIN_2         \
+    WPP_B_ericsson_MAIN_2         \
+    WPP_C_ericsson_MAIN_2         \
+    WPP_D_ericsson_MAIN_2         \
+    WPP_E_ericsson_MAIN_2         \
+    WPP_F_ericsson_MAIN_2         \
+    TILES_A_Cisco_2               \
+
+HEVC_SAMPLES_WPP_10BIT =          \
+    WPP_A_ericsson_MAIN10_2       \
+    WPP_D_ericsson_MAIN10_2       \
+    WPP_F_ericsson_MAIN10_2       \
+
+define FATE_HEVC_WPP_THREADS_TEST
+FATE_HEVC += fate-hevc-wpp-threads-$(1)
+fate-hevc-wpp-threads-$(1): CMD = threads=2 thread_type=frame framecrc -flags unaligned -wpp_threads 4 $(2) -i $(TARGET_SAMPLES)/hevc-conformance/$(1).bit -pix_fmt $(3)
+fate-hevc-wpp-threads-$(1): REF = $(SRC_PATH)/tests/ref/fate/hevc-conformance-$(1)
+endef
+
+$(foreach N,$(HEVC_SAMPLES_WPP),$(eval $(call FATE_HEVC_WPP_THREADS_TEST,$(N),-vsync drop,yuv420p)))
+$(foreach N,$(HEVC_SAMPLES_WPP_10BIT),$(eval $(call FATE_HEVC_WPP_THREADS_TEST,$(N),,yuv420p10le)))
+
 fate-hevc-paramchange-yuv420p-yuv420p10: CMD = framecrc -vsync 0 -i $(TARGET_SAMPLES)/hevc/paramchange_yuv420p_yuv420p10.hevc -sws_flags area+accurate_rnd+bitexact
 FATE_HEVC += fate-hevc-paramchange-yuv420p-yuv420p10
 
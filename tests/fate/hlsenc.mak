@@ -0,0 +1,17 @@
+# Partial segments of at most 0.3 s, listed in each republished playlist.
+FATE_HLSENC-$(call ALLYES, HLS_MUXER MP4_MUXER MPEG4_ENCODER TESTSRC_FILTER LAVFI_INDEV) += fate-hls-fmp4-parts
+fate-hls-fmp4-parts: CMD = segment_playlists -f lavfi -i testsrc=size=64x48:rate=25:d=2 -c:v mpeg4 -g 25 \
+    -f hls -hls_segment_type fmp4 -hls_time 1 -hls_part_time 0.3 \
+    -hls_fmp4_init_filename tests/data/fate/hls-fmp4-parts-init.mp4 \
+    -hls_segment_filename tests/data/fate/hls-fmp4-parts-%d.m4s
+
+# Segments and playlist written by writer threads, same as written synchronously.
+FATE_HLSENC-$(call ALLYES, HLS_MUXER MPEGTS_MUXER MPEG4_ENCODER TESTSRC_FILTER LAVFI_INDEV) += fate-hls-writer-threads fate-hls-writer-nothreads
+fate-hls-writer-threads: CMD = hls_files -f lavfi -i testsrc=size=64x48:rate=25:d=5 -c:v mpeg4 -g 25 \
+    -hls_time 1 -hls_list_size 0 -writer_threads 2
+fate-hls-writer-nothreads: CMD = hls_files -f lavfi -i testsrc=size=64x48:rate=25:d=5 -c:v mpeg4 -g 25 \
+    -hls_time 1 -hls_list_size 0
+fate-hls-writer-nothreads: REF = $(SRC_PATH)/tests/ref/fate/hls-writer-threads
+
+FATE_FFMPEG += $(FATE_HLSENC-yes)
+fate-hlsenc: $(FATE_HLSENC-yes)
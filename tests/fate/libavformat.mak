@@ -2,10 +2,24 @@
 #fate-async: libavformat/tests/async$(EXESUF)
 #fate-async: CMD = run libavformat/tests/async
 
+FATE_CACHE-$(call ALLYES, CACHE_PROTOCOL FILE_PROTOCOL PIPE_PROTOCOL) += fate-cache
+FATE_LIBAVFORMAT-$(HAVE_DIRENT_H) += $(FATE_CACHE-yes)
+fate-cache: libavformat/tests/cache$(EXESUF)
+fate-cache: CMD = run libavformat/tests/cache $(TARGET_PATH)/tests/data/fate/cache
+
+FATE_HTTPPOOL-$(CONFIG_HTTP_PROTOCOL) += fate-httppool
+FATE_LIBAVFORMAT-$(HAVE_PTHREADS) += $(FATE_HTTPPOOL-yes)
+fate-httppool: libavformat/tests/httppool$(EXESUF)
+fate-httppool: CMD = run libavformat/tests/httppool
+
 FATE_LIBAVFORMAT-$(CONFIG_NETWORK) += fate-noproxy
 fate-noproxy: libavformat/tests/noproxy$(EXESUF)
 fate-noproxy: CMD = run libavformat/tests/noproxy
 
+FATE_LIBAVFORMAT-$(call ALLYES, READAHEAD_PROTOCOL FILE_PROTOCOL) += fate-readahead
+fate-readahead: libavformat/tests/readahead$(EXESUF)
+fate-readahead: CMD = run libavformat/tests/readahead $(TARGET_PATH)/tests/data/fate/readahead.dat
+
 FATE_LIBAVFORMAT-$(CONFIG_FFRTMPCRYPT_PROTOCOL) += fate-rtmpdh
 fate-rtmpdh: libavformat/tests/rtmpdh$(EXESUF)
 fate-rtmpdh: CMD = run libavformat/tests/rtmpdh
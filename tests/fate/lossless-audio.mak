@@ -4,6 +4,11 @@ fate-lossless-alac: CMD = md5 -i $(TARGET_SAMPLES)/lossless-audio/inside.m4a -f
 FATE_SAMPLES_LOSSLESS_AUDIO-$(call DEMDEC, MLP, MLP) += fate-lossless-meridianaudio
 fate-lossless-meridianaudio: CMD = md5 -i $(TARGET_SAMPLES)/lossless-audio/luckynight-partial.mlp -f s16le
 
+# The substreams are decoded in parallel with slice threads
+FATE_SAMPLES_LOSSLESS_AUDIO-$(call DEMDEC, MLP, MLP) += fate-lossless-meridianaudio-slice-threads
+fate-lossless-meridianaudio-slice-threads: CMD = threads=4 thread_type=slice md5 -i $(TARGET_SAMPLES)/lossless-audio/luckynight-partial.mlp -f s16le
+fate-lossless-meridianaudio-slice-threads: REF = $(SRC_PATH)/tests/ref/fate/lossless-meridianaudio
+
 FATE_SAMPLES_LOSSLESS_AUDIO-$(call DEMDEC, RM, RALF) += fate-ralf
 fate-ralf: CMD = md5 -i $(TARGET_SAMPLES)/lossless-audio/luckynight-partial.rmvb -vn -f s16le
 
@@ -16,6 +21,9 @@ fate-lossless-tak: CMD = crc -i $(TARGET_SAMPLES)/lossless-audio/luckynight-part
 FATE_TRUEHD = fate-lossless-truehd-5.1 fate-lossless-truehd-5.1-downmix-2.0
 fate-lossless-truehd-5.1: CMD = md5 -f truehd -i $(TARGET_SAMPLES)/lossless-audio/truehd_5.1.raw -f s32le
 fate-lossless-truehd-5.1-downmix-2.0: CMD = md5 -f truehd -request_channel_layout 2 -i $(TARGET_SAMPLES)/lossless-audio/truehd_5.1.raw -f s32le
+FATE_TRUEHD += fate-lossless-truehd-5.1-slice-threads
+fate-lossless-truehd-5.1-slice-threads: CMD = threads=4 thread_type=slice md5 -f truehd -i $(TARGET_SAMPLES)/lossless-audio/truehd_5.1.raw -f s32le
+fate-lossless-truehd-5.1-slice-threads: REF = $(SRC_PATH)/tests/ref/fate/lossless-truehd-5.1
 fate-lossless-truehd: $(FATE_TRUEHD)
 FATE_SAMPLES_LOSSLESS_AUDIO-$(call DEMDEC, TRUEHD, TRUEHD) += $(FATE_TRUEHD)
 
@@ -47,6 +47,10 @@ fate-wmv3-drm-dec: CMD = framecrc -cryptokey 137381538c84c068111902a59c5cf6c3402
 FATE_WMV3_DRM += fate-wmv3-drm-nodec
 fate-wmv3-drm-nodec: CMD = framecrc -cryptokey 137381538c84c068111902a59c5cf6c340247c39 -i $(TARGET_SAMPLES)/wmv8/wmv_drm.wmv -c:a copy -c:v copy
 
+FATE_WMV3_DRM += fate-wmv3-drm-dec-frame-threads
+fate-wmv3-drm-dec-frame-threads: CMD = threads=4 thread_type=frame framecrc -cryptokey 137381538c84c068111902a59c5cf6c340247c39 -i $(TARGET_SAMPLES)/wmv8/wmv_drm.wmv -an -frames:v 129
+fate-wmv3-drm-dec-frame-threads: REF = $(SRC_PATH)/tests/ref/fate/wmv3-drm-dec
+
 FATE_SAMPLES_AVCONV-$(call DEMDEC, ASF, WMV3) += $(FATE_WMV3_DRM)
 fate-wmv3-drm: $(FATE_WMV3_DRM)
 
@@ -74,8 +78,21 @@ fate-vc1_ilaced_twomv: CMD = framecrc -flags +bitexact -i $(TARGET_SAMPLES)/vc1/
 FATE_VC1-$(CONFIG_MOV_DEMUXER) += fate-vc1-ism
 fate-vc1-ism: CMD = framecrc -i $(TARGET_SAMPLES)/isom/vc1-wmapro.ism -an
 
-FATE_MICROSOFT-$(CONFIG_VC1_DECODER) += $(FATE_VC1-yes)
+# Frame and slice threads must give the output of a single thread
+define FATE_VC1_THREADS_TEST
+FATE_VC1_THREADS-$(CONFIG_VC1_DEMUXER) += fate-vc1_$(1)-$(2)-threads
+fate-vc1_$(1)-$(2)-threads: CMD = threads=4 thread_type=$(2) framecrc $(3) -i $(TARGET_SAMPLES)/vc1/$(4).vc1
+fate-vc1_$(1)-$(2)-threads: REF = $(SRC_PATH)/tests/ref/fate/vc1_$(1)
+endef
+
+$(foreach T,frame slice,$(eval $(call FATE_VC1_THREADS_TEST,sa00040,$(T),,SA00040)))
+$(foreach T,frame slice,$(eval $(call FATE_VC1_THREADS_TEST,sa10143,$(T),,SA10143)))
+$(foreach T,frame slice,$(eval $(call FATE_VC1_THREADS_TEST,sa20021,$(T),,SA20021)))
+$(foreach T,frame slice,$(eval $(call FATE_VC1_THREADS_TEST,ilaced_twomv,$(T),-flags +bitexact,ilaced_twomv)))
+
+FATE_MICROSOFT-$(CONFIG_VC1_DECODER) += $(FATE_VC1-yes) $(FATE_VC1_THREADS-yes)
 fate-vc1: $(FATE_VC1-yes)
+fate-vc1-threads: $(FATE_VC1_THREADS-yes)
 
 FATE_MICROSOFT-$(CONFIG_ASF_DEMUXER) += fate-asf-repldata
 fate-asf-repldata: CMD = framecrc -i $(TARGET_SAMPLES)/asf/bug821-2.asf -c copy
@@ -11,4 +11,19 @@ fate-mpegts-probe-latm: CMD = run $(PROBE_CODEC_NAME_COMMAND) -i "$(SRC)"
 
 FATE_SAMPLES_FFPROBE += $(FATE_MPEGTS_PROBE-yes)
 
-fate-mpegts: $(FATE_MPEGTS_PROBE-yes)
+# A program selected with the programs option, demuxed without the others
+tests/data/mpegts-programs.ts: TAG = GEN
+tests/data/mpegts-programs.ts: ffmpeg$(PROGSSUF)$(EXESUF) | tests/data
+	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< -nostdin \
+        -f lavfi -i testsrc=size=64x48:rate=25:d=1 -f lavfi -i testsrc=size=32x24:rate=25:d=1 -map 0 -map 1 \
+        -c:v mpeg2video -program program_num=1:st=0 -program program_num=2:st=1 \
+        -flags +bitexact -fflags +bitexact -f mpegts -y $(TARGET_PATH)/$@ 2>/dev/null
+
+FATE_MPEGTS_PROGRAMS-$(call ALLYES, LAVFI_INDEV TESTSRC_FILTER MPEG2VIDEO_ENCODER MPEGTS_MUXER MPEGTS_DEMUXER) += fate-mpegts-programs fate-mpegts-programs-all
+$(FATE_MPEGTS_PROGRAMS-yes): tests/data/mpegts-programs.ts
+fate-mpegts-programs: CMD = framecrc -programs 2 -i $(TARGET_PATH)/tests/data/mpegts-programs.ts -map 0 -c copy
+fate-mpegts-programs-all: CMD = framecrc -i $(TARGET_PATH)/tests/data/mpegts-programs.ts -map 0 -c copy
+
+FATE_FFMPEG += $(FATE_MPEGTS_PROGRAMS-yes)
+
+fate-mpegts: $(FATE_MPEGTS_PROBE-yes) $(FATE_MPEGTS_PROGRAMS-yes)
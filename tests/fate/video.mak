@@ -256,6 +256,26 @@ fate-mimic: CMD = framecrc -idct simple -i $(TARGET_SAMPLES)/mimic/mimic2-womanl
 FATE_VIDEO-$(call DEMDEC, MOV, MJPEGB) += fate-mjpegb
 fate-mjpegb: CMD = framecrc -idct simple -fflags +bitexact -i $(TARGET_SAMPLES)/mjpegb/mjpegb_part.mov -an
 
+tests/data/mjpeg-rst.avi: TAG = GEN
+tests/data/mjpeg-rst.avi: ffmpeg$(PROGSSUF)$(EXESUF) tests/data/vsynth1.yuv | tests/data
+	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< -nostdin \
+        -f rawvideo -s 352x288 -pix_fmt yuv420p -i $(TARGET_PATH)/tests/data/vsynth1.yuv -frames:v 20 \
+        -c:v mjpeg -qscale 9 -pix_fmt yuvj420p -threads 2 -thread_type slice \
+        -flags +bitexact -fflags +bitexact -y $(TARGET_PATH)/$@ 2>/dev/null
+
+# Frame and slice threads must give the output of a single thread. The slice
+# threaded encoder writes a restart marker after each row of macroblocks.
+FATE_MJPEG_THREADS-$(call ENCDEC, MJPEG, AVI) += fate-mjpeg-rst fate-mjpeg-rst-frame-threads fate-mjpeg-rst-slice-threads
+$(FATE_MJPEG_THREADS-yes): tests/data/mjpeg-rst.avi
+fate-mjpeg-rst: CMD = framecrc -idct simple -i $(TARGET_PATH)/tests/data/mjpeg-rst.avi
+fate-mjpeg-rst-frame-threads: CMD = threads=4 thread_type=frame framecrc -idct simple -i $(TARGET_PATH)/tests/data/mjpeg-rst.avi
+fate-mjpeg-rst-frame-threads: REF = $(SRC_PATH)/tests/ref/fate/mjpeg-rst
+fate-mjpeg-rst-slice-threads: CMD = threads=4 thread_type=slice framecrc -idct simple -i $(TARGET_PATH)/tests/data/mjpeg-rst.avi
+fate-mjpeg-rst-slice-threads: REF = $(SRC_PATH)/tests/ref/fate/mjpeg-rst
+
+FATE_FFMPEG += $(FATE_MJPEG_THREADS-yes)
+fate-mjpeg-threads: $(FATE_MJPEG_THREADS-yes)
+
 FATE_VIDEO-$(call DEMDEC, MVI, MOTIONPIXELS) += fate-motionpixels
 fate-motionpixels: CMD = framecrc -i $(TARGET_SAMPLES)/motion-pixels/INTRO-partial.MVI -an -pix_fmt rgb24 -frames:v 111
 